@@ -0,0 +1,145 @@
+/**
+ * @file clock_sync.h
+ * @brief Device-to-host clock mapping from SYNC exchanges (host only)
+ *
+ * The firmware stamps its log with the low 32 bits of its us time since
+ * boot. The host sends "SYNC <id>" on the command line at its time t1; the
+ * firmware answers "SYNC <id> <t2> <t3>", the arrival of the request and the
+ * departure of the reply in device time, and the reply is read at host time
+ * t4. As in NTP, the round trip minus the time spent on the device,
+ * (t4 - t1) - (t3 - t2), is the transfer delay, and the device time
+ * (t2 + t3) / 2 matches the host time (t1 + t4) / 2 to within half of it.
+ *
+ * USB transfers wait for the next frame and behind queued log output, so
+ * the delay varies from one exchange to the next. The estimator keeps the
+ * last CLOCK_SYNC_WINDOW exchanges, takes those within
+ * CLOCK_SYNC_DELAY_SLACK_US of the shortest delay and fits a line through
+ * them: the offset of the device clock and its drift (the crystal is off by
+ * up to tens of ppm, a millisecond every minute). Device times are extended
+ * to 64 bits on the way, so the 71-minute wrap of the 32-bit stamps is
+ * invisible to the user.
+ */
+
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Exchanges kept for the fit
+ */
+#define CLOCK_SYNC_WINDOW 64
+
+/**
+ * @brief Exchanges before the first fit (one may have waited behind a busy device)
+ */
+#define CLOCK_SYNC_MIN_EXCHANGES 3
+
+/**
+ * @brief Exchanges used: delay at most this much above the shortest one (us)
+ */
+#define CLOCK_SYNC_DELAY_SLACK_US 250.0
+
+/**
+ * @brief Shortest span of device time the drift is estimated over (us)
+ */
+#define CLOCK_SYNC_SPAN_MIN_US 2e6
+
+/**
+ * @brief Largest drift accepted from a fit (relative, 1000 ppm)
+ */
+#define CLOCK_SYNC_DRIFT_MAX 1e-3
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        CLOCK_SYNC_OK = 0,                 /* Operation completed successfully */
+        CLOCK_SYNC_ERR_INVALID_PARAM = -1, /* Exchange with a negative round trip or hold time */
+        CLOCK_SYNC_ERR_NO_FIT = -2         /* Fewer than CLOCK_SYNC_MIN_EXCHANGES exchanges yet */
+    } clock_sync_err_t;
+
+    /**
+     * @brief One exchange
+     */
+    typedef struct
+    {
+        double dev_us;   /* Device time in the middle of the exchange (extended) */
+        double host_us;  /* Host time in the middle of the exchange */
+        double delay_us; /* Round trip minus the time on the device */
+    } clock_sync_sample_t;
+
+    /**
+     * @brief Clock mapping structure
+     */
+    typedef struct
+    {
+        clock_sync_sample_t samples[CLOCK_SYNC_WINDOW]; /* Last exchanges, circular */
+        uint32_t count;                                 /* Exchanges in the window */
+        uint32_t next;                                  /* Slot of the next exchange */
+        uint64_t ref;                                   /* Last extended device time */
+        uint8_t have_ref;                               /* ref is set */
+        uint8_t valid;                                  /* A fit exists */
+        double dev0;                                    /* Device time of the fit origin (us) */
+        double host0;                                   /* Host time at dev0 (us) */
+        double rate;                                    /* Host us per device us (1 + drift) */
+        double error_us;                                /* Half the shortest delay: bound of the offset error */
+        uint32_t exchanges;                             /* Exchanges added */
+        uint32_t used;                                  /* Exchanges in the last fit */
+    } clock_sync_t;
+
+    /**
+     * @brief Initialize the mapping (no fit, no device time seen)
+     *
+     * @param[out] cs Pointer to clock mapping structure
+     */
+    void clock_sync_init(clock_sync_t *cs);
+
+    /**
+     * @brief Extend a 32-bit device time to 64 bits
+     *
+     * Takes the value nearest to the last extended time, so device times
+     * must reach it less than 35 minutes apart (samples, exchanges).
+     *
+     * @param[in,out] cs Pointer to clock mapping structure
+     * @param[in] dev_us Device time (us, low 32 bits)
+     *
+     * @return Extended device time (us)
+     */
+    uint64_t clock_sync_extend(clock_sync_t *cs, uint32_t dev_us);
+
+    /**
+     * @brief Add an exchange and refit
+     *
+     * @param[in,out] cs Pointer to clock mapping structure
+     * @param[in] t1 Host time the request was sent (us)
+     * @param[in] t2 Device time the request arrived (us, low 32 bits)
+     * @param[in] t3 Device time the reply left (us, low 32 bits)
+     * @param[in] t4 Host time the reply was read (us)
+     *
+     * @return CLOCK_SYNC_OK on success, CLOCK_SYNC_ERR_INVALID_PARAM for an impossible exchange
+     */
+    clock_sync_err_t clock_sync_add(clock_sync_t *cs, double t1, uint32_t t2, uint32_t t3, double t4);
+
+    /**
+     * @brief Host time of an (extended) device time
+     *
+     * @param[in] cs Pointer to clock mapping structure
+     * @param[in] dev_us Device time (us)
+     * @param[out] host_us Host time (us)
+     *
+     * @return CLOCK_SYNC_OK on success, CLOCK_SYNC_ERR_NO_FIT before the first fit
+     */
+    clock_sync_err_t clock_sync_to_host(const clock_sync_t *cs, uint64_t dev_us, double *host_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CLOCK_SYNC_H */
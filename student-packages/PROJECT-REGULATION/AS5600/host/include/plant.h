@@ -0,0 +1,99 @@
+/**
+ * @file plant.h
+ * @brief Rigid-body pendulum and propeller model for the host simulator
+ *
+ * The pendulum hangs at the neutral angle with the motor off. The propeller
+ * thrust is expressed in the same "gravity units" as the firmware feedforward:
+ * 1.0 holds the pendulum 90 degrees away from the neutral position.
+ *
+ *   theta'' = w0^2 * (thrust + disturbance - sin(theta - neutral))
+ *             - damping * theta' - coulomb * sign(theta')
+ *
+ * The thrust follows the quadratic steady-state curve of the applied duty
+ * through a first-order motor lag. The host side uses double precision; only
+ * the firmware under test runs in fixed point.
+ */
+
+#ifndef PLANT_H
+#define PLANT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Integration step upper bound (s)
+ */
+#define PLANT_DT_MAX 1e-3
+
+    /**
+     * @brief Physical parameters
+     */
+    typedef struct
+    {
+        double neutral_deg;  /* Rest angle with the motor off (deg) */
+        double w0_sq;        /* m*g*l / J (rad/s^2 per gravity unit) */
+        double damping;      /* Viscous friction b / J (1/s) */
+        double coulomb;      /* Dry friction (rad/s^2) */
+        double thrust_max;   /* Thrust at full duty (gravity units) */
+        double deadzone;     /* Duty below which the propeller does not push */
+        double reverse_gain; /* Thrust ratio of reverse rotation */
+        double motor_tau;    /* Motor/propeller time constant (s) */
+    } plant_params_t;
+
+    /**
+     * @brief Plant state
+     */
+    typedef struct
+    {
+        plant_params_t p;   /* Parameters */
+        double time;        /* Simulated time (s) */
+        double theta;       /* Pendulum angle (deg) */
+        double omega;       /* Angular velocity (deg/s) */
+        double thrust;      /* Current thrust (gravity units) */
+        double duty;        /* Applied duty (-1..1, 0 while coasting) */
+        uint8_t brake;      /* Bridge in brake state */
+        double disturbance; /* External torque (gravity units), e.g. a push by hand */
+    } plant_t;
+
+    /**
+     * @brief Fill the parameters with values of the lab rig (about 0.2 m arm)
+     *
+     * @param[out] p Pointer to parameter structure
+     */
+    void plant_default_params(plant_params_t *p);
+
+    /**
+     * @brief Initialize the plant at rest in the neutral position
+     *
+     * @param[out] plant Pointer to plant structure
+     * @param[in] p Parameters
+     */
+    void plant_init(plant_t *plant, const plant_params_t *p);
+
+    /**
+     * @brief Steady-state thrust for a duty
+     *
+     * @param[in] p Pointer to parameter structure
+     * @param[in] duty Duty (-1..1)
+     *
+     * @return Thrust in gravity units
+     */
+    double plant_thrust_curve(const plant_params_t *p, double duty);
+
+    /**
+     * @brief Integrate the plant up to an absolute time
+     *
+     * @param[in,out] plant Pointer to plant structure
+     * @param[in] time Target time (s); earlier times are ignored
+     */
+    void plant_advance(plant_t *plant, double time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLANT_H */
@@ -0,0 +1,247 @@
+/**
+ * @file scenario.h
+ * @brief Scriptable test scenarios for the host simulator
+ *
+ * A scenario is a plain-text file, one statement per line ('#' starts a comment):
+ *
+ *   name <text>                    Scenario name
+ *   duration <s>                   Simulated time
+ *   gains <kp> <ki> <kd>           Initial PID gains
+ *   filter <alpha>                 Derivative filter coefficient (0-1, default 0.2)
+ *   ilimit <value>                 Integrator limit (output units, default 1)
+ *   band <deg>                     Settling band (default 1 deg)
+ *   plant <param> <value>          Plant parameter (neutral, w0_sq, damping, coulomb,
+ *                                  thrust_max, deadzone, reverse_gain, motor_tau)
+ *   sim <param> <value>            Simulation setting (i2c_hz, slow_filter, compute_us, noise,
+ *                                  offset, seed)
+ *   at <s> start | stop            Enable / disable the regulation
+ *   at <s> set <deg>               New target (starts a "step" event)
+ *   at <s> push <thrust> <s>       External torque in gravity units for a duration
+ *                                  (manual push; starts a "push" event)
+ *   at <s> supply <V>              Motor supply voltage (nominal 12 V; starts a "supply" event)
+ *   at <s> vcomp <0|1>             Supply voltage compensation on / off
+ *   at <s> ff <0|1>                Feedforward on / off
+ *   at <s> dob <0|1>               Disturbance observer compensation on / off
+ *   at <s> dobcfg <rad/s> <ms>     Observer bandwidth and modelled motor lag
+ *   at <s> ffdyn <kvel> <kacc>     Model thrust per deg/s and per deg/s^2
+ *   at <s> lqr <0|1>               State feedback instead of the PID stage on / off
+ *   at <s> lqrk <deg> <kpos> <kvel> <kthr>  State feedback gain table point
+ *   at <s> pred <pid> <lqr>        Latency compensation of the PID / state feedback on / off
+ *   at <s> osc <0|1> <backoff> <deg>  Oscillation detector on / off, automatic gain back-off
+ *                                  and amplitude threshold (0 keeps the default)
+ *   at <s> sched <0|1>             Gain schedule on / off
+ *   at <s> point <deg> <kp> <ki> <kd>  Gain schedule point
+ *   at <s> profile <0|1|2>         Setpoint profile (step, trapezoid, S-curve)
+ *   at <s> limits <vel> <acc> <jerk>   Setpoint profile limits
+ *   expect <metric> <'<'|'>'> <value>  Check a metric of the last declared event
+ *
+ * Metrics of a step event (measured angle against the commanded target, from
+ * the event to the next one or the end): overshoot (% of the step), rise (s,
+ * 10-90 %), settle (s, last exit from the band), error (mean |error| over the
+ * last 0.5 s, deg), iae (deg*s), itae (deg*s^2), effort (integral of duty^2, s).
+ * Push and supply events additionally report deviation (largest |error|, deg)
+ * and recover (s from the end of the push or the supply change to the last
+ * exit from the band).
+ */
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+#include "telemetry.h"
+
+/**
+ * @brief Limits of a scenario
+ */
+#define SCENARIO_MAX_ACTIONS 64
+#define SCENARIO_MAX_EVENTS 16
+#define SCENARIO_MAX_EXPECTS 32
+#define SCENARIO_NAME_LEN 48
+
+/**
+ * @brief Window at the end of an event used for the steady-state error (s)
+ */
+#define SCENARIO_SS_WINDOW 0.5
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        SCENARIO_OK = 0,                 /* Operation completed successfully */
+        SCENARIO_ERR_INVALID_PARAM = -1, /* Invalid parameter */
+        SCENARIO_ERR_FILE = -2,          /* File cannot be read */
+        SCENARIO_ERR_SYNTAX = -3,        /* Unknown or malformed statement */
+        SCENARIO_ERR_FULL = -4,          /* Too many actions, events or expectations */
+        SCENARIO_ERR_SIM = -5            /* Firmware bring-up failed */
+    } scenario_err_t;
+
+    /**
+     * @brief Enumeration for timed actions
+     */
+    typedef enum
+    {
+        SCENARIO_ACT_START = 0,
+        SCENARIO_ACT_STOP,
+        SCENARIO_ACT_SET,
+        SCENARIO_ACT_PUSH,
+        SCENARIO_ACT_FF,
+        SCENARIO_ACT_SCHED,
+        SCENARIO_ACT_POINT,
+        SCENARIO_ACT_PROFILE,
+        SCENARIO_ACT_LIMITS,
+        SCENARIO_ACT_DOB,
+        SCENARIO_ACT_DOBCFG,
+        SCENARIO_ACT_FFDYN,
+        SCENARIO_ACT_LQR,
+        SCENARIO_ACT_LQRK,
+        SCENARIO_ACT_PRED,
+        SCENARIO_ACT_OSC,
+        SCENARIO_ACT_SUPPLY,
+        SCENARIO_ACT_VCOMP
+    } scenario_act_t;
+
+    /**
+     * @brief Enumeration for metrics
+     */
+    typedef enum
+    {
+        SCENARIO_METRIC_OVERSHOOT = 0,
+        SCENARIO_METRIC_RISE,
+        SCENARIO_METRIC_SETTLE,
+        SCENARIO_METRIC_ERROR,
+        SCENARIO_METRIC_IAE,
+        SCENARIO_METRIC_ITAE,
+        SCENARIO_METRIC_EFFORT,
+        SCENARIO_METRIC_DEVIATION,
+        SCENARIO_METRIC_RECOVER,
+        SCENARIO_METRIC_COUNT
+    } scenario_metric_t;
+
+    /**
+     * @brief Timed action
+     */
+    typedef struct
+    {
+        double time;         /* Time of the action (s) */
+        scenario_act_t type; /* Action */
+        double arg[4];       /* Arguments */
+        int8_t event;        /* Index of the event started by the action, -1 if none */
+    } scenario_action_t;
+
+    /**
+     * @brief Metric check
+     */
+    typedef struct
+    {
+        uint8_t event;            /* Event index */
+        scenario_metric_t metric; /* Checked metric */
+        char op;                  /* '<' or '>' */
+        double limit;             /* Limit */
+    } scenario_expect_t;
+
+    /**
+     * @brief Controller tuning (the parameters a gain search varies)
+     */
+    typedef struct
+    {
+        pid_gains_t gains; /* PID gains */
+        fix16_t d_alpha;   /* Derivative filter coefficient */
+        fix16_t i_limit;   /* Integrator limit */
+    } scenario_tuning_t;
+
+    /**
+     * @brief Parsed scenario
+     */
+    typedef struct
+    {
+        char name[SCENARIO_NAME_LEN];                    /* Scenario name */
+        double duration;                                 /* Simulated time (s) */
+        double band;                                     /* Settling band (deg) */
+        scenario_tuning_t tuning;                        /* Initial tuning */
+        plant_params_t plant;                            /* Plant parameters */
+        sim_config_t sim;                                /* Simulation settings */
+        scenario_action_t actions[SCENARIO_MAX_ACTIONS]; /* Actions ordered by time */
+        uint8_t action_count;                            /* Number of actions */
+        uint8_t event_count;                             /* Number of events */
+        scenario_expect_t expects[SCENARIO_MAX_EXPECTS]; /* Checks */
+        uint8_t expect_count;                            /* Number of checks */
+    } scenario_t;
+
+    /**
+     * @brief Result of one event
+     */
+    typedef struct
+    {
+        scenario_act_t type;                  /* SET or PUSH */
+        double start;                         /* Event start (s) */
+        double end;                           /* Event end (s) */
+        double target;                        /* Target during the event (deg) */
+        double metric[SCENARIO_METRIC_COUNT]; /* Metrics */
+    } scenario_event_result_t;
+
+    /**
+     * @brief Result of a scenario run
+     */
+    typedef struct
+    {
+        scenario_event_result_t events[SCENARIO_MAX_EVENTS]; /* Per-event metrics */
+        uint8_t event_count;                                 /* Number of events */
+        uint8_t expect_pass[SCENARIO_MAX_EXPECTS];           /* Per-check result */
+        uint8_t passed;                                      /* All checks passed */
+        uint32_t ticks;                                      /* Simulated ticks */
+        uint32_t sensor_errors;                              /* Ticks with a failed sensor read */
+        double i2c_load;                                     /* Fraction of time the I2C bus was busy */
+        uint32_t oscillations;                               /* Oscillations confirmed by the detector */
+        double osc_freq;                                     /* Frequency of the last one (Hz) */
+        double osc_amplitude;                                /* Amplitude of the last one (deg) */
+        double gain_scale;                                   /* Loop gain scale at the end */
+    } scenario_result_t;
+
+    /**
+     * @brief Metric name as used in scenario files
+     *
+     * @param[in] metric Metric
+     *
+     * @return Name string
+     */
+    const char *scenario_metric_name(scenario_metric_t metric);
+
+    /**
+     * @brief Parse a scenario file
+     *
+     * @param[out] sc Pointer to scenario structure
+     * @param[in] path File path
+     * @param[out] line Line number of a syntax error (may be NULL)
+     *
+     * @return SCENARIO_OK on success, error code on failure
+     */
+    scenario_err_t scenario_load(scenario_t *sc, const char *path, uint32_t *line);
+
+    /**
+     * @brief Run a scenario and evaluate its checks
+     *
+     * @param[in] sc Pointer to scenario structure
+     * @param[in] tuning Tuning overriding the scenario one (NULL to use the scenario tuning)
+     * @param[out] res Pointer to result structure
+     * @param[in] trace CSV trace output in the firmware log format (NULL for none)
+     * @param[in,out] tlm Binary telemetry of the firmware log channels, every tick (NULL for none)
+     *
+     * @return SCENARIO_OK on success, error code on failure
+     */
+    scenario_err_t scenario_run(const scenario_t *sc, const scenario_tuning_t *tuning,
+                                scenario_result_t *res, FILE *trace, telemetry_t *tlm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCENARIO_H */
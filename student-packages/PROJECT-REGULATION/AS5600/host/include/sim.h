@@ -0,0 +1,147 @@
+/**
+ * @file sim.h
+ * @brief Closed-loop host simulation of the pendulum rig
+ *
+ * Runs the unmodified firmware modules (AS5600 driver, motor driver,
+ * regulator and everything below it) against the plant model. The AS5600 is
+ * emulated at register level behind the same I2C callbacks the Pico uses:
+ * every transaction advances the simulated clock by its bus time at the
+ * configured I2C frequency, and the angle registers return the plant angle
+ * at that instant, run through the slow filter selected in CONF, quantized to
+ * 4096 counts and with the configured hysteresis. PWM levels written by the
+ * motor driver are applied to the plant after the controller compute time,
+ * scaled by the motor supply voltage relative to the nominal one (the plant
+ * thrust curve is that of the nominal supply); the supply divider ADC reads
+ * the same voltage.
+ *
+ * The driver callbacks receive the simulation as their interface context,
+ * like the firmware passes each rig its own bus and PWM slice, so any number
+ * of independent simulations can run side by side and on different threads.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "AS5600.h"
+#include "motor.h"
+#include "supply.h"
+#include "regulator.h"
+#include "plant.h"
+
+/**
+ * @brief PWM counter top used by the firmware (20 kHz at 125 MHz)
+ */
+#define SIM_MOTOR_PWM_WRAP 6249
+
+/**
+ * @brief Motor supply: nominal voltage and divider scaling used by the firmware
+ */
+#define SIM_SUPPLY_NOMINAL_V 12.0
+#define SIM_SUPPLY_MV_PER_COUNT (3300.0 / 4096.0 * 122.0 / 22.0)
+
+    /**
+     * @brief Simulation settings (everything outside the plant physics)
+     */
+    typedef struct
+    {
+        uint32_t rate_hz;         /* Control tick rate */
+        uint32_t i2c_hz;          /* I2C clock */
+        uint8_t slow_filter;      /* AS5600 slow filter setting (as5600_slow_filter_t) */
+        double compute_s;         /* Time from the last sensor read to the PWM update (s) */
+        double noise_counts;      /* Sensor noise, standard deviation in counts */
+        double magnet_offset_deg; /* Sensor reading at the neutral position (deg) */
+        uint32_t seed;            /* Noise generator seed */
+    } sim_config_t;
+
+    /**
+     * @brief Simulation structure
+     */
+    typedef struct
+    {
+        sim_config_t cfg;     /* Settings */
+        plant_t plant;        /* Pendulum model */
+        as5600_dev_t sensor;  /* Firmware AS5600 driver instance */
+        motor_dev_t motor;    /* Firmware motor driver instance */
+        supply_t supply;      /* Firmware supply monitor instance */
+        regulator_t reg;      /* Firmware regulation loop */
+        double clock;         /* Simulated time of the firmware (s) */
+        uint32_t ticks;       /* Executed control ticks */
+        uint8_t regs[256];    /* AS5600 register file */
+        uint8_t status;       /* AS5600 STATUS register value */
+        double filt_deg;      /* Slow filter output (unwrapped, deg) */
+        int32_t counts;       /* Last output angle in counts (after hysteresis) */
+        uint32_t rng;         /* Noise generator state */
+        uint32_t i2c_xfers;   /* Number of I2C transactions */
+        double i2c_busy_s;    /* Accumulated I2C bus time (s) */
+        double supply_v;      /* Motor supply voltage (V) */
+    } sim_t;
+
+    /**
+     * @brief Fill the settings with the values of the firmware
+     *
+     * @param[out] cfg Pointer to settings structure
+     */
+    void sim_default_config(sim_config_t *cfg);
+
+    /**
+     * @brief Initialize the plant and bring up the firmware like main() does
+     *
+     * Initializes the drivers through the emulated I2C bus, configures the
+     * sensor, initializes the regulator and calibrates it in the neutral position.
+     *
+     * @param[out] sim Pointer to simulation structure
+     * @param[in] params Plant parameters
+     * @param[in] cfg Simulation settings
+     * @param[in] gains Initial PID gains
+     *
+     * @return AS5600_OK on success, error code of the failing driver call
+     */
+    as5600_err_t sim_init(sim_t *sim, const plant_params_t *params, const sim_config_t *cfg,
+                          const pid_gains_t *gains);
+
+    /**
+     * @brief Run one control tick (the plant is integrated lazily up to each observation)
+     *
+     * @param[in,out] sim Pointer to simulation structure
+     *
+     * @return Result of regulator_tick()
+     */
+    as5600_err_t sim_tick(sim_t *sim);
+
+    /**
+     * @brief Apply an external torque from the current tick on
+     *
+     * @param[in,out] sim Pointer to simulation structure
+     * @param[in] thrust Torque in gravity units
+     */
+    void sim_set_disturbance(sim_t *sim, double thrust);
+
+    /**
+     * @brief Change the motor supply voltage from the current tick on
+     *
+     * @param[in,out] sim Pointer to simulation structure
+     * @param[in] volts Supply voltage (V)
+     */
+    void sim_set_supply(sim_t *sim, double volts);
+
+    /**
+     * @brief Simulated time of the next tick start (s)
+     *
+     * @param[in] sim Pointer to simulation structure
+     *
+     * @return Time in seconds
+     */
+    double sim_time(const sim_t *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_H */
@@ -0,0 +1,146 @@
+/**
+ * @file tlm_stream.h
+ * @brief Incremental decoder of the firmware telemetry stream (host only)
+ *
+ * Bytes from the serial port (or a capture file) are fed in any chunking.
+ * The decoder splits them at the zero delimiters, COBS decodes and CRC
+ * checks each piece and keeps the schema of every stream. Sample frames of
+ * a known schema are handed to the sample callback as values in physical
+ * units; pieces that are not frames but printable are handed to the text
+ * callback (command replies and reports of the firmware), anything else is
+ * counted as a corrupt frame. Text is also handed over at each line end, so
+ * a text-only stream (no delimiters) is delivered line by line. Delta
+ * frames are expanded against the last sample of the stream; after a
+ * sequence gap they are dropped until the next keyframe. See telemetry.h
+ * for the frame layout.
+ */
+
+#ifndef TLM_STREAM_H
+#define TLM_STREAM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+/**
+ * @brief Longest piece between two delimiters that is kept (text included)
+ */
+#define TLM_STREAM_CHUNK_MAX 1024
+
+/**
+ * @brief Number of stream ids
+ */
+#define TLM_STREAM_IDS 256
+
+    /**
+     * @brief Decoded channel description
+     */
+    typedef struct
+    {
+        char name[TELEMETRY_NAME_MAX + 1]; /* Column name */
+        uint8_t type;                      /* Wire type (telemetry_type_t) */
+        uint8_t frac_bits;                 /* Fractional bits on the wire */
+    } tlm_channel_t;
+
+    /**
+     * @brief Decoded schema of one stream
+     */
+    typedef struct
+    {
+        uint8_t valid;                                  /* A schema has been received */
+        uint8_t id;                                     /* Schema id */
+        uint8_t count;                                  /* Number of channels */
+        uint8_t sample_size;                            /* Payload bytes of a sample frame */
+        tlm_channel_t channels[TELEMETRY_MAX_CHANNELS]; /* Channel list */
+    } tlm_schema_t;
+
+    /**
+     * @brief Callbacks of the decoder (any may be NULL)
+     */
+    typedef struct
+    {
+        void (*schema)(void *ctx, uint8_t stream, const tlm_schema_t *schema);
+        void (*sample)(void *ctx, uint8_t stream, uint16_t seq, const tlm_schema_t *schema, const double *values);
+        void (*text)(void *ctx, const char *text, size_t len);
+    } tlm_callbacks_t;
+
+    /**
+     * @brief Decoder statistics
+     */
+    typedef struct
+    {
+        uint64_t bytes;          /* Bytes fed */
+        uint64_t samples;        /* Sample frames decoded */
+        uint64_t schemas;        /* Schema frames decoded */
+        uint64_t lost;           /* Frames missing in the sequence numbers */
+        uint64_t corrupt;        /* Pieces that are neither frames nor text */
+        uint64_t unknown_schema; /* Samples before their schema or with another schema id */
+        uint64_t stale;          /* Delta samples dropped while waiting for a keyframe */
+        uint64_t delta_frames;   /* Delta frames decoded */
+        uint64_t text;           /* Text pieces */
+    } tlm_stats_t;
+
+    /**
+     * @brief Decoder structure
+     */
+    typedef struct
+    {
+        tlm_callbacks_t cb;                                  /* Callbacks */
+        void *ctx;                                           /* Context passed to the callbacks */
+        uint8_t chunk[TLM_STREAM_CHUNK_MAX];                 /* Bytes since the last delimiter */
+        size_t len;                                          /* Bytes in chunk */
+        uint8_t overflow;                                    /* Piece longer than the chunk (dropped) */
+        uint8_t binary;                                      /* Piece holds a byte that is not text */
+        tlm_schema_t schema[TLM_STREAM_IDS];                 /* Schema per stream */
+        int32_t next_seq[TLM_STREAM_IDS];                    /* Expected sequence number, -1 if unknown */
+        int32_t ref[TLM_STREAM_IDS][TELEMETRY_MAX_CHANNELS]; /* Wire values of the last sample per stream */
+        int32_t step[TLM_STREAM_IDS];                        /* Last difference of the time stamp channel */
+        uint8_t ref_valid[TLM_STREAM_IDS];                   /* Last sample known (deltas can be expanded) */
+        tlm_stats_t stats;                                   /* Statistics */
+    } tlm_stream_t;
+
+    /**
+     * @brief Initialize the decoder
+     *
+     * @param[out] s Pointer to decoder structure
+     * @param[in] cb Callbacks (copied; NULL for none)
+     * @param[in] ctx Context passed to the callbacks
+     */
+    void tlm_stream_init(tlm_stream_t *s, const tlm_callbacks_t *cb, void *ctx);
+
+    /**
+     * @brief Feed received bytes
+     *
+     * @param[in,out] s Pointer to decoder structure
+     * @param[in] data Received bytes
+     * @param[in] len Number of bytes
+     */
+    void tlm_stream_feed(tlm_stream_t *s, const uint8_t *data, size_t len);
+
+    /**
+     * @brief Handle the bytes after the last delimiter (end of input)
+     *
+     * @param[in,out] s Pointer to decoder structure
+     */
+    void tlm_stream_flush(tlm_stream_t *s);
+
+    /**
+     * @brief Decimal places that resolve a channel (at least 2, like the text log)
+     *
+     * @param[in] ch Pointer to channel description
+     *
+     * @return Number of decimal places (0 for integer channels)
+     */
+    int tlm_channel_decimals(const tlm_channel_t *ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TLM_STREAM_H */
@@ -0,0 +1,104 @@
+/**
+ * @file work_pool.h
+ * @brief Work-stealing thread pool for batches of independent jobs (host only)
+ *
+ * A batch of jobs 0..count-1 is dealt out in contiguous blocks, one per
+ * worker. Each worker takes jobs from the back of its own queue; a worker
+ * whose queue runs dry steals half of the remaining jobs from the front of
+ * the fullest other queue. Jobs of very different length (a diverging
+ * simulation stops early, a slow one runs to the end) so keep every core
+ * busy until the whole batch is done.
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * @brief Maximum number of worker threads
+ */
+#define WORK_POOL_MAX_WORKERS 64
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        WORK_POOL_OK = 0,                 /* Operation completed successfully */
+        WORK_POOL_ERR_INVALID_PARAM = -1, /* Invalid parameter */
+        WORK_POOL_ERR_THREAD = -2         /* Thread creation failed */
+    } work_pool_err_t;
+
+    /**
+     * @brief Job function
+     *
+     * @param[in] ctx User context passed to work_pool_run()
+     * @param[in] job Job index
+     * @param[in] worker Index of the worker running the job
+     */
+    typedef void (*work_pool_fn_t)(void *ctx, uint32_t job, uint32_t worker);
+
+    /**
+     * @brief Job queue of one worker (range of job indices)
+     */
+    typedef struct
+    {
+        pthread_mutex_t lock; /* Protects head and tail */
+        uint32_t head;        /* First job not taken (stolen from here) */
+        uint32_t tail;        /* One past the last job (owner pops here) */
+    } work_queue_t;
+
+    /**
+     * @brief Thread pool structure
+     */
+    typedef struct
+    {
+        uint32_t workers;                           /* Number of worker threads */
+        work_queue_t queues[WORK_POOL_MAX_WORKERS]; /* Per-worker queues */
+        work_pool_fn_t fn;                          /* Job function of the running batch */
+        void *ctx;                                  /* Context of the running batch */
+        uint32_t steals;                            /* Successful steals since init */
+        pthread_mutex_t stats_lock;                 /* Protects the statistics */
+    } work_pool_t;
+
+    /**
+     * @brief Initialize the pool
+     *
+     * @param[out] pool Pointer to pool structure
+     * @param[in] workers Number of worker threads (0 = one per online CPU)
+     *
+     * @return WORK_POOL_OK on success, error code on failure
+     */
+    work_pool_err_t work_pool_init(work_pool_t *pool, uint32_t workers);
+
+    /**
+     * @brief Run a batch of jobs and wait until all of them are done
+     *
+     * @param[in,out] pool Pointer to pool structure
+     * @param[in] count Number of jobs
+     * @param[in] fn Job function
+     * @param[in] ctx User context passed to the job function
+     *
+     * @return WORK_POOL_OK on success, error code on failure
+     */
+    work_pool_err_t work_pool_run(work_pool_t *pool, uint32_t count, work_pool_fn_t fn, void *ctx);
+
+    /**
+     * @brief Release the pool resources
+     *
+     * @param[in,out] pool Pointer to pool structure
+     */
+    void work_pool_deinit(work_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WORK_POOL_H */
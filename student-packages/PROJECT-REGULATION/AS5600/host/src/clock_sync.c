@@ -0,0 +1,192 @@
+/**
+ * @file clock_sync.c
+ * @brief Device-to-host clock mapping implementation
+ */
+
+#include <math.h>
+#include <stddef.h>
+
+#include "clock_sync.h"
+
+/**
+ * @brief Fit offset and drift through the exchanges with a short delay
+ *
+ * Least squares of host time over device time, both relative to the newest
+ * exchange used (keeps the sums small). Without enough span for a slope the
+ * previous drift is kept (none at first).
+ *
+ * @param[in,out] cs Pointer to clock mapping structure
+ */
+static void clock_sync_fit(clock_sync_t *cs)
+{
+    const clock_sync_sample_t *ref = NULL;
+    double min_delay = INFINITY;
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    double lo = INFINITY, hi = -INFINITY;
+    double rate, mx, my;
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < cs->count; i++)
+    {
+        if (cs->samples[i].delay_us < min_delay)
+        {
+            min_delay = cs->samples[i].delay_us;
+        }
+    }
+
+    for (uint32_t i = 0; i < cs->count; i++)
+    {
+        const clock_sync_sample_t *s = &cs->samples[i];
+
+        if (s->delay_us <= min_delay + CLOCK_SYNC_DELAY_SLACK_US && (!ref || s->dev_us > ref->dev_us))
+        {
+            ref = s;
+        }
+    }
+
+    for (uint32_t i = 0; i < cs->count; i++)
+    {
+        const clock_sync_sample_t *s = &cs->samples[i];
+        double x, y;
+
+        if (s->delay_us > min_delay + CLOCK_SYNC_DELAY_SLACK_US)
+        {
+            continue;
+        }
+
+        x = s->dev_us - ref->dev_us;
+        y = s->host_us - ref->host_us;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        lo = fmin(lo, x);
+        hi = fmax(hi, x);
+        n++;
+    }
+
+    mx = sx / n;
+    my = sy / n;
+    rate = cs->valid ? cs->rate : 1.0;
+    if (n >= 2 && hi - lo >= CLOCK_SYNC_SPAN_MIN_US)
+    {
+        double slope = (sxy - n * mx * my) / (sxx - n * mx * mx);
+
+        if (fabs(slope - 1.0) <= CLOCK_SYNC_DRIFT_MAX)
+        {
+            rate = slope;
+        }
+    }
+
+    cs->dev0 = ref->dev_us;
+    cs->host0 = ref->host_us + my - rate * mx;
+    cs->rate = rate;
+    cs->error_us = min_delay / 2.0;
+    cs->used = n;
+    cs->valid = 1;
+}
+
+/**
+ * @brief Initialize the mapping (no fit, no device time seen)
+ *
+ * @param[out] cs Pointer to clock mapping structure
+ */
+void clock_sync_init(clock_sync_t *cs)
+{
+    cs->count = 0;
+    cs->next = 0;
+    cs->ref = 0;
+    cs->have_ref = 0;
+    cs->valid = 0;
+    cs->dev0 = 0.0;
+    cs->host0 = 0.0;
+    cs->rate = 1.0;
+    cs->error_us = 0.0;
+    cs->exchanges = 0;
+    cs->used = 0;
+}
+
+/**
+ * @brief Extend a 32-bit device time to 64 bits
+ *
+ * @param[in,out] cs Pointer to clock mapping structure
+ * @param[in] dev_us Device time (us, low 32 bits)
+ *
+ * @return Extended device time (us)
+ */
+uint64_t clock_sync_extend(clock_sync_t *cs, uint32_t dev_us)
+{
+    if (!cs->have_ref)
+    {
+        cs->ref = dev_us;
+        cs->have_ref = 1;
+        return cs->ref;
+    }
+
+    /* Nearest value: the signed 32-bit difference to the last one */
+    cs->ref += (int64_t)(int32_t)(dev_us - (uint32_t)cs->ref);
+
+    return cs->ref;
+}
+
+/**
+ * @brief Add an exchange and refit
+ *
+ * @param[in,out] cs Pointer to clock mapping structure
+ * @param[in] t1 Host time the request was sent (us)
+ * @param[in] t2 Device time the request arrived (us, low 32 bits)
+ * @param[in] t3 Device time the reply left (us, low 32 bits)
+ * @param[in] t4 Host time the reply was read (us)
+ *
+ * @return CLOCK_SYNC_OK on success, CLOCK_SYNC_ERR_INVALID_PARAM for an impossible exchange
+ */
+clock_sync_err_t clock_sync_add(clock_sync_t *cs, double t1, uint32_t t2, uint32_t t3, double t4)
+{
+    clock_sync_sample_t *s = &cs->samples[cs->next];
+    double hold = (double)(uint32_t)(t3 - t2);
+    uint64_t rx;
+
+    if (t4 < t1 || hold > t4 - t1)
+    {
+        return CLOCK_SYNC_ERR_INVALID_PARAM;
+    }
+
+    rx = clock_sync_extend(cs, t2);
+    s->dev_us = (double)rx + hold / 2.0;
+    s->host_us = (t1 + t4) / 2.0;
+    s->delay_us = (t4 - t1) - hold;
+
+    cs->next = (cs->next + 1) % CLOCK_SYNC_WINDOW;
+    if (cs->count < CLOCK_SYNC_WINDOW)
+    {
+        cs->count++;
+    }
+    cs->exchanges++;
+    if (cs->count >= CLOCK_SYNC_MIN_EXCHANGES)
+    {
+        clock_sync_fit(cs);
+    }
+
+    return CLOCK_SYNC_OK;
+}
+
+/**
+ * @brief Host time of an (extended) device time
+ *
+ * @param[in] cs Pointer to clock mapping structure
+ * @param[in] dev_us Device time (us)
+ * @param[out] host_us Host time (us)
+ *
+ * @return CLOCK_SYNC_OK on success, CLOCK_SYNC_ERR_NO_FIT before the first fit
+ */
+clock_sync_err_t clock_sync_to_host(const clock_sync_t *cs, uint64_t dev_us, double *host_us)
+{
+    if (!cs->valid)
+    {
+        return CLOCK_SYNC_ERR_NO_FIT;
+    }
+
+    *host_us = cs->host0 + cs->rate * ((double)dev_us - cs->dev0);
+
+    return CLOCK_SYNC_OK;
+}
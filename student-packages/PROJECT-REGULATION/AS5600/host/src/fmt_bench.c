@@ -0,0 +1,247 @@
+/**
+ * @brief Check and benchmark of the firmware text formatter against printf (Linux host)
+ *
+ * Compares the output of fmt.c with snprintf for the conversions the
+ * firmware replaced (Q16.16 values through FIX16_TO_FLOAT with 0 - 6
+ * decimals, decimal fixed point, integers): edge cases (rounding ties, the
+ * 24-bit float boundary, the ends of the range) and pseudo-random values.
+ * Then it formats the text log line (time and four Q16.16 values, as the
+ * firmware LOG_SAMPLE line) both ways and prints the time per line.
+ *
+ * Usage: fmt_bench [-n values] [-l lines]
+ *   -n  pseudo-random values per conversion (default 1000000)
+ *   -l  log lines timed (default 1000000)
+ *
+ * Exit status: 0 if every output matched, 1 on a mismatch, 2 on errors.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fmt.h"
+
+/**
+ * @brief Mismatches found
+ */
+static unsigned long mismatches;
+
+/**
+ * @brief Next pseudo-random number (xorshift32, repeatable)
+ *
+ * @param state Generator state (not zero)
+ * @return Pseudo-random 32-bit value
+ */
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Compare a formatted value with the printf output and report a difference
+ *
+ * @param what Conversion
+ * @param value Input value
+ * @param got fmt output
+ * @param want printf output
+ */
+static void compare(const char *what, long value, const char *got, const char *want)
+{
+    if (strcmp(got, want) != 0)
+    {
+        if (mismatches < 20)
+        {
+            fprintf(stderr, "%s(%ld): \"%s\", printf \"%s\"\n", what, value, got, want);
+        }
+        mismatches++;
+    }
+}
+
+/**
+ * @brief Check one value through every conversion
+ *
+ * @param value Input value
+ */
+static void check_value(int32_t value)
+{
+    char got[64], want[64];
+    fmt_line_t line;
+
+    for (uint8_t d = 0; d <= 6; d++)
+    {
+        fmt_init(&line, got, sizeof(got));
+        fmt_fix16(&line, value, d);
+        snprintf(want, sizeof(want), "%.*f", d, FIX16_TO_FLOAT(value));
+        compare("fmt_fix16", value, got, want);
+
+        // Decimal fixed point as the capture dump used it (exact below 2^23)
+        if (value > -(1 << 23) && value < (1 << 23) && d <= 5)
+        {
+            static const float scale[] = {1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f, 100000.0f};
+
+            fmt_init(&line, got, sizeof(got));
+            fmt_decimal(&line, value, d);
+            snprintf(want, sizeof(want), "%.*f", d, value / scale[d]);
+            compare("fmt_decimal", value, got, want);
+        }
+    }
+
+    fmt_init(&line, got, sizeof(got));
+    fmt_i32(&line, value);
+    snprintf(want, sizeof(want), "%ld", (long)value);
+    compare("fmt_i32", value, got, want);
+
+    fmt_init(&line, got, sizeof(got));
+    fmt_u32(&line, (uint32_t)value);
+    snprintf(want, sizeof(want), "%lu", (unsigned long)(uint32_t)value);
+    compare("fmt_u32", value, got, want);
+}
+
+/**
+ * @brief Seconds of a monotonic clock
+ *
+ * @return Time in seconds
+ */
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Format the text log line with fmt
+ *
+ * @param buf Output buffer
+ * @param size Buffer size
+ * @param time Time stamp (ms)
+ * @param v Setpoint, angle, command and supply (Q16.16)
+ */
+static void format_line(char *buf, uint16_t size, uint32_t time, const int32_t *v)
+{
+    fmt_line_t line;
+
+    fmt_init(&line, buf, size);
+    fmt_u32(&line, time);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        fmt_char(&line, ',');
+        fmt_fix16(&line, v[i], 2);
+    }
+    fmt_char(&line, '\n');
+}
+
+int main(int argc, char **argv)
+{
+    static const int32_t edges[] = {
+        0, 1, -1, 2, -2, 0x8000, -0x8000, 0x7FFF, 0x10000, -0x10000,
+        0x2000, 0x6000, 0xA000, 0xE000, 0x4000, 0xC000, 0x1000, 0x3000, // ties at 2 and 1 decimals
+        0x147, 0x148, 0x28F, 0x290, 0x51E, 0x51F,                       // around 0.005, 0.01, 0.02
+        0xFFFF, 0x1FFFF, 0x63FFF, 0x64000, 0x9FFFF, 0xA0000,            // carries into the integer part
+        (1 << 24) - 1, 1 << 24, (1 << 24) + 1, (1 << 24) + 2, (1 << 24) + 3,
+        (1 << 25) + 2, (1 << 25) + 6, (1 << 25) + 10, -(1 << 24) - 1, -(1 << 25) - 2,
+        INT32_MAX, INT32_MIN, INT32_MAX - 64, INT32_MIN + 64, INT32_MIN + 1,
+    };
+    long values = 1000000, lines = 1000000;
+    uint32_t state = 0x2545F491u;
+    char got[128], want[128];
+    int32_t v[4];
+    double start, t_printf, t_fmt;
+    volatile uint32_t sink = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            values = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+        {
+            lines = atol(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-n values] [-l lines]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (lines < 1)
+    {
+        lines = 1;
+    }
+
+    // Edge cases, all small values, then random values over the whole range and the log range
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+    {
+        check_value(edges[i]);
+        check_value(-edges[i]);
+    }
+    for (int32_t i = -70000; i <= 70000; i++)
+    {
+        check_value(i);
+    }
+    for (long i = 0; i < values; i++)
+    {
+        uint32_t r = next_random(&state);
+
+        check_value((int32_t)r);
+        check_value((int32_t)r >> (r & 15));
+    }
+    printf("Checked %ld values: %lu differ from printf\n", values * 2 + 140001 +
+           (long)(2 * sizeof(edges) / sizeof(edges[0])), mismatches);
+
+    // Log line timing on typical values (angles within +-180 deg, duty within +-1, supply ~12 V)
+    start = now_s();
+    for (long i = 0; i < lines; i++)
+    {
+        v[0] = (int32_t)(next_random(&state) % (360u << 16)) - (180 << 16);
+        v[1] = v[0] + (int32_t)(next_random(&state) & 0x3FFFF) - 0x20000;
+        v[2] = (int32_t)(next_random(&state) & 0x1FFFF) - 0x10000;
+        v[3] = (12 << 16) + (int32_t)(next_random(&state) & 0xFFFF);
+        snprintf(want, sizeof(want), "%lu,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)i, FIX16_TO_FLOAT(v[0]),
+                 FIX16_TO_FLOAT(v[1]), FIX16_TO_FLOAT(v[2]), FIX16_TO_FLOAT(v[3]));
+        sink += (uint8_t)want[0];
+    }
+    t_printf = now_s() - start;
+
+    state = 0x2545F491u;
+    start = now_s();
+    for (long i = 0; i < lines; i++)
+    {
+        v[0] = (int32_t)(next_random(&state) % (360u << 16)) - (180 << 16);
+        v[1] = v[0] + (int32_t)(next_random(&state) & 0x3FFFF) - 0x20000;
+        v[2] = (int32_t)(next_random(&state) & 0x1FFFF) - 0x10000;
+        v[3] = (12 << 16) + (int32_t)(next_random(&state) & 0xFFFF);
+        format_line(got, sizeof(got), (uint32_t)i, v);
+        sink += (uint8_t)got[0];
+    }
+    t_fmt = now_s() - start;
+
+    // Same lines both ways
+    state = 0x2545F491u;
+    for (long i = 0; i < lines && i < 100000; i++)
+    {
+        v[0] = (int32_t)(next_random(&state) % (360u << 16)) - (180 << 16);
+        v[1] = v[0] + (int32_t)(next_random(&state) & 0x3FFFF) - 0x20000;
+        v[2] = (int32_t)(next_random(&state) & 0x1FFFF) - 0x10000;
+        v[3] = (12 << 16) + (int32_t)(next_random(&state) & 0xFFFF);
+        snprintf(want, sizeof(want), "%lu,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)i, FIX16_TO_FLOAT(v[0]),
+                 FIX16_TO_FLOAT(v[1]), FIX16_TO_FLOAT(v[2]), FIX16_TO_FLOAT(v[3]));
+        format_line(got, sizeof(got), (uint32_t)i, v);
+        compare("log line", i, got, want);
+    }
+
+    printf("Log line: printf %.1f ns, fmt %.1f ns (%.1fx)\n", t_printf * 1e9 / lines, t_fmt * 1e9 / lines,
+           t_fmt > 0 ? t_printf / t_fmt : 0.0);
+    printf("%s\n", mismatches ? "MISMATCH" : "identical output");
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,552 @@
+/**
+ * @brief State feedback (LQR) design for the firmware gain table (Linux host)
+ *
+ * Reads the "plant" statements of a plant file (as written by sysid_fit; a
+ * scenario file works as well, other statements are skipped) and designs the
+ * gains of the observer-based state feedback (include/lqr.h) on a grid of
+ * reference angles. At each angle c = theta - neutral the model
+ *
+ *   angle'' = w0_sq * DEG_PER_RAD * (thrust - sin(c)) - damping * angle'
+ *   thrust' = (command - thrust) / motor_tau
+ *
+ * is linearized around its equilibrium (state: angle error in deg, velocity
+ * in deg/s, thrust deviation in gravity units; input: thrust command),
+ * discretized at the tick rate and the discrete algebraic Riccati equation is
+ * solved by iteration. The weights follow Bryson's rule: the largest
+ * acceptable angle error, velocity and thrust command deviation each cost 1.
+ * Dry friction and the thrust curve are left to the observer's bias estimate
+ * and the firmware thrust table.
+ *
+ * The result is printed as serial commands for the firmware (FFDYN, DOBCFG,
+ * LQRK, then LQR 1 enables it) or, with -s, as timed scenario statements for
+ * pendulum_sim.
+ *
+ * Usage: lqr_design [options] plant.txt
+ *   -a <from:to:step>  grid of angles from the neutral position (default 5:85:10)
+ *   -e <deg>           largest acceptable angle error (default 2)
+ *   -v <deg/s>         largest acceptable velocity error (default 60)
+ *   -u <thrust>        largest acceptable thrust command deviation (default 0.3)
+ *   -b <rad/s>         observer bandwidth (default 50)
+ *   -r <Hz>            tick rate (default 1000)
+ *   -s                 print scenario statements instead of serial commands
+ *   -o <file>          write the statements to a file
+ *
+ * Exit status: 0 on success, 1 if the design failed at a grid point, 2 on errors.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Limits of a design
+ */
+#define LQR_STATES 3
+#define LQR_GRID_MAX 16
+#define LQR_LINE_LEN 256
+#define LQR_DARE_ITERATIONS 1000000
+#define LQR_DARE_TOLERANCE 1e-11
+#define LQR_EXPM_TERMS 16
+
+/**
+ * @brief Unit conversion
+ */
+#define LQR_DEG_PER_RAD (180.0 / M_PI)
+
+/**
+ * @brief Plant parameters used by the design (simulator defaults)
+ */
+typedef struct
+{
+    double neutral;   /* Rest angle with the motor off (deg) */
+    double w0_sq;     /* Gravity stiffness (rad/s^2 per gravity unit) */
+    double damping;   /* Viscous friction (1/s) */
+    double motor_tau; /* Motor time constant (s) */
+} design_plant_t;
+
+/**
+ * @brief Discrete model and gains of one grid point
+ */
+typedef struct
+{
+    double a[LQR_STATES][LQR_STATES]; /* State transition per tick */
+    double b[LQR_STATES];             /* Input per tick */
+    double k[LQR_STATES];             /* State feedback gains */
+    double rho;                       /* Spectral radius of the closed loop */
+    int valid;                        /* Riccati iteration converged */
+} design_point_t;
+
+/**
+ * @brief Read the plant statements of a file
+ *
+ * @param path File path
+ * @param p Pointer to plant parameters (keeps the defaults of missing ones)
+ *
+ * @return Number of plant statements read, -1 if the file cannot be read
+ */
+static int design_read_plant(const char *path, design_plant_t *p)
+{
+    FILE *f = fopen(path, "r");
+    char line[LQR_LINE_LEN], name[32];
+    double value;
+    int count = 0;
+
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (sscanf(line, " plant %31s %lf", name, &value) != 2)
+        {
+            continue;
+        }
+
+        if (strcmp(name, "neutral") == 0)
+        {
+            p->neutral = value;
+        }
+        else if (strcmp(name, "w0_sq") == 0)
+        {
+            p->w0_sq = value;
+        }
+        else if (strcmp(name, "damping") == 0)
+        {
+            p->damping = value;
+        }
+        else if (strcmp(name, "motor_tau") == 0)
+        {
+            p->motor_tau = value;
+        }
+        else
+        {
+            /* Dry friction, thrust curve: handled by the firmware, not by the gains */
+            continue;
+        }
+        count++;
+    }
+
+    fclose(f);
+    return count;
+}
+
+/**
+ * @brief Matrix exponential of the augmented [A B; 0 0] * dt (scaling and squaring)
+ *
+ * @param a Continuous state matrix
+ * @param b Continuous input vector
+ * @param dt Tick period (s)
+ * @param pt Grid point receiving the discrete model
+ */
+static void design_discretize(const double a[LQR_STATES][LQR_STATES], const double b[LQR_STATES], double dt,
+                              design_point_t *pt)
+{
+    enum
+    {
+        N = LQR_STATES + 1
+    };
+    double m[N][N] = {{0}}, e[N][N] = {{0}}, term[N][N], tmp[N][N];
+    double norm = 0.0;
+    int squarings = 0;
+
+    for (int i = 0; i < LQR_STATES; i++)
+    {
+        for (int j = 0; j < LQR_STATES; j++)
+        {
+            m[i][j] = a[i][j] * dt;
+        }
+        m[i][LQR_STATES] = b[i] * dt;
+    }
+
+    /* Scale the matrix below 0.5 so the series converges fast */
+    for (int i = 0; i < N; i++)
+    {
+        double row = 0.0;
+
+        for (int j = 0; j < N; j++)
+        {
+            row += fabs(m[i][j]);
+        }
+        norm = row > norm ? row : norm;
+    }
+    while (norm > 0.5)
+    {
+        norm *= 0.5;
+        squarings++;
+    }
+    for (int i = 0; i < N; i++)
+    {
+        for (int j = 0; j < N; j++)
+        {
+            m[i][j] = ldexp(m[i][j], -squarings);
+        }
+    }
+
+    /* Taylor series */
+    memset(term, 0, sizeof(term));
+    for (int i = 0; i < N; i++)
+    {
+        term[i][i] = 1.0;
+        e[i][i] = 1.0;
+    }
+    for (int n = 1; n <= LQR_EXPM_TERMS; n++)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                tmp[i][j] = 0.0;
+                for (int l = 0; l < N; l++)
+                {
+                    tmp[i][j] += term[i][l] * m[l][j];
+                }
+                tmp[i][j] /= n;
+            }
+        }
+        memcpy(term, tmp, sizeof(term));
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                e[i][j] += term[i][j];
+            }
+        }
+    }
+
+    /* Undo the scaling */
+    while (squarings-- > 0)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                tmp[i][j] = 0.0;
+                for (int l = 0; l < N; l++)
+                {
+                    tmp[i][j] += e[i][l] * e[l][j];
+                }
+            }
+        }
+        memcpy(e, tmp, sizeof(e));
+    }
+
+    for (int i = 0; i < LQR_STATES; i++)
+    {
+        for (int j = 0; j < LQR_STATES; j++)
+        {
+            pt->a[i][j] = e[i][j];
+        }
+        pt->b[i] = e[i][LQR_STATES];
+    }
+}
+
+/**
+ * @brief Solve the discrete algebraic Riccati equation and compute the gains
+ *
+ * P = Q + A'PA - A'PB (R + B'PB)^-1 B'PA, K = (R + B'PB)^-1 B'PA
+ *
+ * @param pt Grid point (discrete model in, gains out)
+ * @param q Diagonal state weights
+ * @param r Input weight
+ *
+ * @return 0 on success, -1 if the iteration did not converge
+ */
+static int design_dare(design_point_t *pt, const double q[LQR_STATES], double r)
+{
+    double p[LQR_STATES][LQR_STATES] = {{0}}, pa[LQR_STATES][LQR_STATES], next[LQR_STATES][LQR_STATES];
+    double pb[LQR_STATES], bpa[LQR_STATES];
+
+    for (int i = 0; i < LQR_STATES; i++)
+    {
+        p[i][i] = q[i];
+    }
+
+    for (long it = 0; it < LQR_DARE_ITERATIONS; it++)
+    {
+        double s = r, change = 0.0, size = 0.0;
+
+        /* PA, PB, B'PB, B'PA */
+        for (int i = 0; i < LQR_STATES; i++)
+        {
+            pb[i] = 0.0;
+            for (int j = 0; j < LQR_STATES; j++)
+            {
+                pa[i][j] = 0.0;
+                for (int l = 0; l < LQR_STATES; l++)
+                {
+                    pa[i][j] += p[i][l] * pt->a[l][j];
+                }
+                pb[i] += p[i][j] * pt->b[j];
+            }
+        }
+        for (int i = 0; i < LQR_STATES; i++)
+        {
+            s += pt->b[i] * pb[i];
+            bpa[i] = 0.0;
+            for (int l = 0; l < LQR_STATES; l++)
+            {
+                bpa[i] += pt->b[l] * pa[l][i];
+            }
+        }
+
+        for (int i = 0; i < LQR_STATES; i++)
+        {
+            pt->k[i] = bpa[i] / s;
+        }
+
+        /* Q + A'PA - (B'PA)' K */
+        for (int i = 0; i < LQR_STATES; i++)
+        {
+            for (int j = 0; j < LQR_STATES; j++)
+            {
+                double apa = 0.0;
+
+                for (int l = 0; l < LQR_STATES; l++)
+                {
+                    apa += pt->a[l][i] * pa[l][j];
+                }
+                next[i][j] = (i == j ? q[i] : 0.0) + apa - bpa[i] * pt->k[j];
+                change += fabs(next[i][j] - p[i][j]);
+                size += fabs(next[i][j]);
+            }
+        }
+        memcpy(p, next, sizeof(p));
+
+        if (!isfinite(size))
+        {
+            return -1;
+        }
+        if (change <= LQR_DARE_TOLERANCE * size)
+        {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Spectral radius of the closed loop A - BK (norm of its 2^20-th power)
+ *
+ * @param pt Grid point
+ *
+ * @return Spectral radius estimate
+ */
+static double design_spectral_radius(const design_point_t *pt)
+{
+    double m[LQR_STATES][LQR_STATES], tmp[LQR_STATES][LQR_STATES];
+    double log_scale = 0.0;
+    const int squarings = 20;
+
+    for (int i = 0; i < LQR_STATES; i++)
+    {
+        for (int j = 0; j < LQR_STATES; j++)
+        {
+            m[i][j] = pt->a[i][j] - pt->b[i] * pt->k[j];
+        }
+    }
+
+    /* Renormalize after each squaring so the power does not underflow */
+    for (int n = 0; n < squarings; n++)
+    {
+        double norm = 0.0;
+
+        for (int i = 0; i < LQR_STATES; i++)
+        {
+            for (int j = 0; j < LQR_STATES; j++)
+            {
+                tmp[i][j] = 0.0;
+                for (int l = 0; l < LQR_STATES; l++)
+                {
+                    tmp[i][j] += m[i][l] * m[l][j];
+                }
+                norm = fabs(tmp[i][j]) > norm ? fabs(tmp[i][j]) : norm;
+            }
+        }
+        if (norm == 0.0)
+        {
+            return 0.0;
+        }
+        log_scale = 2.0 * log_scale + log(norm);
+        for (int i = 0; i < LQR_STATES; i++)
+        {
+            for (int j = 0; j < LQR_STATES; j++)
+            {
+                m[i][j] = tmp[i][j] / norm;
+            }
+        }
+    }
+
+    return exp(log_scale / ldexp(1.0, squarings));
+}
+
+int main(int argc, char **argv)
+{
+    design_plant_t plant = {30.0, 49.0, 0.7, 0.06};
+    design_point_t pts[LQR_GRID_MAX];
+    double from = 5.0, to = 85.0, step = 10.0;
+    double err_max = 2.0, vel_max = 60.0, thrust_max = 0.3, rate = 1000.0;
+    int bandwidth = 50, scenario = 0, count = 0, failed = 0;
+    const char *out_path = NULL;
+    char text[LQR_GRID_MAX * 80 + 256];
+    size_t len = 0;
+    int i = 1;
+
+    while (i < argc && argv[i][0] == '-')
+    {
+        if (strcmp(argv[i], "-s") == 0)
+        {
+            scenario = 1;
+            i++;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            break;
+        }
+
+        if (strcmp(argv[i], "-a") == 0)
+        {
+            if (sscanf(argv[i + 1], "%lf:%lf:%lf", &from, &to, &step) != 3)
+            {
+                step = 0.0;
+            }
+        }
+        else if (strcmp(argv[i], "-e") == 0)
+        {
+            err_max = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            vel_max = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-u") == 0)
+        {
+            thrust_max = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            bandwidth = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            rate = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-o") == 0)
+        {
+            out_path = argv[i + 1];
+        }
+        else
+        {
+            break;
+        }
+        i += 2;
+    }
+
+    if (i + 1 != argc || step <= 0.0 || to < from || err_max <= 0.0 || vel_max <= 0.0 || thrust_max <= 0.0 ||
+        rate <= 0.0 || bandwidth < 1 || bandwidth > rate / 8)
+    {
+        fprintf(stderr,
+                "Usage: %s [-a from:to:step] [-e deg] [-v deg/s] [-u thrust] [-b rad/s] [-r Hz] [-s] "
+                "[-o out.txt] plant.txt\n",
+                argv[0]);
+        return 2;
+    }
+
+    if (design_read_plant(argv[i], &plant) < 0)
+    {
+        fprintf(stderr, "Cannot read %s\n", argv[i]);
+        return 2;
+    }
+    if (plant.w0_sq <= 0.0 || plant.damping < 0.0 || plant.motor_tau < 0.0)
+    {
+        fprintf(stderr, "%s: invalid plant parameters\n", argv[i]);
+        return 2;
+    }
+    if ((to - from) / step + 1.0 > LQR_GRID_MAX + 1e-9)
+    {
+        fprintf(stderr, "At most %d grid points\n", LQR_GRID_MAX);
+        return 2;
+    }
+
+    /* A motor without lag is modelled as one tick of lag (the observer treats 0 ms the same way) */
+    double dt = 1.0 / rate;
+    double tau = plant.motor_tau > dt ? plant.motor_tau : dt;
+    double gain = plant.w0_sq * LQR_DEG_PER_RAD;
+    double q[LQR_STATES] = {1.0 / (err_max * err_max), 1.0 / (vel_max * vel_max), 0.0};
+    double r = 1.0 / (thrust_max * thrust_max);
+
+    printf("Plant: neutral %.2f deg, w0_sq %.3f, damping %.3f, motor lag %.1f ms\n", plant.neutral, plant.w0_sq,
+           plant.damping, plant.motor_tau * 1e3);
+    printf("Weights: angle %.2f deg, velocity %.1f deg/s, thrust %.3f, %.0f Hz\n\n", err_max, vel_max, thrust_max,
+           rate);
+    printf("  angle   k_pos      k_vel       k_thr   slowest pole\n");
+
+    for (double c = from; c <= to + 1e-9 && count < LQR_GRID_MAX; c += step, count++)
+    {
+        design_point_t *pt = &pts[count];
+        double a[LQR_STATES][LQR_STATES] = {
+            {0.0, 1.0, 0.0},
+            {-plant.w0_sq * cos(c / LQR_DEG_PER_RAD), -plant.damping, gain},
+            {0.0, 0.0, -1.0 / tau},
+        };
+        double b[LQR_STATES] = {0.0, 0.0, 1.0 / tau};
+
+        design_discretize(a, b, dt, pt);
+        pt->valid = design_dare(pt, q, r) == 0;
+        if (!pt->valid)
+        {
+            printf("  %5.1f   no solution\n", plant.neutral + c);
+            failed = 1;
+            continue;
+        }
+        pt->rho = design_spectral_radius(pt);
+
+        printf("  %5.1f   %.6f   %.7f   %.4f   %.1f ms\n", plant.neutral + c, pt->k[0], pt->k[1], pt->k[2],
+               pt->rho > 0.0 ? -1e3 * dt / log(pt->rho) : 0.0);
+    }
+
+    /* Model, observer and table in the order the firmware needs them */
+    double k_acc = 1.0 / gain;
+    int tau_ms = (int)(plant.motor_tau * 1e3 + 0.5);
+
+    if (scenario)
+    {
+        len += snprintf(text + len, sizeof(text) - len,
+                        "at 0 ffdyn %.8f %.8f\nat 0 dobcfg %d %d\n", plant.damping * k_acc, k_acc, bandwidth, tau_ms);
+    }
+    else
+    {
+        len += snprintf(text + len, sizeof(text) - len,
+                        "FFDYN %.8f %.8f\nDOBCFG %d %d\nLQRCLR\n", plant.damping * k_acc, k_acc, bandwidth, tau_ms);
+    }
+    for (int n = 0; n < count; n++)
+    {
+        if (!pts[n].valid)
+        {
+            continue;
+        }
+        len += snprintf(text + len, sizeof(text) - len, "%s %.2f %.6f %.7f %.4f\n", scenario ? "at 0 lqrk" : "LQRK",
+                        plant.neutral + from + n * step, pts[n].k[0], pts[n].k[1], pts[n].k[2]);
+    }
+    len += snprintf(text + len, sizeof(text) - len, "%s\n", scenario ? "at 0 lqr 1" : "LQR 1");
+
+    printf("\n%s", text);
+
+    if (out_path != NULL)
+    {
+        FILE *f = fopen(out_path, "w");
+
+        if (f == NULL)
+        {
+            fprintf(stderr, "Cannot write %s\n", out_path);
+            return 2;
+        }
+        fputs(text, f);
+        fclose(f);
+    }
+
+    return failed;
+}
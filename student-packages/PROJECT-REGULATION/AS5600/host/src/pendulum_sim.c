@@ -0,0 +1,219 @@
+/**
+ * @brief Closed-loop pendulum simulator (Linux host)
+ *
+ * Runs scenario files against the firmware regulation code and the pendulum
+ * model, much faster than real time, and checks the expectations in them.
+ *
+ * Usage: pendulum_sim [-t trace.csv] [-b telemetry.bin] [-z batch] [-q] scenario...
+ *   -t  write the firmware CSV log (ms, setpoint, angle, command, supply) of the last scenario
+ *   -b  write the same log of the last scenario as binary telemetry (see tlm_decode)
+ *   -z  delta-compress the binary telemetry, up to batch samples per frame (like TLM 2)
+ *   -q  only print the pass/fail line of each scenario
+ *
+ * Exit status: 0 if all checks pass, 1 if any check fails, 2 on errors.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scenario.h"
+
+/**
+ * @brief Telemetry output to a file
+ *
+ * @param data Encoded frame
+ * @param len Number of bytes
+ * @param intf_ptr Output file
+ * @return 0 on success, non-zero on failure
+ */
+static int8_t file_write(const uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    return fwrite(data, 1, len, intf_ptr) == len ? 0 : -1;
+}
+
+/**
+ * @brief Print a metric value, '-' if not applicable
+ *
+ * @param value Metric value
+ */
+static void print_metric(double value)
+{
+    if (isnan(value))
+    {
+        printf("%10s", "-");
+    }
+    else
+    {
+        printf("%10.3f", value);
+    }
+}
+
+/**
+ * @brief Print the per-event metrics and the checks of a scenario
+ *
+ * @param sc Pointer to scenario structure
+ * @param res Pointer to result structure
+ */
+static void print_report(const scenario_t *sc, const scenario_result_t *res)
+{
+    printf("  %-6s %7s %7s", "event", "time", "target");
+    for (int m = 0; m < SCENARIO_METRIC_COUNT; m++)
+    {
+        printf("%10s", scenario_metric_name((scenario_metric_t)m));
+    }
+    printf("\n");
+
+    for (uint8_t i = 0; i < res->event_count; i++)
+    {
+        const scenario_event_result_t *ev = &res->events[i];
+        const char *kind = ev->type == SCENARIO_ACT_SET ? "step" : ev->type == SCENARIO_ACT_PUSH ? "push" : "supply";
+
+        printf("  %-6s %7.2f %7.2f", kind, ev->start, ev->target);
+        for (int m = 0; m < SCENARIO_METRIC_COUNT; m++)
+        {
+            print_metric(ev->metric[m]);
+        }
+        printf("\n");
+    }
+
+    for (uint8_t i = 0; i < sc->expect_count; i++)
+    {
+        const scenario_expect_t *exp = &sc->expects[i];
+        double value = exp->event < res->event_count ? res->events[exp->event].metric[exp->metric] : NAN;
+
+        printf("  [%s] event %u %s %.3f %c %g\n", res->expect_pass[i] ? "PASS" : "FAIL", exp->event,
+               scenario_metric_name(exp->metric), value, exp->op, exp->limit);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static scenario_t sc;
+    scenario_result_t res;
+    const char *trace_path = NULL;
+    const char *tlm_path = NULL;
+    int tlm_batch = 0;
+    int quiet = 0;
+    int status = 0;
+    int first = 1;
+
+    while (first < argc && argv[first][0] == '-')
+    {
+        if (strcmp(argv[first], "-t") == 0 && first + 1 < argc)
+        {
+            trace_path = argv[first + 1];
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-b") == 0 && first + 1 < argc)
+        {
+            tlm_path = argv[first + 1];
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-z") == 0 && first + 1 < argc)
+        {
+            tlm_batch = atoi(argv[first + 1]);
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-q") == 0)
+        {
+            quiet = 1;
+            first++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (first >= argc)
+    {
+        fprintf(stderr, "Usage: %s [-t trace.csv] [-b telemetry.bin] [-z batch] [-q] scenario...\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = first; i < argc; i++)
+    {
+        struct timespec t0, t1;
+        FILE *trace = NULL;
+        FILE *tlm_file = NULL;
+        telemetry_t tlm;
+        scenario_err_t rslt;
+        uint32_t line;
+        double wall;
+
+        rslt = scenario_load(&sc, argv[i], &line);
+        if (rslt != SCENARIO_OK)
+        {
+            fprintf(stderr, "%s:%u: cannot load scenario (error %d)\n", argv[i], line, rslt);
+            status = 2;
+            continue;
+        }
+
+        if (trace_path && i == argc - 1)
+        {
+            trace = fopen(trace_path, "w");
+            if (!trace)
+            {
+                fprintf(stderr, "Cannot open %s\n", trace_path);
+                return 2;
+            }
+        }
+
+        if (tlm_path && i == argc - 1)
+        {
+            tlm_file = fopen(tlm_path, "wb");
+            if (!tlm_file)
+            {
+                fprintf(stderr, "Cannot open %s\n", tlm_path);
+                return 2;
+            }
+            telemetry_init(&tlm, telemetry_log_channels_us, TELEMETRY_LOG_CHANNELS, 0, file_write, tlm_file);
+            telemetry_set_batch(&tlm, (uint8_t)(tlm_batch < 0 ? 0 : tlm_batch));
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        rslt = scenario_run(&sc, NULL, &res, trace, tlm_file ? &tlm : NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        if (trace)
+        {
+            fclose(trace);
+        }
+        if (tlm_file)
+        {
+            telemetry_flush(&tlm);
+            fclose(tlm_file);
+        }
+
+        if (rslt != SCENARIO_OK)
+        {
+            fprintf(stderr, "%s: simulation failed (error %d)\n", argv[i], rslt);
+            status = 2;
+            continue;
+        }
+
+        wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        printf("[%s] %s: %.1f s simulated in %.1f ms (%.0fx real time), I2C load %.1f %%, sensor errors %u\n",
+               res.passed ? "PASS" : "FAIL", sc.name, sc.duration, wall * 1e3,
+               wall > 0 ? sc.duration / wall : 0.0, res.i2c_load * 100.0, res.sensor_errors);
+        if (!quiet)
+        {
+            if (res.oscillations)
+            {
+                printf("  oscillations %u, last %.1f Hz %.2f deg, gain scale %.2f\n", res.oscillations,
+                       res.osc_freq, res.osc_amplitude, res.gain_scale);
+            }
+            print_report(&sc, &res);
+        }
+
+        if (!res.passed && status == 0)
+        {
+            status = 1;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,791 @@
+/**
+ * @brief Parallel PID tuning over the simulated pendulum (Linux host)
+ *
+ * Evaluates candidate tunings (Kp, Ki, Kd, derivative filter, integrator
+ * limit) on every scenario file, each run on the nominal plant and on a set
+ * of randomly perturbed plants, spread over all cores by a work-stealing
+ * pool. The first round samples the search box (Latin hypercube, or a grid
+ * with -g); every further round samples around the current Pareto front with
+ * a shrinking spread. Candidates failing any scenario check are not eligible.
+ *
+ * Usage: pid_tune [options] scenario...
+ *   -n <count>        candidates per round (default 128)
+ *   -r <rounds>       refinement rounds after the first one (default 3)
+ *   -g <points>       grid with this many points per searched axis instead of random sampling
+ *   -v <variants>     plant variants per scenario, including the nominal one (default 8)
+ *   -j <threads>      worker threads (default: one per CPU)
+ *   -s <seed>         random seed (default 1)
+ *   -O <list>         Pareto objectives, comma separated (default overshoot,settle,iae,effort)
+ *   -o <file>         write the Pareto set as a parameter record (serial commands)
+ *   -p <kp|ki|kd|alpha|ilimit> <min> <max>  search range (min = max fixes the parameter)
+ *
+ * Objectives per candidate: overshoot (largest step overshoot, %), settle
+ * (slowest step settling or push recovery, s), and mean iae, itae and effort
+ * per run. Exit status: 0 if a front was found, 1 if no candidate passed all
+ * checks, 2 on errors.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scenario.h"
+#include "work_pool.h"
+
+/**
+ * @brief Limits of a search
+ */
+#define TUNE_MAX_FILES 16
+#define TUNE_MAX_VARIANTS 64
+
+/**
+ * @brief Spread of the refinement samples in the first refinement round
+ *        (fraction of the log or linear search range) and its shrink per round
+ */
+#define TUNE_SPREAD_START 0.15
+#define TUNE_SPREAD_SHRINK 0.6
+
+/**
+ * @brief Enumeration for searched parameters
+ */
+typedef enum
+{
+    TUNE_PARAM_KP = 0,
+    TUNE_PARAM_KI,
+    TUNE_PARAM_KD,
+    TUNE_PARAM_ALPHA,
+    TUNE_PARAM_ILIMIT,
+    TUNE_PARAM_COUNT
+} tune_param_t;
+
+/**
+ * @brief Enumeration for objectives
+ */
+typedef enum
+{
+    TUNE_OBJ_OVERSHOOT = 0,
+    TUNE_OBJ_SETTLE,
+    TUNE_OBJ_IAE,
+    TUNE_OBJ_ITAE,
+    TUNE_OBJ_EFFORT,
+    TUNE_OBJ_COUNT
+} tune_obj_t;
+
+static const char *const tune_param_names[TUNE_PARAM_COUNT] = {"kp", "ki", "kd", "alpha", "ilimit"};
+static const char *const tune_obj_names[TUNE_OBJ_COUNT] = {"overshoot", "settle", "iae", "itae", "effort"};
+
+/**
+ * @brief Search range of one parameter
+ */
+typedef struct
+{
+    double min;  /* Lower bound */
+    double max;  /* Upper bound */
+    uint8_t log; /* Sample on a log scale */
+} tune_range_t;
+
+/**
+ * @brief Candidate tuning and its aggregated result
+ */
+typedef struct
+{
+    double param[TUNE_PARAM_COUNT]; /* Parameter values */
+    double obj[TUNE_OBJ_COUNT];     /* Objectives (worst case or mean over runs) */
+    uint32_t failed;                /* Runs with a failed check or simulation */
+    uint8_t front;                  /* On the Pareto front */
+} tune_cand_t;
+
+/**
+ * @brief Summary of one scenario run
+ */
+typedef struct
+{
+    double obj[TUNE_OBJ_COUNT]; /* Objectives of the run */
+    uint8_t passed;             /* All checks passed */
+} tune_run_t;
+
+/**
+ * @brief Search state shared with the workers
+ */
+typedef struct
+{
+    scenario_t *scenarios; /* Scenario variants */
+    uint32_t runs;         /* Number of scenario variants */
+    tune_cand_t *cands;    /* Candidates of the whole search */
+    uint32_t first;        /* First candidate of the current round */
+    tune_run_t *results;   /* Per-job results of the current round */
+} tune_ctx_t;
+
+/**
+ * @brief Uniform random number in [0, 1) (xorshift64*)
+ *
+ * @param[in,out] state Generator state
+ *
+ * @return Random number
+ */
+static double tune_random(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+
+    return (double)((x * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Map a unit-interval position into a parameter range
+ *
+ * @param[in] r Range
+ * @param[in] u Position (0-1)
+ *
+ * @return Parameter value
+ */
+static double tune_from_unit(const tune_range_t *r, double u)
+{
+    if (r->log)
+    {
+        return r->min * pow(r->max / r->min, u);
+    }
+
+    return r->min + (r->max - r->min) * u;
+}
+
+/**
+ * @brief Map a parameter value into the unit interval of its range
+ *
+ * @param[in] r Range
+ * @param[in] v Parameter value
+ *
+ * @return Position (0-1)
+ */
+static double tune_to_unit(const tune_range_t *r, double v)
+{
+    if (r->max <= r->min)
+    {
+        return 0.0;
+    }
+    if (r->log)
+    {
+        return log(v / r->min) / log(r->max / r->min);
+    }
+
+    return (v - r->min) / (r->max - r->min);
+}
+
+/**
+ * @brief Perturb the plant and the sensor of a scenario copy
+ *
+ * Tolerances of the rig: +-10 % gravity term and thrust, +-20 % damping,
+ * deadzone and motor lag, +-30 % dry friction, any magnet offset, new noise.
+ *
+ * @param[in,out] sc Scenario copy
+ * @param[in,out] rng Generator state
+ */
+static void tune_perturb(scenario_t *sc, uint64_t *rng)
+{
+    plant_params_t *p = &sc->plant;
+
+    p->w0_sq *= 0.9 + 0.2 * tune_random(rng);
+    p->thrust_max *= 0.9 + 0.2 * tune_random(rng);
+    p->damping *= 0.8 + 0.4 * tune_random(rng);
+    p->deadzone *= 0.8 + 0.4 * tune_random(rng);
+    p->motor_tau *= 0.8 + 0.4 * tune_random(rng);
+    p->coulomb *= 0.7 + 0.6 * tune_random(rng);
+    sc->sim.magnet_offset_deg = 360.0 * tune_random(rng);
+    sc->sim.seed = (uint32_t)(tune_random(rng) * 4294967295.0) | 1u;
+}
+
+/**
+ * @brief Summarize one scenario run into objectives
+ *
+ * @param[in] res Scenario result
+ * @param[out] run Run summary
+ */
+static void tune_summarize(const scenario_result_t *res, tune_run_t *run)
+{
+    double *o = run->obj;
+
+    memset(o, 0, sizeof(run->obj));
+    run->passed = res->passed;
+
+    for (uint8_t i = 0; i < res->event_count; i++)
+    {
+        const double *m = res->events[i].metric;
+        double settle = res->events[i].type == SCENARIO_ACT_SET ? m[SCENARIO_METRIC_SETTLE]
+                                                                : m[SCENARIO_METRIC_RECOVER];
+
+        if (res->events[i].type == SCENARIO_ACT_SET && m[SCENARIO_METRIC_OVERSHOOT] > o[TUNE_OBJ_OVERSHOOT])
+        {
+            o[TUNE_OBJ_OVERSHOOT] = m[SCENARIO_METRIC_OVERSHOOT];
+        }
+        if (settle > o[TUNE_OBJ_SETTLE])
+        {
+            o[TUNE_OBJ_SETTLE] = settle;
+        }
+        o[TUNE_OBJ_IAE] += m[SCENARIO_METRIC_IAE];
+        o[TUNE_OBJ_ITAE] += m[SCENARIO_METRIC_ITAE];
+        o[TUNE_OBJ_EFFORT] += m[SCENARIO_METRIC_EFFORT];
+    }
+}
+
+/**
+ * @brief Tuning of a candidate in firmware units
+ *
+ * @param[in] c Candidate
+ * @param[out] tuning Tuning
+ */
+static void tune_to_tuning(const tune_cand_t *c, scenario_tuning_t *tuning)
+{
+    tuning->gains.kp = FIX16_FROM_FLOAT(c->param[TUNE_PARAM_KP]);
+    tuning->gains.ki = FIX16_FROM_FLOAT(c->param[TUNE_PARAM_KI]);
+    tuning->gains.kd = FIX16_FROM_FLOAT(c->param[TUNE_PARAM_KD]);
+    tuning->d_alpha = FIX16_FROM_FLOAT(c->param[TUNE_PARAM_ALPHA]);
+    tuning->i_limit = FIX16_FROM_FLOAT(c->param[TUNE_PARAM_ILIMIT]);
+}
+
+/**
+ * @brief Job: run one scenario variant with one candidate
+ *
+ * @param[in] arg Search state
+ * @param[in] job Job index (candidate of the round * runs + variant)
+ * @param[in] worker Worker index (unused)
+ */
+static void tune_job(void *arg, uint32_t job, uint32_t worker)
+{
+    tune_ctx_t *ctx = arg;
+    const tune_cand_t *c = &ctx->cands[ctx->first + job / ctx->runs];
+    scenario_tuning_t tuning;
+    scenario_result_t res;
+
+    (void)worker;
+    tune_to_tuning(c, &tuning);
+
+    if (scenario_run(&ctx->scenarios[job % ctx->runs], &tuning, &res, NULL, NULL) == SCENARIO_OK)
+    {
+        tune_summarize(&res, &ctx->results[job]);
+    }
+    else
+    {
+        ctx->results[job].passed = 0;
+        for (int k = 0; k < TUNE_OBJ_COUNT; k++)
+        {
+            ctx->results[job].obj[k] = INFINITY;
+        }
+    }
+}
+
+/**
+ * @brief Aggregate the runs of each candidate of a round
+ *
+ * @param[in,out] ctx Search state
+ * @param[in] count Candidates in the round
+ */
+static void tune_reduce(tune_ctx_t *ctx, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        tune_cand_t *c = &ctx->cands[ctx->first + i];
+        const tune_run_t *runs = &ctx->results[(size_t)i * ctx->runs];
+
+        memset(c->obj, 0, sizeof(c->obj));
+        c->failed = 0;
+        for (uint32_t r = 0; r < ctx->runs; r++)
+        {
+            const double *o = runs[r].obj;
+
+            c->failed += !runs[r].passed;
+            c->obj[TUNE_OBJ_OVERSHOOT] = fmax(c->obj[TUNE_OBJ_OVERSHOOT], o[TUNE_OBJ_OVERSHOOT]);
+            c->obj[TUNE_OBJ_SETTLE] = fmax(c->obj[TUNE_OBJ_SETTLE], o[TUNE_OBJ_SETTLE]);
+            c->obj[TUNE_OBJ_IAE] += o[TUNE_OBJ_IAE] / ctx->runs;
+            c->obj[TUNE_OBJ_ITAE] += o[TUNE_OBJ_ITAE] / ctx->runs;
+            c->obj[TUNE_OBJ_EFFORT] += o[TUNE_OBJ_EFFORT] / ctx->runs;
+        }
+    }
+}
+
+/**
+ * @brief Mark the Pareto front among the candidates that passed every check
+ *
+ * @param[in,out] cands Candidates
+ * @param[in] count Number of candidates
+ * @param[in] objs Objective selection mask
+ *
+ * @return Number of candidates on the front
+ */
+static uint32_t tune_pareto(tune_cand_t *cands, uint32_t count, uint32_t objs)
+{
+    uint32_t size = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        cands[i].front = cands[i].failed == 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!cands[i].front)
+        {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < count && cands[i].front; j++)
+        {
+            int better = 0, worse = 0;
+
+            if (j == i || cands[j].failed)
+            {
+                continue;
+            }
+
+            for (int k = 0; k < TUNE_OBJ_COUNT; k++)
+            {
+                if (!(objs & (1u << k)))
+                {
+                    continue;
+                }
+                better |= cands[j].obj[k] < cands[i].obj[k];
+                worse |= cands[j].obj[k] > cands[i].obj[k];
+            }
+
+            /* Dominated, or an exact duplicate of an earlier candidate */
+            if ((better && !worse) || (!better && !worse && j < i))
+            {
+                cands[i].front = 0;
+            }
+        }
+
+        size += cands[i].front;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Generate the first round: Latin hypercube or grid over the search box
+ *
+ * @param[out] cands Candidates
+ * @param[in] count Number of candidates
+ * @param[in] ranges Search ranges
+ * @param[in] grid Points per searched axis (0 for Latin hypercube)
+ * @param[in,out] rng Generator state
+ */
+static void tune_sample_box(tune_cand_t *cands, uint32_t count, const tune_range_t *ranges,
+                            uint32_t grid, uint64_t *rng)
+{
+    uint32_t *perm = malloc(count * sizeof(*perm));
+
+    for (int k = 0; k < TUNE_PARAM_COUNT; k++)
+    {
+        if (!grid)
+        {
+            /* One sample in each of count strata, strata shuffled per axis */
+            for (uint32_t i = 0; i < count; i++)
+            {
+                perm[i] = i;
+            }
+            for (uint32_t i = count - 1; i > 0; i--)
+            {
+                uint32_t j = (uint32_t)(tune_random(rng) * (i + 1));
+                uint32_t t = perm[i];
+
+                perm[i] = perm[j];
+                perm[j] = t;
+            }
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            double u;
+
+            if (grid)
+            {
+                uint32_t stride = 1;
+
+                for (int a = 0; a < k; a++)
+                {
+                    stride *= ranges[a].max > ranges[a].min ? grid : 1;
+                }
+                u = ranges[k].max > ranges[k].min && grid > 1 ? (double)((i / stride) % grid) / (grid - 1) : 0.0;
+            }
+            else
+            {
+                u = (perm[i] + tune_random(rng)) / count;
+            }
+
+            cands[i].param[k] = tune_from_unit(&ranges[k], u);
+        }
+    }
+
+    free(perm);
+}
+
+/**
+ * @brief Generate a refinement round around the current Pareto front
+ *
+ * @param[in] front Candidates on the front
+ * @param[in] front_size Number of candidates on the front
+ * @param[out] cands New candidates
+ * @param[in] count Number of new candidates
+ * @param[in] ranges Search ranges
+ * @param[in] spread Standard deviation of the step (fraction of the range)
+ * @param[in,out] rng Generator state
+ */
+static void tune_sample_front(const tune_cand_t *const *front, uint32_t front_size, tune_cand_t *cands,
+                              uint32_t count, const tune_range_t *ranges, double spread, uint64_t *rng)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const tune_cand_t *parent = front[i % front_size];
+
+        for (int k = 0; k < TUNE_PARAM_COUNT; k++)
+        {
+            /* Approximately normal step (sum of three uniforms) */
+            double step = (tune_random(rng) + tune_random(rng) + tune_random(rng) - 1.5) * 2.0 * spread;
+            double u = tune_to_unit(&ranges[k], parent->param[k]) + step;
+
+            u = u < 0.0 ? 0.0 : (u > 1.0 ? 1.0 : u);
+            cands[i].param[k] = tune_from_unit(&ranges[k], u);
+        }
+    }
+}
+
+/**
+ * @brief Compare candidates by IAE (qsort callback)
+ */
+static int tune_cmp_iae(const void *a, const void *b)
+{
+    const tune_cand_t *ca = *(const tune_cand_t *const *)a;
+    const tune_cand_t *cb = *(const tune_cand_t *const *)b;
+
+    return (ca->obj[TUNE_OBJ_IAE] > cb->obj[TUNE_OBJ_IAE]) - (ca->obj[TUNE_OBJ_IAE] < cb->obj[TUNE_OBJ_IAE]);
+}
+
+/**
+ * @brief Look up a parameter by name
+ *
+ * @param[in] name Parameter name
+ *
+ * @return Parameter index, -1 if unknown
+ */
+static int tune_find_param(const char *name)
+{
+    for (int k = 0; k < TUNE_PARAM_COUNT; k++)
+    {
+        if (strcmp(name, tune_param_names[k]) == 0)
+        {
+            return k;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Parse the objective list
+ *
+ * @param[in] list Comma separated objective names
+ *
+ * @return Objective mask, 0 on error
+ */
+static uint32_t tune_parse_objs(const char *list)
+{
+    char buf[80];
+    uint32_t mask = 0;
+
+    strncpy(buf, list, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","))
+    {
+        int k;
+
+        for (k = 0; k < TUNE_OBJ_COUNT; k++)
+        {
+            if (strcmp(tok, tune_obj_names[k]) == 0)
+            {
+                mask |= 1u << k;
+                break;
+            }
+        }
+        if (k == TUNE_OBJ_COUNT)
+        {
+            return 0;
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * @brief Write the Pareto set as serial commands that load each tuning
+ *
+ * @param[in] path Output file
+ * @param[in] front Candidates on the front, sorted
+ * @param[in] size Number of candidates on the front
+ * @param[in] evaluated Number of evaluated candidates
+ * @param[in] runs Scenario runs per candidate
+ *
+ * @return 0 on success, -1 if the file cannot be written
+ */
+static int tune_write_record(const char *path, const tune_cand_t *const *front, uint32_t size,
+                             uint32_t evaluated, uint32_t runs)
+{
+    FILE *f = fopen(path, "w");
+
+    if (!f)
+    {
+        return -1;
+    }
+
+    fprintf(f, "# Pareto-optimal PID tunings (%u of %u candidates, %u scenario runs each)\n", size, evaluated, runs);
+    fprintf(f, "# Send the two command lines of one tuning over the serial port to load it.\n");
+    for (uint32_t i = 0; i < size; i++)
+    {
+        const tune_cand_t *c = front[i];
+
+        fprintf(f, "\n# %u: overshoot %.2f %%, settle %.3f s, iae %.3f, itae %.3f, effort %.3f\n", i + 1,
+                c->obj[TUNE_OBJ_OVERSHOOT], c->obj[TUNE_OBJ_SETTLE], c->obj[TUNE_OBJ_IAE],
+                c->obj[TUNE_OBJ_ITAE], c->obj[TUNE_OBJ_EFFORT]);
+        fprintf(f, "PID %.6f %.6f %.6f\n", c->param[TUNE_PARAM_KP], c->param[TUNE_PARAM_KI],
+                c->param[TUNE_PARAM_KD]);
+        fprintf(f, "PIDF %.4f %.4f\n", c->param[TUNE_PARAM_ALPHA], c->param[TUNE_PARAM_ILIMIT]);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    tune_range_t ranges[TUNE_PARAM_COUNT] = {
+        {0.005, 0.1, 1}, {0.005, 0.3, 1}, {0.0003, 0.01, 1}, {0.05, 1.0, 1}, {0.3, 1.0, 0},
+    };
+    static scenario_t files[TUNE_MAX_FILES];
+    uint32_t per_round = 128, rounds = 3, grid = 0, variants = 8, threads = 0;
+    uint32_t objs = tune_parse_objs("overshoot,settle,iae,effort");
+    const char *record = NULL;
+    uint64_t rng = 1;
+    uint32_t nfiles = 0, total, evaluated = 0, front_size = 0;
+    double duration = 0.0;
+    tune_ctx_t ctx;
+    work_pool_t pool;
+    tune_cand_t **front;
+    struct timespec t0, t1;
+    double wall;
+    int i = 1;
+
+    while (i < argc && argv[i][0] == '-')
+    {
+        const char *opt = argv[i];
+
+        if (strcmp(opt, "-p") == 0 && i + 3 < argc)
+        {
+            int k = tune_find_param(argv[i + 1]);
+
+            if (k < 0)
+            {
+                fprintf(stderr, "Unknown parameter: %s\n", argv[i + 1]);
+                return 2;
+            }
+            ranges[k].min = atof(argv[i + 2]);
+            ranges[k].max = atof(argv[i + 3]);
+            ranges[k].log = ranges[k].log && ranges[k].min > 0;
+            i += 4;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            break;
+        }
+
+        if (strcmp(opt, "-n") == 0)
+        {
+            per_round = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if (strcmp(opt, "-r") == 0)
+        {
+            rounds = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if (strcmp(opt, "-g") == 0)
+        {
+            grid = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if (strcmp(opt, "-v") == 0)
+        {
+            variants = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if (strcmp(opt, "-j") == 0)
+        {
+            threads = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if (strcmp(opt, "-s") == 0)
+        {
+            rng = strtoull(argv[i + 1], NULL, 0) | 1u;
+        }
+        else if (strcmp(opt, "-O") == 0)
+        {
+            objs = tune_parse_objs(argv[i + 1]);
+        }
+        else if (strcmp(opt, "-o") == 0)
+        {
+            record = argv[i + 1];
+        }
+        else
+        {
+            break;
+        }
+        i += 2;
+    }
+
+    if (i >= argc || objs == 0 || per_round == 0 || variants == 0 || variants > TUNE_MAX_VARIANTS)
+    {
+        fprintf(stderr, "Usage: %s [-n count] [-r rounds] [-g points] [-v variants] [-j threads] [-s seed]\n"
+                        "       [-O overshoot,settle,iae,itae,effort] [-o record.txt]\n"
+                        "       [-p kp|ki|kd|alpha|ilimit <min> <max>]... scenario...\n",
+                argv[0]);
+        return 2;
+    }
+
+    for (int k = 0; k < TUNE_PARAM_COUNT; k++)
+    {
+        if (ranges[k].min > ranges[k].max || (k == TUNE_PARAM_ALPHA && (ranges[k].min <= 0 || ranges[k].max > 1)) ||
+            (k == TUNE_PARAM_ILIMIT && ranges[k].min <= 0))
+        {
+            fprintf(stderr, "Invalid range of %s\n", tune_param_names[k]);
+            return 2;
+        }
+    }
+
+    for (; i < argc && nfiles < TUNE_MAX_FILES; i++)
+    {
+        uint32_t line;
+
+        if (scenario_load(&files[nfiles], argv[i], &line) != SCENARIO_OK)
+        {
+            fprintf(stderr, "%s:%u: cannot load scenario\n", argv[i], line);
+            return 2;
+        }
+        duration += files[nfiles].duration * variants;
+        nfiles++;
+    }
+
+    /* Scenario variants: nominal plant first, then perturbed copies */
+    ctx.runs = nfiles * variants;
+    ctx.scenarios = malloc(ctx.runs * sizeof(*ctx.scenarios));
+    for (uint32_t f = 0; f < nfiles; f++)
+    {
+        for (uint32_t v = 0; v < variants; v++)
+        {
+            scenario_t *sc = &ctx.scenarios[f * variants + v];
+
+            *sc = files[f];
+            if (v > 0)
+            {
+                tune_perturb(sc, &rng);
+            }
+        }
+    }
+
+    if (grid)
+    {
+        per_round = 1;
+        for (int k = 0; k < TUNE_PARAM_COUNT; k++)
+        {
+            per_round *= ranges[k].max > ranges[k].min ? grid : 1;
+        }
+    }
+
+    total = per_round * (rounds + 1);
+    ctx.cands = calloc(total, sizeof(*ctx.cands));
+    ctx.results = malloc((size_t)per_round * ctx.runs * sizeof(*ctx.results));
+    front = malloc(total * sizeof(*front));
+    if (!ctx.scenarios || !ctx.cands || !ctx.results || !front)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 2;
+    }
+
+    work_pool_init(&pool, threads);
+    printf("Searching %u candidates per round, %u rounds, %u scenario runs each, %u threads\n", per_round,
+           rounds + 1, ctx.runs, pool.workers);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t round = 0; round <= rounds; round++)
+    {
+        ctx.first = evaluated;
+
+        if (round == 0)
+        {
+            tune_sample_box(&ctx.cands[evaluated], per_round, ranges, grid, &rng);
+        }
+        else
+        {
+            double spread = TUNE_SPREAD_START * pow(TUNE_SPREAD_SHRINK, round - 1);
+
+            tune_sample_front((const tune_cand_t *const *)front, front_size, &ctx.cands[evaluated], per_round,
+                              ranges, spread, &rng);
+        }
+
+        if (work_pool_run(&pool, per_round * ctx.runs, tune_job, &ctx) != WORK_POOL_OK)
+        {
+            fprintf(stderr, "Worker threads could not be started, running on fewer cores\n");
+        }
+        tune_reduce(&ctx, per_round);
+        evaluated += per_round;
+
+        front_size = tune_pareto(ctx.cands, evaluated, objs);
+        printf("Round %u: %u evaluated, %u on the front\n", round, evaluated, front_size);
+
+        if (front_size == 0)
+        {
+            break; /* Nothing to refine around */
+        }
+
+        front_size = 0;
+        for (uint32_t c = 0; c < evaluated; c++)
+        {
+            if (ctx.cands[c].front)
+            {
+                front[front_size++] = &ctx.cands[c];
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    printf("%u simulations (%.0f simulated s) in %.1f s, %u steals\n", evaluated * ctx.runs,
+           evaluated * duration, wall, pool.steals);
+    work_pool_deinit(&pool);
+
+    if (front_size == 0)
+    {
+        printf("No candidate passed every scenario check\n");
+        return 1;
+    }
+
+    qsort(front, front_size, sizeof(*front), tune_cmp_iae);
+    printf("%3s %9s %9s %9s %7s %7s %10s %9s %9s %9s %9s\n", "#", "kp", "ki", "kd", "alpha", "ilimit",
+           "overshoot", "settle", "iae", "itae", "effort");
+    for (uint32_t c = 0; c < front_size; c++)
+    {
+        const double *p = front[c]->param;
+        const double *o = front[c]->obj;
+
+        printf("%3u %9.5f %9.5f %9.6f %7.3f %7.3f %10.2f %9.3f %9.3f %9.3f %9.3f\n", c + 1, p[TUNE_PARAM_KP],
+               p[TUNE_PARAM_KI], p[TUNE_PARAM_KD], p[TUNE_PARAM_ALPHA], p[TUNE_PARAM_ILIMIT],
+               o[TUNE_OBJ_OVERSHOOT], o[TUNE_OBJ_SETTLE], o[TUNE_OBJ_IAE], o[TUNE_OBJ_ITAE], o[TUNE_OBJ_EFFORT]);
+    }
+
+    if (record && tune_write_record(record, (const tune_cand_t *const *)front, front_size, evaluated, ctx.runs) != 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", record);
+        return 2;
+    }
+
+    return 0;
+}
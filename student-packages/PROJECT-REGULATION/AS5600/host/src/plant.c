@@ -0,0 +1,157 @@
+/**
+ * @file plant.c
+ * @brief Rigid-body pendulum and propeller model implementation
+ */
+
+#include <math.h>
+
+#include "plant.h"
+
+#define DEG_PER_RAD (180.0 / M_PI)
+#define RAD_PER_DEG (M_PI / 180.0)
+
+/**
+ * @brief Velocity scale of the smoothed dry friction (deg/s)
+ */
+#define PLANT_COULOMB_EPS 0.5
+
+/**
+ * @brief The brake shorts the motor, which stops the propeller faster than coasting
+ */
+#define PLANT_BRAKE_TAU_RATIO 0.3
+
+/**
+ * @brief Fill the parameters with values of the lab rig (about 0.2 m arm)
+ *
+ * @param[out] p Pointer to parameter structure
+ */
+void plant_default_params(plant_params_t *p)
+{
+    p->neutral_deg = 30.0;
+    p->w0_sq = 49.0; /* g / l for l = 0.2 m */
+    p->damping = 0.7;
+    p->coulomb = 0.3;
+    p->thrust_max = 1.5;
+    p->deadzone = 0.08;
+    p->reverse_gain = 0.5;
+    p->motor_tau = 0.06;
+}
+
+/**
+ * @brief Initialize the plant at rest in the neutral position
+ *
+ * @param[out] plant Pointer to plant structure
+ * @param[in] p Parameters
+ */
+void plant_init(plant_t *plant, const plant_params_t *p)
+{
+    plant->p = *p;
+    plant->time = 0.0;
+    plant->theta = p->neutral_deg;
+    plant->omega = 0.0;
+    plant->thrust = 0.0;
+    plant->duty = 0.0;
+    plant->brake = 0;
+    plant->disturbance = 0.0;
+}
+
+/**
+ * @brief Steady-state thrust for a duty
+ *
+ * @param[in] p Pointer to parameter structure
+ * @param[in] duty Duty (-1..1)
+ *
+ * @return Thrust in gravity units
+ */
+double plant_thrust_curve(const plant_params_t *p, double duty)
+{
+    double mag = fabs(duty);
+    double x;
+
+    if (mag <= p->deadzone)
+    {
+        return 0.0;
+    }
+
+    /* Thrust grows with the square of the propeller speed */
+    x = (mag - p->deadzone) / (1.0 - p->deadzone);
+    x = p->thrust_max * x * x;
+    return duty > 0 ? x : -p->reverse_gain * x;
+}
+
+/**
+ * @brief State derivative
+ *
+ * @param[in] plant Pointer to plant structure (parameters and inputs)
+ * @param[in] state Angle (deg), velocity (deg/s), thrust (gravity units)
+ * @param[out] deriv Time derivative of the state
+ */
+static void plant_deriv(const plant_t *plant, const double state[3], double deriv[3])
+{
+    const plant_params_t *p = &plant->p;
+    double torque = state[2] + plant->disturbance - sin((state[0] - p->neutral_deg) * RAD_PER_DEG);
+    double friction = p->coulomb * state[1] / (fabs(state[1]) + PLANT_COULOMB_EPS);
+    double tau = plant->brake ? p->motor_tau * PLANT_BRAKE_TAU_RATIO : p->motor_tau;
+
+    deriv[0] = state[1];
+    deriv[1] = (p->w0_sq * torque - friction) * DEG_PER_RAD - p->damping * state[1];
+    deriv[2] = (plant_thrust_curve(p, plant->duty) - state[2]) / tau;
+}
+
+/**
+ * @brief One fourth-order Runge-Kutta step
+ *
+ * @param[in,out] plant Pointer to plant structure
+ * @param[in] h Step (s)
+ */
+static void plant_rk4(plant_t *plant, double h)
+{
+    double s0[3] = {plant->theta, plant->omega, plant->thrust};
+    double k1[3], k2[3], k3[3], k4[3], s[3];
+
+    plant_deriv(plant, s0, k1);
+    for (int i = 0; i < 3; i++)
+    {
+        s[i] = s0[i] + 0.5 * h * k1[i];
+    }
+    plant_deriv(plant, s, k2);
+    for (int i = 0; i < 3; i++)
+    {
+        s[i] = s0[i] + 0.5 * h * k2[i];
+    }
+    plant_deriv(plant, s, k3);
+    for (int i = 0; i < 3; i++)
+    {
+        s[i] = s0[i] + h * k3[i];
+    }
+    plant_deriv(plant, s, k4);
+
+    plant->theta = s0[0] + h / 6.0 * (k1[0] + 2.0 * k2[0] + 2.0 * k3[0] + k4[0]);
+    plant->omega = s0[1] + h / 6.0 * (k1[1] + 2.0 * k2[1] + 2.0 * k3[1] + k4[1]);
+    plant->thrust = s0[2] + h / 6.0 * (k1[2] + 2.0 * k2[2] + 2.0 * k3[2] + k4[2]);
+}
+
+/**
+ * @brief Integrate the plant up to an absolute time
+ *
+ * @param[in,out] plant Pointer to plant structure
+ * @param[in] time Target time (s); earlier times are ignored
+ */
+void plant_advance(plant_t *plant, double time)
+{
+    while (plant->time < time)
+    {
+        double h = time - plant->time;
+
+        if (h > PLANT_DT_MAX)
+        {
+            plant_rk4(plant, PLANT_DT_MAX);
+            plant->time += PLANT_DT_MAX;
+        }
+        else
+        {
+            plant_rk4(plant, h);
+            plant->time = time;
+        }
+    }
+}
@@ -0,0 +1,831 @@
+/**
+ * @file scenario.c
+ * @brief Scriptable test scenarios for the host simulator implementation
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "scenario.h"
+
+/**
+ * @brief Longest accepted scenario line
+ */
+#define SCENARIO_LINE_LEN 256
+
+/**
+ * @brief Metric names in scenario_metric_t order
+ */
+static const char *const scenario_metric_names[SCENARIO_METRIC_COUNT] = {
+    "overshoot", "rise", "settle", "error", "iae", "itae", "effort", "deviation", "recover"};
+
+/**
+ * @brief Running evaluation of one event
+ */
+typedef struct
+{
+    double step_from;  /* Target before a step (deg) */
+    double t10;        /* First time at 10 % of the step (s, < 0 if not reached) */
+    double t90;        /* First time at 90 % of the step (s, < 0 if not reached) */
+    double peak;       /* Largest excursion beyond the target in the step direction (deg) */
+    double last_out;   /* Last time outside the band (s, < 0 if never) */
+    double ss_sum;     /* Sum of |error| in the steady-state window */
+    uint32_t ss_count; /* Samples in the steady-state window */
+    double release;    /* End of the push (s) */
+} scenario_eval_t;
+
+/**
+ * @brief Metric name as used in scenario files
+ *
+ * @param[in] metric Metric
+ *
+ * @return Name string
+ */
+const char *scenario_metric_name(scenario_metric_t metric)
+{
+    return metric < SCENARIO_METRIC_COUNT ? scenario_metric_names[metric] : "?";
+}
+
+/**
+ * @brief Set a plant parameter by name
+ *
+ * @param[in,out] p Pointer to parameter structure
+ * @param[in] name Parameter name
+ * @param[in] value Value
+ *
+ * @return 0 on success, -1 for an unknown name
+ */
+static int scenario_set_plant(plant_params_t *p, const char *name, double value)
+{
+    if (strcmp(name, "neutral") == 0)
+    {
+        p->neutral_deg = value;
+    }
+    else if (strcmp(name, "w0_sq") == 0)
+    {
+        p->w0_sq = value;
+    }
+    else if (strcmp(name, "damping") == 0)
+    {
+        p->damping = value;
+    }
+    else if (strcmp(name, "coulomb") == 0)
+    {
+        p->coulomb = value;
+    }
+    else if (strcmp(name, "thrust_max") == 0)
+    {
+        p->thrust_max = value;
+    }
+    else if (strcmp(name, "deadzone") == 0)
+    {
+        p->deadzone = value;
+    }
+    else if (strcmp(name, "reverse_gain") == 0)
+    {
+        p->reverse_gain = value;
+    }
+    else if (strcmp(name, "motor_tau") == 0)
+    {
+        p->motor_tau = value;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Set a simulation setting by name
+ *
+ * @param[in,out] cfg Pointer to settings structure
+ * @param[in] name Setting name
+ * @param[in] value Value
+ *
+ * @return 0 on success, -1 for an unknown name
+ */
+static int scenario_set_sim(sim_config_t *cfg, const char *name, double value)
+{
+    if (strcmp(name, "i2c_hz") == 0 && value > 0)
+    {
+        cfg->i2c_hz = (uint32_t)value;
+    }
+    else if (strcmp(name, "slow_filter") == 0 && value >= AS5600_SF_16X && value <= AS5600_SF_2X)
+    {
+        cfg->slow_filter = (uint8_t)value;
+    }
+    else if (strcmp(name, "compute_us") == 0)
+    {
+        cfg->compute_s = value * 1e-6;
+    }
+    else if (strcmp(name, "noise") == 0)
+    {
+        cfg->noise_counts = value;
+    }
+    else if (strcmp(name, "offset") == 0)
+    {
+        cfg->magnet_offset_deg = value;
+    }
+    else if (strcmp(name, "seed") == 0)
+    {
+        cfg->seed = (uint32_t)value;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Parse the action part of an "at" statement
+ *
+ * @param[in,out] sc Pointer to scenario structure
+ * @param[in] time Action time (s)
+ * @param[in] text Text after the time
+ *
+ * @return SCENARIO_OK on success, error code on failure
+ */
+static scenario_err_t scenario_parse_action(scenario_t *sc, double time, const char *text)
+{
+    scenario_action_t *act;
+    char verb[16];
+    double *a;
+    int n;
+
+    if (sc->action_count >= SCENARIO_MAX_ACTIONS)
+    {
+        return SCENARIO_ERR_FULL;
+    }
+
+    /* Actions must be listed in chronological order */
+    if (sc->action_count > 0 && time < sc->actions[sc->action_count - 1].time)
+    {
+        return SCENARIO_ERR_SYNTAX;
+    }
+
+    act = &sc->actions[sc->action_count];
+    a = act->arg;
+    memset(act, 0, sizeof(*act));
+    act->time = time;
+    act->event = -1;
+
+    n = sscanf(text, "%15s %lf %lf %lf %lf", verb, &a[0], &a[1], &a[2], &a[3]);
+    if (n < 1)
+    {
+        return SCENARIO_ERR_SYNTAX;
+    }
+
+    if (strcmp(verb, "start") == 0 && n == 1)
+    {
+        act->type = SCENARIO_ACT_START;
+    }
+    else if (strcmp(verb, "stop") == 0 && n == 1)
+    {
+        act->type = SCENARIO_ACT_STOP;
+    }
+    else if (strcmp(verb, "set") == 0 && n == 2)
+    {
+        act->type = SCENARIO_ACT_SET;
+    }
+    else if (strcmp(verb, "push") == 0 && n == 3 && a[1] >= 0)
+    {
+        act->type = SCENARIO_ACT_PUSH;
+    }
+    else if (strcmp(verb, "ff") == 0 && n == 2)
+    {
+        act->type = SCENARIO_ACT_FF;
+    }
+    else if (strcmp(verb, "dob") == 0 && n == 2)
+    {
+        act->type = SCENARIO_ACT_DOB;
+    }
+    else if (strcmp(verb, "dobcfg") == 0 && n == 3)
+    {
+        act->type = SCENARIO_ACT_DOBCFG;
+    }
+    else if (strcmp(verb, "ffdyn") == 0 && n == 3)
+    {
+        act->type = SCENARIO_ACT_FFDYN;
+    }
+    else if (strcmp(verb, "lqr") == 0 && n == 2)
+    {
+        act->type = SCENARIO_ACT_LQR;
+    }
+    else if (strcmp(verb, "lqrk") == 0 && n == 5)
+    {
+        act->type = SCENARIO_ACT_LQRK;
+    }
+    else if (strcmp(verb, "pred") == 0 && n == 3)
+    {
+        act->type = SCENARIO_ACT_PRED;
+    }
+    else if (strcmp(verb, "osc") == 0 && n == 4 && a[2] >= 0)
+    {
+        act->type = SCENARIO_ACT_OSC;
+    }
+    else if (strcmp(verb, "supply") == 0 && n == 2 && a[0] > 0)
+    {
+        act->type = SCENARIO_ACT_SUPPLY;
+    }
+    else if (strcmp(verb, "vcomp") == 0 && n == 2)
+    {
+        act->type = SCENARIO_ACT_VCOMP;
+    }
+    else if (strcmp(verb, "sched") == 0 && n == 2)
+    {
+        act->type = SCENARIO_ACT_SCHED;
+    }
+    else if (strcmp(verb, "point") == 0 && n == 5)
+    {
+        act->type = SCENARIO_ACT_POINT;
+    }
+    else if (strcmp(verb, "profile") == 0 && n == 2 && a[0] >= TRAJ_PROFILE_STEP && a[0] <= TRAJ_PROFILE_SCURVE)
+    {
+        act->type = SCENARIO_ACT_PROFILE;
+    }
+    else if (strcmp(verb, "limits") == 0 && n == 4)
+    {
+        act->type = SCENARIO_ACT_LIMITS;
+    }
+    else
+    {
+        return SCENARIO_ERR_SYNTAX;
+    }
+
+    if (act->type == SCENARIO_ACT_SET || act->type == SCENARIO_ACT_PUSH || act->type == SCENARIO_ACT_SUPPLY)
+    {
+        if (sc->event_count >= SCENARIO_MAX_EVENTS)
+        {
+            return SCENARIO_ERR_FULL;
+        }
+        act->event = (int8_t)sc->event_count++;
+    }
+
+    sc->action_count++;
+    return SCENARIO_OK;
+}
+
+/**
+ * @brief Parse an "expect" statement
+ *
+ * @param[in,out] sc Pointer to scenario structure
+ * @param[in] text Text after the keyword
+ *
+ * @return SCENARIO_OK on success, error code on failure
+ */
+static scenario_err_t scenario_parse_expect(scenario_t *sc, const char *text)
+{
+    scenario_expect_t *exp;
+    char name[16], op[2];
+    int m;
+
+    if (sc->expect_count >= SCENARIO_MAX_EXPECTS)
+    {
+        return SCENARIO_ERR_FULL;
+    }
+
+    exp = &sc->expects[sc->expect_count];
+    if (sc->event_count == 0 || sscanf(text, "%15s %1[<>] %lf", name, op, &exp->limit) != 3)
+    {
+        return SCENARIO_ERR_SYNTAX;
+    }
+
+    for (m = 0; m < SCENARIO_METRIC_COUNT; m++)
+    {
+        if (strcmp(name, scenario_metric_names[m]) == 0)
+        {
+            break;
+        }
+    }
+    if (m == SCENARIO_METRIC_COUNT)
+    {
+        return SCENARIO_ERR_SYNTAX;
+    }
+
+    exp->event = sc->event_count - 1;
+    exp->metric = (scenario_metric_t)m;
+    exp->op = op[0];
+    sc->expect_count++;
+    return SCENARIO_OK;
+}
+
+/**
+ * @brief Parse a scenario file
+ *
+ * @param[out] sc Pointer to scenario structure
+ * @param[in] path File path
+ * @param[out] line Line number of a syntax error (may be NULL)
+ *
+ * @return SCENARIO_OK on success, error code on failure
+ */
+scenario_err_t scenario_load(scenario_t *sc, const char *path, uint32_t *line)
+{
+    char buf[SCENARIO_LINE_LEN];
+    scenario_err_t rslt = SCENARIO_OK;
+    uint32_t line_no = 0;
+    FILE *f;
+
+    if (!sc || !path)
+    {
+        return SCENARIO_ERR_INVALID_PARAM;
+    }
+
+    memset(sc, 0, sizeof(*sc));
+    strncpy(sc->name, path, SCENARIO_NAME_LEN - 1);
+    sc->duration = 10.0;
+    sc->band = 1.0;
+    sc->tuning.gains.kp = FIX16_FROM_FLOAT(0.020);
+    sc->tuning.gains.ki = FIX16_FROM_FLOAT(0.030);
+    sc->tuning.gains.kd = FIX16_FROM_FLOAT(0.0015);
+    sc->tuning.d_alpha = PID_D_ALPHA_DEFAULT;
+    sc->tuning.i_limit = PID_I_LIMIT_DEFAULT;
+    plant_default_params(&sc->plant);
+    sim_default_config(&sc->sim);
+
+    f = fopen(path, "r");
+    if (!f)
+    {
+        return SCENARIO_ERR_FILE;
+    }
+
+    while (rslt == SCENARIO_OK && fgets(buf, sizeof(buf), f))
+    {
+        char key[16], name[24];
+        double v[3];
+        int offset = 0;
+        char *hash = strchr(buf, '#');
+
+        line_no++;
+        if (hash)
+        {
+            *hash = '\0';
+        }
+
+        if (sscanf(buf, "%15s%n", key, &offset) != 1)
+        {
+            continue; /* Empty line */
+        }
+
+        if (strcmp(key, "name") == 0)
+        {
+            if (sscanf(buf + offset, " %47[^\r\n]", sc->name) != 1)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+        }
+        else if (strcmp(key, "duration") == 0)
+        {
+            if (sscanf(buf + offset, "%lf", &sc->duration) != 1 || sc->duration <= 0)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+        }
+        else if (strcmp(key, "band") == 0)
+        {
+            if (sscanf(buf + offset, "%lf", &sc->band) != 1 || sc->band <= 0)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+        }
+        else if (strcmp(key, "gains") == 0)
+        {
+            if (sscanf(buf + offset, "%lf %lf %lf", &v[0], &v[1], &v[2]) != 3)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+            else
+            {
+                sc->tuning.gains.kp = FIX16_FROM_FLOAT(v[0]);
+                sc->tuning.gains.ki = FIX16_FROM_FLOAT(v[1]);
+                sc->tuning.gains.kd = FIX16_FROM_FLOAT(v[2]);
+            }
+        }
+        else if (strcmp(key, "filter") == 0)
+        {
+            if (sscanf(buf + offset, "%lf", &v[0]) != 1 || v[0] <= 0 || v[0] > 1)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+            else
+            {
+                sc->tuning.d_alpha = FIX16_FROM_FLOAT(v[0]);
+            }
+        }
+        else if (strcmp(key, "ilimit") == 0)
+        {
+            if (sscanf(buf + offset, "%lf", &v[0]) != 1 || v[0] <= 0)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+            else
+            {
+                sc->tuning.i_limit = FIX16_FROM_FLOAT(v[0]);
+            }
+        }
+        else if (strcmp(key, "plant") == 0)
+        {
+            if (sscanf(buf + offset, "%23s %lf", name, &v[0]) != 2 ||
+                scenario_set_plant(&sc->plant, name, v[0]) != 0)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+        }
+        else if (strcmp(key, "sim") == 0)
+        {
+            if (sscanf(buf + offset, "%23s %lf", name, &v[0]) != 2 ||
+                scenario_set_sim(&sc->sim, name, v[0]) != 0)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+        }
+        else if (strcmp(key, "at") == 0)
+        {
+            int n = 0;
+
+            if (sscanf(buf + offset, "%lf%n", &v[0], &n) != 1 || v[0] < 0)
+            {
+                rslt = SCENARIO_ERR_SYNTAX;
+            }
+            else
+            {
+                rslt = scenario_parse_action(sc, v[0], buf + offset + n);
+            }
+        }
+        else if (strcmp(key, "expect") == 0)
+        {
+            rslt = scenario_parse_expect(sc, buf + offset);
+        }
+        else
+        {
+            rslt = SCENARIO_ERR_SYNTAX;
+        }
+    }
+
+    fclose(f);
+
+    if (line)
+    {
+        *line = rslt == SCENARIO_OK ? 0 : line_no;
+    }
+
+    return rslt;
+}
+
+/**
+ * @brief Apply a timed action to the firmware or the plant
+ *
+ * Controller settings are edited in the parameter shadow and take effect at
+ * the next tick; schedule and state feedback points go into the tables directly.
+ *
+ * @param[in,out] sim Pointer to simulation structure
+ * @param[in] act Action
+ */
+static void scenario_apply(sim_t *sim, const scenario_action_t *act)
+{
+    controller_t *ctrl = &sim->reg.ctrl;
+    ctrl_params_block_t *pb = &sim->reg.params;
+    const double *a = act->arg;
+
+    switch (act->type)
+    {
+    case SCENARIO_ACT_START:
+        regulator_enable(&sim->reg, 1);
+        break;
+    case SCENARIO_ACT_STOP:
+        regulator_enable(&sim->reg, 0);
+        break;
+    case SCENARIO_ACT_SET:
+        ctrl_params_edit(pb)->target = FIX16_FROM_FLOAT(a[0]);
+        break;
+    case SCENARIO_ACT_PUSH:
+        sim_set_disturbance(sim, a[0]);
+        break;
+    case SCENARIO_ACT_FF:
+        ctrl_params_edit(pb)->ff_enabled = a[0] != 0;
+        break;
+    case SCENARIO_ACT_DOB:
+        ctrl_params_edit(pb)->dob_enabled = a[0] != 0;
+        break;
+    case SCENARIO_ACT_DOBCFG:
+        ctrl_params_edit(pb)->dob_bandwidth = (uint16_t)a[0];
+        ctrl_params_edit(pb)->dob_motor_tau_ms = (uint16_t)a[1];
+        break;
+    case SCENARIO_ACT_FFDYN:
+        ctrl_params_edit(pb)->ff_k_vel = FF_K_FROM_FLOAT(a[0]);
+        ctrl_params_edit(pb)->ff_k_acc = FF_K_FROM_FLOAT(a[1]);
+        break;
+    case SCENARIO_ACT_LQR:
+        ctrl_params_edit(pb)->lqr_enabled = a[0] != 0 && ctrl->lqr.count > 0;
+        break;
+    case SCENARIO_ACT_LQRK:
+    {
+        lqr_gains_t gains = {LQR_K_FROM_FLOAT(a[1]), LQR_K_FROM_FLOAT(a[2]), FIX16_FROM_FLOAT(a[3])};
+
+        lqr_set_point(&ctrl->lqr, FIX16_FROM_FLOAT(a[0]), &gains);
+        break;
+    }
+    case SCENARIO_ACT_PRED:
+        ctrl_params_edit(pb)->pred_modes = (a[0] != 0 ? CONTROLLER_PRED_PID : 0) | (a[1] != 0 ? CONTROLLER_PRED_LQR : 0);
+        break;
+    case SCENARIO_ACT_OSC:
+        regulator_configure_osc(&sim->reg, a[0] != 0, a[1] != 0, FIX16_FROM_FLOAT(a[2]));
+        break;
+    case SCENARIO_ACT_SUPPLY:
+        sim_set_supply(sim, a[0]);
+        break;
+    case SCENARIO_ACT_VCOMP:
+        supply_configure(sim->reg.supply, a[0] != 0, FIX16_FROM_FLOAT(SIM_SUPPLY_NOMINAL_V));
+        break;
+    case SCENARIO_ACT_SCHED:
+        ctrl_params_edit(pb)->sched_enabled = a[0] != 0 && ctrl->sched.count > 0;
+        break;
+    case SCENARIO_ACT_POINT:
+    {
+        pid_gains_t gains = {FIX16_FROM_FLOAT(a[1]), FIX16_FROM_FLOAT(a[2]), FIX16_FROM_FLOAT(a[3])};
+
+        gain_sched_set_point(&ctrl->sched, FIX16_FROM_FLOAT(a[0]), &gains);
+        break;
+    }
+    case SCENARIO_ACT_PROFILE:
+        ctrl_params_edit(pb)->profile = (traj_profile_t)a[0];
+        break;
+    case SCENARIO_ACT_LIMITS:
+        ctrl_params_edit(pb)->vel_max = FIX16_FROM_FLOAT(a[0]);
+        ctrl_params_edit(pb)->acc_max = FIX16_FROM_FLOAT(a[1]);
+        ctrl_params_edit(pb)->jerk_max = FIX16_FROM_FLOAT(a[2]);
+        break;
+    }
+}
+
+/**
+ * @brief Start the evaluation of an event
+ *
+ * @param[out] ev Event result
+ * @param[out] eval Running evaluation
+ * @param[in] act Action starting the event
+ * @param[in] target Target before the action (deg)
+ * @param[in] end End of the event (s)
+ */
+static void scenario_event_begin(scenario_event_result_t *ev, scenario_eval_t *eval,
+                                 const scenario_action_t *act, double target, double end)
+{
+    memset(ev, 0, sizeof(*ev));
+    ev->type = act->type;
+    ev->start = act->time;
+    ev->end = end;
+    ev->target = act->type == SCENARIO_ACT_SET ? act->arg[0] : target;
+
+    eval->step_from = target;
+    eval->t10 = -1.0;
+    eval->t90 = -1.0;
+    eval->peak = 0.0;
+    eval->last_out = -1.0;
+    eval->ss_sum = 0.0;
+    eval->ss_count = 0;
+    eval->release = act->type == SCENARIO_ACT_PUSH ? act->time + act->arg[1] : act->time;
+}
+
+/**
+ * @brief Add one sample to the running evaluation
+ *
+ * @param[in,out] ev Event result
+ * @param[in,out] eval Running evaluation
+ * @param[in] t Sample time (s)
+ * @param[in] dt Sample period (s)
+ * @param[in] angle Measured angle (deg)
+ * @param[in] duty Motor duty
+ * @param[in] band Settling band (deg)
+ */
+static void scenario_event_sample(scenario_event_result_t *ev, scenario_eval_t *eval, double t,
+                                  double dt, double angle, double duty, double band)
+{
+    double e = fabs(angle - ev->target);
+    double *m = ev->metric;
+
+    m[SCENARIO_METRIC_IAE] += e * dt;
+    m[SCENARIO_METRIC_ITAE] += (t - ev->start) * e * dt;
+    m[SCENARIO_METRIC_EFFORT] += duty * duty * dt;
+    m[SCENARIO_METRIC_DEVIATION] = e > m[SCENARIO_METRIC_DEVIATION] ? e : m[SCENARIO_METRIC_DEVIATION];
+
+    if (e > band && t >= eval->release)
+    {
+        eval->last_out = t;
+    }
+
+    if (t >= ev->end - SCENARIO_SS_WINDOW)
+    {
+        eval->ss_sum += e;
+        eval->ss_count++;
+    }
+
+    if (ev->type == SCENARIO_ACT_SET)
+    {
+        double step = ev->target - eval->step_from;
+        double dir = step >= 0 ? 1.0 : -1.0;
+        double progress = step != 0 ? (angle - eval->step_from) / step : 1.0;
+        double beyond = dir * (angle - ev->target);
+
+        eval->peak = beyond > eval->peak ? beyond : eval->peak;
+        if (eval->t10 < 0 && progress >= 0.1)
+        {
+            eval->t10 = t;
+        }
+        if (eval->t90 < 0 && progress >= 0.9)
+        {
+            eval->t90 = t;
+        }
+    }
+}
+
+/**
+ * @brief Finish the evaluation of an event
+ *
+ * @param[in,out] ev Event result
+ * @param[in] eval Running evaluation
+ * @param[in] dt Sample period (s)
+ */
+static void scenario_event_end(scenario_event_result_t *ev, const scenario_eval_t *eval, double dt)
+{
+    double *m = ev->metric;
+    double settle = eval->last_out < 0 ? 0.0 : eval->last_out + dt - eval->release;
+
+    m[SCENARIO_METRIC_ERROR] = eval->ss_count ? eval->ss_sum / eval->ss_count : NAN;
+
+    /* Never settled within the event: report it as not settled at all */
+    if (eval->last_out >= ev->end - dt)
+    {
+        settle = INFINITY;
+    }
+
+    if (ev->type == SCENARIO_ACT_SET)
+    {
+        double step = fabs(ev->target - eval->step_from);
+
+        m[SCENARIO_METRIC_OVERSHOOT] = step > 0 ? 100.0 * eval->peak / step : 0.0;
+        m[SCENARIO_METRIC_RISE] = (eval->t10 >= 0 && eval->t90 >= 0) ? eval->t90 - eval->t10 : INFINITY;
+        m[SCENARIO_METRIC_SETTLE] = settle;
+        m[SCENARIO_METRIC_RECOVER] = NAN;
+    }
+    else
+    {
+        m[SCENARIO_METRIC_OVERSHOOT] = NAN;
+        m[SCENARIO_METRIC_RISE] = NAN;
+        m[SCENARIO_METRIC_SETTLE] = NAN;
+        m[SCENARIO_METRIC_RECOVER] = settle;
+    }
+}
+
+/**
+ * @brief Run a scenario and evaluate its checks
+ *
+ * @param[in] sc Pointer to scenario structure
+ * @param[in] tuning Tuning overriding the scenario one (NULL to use the scenario tuning)
+ * @param[out] res Pointer to result structure
+ * @param[in] trace CSV trace output in the firmware log format (NULL for none)
+ * @param[in,out] tlm Binary telemetry of the firmware log channels, every tick (NULL for none)
+ *
+ * @return SCENARIO_OK on success, error code on failure
+ */
+scenario_err_t scenario_run(const scenario_t *sc, const scenario_tuning_t *tuning,
+                            scenario_result_t *res, FILE *trace, telemetry_t *tlm)
+{
+    static _Thread_local sim_t sim;
+    scenario_eval_t eval;
+    double dt, push_end = -1.0;
+    uint32_t ticks;
+    int cur = -1;
+    uint8_t next = 0;
+
+    if (!sc || !res)
+    {
+        return SCENARIO_ERR_INVALID_PARAM;
+    }
+
+    dt = 1.0 / sc->sim.rate_hz;
+    ticks = (uint32_t)(sc->duration * sc->sim.rate_hz + 0.5);
+
+    if (!tuning)
+    {
+        tuning = &sc->tuning;
+    }
+
+    memset(res, 0, sizeof(*res));
+    if (sim_init(&sim, &sc->plant, &sc->sim, &tuning->gains) != AS5600_OK)
+    {
+        return SCENARIO_ERR_SIM;
+    }
+    ctrl_params_edit(&sim.reg.params)->d_alpha = tuning->d_alpha;
+    ctrl_params_edit(&sim.reg.params)->i_limit = tuning->i_limit;
+
+    for (uint32_t tick = 0; tick < ticks; tick++)
+    {
+        double t = sim_time(&sim);
+        as5600_err_t rslt;
+        double angle;
+
+        /* Actions due at this tick (half a tick tolerance for decimal times) */
+        while (next < sc->action_count && sc->actions[next].time <= t + 0.5 * dt)
+        {
+            const scenario_action_t *act = &sc->actions[next++];
+
+            if (act->event >= 0)
+            {
+                double end = sc->duration;
+
+                if (cur >= 0)
+                {
+                    scenario_event_end(&res->events[cur], &eval, dt);
+                }
+
+                /* The event lasts until the next one starts */
+                for (uint8_t i = next; i < sc->action_count; i++)
+                {
+                    if (sc->actions[i].event >= 0)
+                    {
+                        end = sc->actions[i].time;
+                        break;
+                    }
+                }
+
+                cur = act->event;
+                scenario_event_begin(&res->events[cur], &eval, act,
+                                     FIX16_TO_FLOAT(sim.reg.ctrl.target), end);
+                res->event_count = (uint8_t)(cur + 1);
+            }
+
+            if (act->type == SCENARIO_ACT_PUSH)
+            {
+                push_end = act->time + act->arg[1];
+            }
+
+            scenario_apply(&sim, act);
+        }
+
+        if (push_end >= 0 && t >= push_end - 0.5 * dt)
+        {
+            sim_set_disturbance(&sim, 0.0);
+            push_end = -1.0;
+        }
+
+        /* Controller settings reach the firmware like from the serial handler */
+        ctrl_params_publish(&sim.reg.params);
+        rslt = sim_tick(&sim);
+        if (rslt != AS5600_OK)
+        {
+            res->sensor_errors++;
+            continue;
+        }
+
+        angle = FIX16_TO_FLOAT(sim.reg.angle);
+        if (cur >= 0)
+        {
+            scenario_event_sample(&res->events[cur], &eval, t, dt, angle,
+                                  FIX16_TO_FLOAT(sim.reg.command), sc->band);
+        }
+
+        if (trace)
+        {
+            fprintf(trace, "%lu,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)(t * 1000.0 + 0.5),
+                    FIX16_TO_FLOAT(sim.reg.ctrl.setpoint), angle, FIX16_TO_FLOAT(sim.reg.command),
+                    FIX16_TO_FLOAT(sim.supply.voltage));
+        }
+
+        if (tlm)
+        {
+            int32_t values[TELEMETRY_LOG_CHANNELS] = {
+                (int32_t)(uint32_t)(t * 1e6 + 0.5), sim.reg.ctrl.setpoint, sim.reg.angle, sim.reg.command,
+                sim.supply.voltage,
+            };
+
+            telemetry_send(tlm, values);
+        }
+    }
+
+    if (cur >= 0)
+    {
+        scenario_event_end(&res->events[cur], &eval, dt);
+    }
+
+    res->ticks = ticks;
+    res->i2c_load = sim.i2c_busy_s / sc->duration;
+    res->oscillations = sim.reg.osc.detections;
+    res->osc_freq = FIX16_TO_FLOAT(sim.reg.osc.freq);
+    res->osc_amplitude = FIX16_TO_FLOAT(sim.reg.osc.amplitude);
+    res->gain_scale = FIX16_TO_FLOAT(sim.reg.ctrl.gain_scale);
+    res->passed = 1;
+    for (uint8_t i = 0; i < sc->expect_count; i++)
+    {
+        const scenario_expect_t *exp = &sc->expects[i];
+        double value = exp->event < res->event_count ? res->events[exp->event].metric[exp->metric] : NAN;
+
+        /* NaN (metric not applicable or event not reached) never passes */
+        res->expect_pass[i] = exp->op == '<' ? value < exp->limit : value > exp->limit;
+        res->passed &= res->expect_pass[i];
+    }
+
+    return SCENARIO_OK;
+}
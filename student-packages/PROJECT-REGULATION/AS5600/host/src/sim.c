@@ -0,0 +1,421 @@
+/**
+ * @file sim.c
+ * @brief Closed-loop host simulation of the pendulum rig implementation
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sim.h"
+
+/**
+ * @brief I2C frame sizes in bit times (8 data bits + ACK per byte)
+ */
+#define SIM_I2C_BYTE_BITS 9
+#define SIM_I2C_START_BITS 1
+#define SIM_I2C_STOP_BITS 1
+
+/**
+ * @brief Emulated AS5600 register values that do not depend on the angle
+ */
+#define SIM_AS5600_AGC 128
+#define SIM_AS5600_MAGNITUDE 0x0800
+
+/**
+ * @brief Slow filter step response delay per CONF SF setting (datasheet), used as
+ * the time constant of a first-order low-pass
+ */
+static const double sim_sf_tau[4] = {
+    2.2e-3,   /* AS5600_SF_16X */
+    1.1e-3,   /* AS5600_SF_8X */
+    0.55e-3,  /* AS5600_SF_4X */
+    0.286e-3, /* AS5600_SF_2X */
+};
+
+/**
+ * @brief Next value of the xorshift32 generator
+ *
+ * @param[in,out] state Generator state (non-zero)
+ *
+ * @return Pseudo-random 32-bit value
+ */
+static uint32_t sim_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Approximately normally distributed pseudo-random value
+ *
+ * Sum of four uniform samples (Irwin-Hall), cheaper than Box-Muller and
+ * close enough for sensor noise.
+ *
+ * @param[in,out] state Generator state
+ *
+ * @return Sample with zero mean and unit variance
+ */
+static double sim_gauss(uint32_t *state)
+{
+    double sum = 0.0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        sum += sim_rand(state) / 4294967296.0;
+    }
+
+    return (sum - 2.0) * 1.7320508075688772; /* sqrt(12 / 4) */
+}
+
+/**
+ * @brief Integrate the plant and the sensor slow filter up to a time
+ *
+ * @param[in,out] sim Pointer to simulation structure
+ * @param[in] time Target time (s)
+ */
+static void sim_advance(sim_t *sim, double time)
+{
+    const double tau = sim_sf_tau[sim->regs[AS5600_CONF_HIGH_REG] & AS5600_CONF_SF_MASK];
+
+    while (sim->plant.time < time)
+    {
+        double t0 = sim->plant.time;
+        double h;
+
+        plant_advance(&sim->plant, time - t0 > PLANT_DT_MAX ? t0 + PLANT_DT_MAX : time);
+        h = sim->plant.time - t0;
+        sim->filt_deg += (sim->plant.theta - sim->filt_deg) * (1.0 - exp(-h / tau));
+    }
+}
+
+/**
+ * @brief Occupy the I2C bus for a number of bit times
+ *
+ * The plant is only integrated up to the clock where its state is observed or
+ * its input changes, which keeps the number of integration steps per tick low.
+ *
+ * @param[in,out] sim Pointer to simulation structure
+ * @param[in] bits Number of SCL periods
+ */
+static void sim_bus(sim_t *sim, uint32_t bits)
+{
+    double t = (double)bits / sim->cfg.i2c_hz;
+
+    sim->clock += t;
+    sim->i2c_busy_s += t;
+}
+
+/**
+ * @brief Convert the filtered angle at the current clock into the RAW ANGLE / ANGLE registers
+ *
+ * @param[in,out] sim Pointer to simulation structure
+ */
+static void sim_sample_angle(sim_t *sim)
+{
+    const uint8_t conf_low = sim->regs[AS5600_CONF_LOW_REG];
+    const int32_t hyst = (conf_low & AS5600_CONF_HYST_MASK) >> AS5600_CONF_HYST_POS;
+    const uint16_t zpos = (uint16_t)(((sim->regs[AS5600_ZPOS_HIGH_REG] & 0x0F) << 8) |
+                                     sim->regs[AS5600_ZPOS_LOW_REG]);
+    double deg, counts;
+    int32_t raw, diff;
+    uint16_t angle;
+
+    sim_advance(sim, sim->clock);
+    deg = sim->filt_deg - sim->plant.p.neutral_deg + sim->cfg.magnet_offset_deg;
+    counts = deg * AS5600_COUNTS / 360.0;
+
+    if (sim->cfg.noise_counts > 0)
+    {
+        counts += sim->cfg.noise_counts * sim_gauss(&sim->rng);
+    }
+
+    raw = (int32_t)floor(counts + 0.5) & (AS5600_COUNTS - 1);
+
+    /* Output only follows once it moved more than the hysteresis away */
+    diff = (raw - sim->counts) & (AS5600_COUNTS - 1);
+    diff = diff >= AS5600_COUNTS / 2 ? diff - AS5600_COUNTS : diff;
+    if (diff > hyst || diff < -hyst)
+    {
+        sim->counts = raw;
+    }
+
+    angle = (uint16_t)((sim->counts - zpos) & (AS5600_COUNTS - 1));
+    sim->regs[AS5600_RAW_ANGLE_HIGH_REG] = (uint8_t)(sim->counts >> 8);
+    sim->regs[AS5600_RAW_ANGLE_LOW_REG] = (uint8_t)sim->counts;
+    sim->regs[AS5600_ANGLE_HIGH_REG] = (uint8_t)(angle >> 8);
+    sim->regs[AS5600_ANGLE_LOW_REG] = (uint8_t)angle;
+}
+
+/**
+ * @brief Emulated I2C write (register address followed by data)
+ *
+ * @param dev_addr Device I2C address
+ * @param reg_addr Register address
+ * @param data Pointer to data to write
+ * @param len Length of data
+ * @param intf_ptr Simulation the sensor belongs to
+ * @return 0 on success, non-zero on failure
+ */
+static int8_t sim_i2c_write(uint8_t dev_addr, uint8_t reg_addr, const uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    sim_t *sim = intf_ptr;
+
+    sim->i2c_xfers++;
+    if (dev_addr != AS5600_I2C_ADDR)
+    {
+        /* Address not acknowledged */
+        sim_bus(sim, SIM_I2C_START_BITS + SIM_I2C_BYTE_BITS + SIM_I2C_STOP_BITS);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if (reg_addr + i != AS5600_BURN_REG)
+        {
+            sim->regs[(uint8_t)(reg_addr + i)] = data[i];
+        }
+    }
+
+    sim_bus(sim, SIM_I2C_START_BITS + (2 + len) * SIM_I2C_BYTE_BITS + SIM_I2C_STOP_BITS);
+    return 0;
+}
+
+/**
+ * @brief Emulated I2C read (register address write, repeated start, data read)
+ *
+ * @param dev_addr Device I2C address
+ * @param reg_addr Register address
+ * @param data Pointer to store read data
+ * @param len Length of data to read
+ * @param intf_ptr Simulation the sensor belongs to
+ * @return 0 on success, non-zero on failure
+ */
+static int8_t sim_i2c_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    sim_t *sim = intf_ptr;
+
+    sim->i2c_xfers++;
+    if (dev_addr != AS5600_I2C_ADDR)
+    {
+        sim_bus(sim, SIM_I2C_START_BITS + SIM_I2C_BYTE_BITS + SIM_I2C_STOP_BITS);
+        return -1;
+    }
+
+    /* Address + register, repeated start + address; the data is latched here */
+    sim_bus(sim, 2 * SIM_I2C_START_BITS + 3 * SIM_I2C_BYTE_BITS);
+    if (reg_addr <= AS5600_ANGLE_LOW_REG && reg_addr + len > AS5600_RAW_ANGLE_HIGH_REG)
+    {
+        sim_sample_angle(sim);
+    }
+    sim->regs[AS5600_STATUS_REG] = sim->status;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        data[i] = sim->regs[(uint8_t)(reg_addr + i)];
+    }
+
+    sim_bus(sim, len * SIM_I2C_BYTE_BITS + SIM_I2C_STOP_BITS);
+    return 0;
+}
+
+/**
+ * @brief Emulated millisecond delay
+ *
+ * @param ms Delay time in milliseconds
+ * @param intf_ptr Simulation whose clock advances
+ */
+static void sim_delay_ms(uint32_t ms, void *intf_ptr)
+{
+    sim_t *sim = intf_ptr;
+
+    sim->clock += ms * 1e-3;
+    sim_advance(sim, sim->clock);
+}
+
+/**
+ * @brief Emulated PWM update of the DRV8871 inputs
+ *
+ * @param in1_level Compare level of IN1
+ * @param in2_level Compare level of IN2
+ * @param intf_ptr Simulation the bridge belongs to
+ */
+static void sim_motor_set_levels(uint16_t in1_level, uint16_t in2_level, void *intf_ptr)
+{
+    sim_t *sim = intf_ptr;
+    const double period = SIM_MOTOR_PWM_WRAP + 1.0;
+
+    /* The output changes once the controller has finished computing */
+    sim->clock += sim->cfg.compute_s;
+    sim_advance(sim, sim->clock);
+
+    sim->plant.brake = in1_level > SIM_MOTOR_PWM_WRAP && in2_level > SIM_MOTOR_PWM_WRAP;
+    sim->plant.duty = sim->plant.brake ? 0.0 : (in1_level - in2_level) / period * sim->supply_v / SIM_SUPPLY_NOMINAL_V;
+}
+
+/**
+ * @brief Emulated ADC reading of the supply divider
+ *
+ * @param intf_ptr Simulation the supply belongs to
+ * @return Mean ADC reading (counts)
+ */
+static uint16_t sim_supply_read(void *intf_ptr)
+{
+    const sim_t *sim = intf_ptr;
+    double counts = sim->supply_v * 1000.0 / SIM_SUPPLY_MV_PER_COUNT + 0.5;
+
+    return (uint16_t)(counts < 4095.0 ? counts : 4095.0);
+}
+
+/**
+ * @brief Fill the settings with the values of the firmware
+ *
+ * @param[out] cfg Pointer to settings structure
+ */
+void sim_default_config(sim_config_t *cfg)
+{
+    cfg->rate_hz = 1000;
+    cfg->i2c_hz = 400000;
+    cfg->slow_filter = AS5600_SF_4X;
+    cfg->compute_s = 20e-6;
+    cfg->noise_counts = 0.3;
+    cfg->magnet_offset_deg = 123.4;
+    cfg->seed = 1;
+}
+
+/**
+ * @brief Initialize the plant and bring up the firmware like main() does
+ *
+ * @param[out] sim Pointer to simulation structure
+ * @param[in] params Plant parameters
+ * @param[in] cfg Simulation settings
+ * @param[in] gains Initial PID gains
+ *
+ * @return AS5600_OK on success, error code of the failing driver call
+ */
+as5600_err_t sim_init(sim_t *sim, const plant_params_t *params, const sim_config_t *cfg,
+                      const pid_gains_t *gains)
+{
+    as5600_config_t config;
+    as5600_err_t rslt;
+    double read_start;
+    fix16_t angle;
+
+    memset(sim, 0, sizeof(*sim));
+    sim->cfg = *cfg;
+    sim->rng = cfg->seed ? cfg->seed : 1;
+    sim->status = AS5600_STATUS_MD;
+    sim->regs[AS5600_AGC_REG] = SIM_AS5600_AGC;
+    sim->regs[AS5600_MAGNITUDE_HIGH_REG] = (uint8_t)(SIM_AS5600_MAGNITUDE >> 8);
+    sim->regs[AS5600_MAGNITUDE_LOW_REG] = (uint8_t)SIM_AS5600_MAGNITUDE;
+    plant_init(&sim->plant, params);
+    sim->filt_deg = sim->plant.theta;
+
+    motor_init(&sim->motor, sim_motor_set_levels, SIM_MOTOR_PWM_WRAP, sim);
+    sim->supply_v = SIM_SUPPLY_NOMINAL_V;
+    supply_init(&sim->supply, sim_supply_read, FIX16_FROM_FLOAT(SIM_SUPPLY_MV_PER_COUNT),
+                FIX16_FROM_FLOAT(SIM_SUPPLY_NOMINAL_V), cfg->rate_hz, sim);
+
+    rslt = as5600_init(&sim->sensor, sim_i2c_write, sim_i2c_read, sim_delay_ms, sim);
+    if (rslt != AS5600_OK)
+    {
+        return rslt;
+    }
+
+    /* Same sensor configuration as the firmware, slow filter from the settings */
+    rslt = as5600_get_config(&sim->sensor, &config);
+    if (rslt != AS5600_OK)
+    {
+        return rslt;
+    }
+
+    config.power_mode = AS5600_PM_NOM;
+    config.hysteresis = AS5600_HYST_1LSB;
+    config.slow_filter = (as5600_slow_filter_t)sim->cfg.slow_filter;
+    config.fast_filter_threshold = AS5600_FTH_SLOW_ONLY;
+    rslt = as5600_set_config(&sim->sensor, &config);
+    if (rslt != AS5600_OK)
+    {
+        return rslt;
+    }
+
+    /* Let the sensor filter settle before the offset calibration */
+    sim_delay_ms(10, sim);
+    sim_sample_angle(sim);
+
+    regulator_init(&sim->reg, &sim->sensor, &sim->motor, &sim->supply, gains, cfg->rate_hz);
+    rslt = regulator_calibrate(&sim->reg);
+
+    /* Latency from one timed read, like the firmware measures it */
+    read_start = sim->clock;
+    regulator_read_angle(&sim->reg, &angle);
+    regulator_set_latency(&sim->reg, (uint32_t)((sim->clock - read_start + cfg->compute_s) * 1e6 + 0.5));
+
+    /* Ticks start on a fresh time base */
+    sim->clock = 0.0;
+    sim->plant.time = 0.0;
+    sim->i2c_xfers = 0;
+    sim->i2c_busy_s = 0.0;
+    return rslt;
+}
+
+/**
+ * @brief Run one control tick (the plant is integrated lazily up to each observation)
+ *
+ * @param[in,out] sim Pointer to simulation structure
+ *
+ * @return Result of regulator_tick()
+ */
+as5600_err_t sim_tick(sim_t *sim)
+{
+    as5600_err_t rslt;
+
+    sim->clock = (double)sim->ticks / sim->cfg.rate_hz;
+
+    /* The plant is integrated lazily; the next sensor read brings it up to date */
+    rslt = regulator_tick(&sim->reg);
+
+    sim->ticks++;
+    return rslt;
+}
+
+/**
+ * @brief Apply an external torque from the current tick on
+ *
+ * @param[in,out] sim Pointer to simulation structure
+ * @param[in] thrust Torque in gravity units
+ */
+void sim_set_disturbance(sim_t *sim, double thrust)
+{
+    sim_advance(sim, sim_time(sim));
+    sim->plant.disturbance = thrust;
+}
+
+/**
+ * @brief Change the motor supply voltage from the current tick on
+ *
+ * @param[in,out] sim Pointer to simulation structure
+ * @param[in] volts Supply voltage (V)
+ */
+void sim_set_supply(sim_t *sim, double volts)
+{
+    sim_advance(sim, sim_time(sim));
+    sim->plant.duty *= volts / sim->supply_v;
+    sim->supply_v = volts;
+}
+
+/**
+ * @brief Simulated time of the next tick start (s)
+ *
+ * @param[in] sim Pointer to simulation structure
+ *
+ * @return Time in seconds
+ */
+double sim_time(const sim_t *sim)
+{
+    return (double)sim->ticks / sim->cfg.rate_hz;
+}
@@ -0,0 +1,847 @@
+/**
+ * @brief Plant model fit to an identification capture (Linux host)
+ *
+ * Reads the CSV dump of the firmware ID command (a serial log is fine, lines
+ * before "# sysid" and after "# end" are skipped) and removes the operating
+ * point. The fit runs in two stages:
+ *   1. a second-order ARX model
+ *        y[n] = a1*y[n-1] + a2*y[n-2] + b1*u[n-d] + b2*u[n-d-1]
+ *      is fitted by least squares on the decimated capture for every delay d
+ *      up to the limit; the delay with the smallest residual and the model
+ *      give the starting point,
+ *   2. the continuous model
+ *        G(s) = K * wn^2 / ((tau*s + 1) * (s^2 + 2*zeta*wn*s + wn^2)) * exp(-T*s)
+ *      (without the motor lag for -n 2) is simulated at the tick rate and
+ *      its parameters are refined by minimizing the simulation error
+ *      (Nelder-Mead). Equation-error ARX alone is biased by the sensor
+ *      quantization and the dry friction; the output-error fit is not.
+ *
+ * Below the motor corner frequency a dead time and a motor lag shift the
+ * phase alike, so the fit can trade one for the other: on a nonlinear plant
+ * the best dead time moves with the excitation signal. The dead time is
+ * therefore not refined freely. It is fixed at the measured sensor latency
+ * from the capture header (the firmware's latency_us, sensor filter and bus
+ * transfer) or at -T; otherwise it is scanned on the tick grid with the
+ * other parameters refined at each step, and the range of dead times that
+ * fit about equally well is reported.
+ *
+ * The result is reported as a transfer function and a state-space model, and
+ * mapped back onto the parameters of the simulator plant at the operating
+ * point, as "plant" statements that can be pasted into scenario files for
+ * pendulum_sim and pid_tune.
+ *
+ * Usage: sysid_fit [options] capture.csv
+ *   -n <order>   model order, 2 (pendulum) or 3 (pendulum and motor lag, default)
+ *   -r <factor>  decimation of the ARX stage (default 5)
+ *   -d <ms>      longest dead time searched (default 50 ms)
+ *   -T <ms>      fixed dead time (default: latency_us of the capture; negative: scan)
+ *   -o <file>    write the plant statements to a file
+ *
+ * Exit status: 0 on success, 1 if no usable model was found, 2 on errors.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Limits of a fit
+ */
+#define FIT_ARX_PARAMS 4
+#define FIT_MODEL_PARAMS 5
+#define FIT_LINE_LEN 256
+#define FIT_NM_ITERATIONS 3000
+#define FIT_NM_RESTARTS 3
+#define FIT_DEAD_TOL 0.01     /* Relative rms increase of dead times that fit about equally well */
+#define FIT_DEAD_SPREAD_MS 3.0 /* Wider range: dead time and motor lag not separately identifiable */
+
+/**
+ * @brief Unit conversion
+ */
+#define FIT_DEG_PER_RAD (180.0 / M_PI)
+
+/**
+ * @brief Capture read from the dump
+ */
+typedef struct
+{
+    char signal[16]; /* Excitation name */
+    double rate_hz;  /* Tick rate */
+    double u0;       /* Operating-point duty */
+    double neutral;  /* Pendulum angle at the neutral position (deg) */
+    double latency;  /* Measured sensor latency (s), negative if not in the header */
+    double *duty;    /* Applied duty per tick */
+    double *angle;   /* Measured angle per tick (deg) */
+    size_t count;    /* Number of ticks */
+    size_t capacity; /* Allocated ticks */
+} fit_capture_t;
+
+/**
+ * @brief Second-order ARX model
+ */
+typedef struct
+{
+    int delay;   /* Input delay in samples (1 = no dead time) */
+    double a[2]; /* Output coefficients */
+    double b[2]; /* Input coefficients */
+    double rms;  /* One-step prediction residual (deg) */
+} fit_arx_t;
+
+/**
+ * @brief Continuous model
+ */
+typedef struct
+{
+    double gain; /* Static gain (deg per duty) */
+    double wn;   /* Natural frequency (rad/s) */
+    double zeta; /* Damping ratio */
+    double dead; /* Dead time (s) */
+    double tau;  /* Motor lag (s), unused for order 2 */
+} fit_model_t;
+
+/**
+ * @brief Data of the output-error cost
+ */
+typedef struct
+{
+    const double *u; /* Input deviation per tick */
+    const double *y; /* Output deviation per tick */
+    size_t n;        /* Number of ticks */
+    double dt;       /* Tick period (s) */
+    int order;       /* Model order (2 or 3) */
+    double dead_max; /* Longest dead time (s) */
+} fit_oe_t;
+
+/**
+ * @brief Read the capture from a dump file
+ *
+ * @param path File path
+ * @param cap Pointer to capture structure
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int fit_read_capture(const char *path, fit_capture_t *cap)
+{
+    char line[FIT_LINE_LEN];
+    int in_capture = 0;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    memset(cap, 0, sizeof(*cap));
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        unsigned long tick;
+        double duty, angle;
+        char *p;
+
+        if (strncmp(line, "# sysid ", 8) == 0)
+        {
+            /* A later capture in the same log replaces an earlier one */
+            if (sscanf(line + 8, "%15s", cap->signal) != 1)
+            {
+                break;
+            }
+            p = strstr(line, " rate ");
+            cap->rate_hz = p ? atof(p + 6) : 0.0;
+            p = strstr(line, " u0 ");
+            cap->u0 = p ? atof(p + 4) : 0.0;
+            p = strstr(line, " neutral ");
+            cap->neutral = p ? atof(p + 9) : 0.0;
+            p = strstr(line, " latency_us ");
+            cap->latency = p ? atof(p + 12) * 1e-6 : -1.0;
+            cap->count = 0;
+            in_capture = 1;
+            continue;
+        }
+        if (!in_capture)
+        {
+            continue;
+        }
+        if (strncmp(line, "# end", 5) == 0)
+        {
+            in_capture = 0;
+            continue;
+        }
+        if (sscanf(line, "%lu,%lf,%lf", &tick, &duty, &angle) != 3)
+        {
+            continue;
+        }
+
+        if (cap->count == cap->capacity)
+        {
+            cap->capacity = cap->capacity ? cap->capacity * 2 : 4096;
+            cap->duty = realloc(cap->duty, cap->capacity * sizeof(double));
+            cap->angle = realloc(cap->angle, cap->capacity * sizeof(double));
+        }
+        cap->duty[cap->count] = duty;
+        cap->angle[cap->count] = angle;
+        cap->count++;
+    }
+
+    fclose(f);
+    return cap->rate_hz > 0 && cap->count > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Solve a small linear system in place (Gaussian elimination, partial pivoting)
+ *
+ * @param n System size
+ * @param m Matrix (row-major n x n), destroyed
+ * @param x Right-hand side on entry, solution on return
+ *
+ * @return 0 on success, -1 if the matrix is singular
+ */
+static int fit_solve(int n, double m[FIT_ARX_PARAMS][FIT_ARX_PARAMS], double x[FIT_ARX_PARAMS])
+{
+    for (int c = 0; c < n; c++)
+    {
+        int piv = c;
+        double t;
+
+        for (int r = c + 1; r < n; r++)
+        {
+            if (fabs(m[r][c]) > fabs(m[piv][c]))
+            {
+                piv = r;
+            }
+        }
+        if (fabs(m[piv][c]) < 1e-12)
+        {
+            return -1;
+        }
+        for (int k = 0; k < n; k++)
+        {
+            t = m[c][k];
+            m[c][k] = m[piv][k];
+            m[piv][k] = t;
+        }
+        t = x[c];
+        x[c] = x[piv];
+        x[piv] = t;
+
+        for (int r = c + 1; r < n; r++)
+        {
+            double f = m[r][c] / m[c][c];
+
+            for (int k = c; k < n; k++)
+            {
+                m[r][k] -= f * m[c][k];
+            }
+            x[r] -= f * x[c];
+        }
+    }
+
+    for (int r = n - 1; r >= 0; r--)
+    {
+        for (int k = r + 1; k < n; k++)
+        {
+            x[r] -= m[r][k] * x[k];
+        }
+        x[r] /= m[r][r];
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Fit the ARX model with a given delay by least squares
+ *
+ * @param u Input deviation
+ * @param y Output deviation
+ * @param n Number of samples
+ * @param start First predicted sample (same for all delays, so residuals compare)
+ * @param arx Pointer to model, delay set on entry
+ *
+ * @return 0 on success, -1 if the regression is singular
+ */
+static int fit_arx(const double *u, const double *y, size_t n, size_t start, fit_arx_t *arx)
+{
+    double m[FIT_ARX_PARAMS][FIT_ARX_PARAMS] = {{0}};
+    double v[FIT_ARX_PARAMS] = {0};
+    double phi[FIT_ARX_PARAMS];
+    double sse = 0.0;
+
+    for (size_t k = start; k < n; k++)
+    {
+        phi[0] = y[k - 1];
+        phi[1] = y[k - 2];
+        phi[2] = u[k - arx->delay];
+        phi[3] = u[k - arx->delay - 1];
+        for (int r = 0; r < FIT_ARX_PARAMS; r++)
+        {
+            for (int c = 0; c < FIT_ARX_PARAMS; c++)
+            {
+                m[r][c] += phi[r] * phi[c];
+            }
+            v[r] += phi[r] * y[k];
+        }
+    }
+
+    if (fit_solve(FIT_ARX_PARAMS, m, v) != 0)
+    {
+        return -1;
+    }
+
+    arx->a[0] = v[0];
+    arx->a[1] = v[1];
+    arx->b[0] = v[2];
+    arx->b[1] = v[3];
+
+    for (size_t k = start; k < n; k++)
+    {
+        double e = y[k] - arx->a[0] * y[k - 1] - arx->a[1] * y[k - 2] - arx->b[0] * u[k - arx->delay] -
+                   arx->b[1] * u[k - arx->delay - 1];
+        sse += e * e;
+    }
+    arx->rms = sqrt(sse / (double)(n - start));
+
+    return 0;
+}
+
+/**
+ * @brief Continuous second-order equivalent of the ARX model
+ *
+ * @param arx Pointer to ARX model
+ * @param ts Sample period of the ARX model (s)
+ * @param model Pointer to model, gain, wn, zeta and dead time set
+ *
+ * @return 0 on success, -1 if the poles have no stable continuous equivalent
+ */
+static int fit_arx_to_model(const fit_arx_t *arx, double ts, fit_model_t *model)
+{
+    /* Poles of z^2 - a1*z - a2 */
+    double disc = arx->a[0] * arx->a[0] + 4.0 * arx->a[1];
+
+    model->gain = (arx->b[0] + arx->b[1]) / (1.0 - arx->a[0] - arx->a[1]);
+    model->dead = (arx->delay - 1) * ts;
+
+    if (disc < 0.0)
+    {
+        /* Complex pair r * exp(+-j*phi): s = (ln(r) +- j*phi) / ts */
+        double re = log(sqrt(-arx->a[1])) / ts;
+        double im = atan2(sqrt(-disc) / 2.0, arx->a[0] / 2.0) / ts;
+
+        model->wn = sqrt(re * re + im * im);
+        model->zeta = -re / model->wn;
+    }
+    else
+    {
+        double z1 = (arx->a[0] + sqrt(disc)) / 2.0;
+        double z2 = (arx->a[0] - sqrt(disc)) / 2.0;
+        double s1, s2;
+
+        if (z1 <= 0.0 || z2 <= 0.0 || z1 >= 1.0 || z2 >= 1.0)
+        {
+            return -1;
+        }
+        s1 = log(z1) / ts;
+        s2 = log(z2) / ts;
+        model->wn = sqrt(s1 * s2);
+        model->zeta = -(s1 + s2) / (2.0 * model->wn);
+    }
+
+    return isfinite(model->gain) && model->wn > 0.0 && model->zeta > 0.0 ? 0 : -1;
+}
+
+/**
+ * @brief Sum of the squared simulation errors of the continuous model at the tick rate
+ *
+ * @param oe Pointer to cost data
+ * @param model Pointer to model
+ *
+ * @return Sum of the squared errors (deg^2)
+ */
+static double fit_oe_simulate(const fit_oe_t *oe, const fit_model_t *model)
+{
+    double lag = oe->order > 2 ? 1.0 - exp(-oe->dt / model->tau) : 1.0;
+    double shift = model->dead / oe->dt;
+    size_t whole = (size_t)shift;
+    double frac = shift - (double)whole;
+    double w2 = model->wn * model->wn, c2 = 2.0 * model->zeta * model->wn;
+    double x = 0.0, theta = oe->y[0], omega = 0.0, sse = 0.0;
+
+    for (size_t k = 0; k < oe->n; k++)
+    {
+        /* Delayed input, linear interpolation between ticks */
+        double u = k > whole ? (1.0 - frac) * oe->u[k - whole] + frac * oe->u[k - whole - 1] : 0.0;
+
+        x += lag * (model->gain * u - x);
+        omega += oe->dt * (w2 * (x - theta) - c2 * omega);
+        theta += oe->dt * omega;
+        sse += (oe->y[k] - theta) * (oe->y[k] - theta);
+    }
+
+    return sse;
+}
+
+/**
+ * @brief Model from the search vector (log scale for the positive parameters)
+ *
+ * @param p Search vector
+ * @param model Pointer to model on return
+ */
+static void fit_unpack(const double p[FIT_MODEL_PARAMS], fit_model_t *model)
+{
+    model->gain = p[0];
+    model->wn = exp(p[1]);
+    model->zeta = exp(p[2]);
+    model->dead = p[3];
+    model->tau = exp(p[4]);
+}
+
+/**
+ * @brief Search vector from a model
+ *
+ * @param model Pointer to model
+ * @param p Search vector on return
+ */
+static void fit_pack(const fit_model_t *model, double p[FIT_MODEL_PARAMS])
+{
+    p[0] = model->gain;
+    p[1] = log(model->wn);
+    p[2] = log(model->zeta);
+    p[3] = model->dead;
+    p[4] = log(model->tau);
+}
+
+/**
+ * @brief Output-error cost of a search vector
+ *
+ * @param oe Pointer to cost data
+ * @param p Search vector
+ *
+ * @return Sum of the squared simulation errors (infinite outside the valid range)
+ */
+static double fit_oe_cost(const fit_oe_t *oe, const double p[FIT_MODEL_PARAMS])
+{
+    fit_model_t model;
+
+    fit_unpack(p, &model);
+    if (model.dead < 0.0 || model.dead > oe->dead_max || model.tau < oe->dt || model.wn * oe->dt > 0.5)
+    {
+        return INFINITY;
+    }
+
+    return fit_oe_simulate(oe, &model);
+}
+
+/**
+ * @brief Minimize the output-error cost (Nelder-Mead simplex, restarted around the best point)
+ *
+ * @param oe Pointer to cost data
+ * @param p Starting point on entry, minimum on return (the other entries are kept)
+ * @param idx Entries of the vector searched
+ * @param dim Number of searched entries
+ *
+ * @return Cost at the minimum
+ */
+static double fit_nelder_mead(const fit_oe_t *oe, double p[FIT_MODEL_PARAMS], const int *idx, int dim)
+{
+    static const double step[FIT_MODEL_PARAMS] = {0.0, 0.2, 0.3, 0.005, 0.3};
+    double x[FIT_MODEL_PARAMS + 1][FIT_MODEL_PARAMS];
+    double f[FIT_MODEL_PARAMS + 1];
+    double best = fit_oe_cost(oe, p);
+
+    for (int restart = 0; restart < FIT_NM_RESTARTS; restart++)
+    {
+        for (int i = 0; i <= dim; i++)
+        {
+            memcpy(x[i], p, sizeof(x[i]));
+            if (i > 0)
+            {
+                /* The gain is searched on a linear scale: relative step */
+                x[i][idx[i - 1]] += idx[i - 1] == 0 ? 0.2 * fabs(p[0]) + 1e-3 : step[idx[i - 1]];
+            }
+            f[i] = fit_oe_cost(oe, x[i]);
+        }
+
+        for (int iter = 0; iter < FIT_NM_ITERATIONS; iter++)
+        {
+            double centroid[FIT_MODEL_PARAMS], xr[FIT_MODEL_PARAMS], xe[FIT_MODEL_PARAMS];
+            double fr, fe;
+            int hi = 0, lo = 0, nh;
+
+            for (int i = 0; i <= dim; i++)
+            {
+                lo = f[i] < f[lo] ? i : lo;
+                hi = f[i] > f[hi] ? i : hi;
+            }
+            nh = lo;
+            for (int i = 0; i <= dim; i++)
+            {
+                nh = (i != hi && f[i] > f[nh]) ? i : nh;
+            }
+            if (isfinite(f[hi]) && f[hi] - f[lo] <= 1e-10 * f[lo])
+            {
+                break;
+            }
+
+            /* Reflect the worst point through the centroid of the others */
+            memcpy(centroid, p, sizeof(centroid));
+            for (int j = 0; j < dim; j++)
+            {
+                centroid[idx[j]] = 0.0;
+                for (int i = 0; i <= dim; i++)
+                {
+                    centroid[idx[j]] += i != hi ? x[i][idx[j]] / dim : 0.0;
+                }
+            }
+            memcpy(xr, centroid, sizeof(xr));
+            memcpy(xe, centroid, sizeof(xe));
+            for (int j = 0; j < dim; j++)
+            {
+                xr[idx[j]] = 2.0 * centroid[idx[j]] - x[hi][idx[j]];
+                xe[idx[j]] = 3.0 * centroid[idx[j]] - 2.0 * x[hi][idx[j]];
+            }
+            fr = fit_oe_cost(oe, xr);
+
+            if (fr < f[lo])
+            {
+                fe = fit_oe_cost(oe, xe);
+                memcpy(x[hi], fe < fr ? xe : xr, sizeof(x[hi]));
+                f[hi] = fe < fr ? fe : fr;
+                continue;
+            }
+            if (fr < f[nh])
+            {
+                memcpy(x[hi], xr, sizeof(x[hi]));
+                f[hi] = fr;
+                continue;
+            }
+
+            /* Contract towards the centroid, shrink around the best point if that fails */
+            for (int j = 0; j < dim; j++)
+            {
+                xr[idx[j]] = 0.5 * (centroid[idx[j]] + x[hi][idx[j]]);
+            }
+            fr = fit_oe_cost(oe, xr);
+            if (fr < f[hi])
+            {
+                memcpy(x[hi], xr, sizeof(x[hi]));
+                f[hi] = fr;
+                continue;
+            }
+            for (int i = 0; i <= dim; i++)
+            {
+                if (i != lo)
+                {
+                    for (int j = 0; j < dim; j++)
+                    {
+                        x[i][idx[j]] = 0.5 * (x[i][idx[j]] + x[lo][idx[j]]);
+                    }
+                    f[i] = fit_oe_cost(oe, x[i]);
+                }
+            }
+        }
+
+        for (int i = 0; i <= dim; i++)
+        {
+            if (f[i] < best)
+            {
+                best = f[i];
+                memcpy(p, x[i], sizeof(x[i]));
+            }
+        }
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    fit_capture_t cap;
+    fit_arx_t best = {0}, arx;
+    fit_model_t model;
+    fit_oe_t oe;
+    double p[FIT_MODEL_PARAMS];
+    double *u, *y, *ud, *yd;
+    double u_mean = 0.0, y_mean = 0.0, y_var = 0.0, ts, sse, fit, dead_ms = NAN, dead_fixed;
+    int order = 3, decim = 5, max_delay_ms = 50, max_delay;
+    const char *out_path = NULL;
+    size_t nd, start;
+    int i = 1;
+
+    while (i + 1 < argc && argv[i][0] == '-')
+    {
+        if (strcmp(argv[i], "-n") == 0)
+        {
+            order = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            decim = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-d") == 0)
+        {
+            max_delay_ms = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-T") == 0)
+        {
+            dead_ms = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-o") == 0)
+        {
+            out_path = argv[i + 1];
+        }
+        else
+        {
+            break;
+        }
+        i += 2;
+    }
+
+    if (i + 1 != argc || order < 2 || order > 3 || decim < 1 || max_delay_ms < 0)
+    {
+        fprintf(stderr, "Usage: %s [-n 2|3] [-r factor] [-d ms] [-T ms] [-o plant.txt] capture.csv\n", argv[0]);
+        return 2;
+    }
+
+    if (fit_read_capture(argv[i], &cap) != 0)
+    {
+        fprintf(stderr, "%s: no identification capture found\n", argv[i]);
+        return 2;
+    }
+
+    /* Remove the operating point */
+    u = malloc(cap.count * sizeof(double));
+    y = malloc(cap.count * sizeof(double));
+    for (size_t k = 0; k < cap.count; k++)
+    {
+        u_mean += cap.duty[k] / cap.count;
+        y_mean += cap.angle[k] / cap.count;
+    }
+    for (size_t k = 0; k < cap.count; k++)
+    {
+        u[k] = cap.duty[k] - u_mean;
+        y[k] = cap.angle[k] - y_mean;
+        y_var += y[k] * y[k];
+    }
+
+    /* Stage 1: ARX delay scan on block averages */
+    nd = cap.count / (size_t)decim;
+    ts = decim / cap.rate_hz;
+    ud = calloc(nd, sizeof(double));
+    yd = calloc(nd, sizeof(double));
+    for (size_t k = 0; k < nd; k++)
+    {
+        for (int j = 0; j < decim; j++)
+        {
+            ud[k] += u[k * decim + j] / decim;
+            yd[k] += y[k * decim + j] / decim;
+        }
+    }
+
+    /* The duty recorded with an angle is applied after it, so d = 1 is no dead time */
+    max_delay = 1 + (int)(max_delay_ms * 1e-3 / ts + 0.5);
+    start = (size_t)max_delay + 2;
+    if (nd < start + 10 * FIT_ARX_PARAMS)
+    {
+        fprintf(stderr, "%s: capture too short (%zu ticks)\n", argv[i], cap.count);
+        return 2;
+    }
+
+    best.rms = INFINITY;
+    for (int d = 1; d <= max_delay; d++)
+    {
+        arx.delay = d;
+        if (fit_arx(ud, yd, nd, start, &arx) == 0 && arx.rms < best.rms)
+        {
+            best = arx;
+        }
+    }
+    if (!isfinite(best.rms))
+    {
+        fprintf(stderr, "No model found (input not exciting enough?)\n");
+        return 1;
+    }
+
+    printf("Capture: %s, %zu ticks at %.0f Hz, u0 %.4f (mean %.4f), mean angle %.2f deg\n", cap.signal, cap.count,
+           cap.rate_hz, cap.u0, u_mean, y_mean);
+    printf("ARX at %.0f Hz: a1 %+.6f, a2 %+.6f, b1 %+.6f, b2 %+.6f, delay %d, residual %.4f deg\n", 1.0 / ts,
+           best.a[0], best.a[1], best.b[0], best.b[1], best.delay, best.rms);
+
+    if (fit_arx_to_model(&best, ts, &model) != 0)
+    {
+        /* No usable continuous equivalent: start from a slow, lightly damped pendulum */
+        model.gain = isfinite(model.gain) && model.gain > 0.0 ? model.gain : 50.0;
+        model.wn = 5.0;
+        model.zeta = 0.2;
+        printf("ARX poles have no continuous equivalent, output-error fit starts from defaults\n");
+    }
+    model.tau = 0.05;
+
+    /* Stage 2: output-error refinement at the tick rate, the dead time (p[3]) fixed or scanned */
+    static const int search[] = {0, 1, 2, 4};
+    int dim = order < 3 ? 3 : 4;
+
+    oe.u = u;
+    oe.y = y;
+    oe.n = cap.count;
+    oe.dt = 1.0 / cap.rate_hz;
+    oe.order = order;
+    oe.dead_max = max_delay_ms * 1e-3;
+    dead_fixed = isnan(dead_ms) ? cap.latency : dead_ms * 1e-3;
+    fit_pack(&model, p);
+
+    if (dead_fixed >= 0.0)
+    {
+        oe.dead_max = dead_fixed > oe.dead_max ? dead_fixed : oe.dead_max;
+        p[3] = dead_fixed;
+        sse = fit_nelder_mead(&oe, p, search, dim);
+        printf("Dead time fixed at %.1f ms (%s)\n", dead_fixed * 1e3,
+               isnan(dead_ms) ? "measured latency of the capture" : "-T");
+    }
+    else
+    {
+        /* Each step starts from the minimum of the previous one */
+        int steps = (int)(oe.dead_max / oe.dt + 1e-9) + 1;
+        double *cost = malloc(steps * sizeof(double));
+        double *lag = malloc(steps * sizeof(double));
+        double q[FIT_MODEL_PARAMS];
+        int lo = -1, hi = -1;
+
+        sse = INFINITY;
+        memcpy(q, p, sizeof(q));
+        for (int k = 0; k < steps; k++)
+        {
+            q[3] = k * oe.dt;
+            cost[k] = fit_nelder_mead(&oe, q, search, dim);
+            lag[k] = exp(q[4]);
+            if (cost[k] < sse)
+            {
+                sse = cost[k];
+                memcpy(p, q, sizeof(q));
+            }
+        }
+        for (int k = 0; k < steps; k++)
+        {
+            if (cost[k] <= sse * (1.0 + FIT_DEAD_TOL) * (1.0 + FIT_DEAD_TOL))
+            {
+                lo = lo < 0 ? k : lo;
+                hi = k;
+            }
+        }
+        if (isfinite(sse))
+        {
+            printf("Dead time scan: residual within %.0f %% of the best from %.1f to %.1f ms", FIT_DEAD_TOL * 100.0,
+                   lo * oe.dt * 1e3, hi * oe.dt * 1e3);
+            if (order > 2)
+            {
+                printf(" (motor lag %.1f to %.1f ms)", lag[lo] * 1e3, lag[hi] * 1e3);
+            }
+            printf("\n");
+            if ((hi - lo) * oe.dt * 1e3 > FIT_DEAD_SPREAD_MS)
+            {
+                printf("Warning: dead time %s not separately identifiable from this capture, fix it with -T\n",
+                       order > 2 ? "and motor lag are" : "is");
+            }
+        }
+        free(cost);
+        free(lag);
+    }
+    if (!isfinite(sse))
+    {
+        fprintf(stderr, "Output-error fit failed\n");
+        return 1;
+    }
+    fit_unpack(p, &model);
+    fit = y_var > 0.0 ? 100.0 * (1.0 - sqrt(sse / y_var)) : 0.0;
+
+    double w2 = model.wn * model.wn, c2 = 2.0 * model.zeta * model.wn;
+
+    printf("\nTransfer function (angle deg per duty), simulation fit %.1f %%:\n", fit);
+    if (order > 2)
+    {
+        printf("  G(s) = %.3f * %.3f / ((%.4f s + 1) (s^2 + %.3f s + %.3f)) * exp(-%.4f s)\n", model.gain, w2,
+               model.tau, c2, w2, model.dead);
+    }
+    else
+    {
+        printf("  G(s) = %.3f * %.3f / (s^2 + %.3f s + %.3f) * exp(-%.4f s)\n", model.gain, w2, c2, w2, model.dead);
+    }
+    printf("  gain %.2f deg/duty, wn %.3f rad/s (%.3f Hz), damping ratio %.3f", model.gain, model.wn,
+           model.wn / (2.0 * M_PI), model.zeta);
+    if (order > 2)
+    {
+        printf(", motor lag %.1f ms", model.tau * 1e3);
+    }
+    printf(", dead time %.1f ms\n", model.dead * 1e3);
+
+    printf("\nState space (x = [angle, rate%s], input delayed by %.4f s):\n", order > 2 ? ", thrust" : "", model.dead);
+    if (order > 2)
+    {
+        printf("  A = [0 1 0; %.3f %.3f %.3f; 0 0 %.3f]\n", -w2, -c2, w2, -1.0 / model.tau);
+        printf("  B = [0; 0; %.3f]\n", model.gain / model.tau);
+        printf("  C = [1 0 0]\n");
+    }
+    else
+    {
+        printf("  A = [0 1; %.3f %.3f]\n", -w2, -c2);
+        printf("  B = [0; %.3f]\n", model.gain * w2);
+        printf("  C = [1 0]\n");
+    }
+
+    /*
+     * Plant of the simulator linearized at the operating angle c = theta - neutral:
+     *   wn^2 = w0_sq * cos(c), 2 * zeta * wn = damping,
+     *   gain = thrust'(u0) * DEG_PER_RAD / cos(c), thrust(u0) = sin(c)
+     * and the quadratic thrust curve through level and slope gives the
+     * deadzone and the thrust at full duty. Dry friction ends up in the
+     * damping, so the statements set it to zero.
+     */
+    double c = (y_mean - cap.neutral) / FIT_DEG_PER_RAD;
+    double level = sin(c);
+    double slope = model.gain * cos(c) / FIT_DEG_PER_RAD;
+
+    if (cos(c) <= 0.1 || level <= 0.0 || slope <= 0.0)
+    {
+        printf("\nOperating point %.1f deg from neutral: no plant mapping\n", c * FIT_DEG_PER_RAD);
+        return 0;
+    }
+
+    double deadzone = u_mean - 2.0 * level / slope;
+    deadzone = deadzone > 0.0 ? deadzone : 0.0;
+    double x = (u_mean - deadzone) / (1.0 - deadzone);
+    char plant[512];
+    int len;
+
+    len = snprintf(plant, sizeof(plant),
+                   "# Identified at %.1f deg (u0 %.3f, %s, fit %.1f %%), dead time %.1f ms\n"
+                   "plant neutral %.2f\nplant w0_sq %.3f\nplant damping %.3f\nplant coulomb 0\n"
+                   "plant thrust_max %.3f\nplant deadzone %.3f\n",
+                   y_mean, u_mean, cap.signal, fit, model.dead * 1e3, cap.neutral, w2 / cos(c), c2,
+                   level / (x * x), deadzone);
+    if (order > 2)
+    {
+        snprintf(plant + len, sizeof(plant) - len, "plant motor_tau %.4f\n", model.tau);
+    }
+
+    printf("\nSimulator plant (linearized match at the operating point):\n%s", plant);
+
+    if (out_path != NULL)
+    {
+        FILE *f = fopen(out_path, "w");
+
+        if (f == NULL)
+        {
+            fprintf(stderr, "Cannot write %s\n", out_path);
+            return 2;
+        }
+        fputs(plant, f);
+        fclose(f);
+    }
+
+    free(u);
+    free(y);
+    free(ud);
+    free(yd);
+    free(cap.duty);
+    free(cap.angle);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * @brief Decoder of the binary firmware telemetry (Linux host)
+ *
+ * Reads the telemetry stream (firmware command TLM 1 or TLM 2, or pendulum_sim -b)
+ * and writes the samples as CSV with the columns of DATA_LOGGING.md
+ * (Timestamp_us,TargetAngle,CurrentAngle,MotorPower,SupplyVoltage; the time
+ * stamp in us), header included. Text the firmware prints in between (command replies, reports)
+ * goes to stderr.
+ *
+ * Usage: tlm_decode [-r rig] [-o log.csv] [-q] [input]
+ *   -r  only the samples of this rig (default: all)
+ *   -o  write the CSV to a file instead of stdout
+ *   -q  do not echo the firmware text
+ *   input  capture file or serial device in raw mode (stty -F /dev/ttyACM0 raw -echo);
+ *          stdin if omitted
+ *
+ * Delta-compressed streams (TLM 2) are expanded transparently. The
+ * statistics (samples, lost and corrupt frames) are printed to stderr at
+ * the end of the input. Exit status: 0 on success, 2 on errors.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tlm_stream.h"
+
+/**
+ * @brief Output settings
+ */
+typedef struct
+{
+    FILE *out;                            /* CSV output */
+    int rig;                              /* Stream to write, -1 for all */
+    int quiet;                            /* Do not echo the firmware text */
+    int decimals[TELEMETRY_MAX_CHANNELS]; /* Decimal places per channel */
+} decode_ctx_t;
+
+/**
+ * @brief Schema of a stream received: write the CSV header
+ *
+ * @param ctx Output settings
+ * @param stream Stream id
+ * @param schema Channel list
+ */
+static void on_schema(void *ctx, uint8_t stream, const tlm_schema_t *schema)
+{
+    decode_ctx_t *d = ctx;
+
+    if (d->rig >= 0 && stream != d->rig)
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < schema->count; i++)
+    {
+        d->decimals[i] = tlm_channel_decimals(&schema->channels[i]);
+        fprintf(d->out, "%s%s", i ? "," : "", schema->channels[i].name);
+    }
+    fprintf(d->out, "\n");
+}
+
+/**
+ * @brief Sample received: write a CSV line
+ *
+ * @param ctx Output settings
+ * @param stream Stream id
+ * @param seq Sequence number
+ * @param schema Channel list
+ * @param values One value per channel
+ */
+static void on_sample(void *ctx, uint8_t stream, uint16_t seq, const tlm_schema_t *schema, const double *values)
+{
+    decode_ctx_t *d = ctx;
+
+    (void)seq;
+    if (d->rig >= 0 && stream != d->rig)
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < schema->count; i++)
+    {
+        fprintf(d->out, "%s%.*f", i ? "," : "", d->decimals[i], values[i]);
+    }
+    fprintf(d->out, "\n");
+}
+
+/**
+ * @brief Text of the firmware: echo to stderr
+ *
+ * @param ctx Output settings
+ * @param text Text (not null-terminated)
+ * @param len Length
+ */
+static void on_text(void *ctx, const char *text, size_t len)
+{
+    const decode_ctx_t *d = ctx;
+
+    if (!d->quiet)
+    {
+        fwrite(text, 1, len, stderr);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const tlm_callbacks_t callbacks = {on_schema, on_sample, on_text};
+    static tlm_stream_t stream;
+    static uint8_t buf[4096];
+    decode_ctx_t ctx = {stdout, -1, 0, {0}};
+    const char *out_path = NULL;
+    FILE *in = stdin;
+    size_t n;
+    int first = 1;
+
+    while (first < argc && argv[first][0] == '-' && argv[first][1] != '\0')
+    {
+        if (strcmp(argv[first], "-r") == 0 && first + 1 < argc)
+        {
+            ctx.rig = atoi(argv[first + 1]);
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-o") == 0 && first + 1 < argc)
+        {
+            out_path = argv[first + 1];
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-q") == 0)
+        {
+            ctx.quiet = 1;
+            first++;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-r rig] [-o log.csv] [-q] [input]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (first < argc && strcmp(argv[first], "-") != 0)
+    {
+        in = fopen(argv[first], "rb");
+        if (!in)
+        {
+            fprintf(stderr, "Cannot open %s\n", argv[first]);
+            return 2;
+        }
+    }
+
+    if (out_path)
+    {
+        ctx.out = fopen(out_path, "w");
+        if (!ctx.out)
+        {
+            fprintf(stderr, "Cannot open %s\n", out_path);
+            return 2;
+        }
+    }
+
+    tlm_stream_init(&stream, &callbacks, &ctx);
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        tlm_stream_feed(&stream, buf, n);
+
+        /* Live input from a serial port: keep the CSV current */
+        if (in == stdin || n < sizeof(buf))
+        {
+            fflush(ctx.out);
+        }
+    }
+    tlm_stream_flush(&stream);
+
+    fprintf(stderr, "%llu bytes: %llu samples (%.1f bytes each), %llu schemas, %llu delta frames, %llu lost, "
+                    "%llu corrupt, %llu without schema, %llu without keyframe, %llu text\n",
+            (unsigned long long)stream.stats.bytes, (unsigned long long)stream.stats.samples,
+            stream.stats.samples ? (double)stream.stats.bytes / (double)stream.stats.samples : 0.0,
+            (unsigned long long)stream.stats.schemas, (unsigned long long)stream.stats.delta_frames,
+            (unsigned long long)stream.stats.lost, (unsigned long long)stream.stats.corrupt,
+            (unsigned long long)stream.stats.unknown_schema, (unsigned long long)stream.stats.stale,
+            (unsigned long long)stream.stats.text);
+
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    if (ctx.out != stdout)
+    {
+        fclose(ctx.out);
+    }
+
+    return 0;
+}
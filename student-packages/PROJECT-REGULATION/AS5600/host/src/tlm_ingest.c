@@ -0,0 +1,1024 @@
+/**
+ * @brief Live ingest of the firmware log: binary or text in, columns out (Linux host)
+ *
+ * Reads the device output from a serial port, a pseudo-terminal, a file or
+ * stdin as it arrives and writes one table per stream, header first:
+ *
+ *   - binary telemetry (TLM 1, TLM 2, CH channel groups, dumps): one stream
+ *     per stream id, columns from the schema; a new schema starts a new header;
+ *   - text log lines (TLM 0: "time,setpoint,angle,command,supply"), the CSV
+ *     dumps (CAPDUMP CSV, FLOG DUMP CSV; their own header line names the
+ *     columns): stream "text", fields passed through as received;
+ *   - serial-plotter lines (">name:value,..."): stream "plot".
+ *
+ * Other text (command replies, reports, "#" comments) goes to stderr.
+ *
+ * With -S the tool sends SYNC requests on the serial port and fits the offset
+ * and drift of the device clock to the replies (clock_sync.h). Every table
+ * with a device time stamp (Timestamp_us of the binary log and the channel
+ * groups, Timestamp in ms of the text log) then gets a first column
+ * host_time: the host wall clock at that device time, Unix time in seconds.
+ * Tables of several boards, and host-side events, share this one timeline.
+ * Serial-plotter lines carry no time stamp, they get the time they were read.
+ * Rows before the first fit (CLOCK_SYNC_MIN_EXCHANGES replies, about 0.1 s
+ * after the start) have it empty.
+ *
+ * Usage: tlm_ingest [-r stream] [-F csv|tsv|plot] [-o prefix] [-b baud] [-S s] [-q] [-s] [input]
+ *   -r  only this stream: a stream id, "text" or "plot" (default: all)
+ *   -F  csv (default), tsv, or serial-plotter lines (">name:value,...")
+ *   -o  write each stream to <prefix><stream>.csv (.tsv, .txt) instead of stdout;
+ *       without it the first stream with samples goes to stdout (plot: all streams)
+ *   -b  baud rate set on a serial port (default 115200; USB CDC ignores it)
+ *   -S  clock sync: a SYNC request every s seconds (e.g. 1), host_time columns;
+ *       needs the serial port as input (not with -F plot)
+ *   -q  do not echo the firmware text
+ *   -s  print the throughput and the decoder statistics at the end
+ *   input  serial device or pseudo-terminal (switched to raw mode), file, or stdin if omitted
+ *
+ * The output is flushed whenever the input pauses, so a live table can be
+ * followed (tail -f) or plotted while the device runs. A serial port that
+ * goes away (device unplugged, pty closed) ends the input like end of file.
+ * Exit status: 0 on success, 2 on errors.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clock_sync.h"
+#include "tlm_stream.h"
+
+/**
+ * @brief Tables: binary stream ids, then the two text streams
+ */
+#define INGEST_TEXT TLM_STREAM_IDS
+#define INGEST_PLOT (TLM_STREAM_IDS + 1)
+#define INGEST_TABLES (TLM_STREAM_IDS + 2)
+
+/**
+ * @brief Limits of the text input
+ */
+#define INGEST_LINE_MAX 1024
+#define INGEST_FIELDS_MAX 32
+#define INGEST_NAMES_MAX 512
+
+/**
+ * @brief Time stamp column of a table: none, or the time the row was read
+ */
+#define INGEST_TIME_NONE (-1)
+#define INGEST_TIME_ARRIVAL (-2)
+
+/**
+ * @brief Clock sync: requests awaiting their reply, and the first few sent quickly
+ */
+#define INGEST_PINGS 16
+#define INGEST_SYNC_FIRST 8
+#define INGEST_SYNC_FIRST_S 0.05
+
+/**
+ * @brief Output formats
+ */
+typedef enum
+{
+    FORMAT_CSV = 0, /* Comma-separated, header line */
+    FORMAT_TSV,     /* Tab-separated, header line */
+    FORMAT_PLOT     /* Serial-plotter lines, names in every line */
+} ingest_format_t;
+
+/**
+ * @brief Output of one stream
+ */
+typedef struct
+{
+    FILE *out;                            /* Output, NULL until the first line */
+    uint8_t count;                        /* Columns of the current header */
+    char names[INGEST_NAMES_MAX];         /* Column names, separated by zeros */
+    int decimals[TELEMETRY_MAX_CHANNELS]; /* Decimal places (binary streams) */
+    uint8_t header_due;                   /* Header not written yet for the current columns */
+    uint8_t failed;                       /* Output file could not be opened */
+    int time_col;                         /* Column of the device time, or INGEST_TIME_NONE / _ARRIVAL */
+    uint32_t time_unit;                   /* Device us per unit of that column */
+    uint64_t rows;                        /* Rows written */
+} ingest_table_t;
+
+/**
+ * @brief Ingest settings and state
+ */
+typedef struct
+{
+    int only;                             /* Table to write, -1 for all */
+    ingest_format_t format;               /* Output format */
+    const char *prefix;                   /* Output file prefix, NULL for stdout */
+    int quiet;                            /* Do not echo the firmware text */
+    int stdout_table;                     /* Table owning stdout, -1 while none */
+    ingest_table_t tables[INGEST_TABLES]; /* Output per stream */
+    char line[INGEST_LINE_MAX];           /* Text line being assembled */
+    size_t line_len;                      /* Characters in line */
+    char text_names[INGEST_NAMES_MAX];    /* Header line of the next text rows, separated by zeros */
+    uint8_t text_names_count;             /* Columns of that header, 0 if none */
+    uint64_t skipped;                     /* Rows of streams not written */
+    double sync_period;                   /* Seconds between SYNC requests, 0 = no clock sync */
+    clock_sync_t sync;                    /* Device to host clock mapping */
+    uint32_t pings;                       /* SYNC requests sent (also the id of the last one) */
+    uint32_t ping_id[INGEST_PINGS];       /* Id of the request in each slot */
+    double ping_sent[INGEST_PINGS];       /* Host time it was sent (us), 0 once answered */
+    double read_us;                       /* Host time the input being decoded was read (us) */
+    double realtime_us;                   /* Wall clock minus monotonic clock (us) */
+} ingest_ctx_t;
+
+/**
+ * @brief Column names of the text log (same as the binary log schema), separated by zeros
+ */
+static const char text_log_names[] = "Timestamp\0TargetAngle\0CurrentAngle\0MotorPower\0SupplyVoltage";
+#define TEXT_LOG_COLUMNS 5
+
+/**
+ * @brief Name of a table for file names and messages
+ *
+ * @param table Table number
+ * @param buf Buffer for a stream id
+ * @param size Buffer size
+ * @return Name
+ */
+static const char *table_name(int table, char *buf, size_t size)
+{
+    if (table == INGEST_TEXT)
+    {
+        return "text";
+    }
+    if (table == INGEST_PLOT)
+    {
+        return "plot";
+    }
+    snprintf(buf, size, "%d", table);
+    return buf;
+}
+
+/**
+ * @brief Output of a table, opened with the first row; NULL if the table is not written
+ *
+ * @param c Ingest state
+ * @param table Table number
+ * @return Output or NULL
+ */
+static FILE *table_out(ingest_ctx_t *c, int table)
+{
+    static const char *const extensions[] = {".csv", ".tsv", ".txt"};
+    ingest_table_t *t = &c->tables[table];
+    char path[1024], id[8];
+
+    if (t->out)
+    {
+        return t->out;
+    }
+    if ((c->only >= 0 && table != c->only) || t->failed)
+    {
+        return NULL;
+    }
+
+    if (c->prefix)
+    {
+        snprintf(path, sizeof(path), "%s%s%s", c->prefix, table_name(table, id, sizeof(id)),
+                 extensions[c->format]);
+        t->out = fopen(path, "w");
+        if (!t->out)
+        {
+            fprintf(stderr, "Cannot open %s\n", path);
+            t->failed = 1;
+            return NULL;
+        }
+        setvbuf(t->out, NULL, _IOFBF, 1 << 16);
+        fprintf(stderr, "Stream %s: %s\n", table_name(table, id, sizeof(id)), path);
+        return t->out;
+    }
+
+    // One table on stdout; serial-plotter lines carry their names, so any number
+    if (c->format != FORMAT_PLOT && c->stdout_table >= 0 && c->stdout_table != table)
+    {
+        return NULL;
+    }
+    if (c->stdout_table < 0 && c->format != FORMAT_PLOT && c->only < 0)
+    {
+        fprintf(stderr, "Writing stream %s (others: -o prefix)\n", table_name(table, id, sizeof(id)));
+    }
+    c->stdout_table = table;
+    t->out = stdout;
+    return t->out;
+}
+
+/**
+ * @brief Set the columns of a table; a change writes a new header with the next row
+ *
+ * @param t Table
+ * @param names Column names, separated by zeros
+ * @param len Bytes of names
+ * @param count Number of columns
+ */
+static void table_columns(ingest_table_t *t, const char *names, size_t len, uint8_t count)
+{
+    if (count == t->count && memcmp(t->names, names, len) == 0)
+    {
+        return;
+    }
+
+    memcpy(t->names, names, len);
+    t->count = count;
+    t->header_due = 1;
+}
+
+/**
+ * @brief Check whether a table has the host_time column
+ *
+ * @param c Ingest state
+ * @param t Table
+ * @return 1 with clock sync and a time stamp, 0 otherwise
+ */
+static int table_timed(const ingest_ctx_t *c, const ingest_table_t *t)
+{
+    return c->sync_period > 0 && c->format != FORMAT_PLOT && t->time_col != INGEST_TIME_NONE;
+}
+
+/**
+ * @brief Write the host time of a row (Unix time in s), nothing before the first SYNC reply
+ *
+ * @param c Ingest state
+ * @param t Table
+ * @param fields Field texts
+ * @param lens Field lengths
+ * @param out Output
+ */
+static void table_host_time(ingest_ctx_t *c, const ingest_table_t *t, const char *const *fields,
+                            const size_t *lens, FILE *out)
+{
+    double host_us = c->read_us;
+
+    if (t->time_col >= 0)
+    {
+        char num[24] = {0};
+        uint64_t dev;
+
+        memcpy(num, fields[t->time_col], lens[t->time_col] < sizeof(num) ? lens[t->time_col] : sizeof(num) - 1);
+        dev = clock_sync_extend(&c->sync, (uint32_t)(strtoull(num, NULL, 10) * t->time_unit));
+        if (clock_sync_to_host(&c->sync, dev, &host_us) != CLOCK_SYNC_OK)
+        {
+            return;
+        }
+    }
+
+    fprintf(out, "%.6f", (host_us + c->realtime_us) / 1e6);
+}
+
+/**
+ * @brief Write the header of a table if due (not in the serial-plotter format)
+ *
+ * @param c Ingest state
+ * @param t Table
+ * @param out Output
+ */
+static void table_header(const ingest_ctx_t *c, ingest_table_t *t, FILE *out)
+{
+    const char *name = t->names;
+
+    if (!t->header_due)
+    {
+        return;
+    }
+    t->header_due = 0;
+    if (c->format == FORMAT_PLOT)
+    {
+        return;
+    }
+
+    if (table_timed(c, t))
+    {
+        fputs("host_time", out);
+        fputc(c->format == FORMAT_TSV ? '\t' : ',', out);
+    }
+    for (uint8_t i = 0; i < t->count; i++)
+    {
+        if (i)
+        {
+            fputc(c->format == FORMAT_TSV ? '\t' : ',', out);
+        }
+        fputs(name, out);
+        name += strlen(name) + 1;
+    }
+    fputc('\n', out);
+}
+
+/**
+ * @brief Write one row: fields as text
+ *
+ * @param c Ingest state
+ * @param table Table number
+ * @param fields Field texts
+ * @param lens Field lengths
+ * @param count Number of fields
+ */
+static void table_row(ingest_ctx_t *c, int table, const char *const *fields, const size_t *lens, uint8_t count)
+{
+    ingest_table_t *t = &c->tables[table];
+    FILE *out = table_out(c, table);
+    const char *name = t->names;
+
+    if (!out)
+    {
+        c->skipped++;
+        return;
+    }
+
+    table_header(c, t, out);
+    if (table_timed(c, t))
+    {
+        table_host_time(c, t, fields, lens, out);
+        fputc(c->format == FORMAT_TSV ? '\t' : ',', out);
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (c->format == FORMAT_PLOT)
+        {
+            fputc(i ? ',' : '>', out);
+            fputs(name, out);
+            fputc(':', out);
+            name += strlen(name) + 1;
+        }
+        else if (i)
+        {
+            fputc(c->format == FORMAT_TSV ? '\t' : ',', out);
+        }
+        fwrite(fields[i], 1, lens[i], out);
+    }
+    fputs(c->format == FORMAT_PLOT ? "\r\n" : "\n", out);
+    t->rows++;
+}
+
+/**
+ * @brief Render a decoded value with a number of decimals (same digits as printf "%.*f")
+ *
+ * The values are wire integers scaled by a power of two, so value * 10^decimals
+ * is exact and rint() rounds ties to even like printf.
+ *
+ * @param value Value
+ * @param decimals Decimal places (0 - 9)
+ * @param buf Output buffer (at least 32 bytes)
+ * @return Length
+ */
+static size_t render_value(double value, int decimals, char *buf)
+{
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    char digits[24];
+    double scaled = rint(fabs(value) * pow10[decimals]);
+    unsigned long long q;
+    size_t n = 0, len = 0;
+
+    if (scaled >= 1e18)
+    {
+        return (size_t)snprintf(buf, 32, "%.*f", decimals, value);
+    }
+
+    q = (unsigned long long)scaled;
+    do
+    {
+        digits[n++] = (char)('0' + q % 10);
+        q /= 10;
+    } while (q || (int)n <= decimals);
+
+    if (signbit(value) && value != 0.0)
+    {
+        buf[len++] = '-';
+    }
+    while (n > 0)
+    {
+        if ((int)n == decimals)
+        {
+            buf[len++] = '.';
+        }
+        buf[len++] = digits[--n];
+    }
+
+    return len;
+}
+
+/**
+ * @brief Schema of a binary stream received: new columns
+ *
+ * @param ctx Ingest state
+ * @param stream Stream id
+ * @param schema Channel list
+ */
+static void on_schema(void *ctx, uint8_t stream, const tlm_schema_t *schema)
+{
+    ingest_ctx_t *c = ctx;
+    ingest_table_t *t = &c->tables[stream];
+    char names[INGEST_NAMES_MAX];
+    size_t len = 0;
+
+    t->time_col = INGEST_TIME_NONE;
+    for (uint8_t i = 0; i < schema->count; i++)
+    {
+        size_t n = strlen(schema->channels[i].name) + 1;
+
+        memcpy(&names[len], schema->channels[i].name, n);
+        len += n;
+        t->decimals[i] = tlm_channel_decimals(&schema->channels[i]);
+
+        // Live log and channel groups; the dumps hold older times (ms or ticks)
+        if (strcmp(schema->channels[i].name, "Timestamp_us") == 0)
+        {
+            t->time_col = i;
+            t->time_unit = 1;
+        }
+    }
+    table_columns(t, names, len, schema->count);
+}
+
+/**
+ * @brief Binary sample received: one row
+ *
+ * @param ctx Ingest state
+ * @param stream Stream id
+ * @param seq Sequence number
+ * @param schema Channel list
+ * @param values One value per channel
+ */
+static void on_sample(void *ctx, uint8_t stream, uint16_t seq, const tlm_schema_t *schema, const double *values)
+{
+    ingest_ctx_t *c = ctx;
+    char text[TELEMETRY_MAX_CHANNELS][32];
+    const char *fields[TELEMETRY_MAX_CHANNELS];
+    size_t lens[TELEMETRY_MAX_CHANNELS];
+
+    (void)seq;
+    if (c->only >= 0 && stream != c->only)
+    {
+        c->skipped++;
+        return;
+    }
+
+    for (uint8_t i = 0; i < schema->count; i++)
+    {
+        lens[i] = render_value(values[i], c->tables[stream].decimals[i], text[i]);
+        fields[i] = text[i];
+    }
+    table_row(c, stream, fields, lens, schema->count);
+}
+
+/**
+ * @brief Check a field for a number as the firmware prints it
+ *
+ * @param p Field
+ * @param len Length
+ * @return 1 if numeric
+ */
+static int is_number(const char *p, size_t len)
+{
+    size_t digits = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (p[i] >= '0' && p[i] <= '9')
+        {
+            digits++;
+        }
+        else if (!((p[i] == '-' || p[i] == '+') && i == 0) && p[i] != '.')
+        {
+            return 0;
+        }
+    }
+
+    return digits > 0;
+}
+
+/**
+ * @brief Check a field for a column name
+ *
+ * @param p Field
+ * @param len Length
+ * @return 1 if a name
+ */
+static int is_name(const char *p, size_t len)
+{
+    if (len == 0 || len >= 64 || !(p[0] == '_' || (p[0] >= 'A' && p[0] <= 'Z') || (p[0] >= 'a' && p[0] <= 'z')))
+    {
+        return 0;
+    }
+    for (size_t i = 1; i < len; i++)
+    {
+        if (!(p[i] == '_' || (p[i] >= 'A' && p[i] <= 'Z') || (p[i] >= 'a' && p[i] <= 'z') ||
+              (p[i] >= '0' && p[i] <= '9')))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Copy field texts into a zero-separated name list
+ *
+ * @param names Output (INGEST_NAMES_MAX bytes)
+ * @param fields Field texts
+ * @param lens Field lengths
+ * @param count Number of fields
+ * @return Bytes used, 0 if the names do not fit
+ */
+static size_t pack_names(char *names, const char *const *fields, const size_t *lens, uint8_t count)
+{
+    size_t len = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (len + lens[i] + 1 > INGEST_NAMES_MAX)
+        {
+            return 0;
+        }
+        memcpy(&names[len], fields[i], lens[i]);
+        len += lens[i];
+        names[len++] = '\0';
+    }
+
+    return len;
+}
+
+/**
+ * @brief Take a SYNC reply of the firmware: "SYNC <id> <arrival us> <reply us>"
+ *
+ * @param c Ingest state
+ * @param p Line (without the line end)
+ * @param len Length
+ * @return 1 if the line is a reply (consumed), 0 otherwise
+ */
+static int sync_reply(ingest_ctx_t *c, const char *p, size_t len)
+{
+    char text[64];
+    unsigned long id, rx, tx;
+    uint32_t slot;
+
+    if (c->sync_period <= 0 || len < 5 || len >= sizeof(text) || memcmp(p, "SYNC ", 5) != 0)
+    {
+        return 0;
+    }
+    memcpy(text, p, len);
+    text[len] = '\0';
+    if (sscanf(text, "SYNC %lu %lu %lu", &id, &rx, &tx) != 3)
+    {
+        return 0;
+    }
+
+    // Requests still in their slot and not answered yet; a late reply is dropped
+    slot = (uint32_t)id % INGEST_PINGS;
+    if (c->ping_id[slot] == (uint32_t)id && c->ping_sent[slot] > 0)
+    {
+        clock_sync_add(&c->sync, c->ping_sent[slot], (uint32_t)rx, (uint32_t)tx, c->read_us);
+        c->ping_sent[slot] = 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Handle one complete text line of the firmware
+ *
+ * @param c Ingest state
+ * @param p Line (without the line end)
+ * @param len Length
+ */
+static void text_line(ingest_ctx_t *c, const char *p, size_t len)
+{
+    const char *fields[INGEST_FIELDS_MAX];
+    size_t lens[INGEST_FIELDS_MAX];
+    const char *names_f[INGEST_FIELDS_MAX];
+    size_t names_l[INGEST_FIELDS_MAX];
+    char names[INGEST_NAMES_MAX];
+    uint8_t count = 0, numeric = 1, named = 1;
+    int plot = len > 0 && p[0] == '>';
+    size_t start = plot ? 1 : 0;
+    size_t names_len;
+
+    if (sync_reply(c, p, len))
+    {
+        return;
+    }
+
+    // Split at the commas; serial-plotter pairs at the colon as well
+    for (size_t i = start; i <= len && len > 0; i++)
+    {
+        if (i < len && p[i] != ',')
+        {
+            continue;
+        }
+        if (count == INGEST_FIELDS_MAX)
+        {
+            numeric = named = 0;
+            break;
+        }
+
+        fields[count] = &p[start];
+        lens[count] = i - start;
+        if (plot)
+        {
+            const char *colon = memchr(fields[count], ':', lens[count]);
+
+            if (!colon)
+            {
+                numeric = 0;
+                break;
+            }
+            names_f[count] = fields[count];
+            names_l[count] = (size_t)(colon - fields[count]);
+            lens[count] -= names_l[count] + 1;
+            fields[count] = colon + 1;
+        }
+        numeric &= is_number(fields[count], lens[count]);
+        named &= is_name(fields[count], lens[count]);
+        count++;
+        start = i + 1;
+    }
+
+    if (plot && numeric && count > 0)
+    {
+        names_len = pack_names(names, names_f, names_l, count);
+        if (names_len > 0)
+        {
+            table_columns(&c->tables[INGEST_PLOT], names, names_len, count);
+            table_row(c, INGEST_PLOT, fields, lens, count);
+            return;
+        }
+    }
+    else if (!plot && count >= 2 && numeric)
+    {
+        ingest_table_t *t = &c->tables[INGEST_TEXT];
+
+        // Columns from the header line before, else the text log columns (time in ms), else numbered
+        t->time_col = INGEST_TIME_NONE;
+        if (c->text_names_count == count)
+        {
+            table_columns(t, c->text_names, INGEST_NAMES_MAX, count);
+        }
+        else if (count == TEXT_LOG_COLUMNS)
+        {
+            table_columns(t, text_log_names, sizeof(text_log_names), count);
+            t->time_col = 0;
+            t->time_unit = 1000;
+        }
+        else
+        {
+            names_len = 0;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                names_len += (size_t)snprintf(&names[names_len], 8, "col%u", i) + 1;
+            }
+            table_columns(t, names, names_len, count);
+        }
+        table_row(c, INGEST_TEXT, fields, lens, count);
+        return;
+    }
+    else if (!plot && count >= 2 && named)
+    {
+        // Header line of a CSV dump: names the columns of the rows that follow
+        memset(c->text_names, 0, sizeof(c->text_names));
+        if (pack_names(c->text_names, fields, lens, count) > 0)
+        {
+            c->text_names_count = count;
+        }
+    }
+    else if (len > 0 && p[0] != '#')
+    {
+        // Any other text ends a dump
+        c->text_names_count = 0;
+    }
+
+    if (!c->quiet)
+    {
+        fwrite(p, 1, len, stderr);
+        fputc('\n', stderr);
+    }
+}
+
+/**
+ * @brief Text of the firmware: assemble lines
+ *
+ * @param ctx Ingest state
+ * @param text Text (not null-terminated, not always a whole line)
+ * @param len Length
+ */
+static void on_text(void *ctx, const char *text, size_t len)
+{
+    ingest_ctx_t *c = ctx;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (text[i] == '\n')
+        {
+            size_t n = c->line_len;
+
+            if (n > 0 && c->line[n - 1] == '\r')
+            {
+                n--;
+            }
+            text_line(c, c->line, n);
+            c->line_len = 0;
+        }
+        else if (c->line_len < sizeof(c->line))
+        {
+            c->line[c->line_len++] = text[i];
+        }
+    }
+}
+
+/**
+ * @brief Switch a serial port or pseudo-terminal to raw mode
+ *
+ * @param fd Open terminal
+ * @param baud Baud rate
+ * @return 0 on success, -1 on failure
+ */
+static int serial_raw(int fd, long baud)
+{
+    static const struct
+    {
+        long baud;
+        speed_t speed;
+    } speeds[] = {
+        {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+        {230400, B230400}, {460800, B460800}, {921600, B921600},
+    };
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+    {
+        if (speeds[i].baud == baud)
+        {
+            cfsetispeed(&tio, speeds[i].speed);
+            cfsetospeed(&tio, speeds[i].speed);
+        }
+    }
+
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/**
+ * @brief Seconds of a monotonic clock
+ *
+ * @return Time in seconds
+ */
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Send a SYNC request if one is due and wait for input until the next one
+ *
+ * @param c Ingest state
+ * @param fd Serial port
+ * @param next Host time the next request is due (s), advanced when one is sent
+ * @return 1 if there is input (or the port is closed), 0 if not yet
+ */
+static int sync_wait(ingest_ctx_t *c, int fd, double *next)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    double now = now_s();
+
+    if (now >= *next)
+    {
+        char cmd[32];
+        uint32_t slot = ++c->pings % INGEST_PINGS;
+        int len = snprintf(cmd, sizeof(cmd), "SYNC %lu\n", (unsigned long)c->pings);
+
+        c->ping_id[slot] = c->pings;
+        c->ping_sent[slot] = now_s() * 1e6;
+        if (write(fd, cmd, (size_t)len) != len)
+        {
+            c->ping_sent[slot] = 0;
+        }
+        *next = now + (c->pings < INGEST_SYNC_FIRST ? INGEST_SYNC_FIRST_S : c->sync_period);
+    }
+
+    return poll(&pfd, 1, (int)ceil((*next - now) * 1000.0)) != 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const tlm_callbacks_t callbacks = {on_schema, on_sample, on_text};
+    static const char *const formats[] = {"csv", "tsv", "plot"};
+    static tlm_stream_t stream;
+    static ingest_ctx_t ctx;
+    static uint8_t buf[1 << 16];
+    long baud = 115200;
+    int stats = 0;
+    int fd = STDIN_FILENO;
+    int first = 1;
+    double start, next_sync;
+    struct timespec wall, mono;
+    ssize_t n;
+
+    ctx.only = -1;
+    ctx.stdout_table = -1;
+    while (first < argc && argv[first][0] == '-' && argv[first][1] != '\0')
+    {
+        const char *arg = first + 1 < argc ? argv[first + 1] : NULL;
+
+        if (strcmp(argv[first], "-r") == 0 && arg)
+        {
+            ctx.only = strcmp(arg, "text") == 0 ? INGEST_TEXT : (strcmp(arg, "plot") == 0 ? INGEST_PLOT : atoi(arg));
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-F") == 0 && arg)
+        {
+            size_t f = 0;
+
+            while (f < sizeof(formats) / sizeof(formats[0]) && strcmp(arg, formats[f]) != 0)
+            {
+                f++;
+            }
+            if (f == sizeof(formats) / sizeof(formats[0]))
+            {
+                fprintf(stderr, "Unknown format: %s\n", arg);
+                return 2;
+            }
+            ctx.format = (ingest_format_t)f;
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-o") == 0 && arg)
+        {
+            ctx.prefix = arg;
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-b") == 0 && arg)
+        {
+            baud = atol(arg);
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-S") == 0 && arg)
+        {
+            ctx.sync_period = atof(arg);
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-q") == 0)
+        {
+            ctx.quiet = 1;
+            first++;
+        }
+        else if (strcmp(argv[first], "-s") == 0)
+        {
+            stats = 1;
+            first++;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-r stream] [-F csv|tsv|plot] [-o prefix] [-b baud] [-S s] [-q] [-s] [input]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (ctx.only < -1 || ctx.only >= INGEST_TABLES)
+    {
+        fprintf(stderr, "Invalid stream\n");
+        return 2;
+    }
+
+    if (first < argc && strcmp(argv[first], "-") != 0)
+    {
+        fd = open(argv[first], (ctx.sync_period > 0 ? O_RDWR : O_RDONLY) | O_NOCTTY);
+        if (fd < 0)
+        {
+            fprintf(stderr, "Cannot open %s: %s\n", argv[first], strerror(errno));
+            return 2;
+        }
+    }
+    if (isatty(fd) && serial_raw(fd, baud) != 0)
+    {
+        fprintf(stderr, "Cannot configure the serial port: %s\n", strerror(errno));
+        return 2;
+    }
+    if (ctx.sync_period > 0 && (fd == STDIN_FILENO || !isatty(fd)))
+    {
+        fprintf(stderr, "Clock sync (-S) needs the serial port as input\n");
+        return 2;
+    }
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+    // Host times are taken from the monotonic clock and written as wall-clock time
+    clock_sync_init(&ctx.sync);
+    clock_gettime(CLOCK_REALTIME, &wall);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    ctx.realtime_us = (wall.tv_sec - mono.tv_sec) * 1e6 + (wall.tv_nsec - mono.tv_nsec) * 1e-3;
+    for (int i = 0; i < INGEST_TABLES; i++)
+    {
+        ctx.tables[i].time_col = i == INGEST_PLOT ? INGEST_TIME_ARRIVAL : INGEST_TIME_NONE;
+    }
+
+    tlm_stream_init(&stream, &callbacks, &ctx);
+    start = now_s();
+    next_sync = start;
+    while (1)
+    {
+        // SYNC requests on time: the input is awaited only until the next one is due
+        if (ctx.sync_period > 0 && !sync_wait(&ctx, fd, &next_sync))
+        {
+            continue;
+        }
+
+        n = read(fd, buf, sizeof(buf));
+        if (n == 0)
+        {
+            break;
+        }
+        if (n < 0)
+        {
+            // A closed pty or unplugged device reads as EIO: end of input
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EIO)
+            {
+                fprintf(stderr, "Read error: %s\n", strerror(errno));
+            }
+            break;
+        }
+
+        ctx.read_us = now_s() * 1e6;
+        tlm_stream_feed(&stream, buf, (size_t)n);
+
+        // Input paused: make the tables current
+        if ((size_t)n < sizeof(buf))
+        {
+            for (int i = 0; i < INGEST_TABLES; i++)
+            {
+                if (ctx.tables[i].out)
+                {
+                    fflush(ctx.tables[i].out);
+                }
+            }
+        }
+    }
+    tlm_stream_flush(&stream);
+    // A line cut off by the end of the input is not a complete row
+    if (ctx.line_len > 0 && !ctx.quiet)
+    {
+        fwrite(ctx.line, 1, ctx.line_len, stderr);
+        fputc('\n', stderr);
+    }
+
+    for (int i = 0; i < INGEST_TABLES; i++)
+    {
+        if (ctx.tables[i].out && ctx.tables[i].out != stdout)
+        {
+            fclose(ctx.tables[i].out);
+        }
+    }
+    fflush(stdout);
+
+    if (stats)
+    {
+        double secs = now_s() - start;
+        uint64_t rows = 0;
+
+        for (int i = 0; i < INGEST_TABLES; i++)
+        {
+            rows += ctx.tables[i].rows;
+        }
+        fprintf(stderr, "%llu bytes in %.3f s (%.2f MB/s): %llu rows written, %llu skipped; "
+                        "%llu samples, %llu lost, %llu corrupt, %llu without schema, %llu text lines\n",
+                (unsigned long long)stream.stats.bytes, secs, secs > 0 ? stream.stats.bytes / secs / 1e6 : 0.0,
+                (unsigned long long)rows, (unsigned long long)ctx.skipped, (unsigned long long)stream.stats.samples,
+                (unsigned long long)stream.stats.lost, (unsigned long long)stream.stats.corrupt,
+                (unsigned long long)stream.stats.unknown_schema, (unsigned long long)stream.stats.text);
+        if (ctx.sync_period > 0)
+        {
+            // Drift of the device clock: positive if it runs fast
+            fprintf(stderr, "Clock sync: %lu of %lu requests answered, %lu used, device clock %+.1f ppm, "
+                            "offset within %.0f us\n",
+                    (unsigned long)ctx.sync.exchanges, (unsigned long)ctx.pings, (unsigned long)ctx.sync.used,
+                    (1.0 / ctx.sync.rate - 1.0) * 1e6, ctx.sync.error_us);
+        }
+    }
+
+    if (fd != STDIN_FILENO)
+    {
+        close(fd);
+    }
+
+    return 0;
+}
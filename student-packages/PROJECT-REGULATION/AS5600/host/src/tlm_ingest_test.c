@@ -0,0 +1,515 @@
+/**
+ * @brief Integration test of tlm_ingest over a pseudo-terminal (Linux host)
+ *
+ * Builds a device stream like the firmware output: command replies, text log
+ * lines (TLM 0), a CSV capture dump, the binary log (TLM 1) on stream 0 and
+ * the delta-compressed one (TLM 2) on stream 1, the text between the frames.
+ * The stream is written to the master side of a pseudo-terminal in chunks of
+ * random size with random pauses while tlm_ingest reads the slave side. The
+ * tables it writes are then compared: the binary streams with the output of
+ * tlm_decode for the same bytes (which must hold every sample sent), the
+ * text stream with the lines sent.
+ *
+ * Usage: tlm_ingest_test [-n samples] [-s seed] [-k] [bindir]
+ *   -n  samples per binary stream (default 20000)
+ *   -s  seed of the values and the chunk sizes (default 1)
+ *   -k  keep the work directory (it is kept anyway on a difference)
+ *   bindir  directory with tlm_ingest and tlm_decode (default: that of this program)
+ *
+ * Exit status: 0 if every table matched, 1 on a difference, 2 on errors.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fixed.h"
+#include "telemetry.h"
+
+/**
+ * @brief Largest chunk written to the pseudo-terminal at once
+ */
+#define TEST_CHUNK_MAX 4096
+
+/**
+ * @brief Binary samples per text log line (LOG_DIVIDER of the firmware is 33)
+ */
+#define TEST_TEXT_DIVIDER 10
+
+/**
+ * @brief Batch of the delta-compressed stream (TLM 2 at 1 kHz)
+ */
+#define TEST_BATCH 20
+
+/**
+ * @brief Growing byte buffer
+ */
+typedef struct
+{
+    char *data;  /* Contents */
+    size_t len;  /* Bytes used */
+    size_t size; /* Bytes allocated */
+} test_buf_t;
+
+/**
+ * @brief Append bytes to a buffer
+ *
+ * @param buf Pointer to buffer
+ * @param data Bytes
+ * @param len Number of bytes
+ */
+static void buf_append(test_buf_t *buf, const void *data, size_t len)
+{
+    if (buf->len + len > buf->size)
+    {
+        buf->size = (buf->len + len) * 2;
+        buf->data = realloc(buf->data, buf->size);
+        if (!buf->data)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(2);
+        }
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+/**
+ * @brief Append formatted text to a buffer
+ *
+ * @param buf Pointer to buffer
+ * @param format printf format, followed by its arguments
+ */
+static void buf_printf(test_buf_t *buf, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    buf_append(buf, line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1);
+}
+
+/**
+ * @brief Output function of the telemetry streams: append the frame to the device stream
+ *
+ * @param data Encoded frame
+ * @param len Length
+ * @param intf_ptr Device stream (test_buf_t)
+ * @return 0
+ */
+static int8_t stream_write(const uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    buf_append(intf_ptr, data, len);
+    return 0;
+}
+
+/**
+ * @brief Next pseudo-random number (xorshift32, repeatable)
+ *
+ * @param state Generator state (not zero)
+ * @return Pseudo-random 32-bit value
+ */
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Build the device stream and the text table tlm_ingest should write from it
+ *
+ * @param samples Samples per binary stream
+ * @param seed Generator state
+ * @param stream Device stream on return
+ * @param text Expected text table on return
+ */
+static void build_stream(long samples, uint32_t *seed, test_buf_t *stream, test_buf_t *text)
+{
+    static const char text_header[] = "Timestamp,TargetAngle,CurrentAngle,MotorPower,SupplyVoltage\n";
+    static const char dump_header[] = "tick,setpoint,angle,command,late_us,cpu_us\n";
+    telemetry_t plain, delta;
+    fix16_t angle = FIX16_FROM_INT(30);
+    int header_due = 1;
+
+    telemetry_init(&plain, telemetry_log_channels_us, TELEMETRY_LOG_CHANNELS, 0, stream_write, stream);
+    telemetry_init(&delta, telemetry_log_channels_us, TELEMETRY_LOG_CHANNELS, 1, stream_write, stream);
+    telemetry_set_batch(&delta, TEST_BATCH);
+    buf_printf(stream, "\r\nPendulum regulation for Raspberry Pi Pico\r\n");
+
+    for (long k = 0; k < samples; k++)
+    {
+        fix16_t setpoint = FIX16_FROM_INT(30 + 10 * (int32_t)(k / 5000 % 4));
+        fix16_t duty = (fix16_t)(next_random(seed) % (2 * FIX16_ONE + 1)) - FIX16_ONE;
+        fix16_t supply = FIX16_FROM_INT(12) + (fix16_t)(next_random(seed) % 8192) - 4096;
+        int32_t values[TELEMETRY_LOG_CHANNELS] = {(int32_t)(k * 1000), setpoint, angle, duty, supply};
+        int32_t mirrored[TELEMETRY_LOG_CHANNELS] = {(int32_t)(k * 1000 + 500), -setpoint, -angle, duty / 2, supply};
+
+        angle += (fix16_t)(next_random(seed) % 4001) - 2000 + (setpoint - angle) / 256;
+        telemetry_send(&plain, values);
+        telemetry_send(&delta, mirrored);
+
+        // Text log lines, replies and one capture dump between the frames
+        if (k % TEST_TEXT_DIVIDER == 0)
+        {
+            char line[128];
+            int len = snprintf(line, sizeof(line), "%ld,%.2f,%.2f,%.2f,%.2f", k, FIX16_TO_FLOAT(setpoint),
+                               FIX16_TO_FLOAT(angle), FIX16_TO_FLOAT(duty), FIX16_TO_FLOAT(supply));
+
+            buf_printf(stream, "%s\r\n", line);
+            if (header_due)
+            {
+                buf_append(text, text_header, sizeof(text_header) - 1);
+                header_due = 0;
+            }
+            buf_append(text, line, (size_t)len);
+            buf_append(text, "\n", 1);
+        }
+        if (k % 5000 == 2500)
+        {
+            buf_printf(stream, "Disturbance observer enabled (estimate %.3f)\r\n", FIX16_TO_FLOAT(duty));
+        }
+        if (k == samples / 2)
+        {
+            buf_printf(stream, "# capture rig 0 trigger manual rate 1000 pre 2 post 3 samples 5\r\n");
+            buf_printf(stream, "tick,setpoint,angle,command,late_us,cpu_us\r\n");
+            buf_append(text, dump_header, sizeof(dump_header) - 1);
+            for (int t = -2; t < 3; t++)
+            {
+                char line[128];
+                int len = snprintf(line, sizeof(line), "%d,%.2f,%.2f,%.5f,%u,%u", t, 30.0 + t, 29.5 - t,
+                                   0.125 * t, (unsigned)(next_random(seed) % 20), 40 + (unsigned)t);
+
+                buf_printf(stream, "%s\r\n", line);
+                buf_append(text, line, (size_t)len);
+                buf_append(text, "\n", 1);
+            }
+            buf_printf(stream, "# end\r\n");
+            header_due = 1;
+        }
+    }
+
+    telemetry_flush(&delta);
+    buf_printf(stream, "Regulation stopped\r\n");
+}
+
+/**
+ * @brief Run a program and wait for it
+ *
+ * @param argv Program path and arguments, NULL-terminated
+ * @return Exit status, -1 if it could not be run or did not exit normally
+ */
+static int run(char *const argv[])
+{
+    pid_t pid = fork();
+    int status;
+
+    if (pid < 0)
+    {
+        return -1;
+    }
+    if (pid == 0)
+    {
+        execv(argv[0], argv);
+        fprintf(stderr, "Cannot run %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+    {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+/**
+ * @brief Write the device stream to the pseudo-terminal in random chunks while tlm_ingest reads it
+ *
+ * @param ingest Path of tlm_ingest
+ * @param prefix Output prefix of the tables
+ * @param stream Device stream
+ * @param seed Generator state
+ * @return Exit status of tlm_ingest, -1 on errors
+ */
+static int run_ingest(const char *ingest, const char *prefix, const test_buf_t *stream, uint32_t *seed)
+{
+    struct termios raw;
+    char name[64];
+    int master, slave, status, queued;
+    size_t pos = 0;
+    pid_t pid;
+
+    // Raw from the start: no echo, no line editing of the binary frames
+    if (openpty(&master, &slave, name, NULL, NULL) != 0 || tcgetattr(slave, &raw) != 0)
+    {
+        fprintf(stderr, "Cannot open a pseudo-terminal: %s\n", strerror(errno));
+        return -1;
+    }
+    cfmakeraw(&raw);
+    tcsetattr(slave, TCSANOW, &raw);
+
+    pid = fork();
+    if (pid < 0)
+    {
+        return -1;
+    }
+    if (pid == 0)
+    {
+        char *const argv[] = {(char *)ingest, "-q", "-o", (char *)prefix, name, NULL};
+
+        close(master);
+        close(slave);
+        execv(ingest, argv);
+        fprintf(stderr, "Cannot run %s: %s\n", ingest, strerror(errno));
+        _exit(127);
+    }
+
+    while (pos < stream->len)
+    {
+        size_t n = 1 + next_random(seed) % TEST_CHUNK_MAX;
+        ssize_t written = write(master, stream->data + pos, n < stream->len - pos ? n : stream->len - pos);
+
+        if (written < 0)
+        {
+            fprintf(stderr, "Write to the pseudo-terminal failed: %s\n", strerror(errno));
+            break;
+        }
+        pos += (size_t)written;
+        if (next_random(seed) % 100 == 0)
+        {
+            usleep(1000);
+        }
+    }
+
+    // Hang up once tlm_ingest has read everything: that ends its input
+    for (int idle = 0; idle < 5;)
+    {
+        usleep(10000);
+        idle = ioctl(slave, FIONREAD, &queued) == 0 && queued == 0 ? idle + 1 : 0;
+    }
+    close(master);
+    close(slave);
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+    {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+/**
+ * @brief Compare a file with the expected contents and report the first differing line
+ *
+ * @param path File
+ * @param want Expected contents
+ * @param len Length of want
+ * @return 0 if equal, 1 otherwise
+ */
+static int compare_file(const char *path, const char *want, size_t len)
+{
+    test_buf_t got = {0};
+    char chunk[65536];
+    size_t n, line = 1, i;
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+    {
+        printf("%s: missing\n", path);
+        return 1;
+    }
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    {
+        buf_append(&got, chunk, n);
+    }
+    fclose(f);
+
+    for (i = 0; i < got.len && i < len && got.data[i] == want[i]; i++)
+    {
+        line += want[i] == '\n';
+    }
+    free(got.data);
+    if (i == len && i == got.len)
+    {
+        printf("%s: %zu lines match\n", path, line - 1);
+        return 0;
+    }
+
+    printf("%s: differs at line %zu (%zu bytes, %zu expected)\n", path, line, got.len, len);
+    return 1;
+}
+
+/**
+ * @brief Compare a binary stream table of tlm_ingest with the output of tlm_decode
+ *
+ * @param decode Path of tlm_decode
+ * @param dir Work directory
+ * @param stream_path Device stream file
+ * @param id Stream id
+ * @param samples Samples sent on the stream
+ * @return 0 if equal, 1 if different, 2 on errors
+ */
+static int compare_stream(const char *decode, const char *dir, const char *stream_path, int id, long samples)
+{
+    char rig[8], want_path[1024], got_path[1024];
+    test_buf_t want = {0};
+    char chunk[65536];
+    long rows = 0;
+    size_t n;
+    FILE *f;
+    int rslt;
+
+    snprintf(rig, sizeof(rig), "%d", id);
+    snprintf(want_path, sizeof(want_path), "%s/decode-%d.csv", dir, id);
+    snprintf(got_path, sizeof(got_path), "%s/ingest-%d.csv", dir, id);
+
+    char *const argv[] = {(char *)decode, "-q", "-r", rig, "-o", want_path, (char *)stream_path, NULL};
+
+    if (run(argv) != 0 || (f = fopen(want_path, "rb")) == NULL)
+    {
+        fprintf(stderr, "%s failed on stream %d\n", decode, id);
+        return 2;
+    }
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    {
+        buf_append(&want, chunk, n);
+    }
+    fclose(f);
+
+    // Header and one row per sample: a frame lost in both decoders would still compare equal
+    for (size_t i = 0; i < want.len; i++)
+    {
+        rows += want.data[i] == '\n';
+    }
+    if (rows != samples + 1)
+    {
+        printf("%s: %ld of %ld samples decoded\n", want_path, rows - 1, samples);
+        free(want.data);
+        return 1;
+    }
+
+    rslt = compare_file(got_path, want.data, want.len);
+    free(want.data);
+    return rslt;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const outputs[] = {"stream.bin", "decode-0.csv", "decode-1.csv",
+                                          "ingest-0.csv", "ingest-1.csv", "ingest-text.csv"};
+    test_buf_t stream = {0}, text = {0};
+    char dir[] = "/tmp/tlm_ingest_test.XXXXXX";
+    char bindir[1024] = ".", ingest[1100], decode[1100], path[1100], prefix[1100];
+    long samples = 20000;
+    uint32_t seed = 1;
+    int keep = 0, failed = 0, rslt, i = 1;
+    const char *slash = strrchr(argv[0], '/');
+    FILE *f;
+
+    while (i < argc && argv[i][0] == '-')
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            samples = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-k") == 0)
+        {
+            keep = 1;
+        }
+        else
+        {
+            break;
+        }
+        i++;
+    }
+
+    if (i + 1 < argc || samples < 2 || seed == 0)
+    {
+        fprintf(stderr, "Usage: %s [-n samples] [-s seed] [-k] [bindir]\n", argv[0]);
+        return 2;
+    }
+    if (i < argc)
+    {
+        snprintf(bindir, sizeof(bindir), "%s", argv[i]);
+    }
+    else if (slash)
+    {
+        snprintf(bindir, sizeof(bindir), "%.*s", (int)(slash - argv[0]), argv[0]);
+    }
+    snprintf(ingest, sizeof(ingest), "%s/tlm_ingest", bindir);
+    snprintf(decode, sizeof(decode), "%s/tlm_decode", bindir);
+
+    if (!mkdtemp(dir))
+    {
+        fprintf(stderr, "Cannot create a work directory: %s\n", strerror(errno));
+        return 2;
+    }
+
+    build_stream(samples, &seed, &stream, &text);
+    snprintf(path, sizeof(path), "%s/stream.bin", dir);
+    f = fopen(path, "wb");
+    if (!f || fwrite(stream.data, 1, stream.len, f) != stream.len || fclose(f) != 0)
+    {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return 2;
+    }
+    printf("Stream: %zu bytes, %ld samples on streams 0 (plain) and 1 (delta), text in between\n", stream.len,
+           samples);
+
+    snprintf(prefix, sizeof(prefix), "%s/ingest-", dir);
+    rslt = run_ingest(ingest, prefix, &stream, &seed);
+    if (rslt != 0)
+    {
+        fprintf(stderr, "%s exited with %d\n", ingest, rslt);
+        return 2;
+    }
+
+    for (int id = 0; id < 2; id++)
+    {
+        rslt = compare_stream(decode, dir, path, id, samples);
+        if (rslt == 2)
+        {
+            return 2;
+        }
+        failed |= rslt;
+    }
+    snprintf(path, sizeof(path), "%s/ingest-text.csv", dir);
+    failed |= compare_file(path, text.data, text.len);
+
+    if (failed || keep)
+    {
+        printf("Tables kept in %s\n", dir);
+    }
+    else
+    {
+        for (size_t k = 0; k < sizeof(outputs) / sizeof(outputs[0]); k++)
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, outputs[k]);
+            unlink(path);
+        }
+        rmdir(dir);
+    }
+
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    free(stream.data);
+    free(text.data);
+    return failed;
+}
@@ -0,0 +1,452 @@
+/**
+ * @file tlm_stream.c
+ * @brief Incremental decoder of the firmware telemetry stream
+ */
+
+#include <ctype.h>
+#include <string.h>
+
+#include "tlm_stream.h"
+
+/**
+ * @brief Read a little-endian value from a frame
+ *
+ * @param src Input
+ * @param bytes Number of bytes (2 or 4)
+ * @return Value
+ */
+static uint32_t tlm_get(const uint8_t *src, uint8_t bytes)
+{
+    uint32_t value = 0;
+
+    for (uint8_t i = 0; i < bytes; i++)
+    {
+        value |= (uint32_t)src[i] << (8 * i);
+    }
+
+    return value;
+}
+
+/**
+ * @brief Parse a schema frame payload
+ *
+ * @param schema Output
+ * @param id Schema id from the header
+ * @param p Payload
+ * @param len Payload length
+ * @return 1 if valid, 0 otherwise
+ */
+static int tlm_parse_schema(tlm_schema_t *schema, uint8_t id, const uint8_t *p, size_t len)
+{
+    tlm_schema_t out;
+    size_t pos = 2;
+
+    if (len < 2 || p[0] != TELEMETRY_SCHEMA_VERSION || p[1] == 0 || p[1] > TELEMETRY_MAX_CHANNELS)
+    {
+        return 0;
+    }
+
+    memset(&out, 0, sizeof(out));
+    out.id = id;
+    out.count = p[1];
+
+    for (uint8_t i = 0; i < out.count; i++)
+    {
+        tlm_channel_t *ch = &out.channels[i];
+        uint8_t name_len;
+
+        if (pos + 3 > len)
+        {
+            return 0;
+        }
+        ch->type = p[pos];
+        ch->frac_bits = p[pos + 1];
+        name_len = p[pos + 2];
+        pos += 3;
+
+        if (ch->type > TELEMETRY_TYPE_Q32 || ch->frac_bits > 16 || name_len > TELEMETRY_NAME_MAX ||
+            pos + name_len > len)
+        {
+            return 0;
+        }
+        memcpy(ch->name, &p[pos], name_len);
+        ch->name[name_len] = '\0';
+        pos += name_len;
+
+        out.sample_size += ch->type == TELEMETRY_TYPE_Q16 ? 2 : 4;
+    }
+
+    if (pos != len)
+    {
+        return 0;
+    }
+
+    out.valid = 1;
+    *schema = out;
+    return 1;
+}
+
+/**
+ * @brief Read the wire values of a sample frame payload
+ *
+ * @param schema Schema of the stream
+ * @param p Payload (schema->sample_size bytes)
+ * @param wire Output, one wire value per channel
+ */
+static void tlm_parse_sample(const tlm_schema_t *schema, const uint8_t *p, int32_t *wire)
+{
+    size_t pos = 0;
+
+    for (uint8_t i = 0; i < schema->count; i++)
+    {
+        if (schema->channels[i].type == TELEMETRY_TYPE_Q16)
+        {
+            wire[i] = (int16_t)tlm_get(&p[pos], 2);
+            pos += 2;
+        }
+        else
+        {
+            wire[i] = (int32_t)tlm_get(&p[pos], 4);
+            pos += 4;
+        }
+    }
+}
+
+/**
+ * @brief Convert wire values to physical units
+ *
+ * @param schema Schema of the stream
+ * @param wire One wire value per channel
+ * @param values Output, one value per channel
+ */
+static void tlm_scale(const tlm_schema_t *schema, const int32_t *wire, double *values)
+{
+    for (uint8_t i = 0; i < schema->count; i++)
+    {
+        const tlm_channel_t *ch = &schema->channels[i];
+
+        if (ch->type == TELEMETRY_TYPE_U32)
+        {
+            values[i] = (double)(uint32_t)wire[i];
+        }
+        else
+        {
+            values[i] = wire[i] / (double)(1u << ch->frac_bits);
+        }
+    }
+}
+
+/**
+ * @brief Expand a delta frame payload against the last sample of the stream
+ *
+ * A U32 first channel (time stamp) carries the change of its step.
+ *
+ * @param s Pointer to decoder structure
+ * @param stream Stream id
+ * @param seq Sequence number of the first sample
+ * @param p Payload
+ * @param len Payload length
+ * @param synced The last sample is known (no gap before this frame)
+ * @return Number of samples in the frame, -1 if malformed
+ */
+static int32_t tlm_parse_delta(tlm_stream_t *s, uint8_t stream, uint16_t seq, const uint8_t *p, size_t len,
+                               int synced)
+{
+    const tlm_schema_t *schema = &s->schema[stream];
+    int32_t *ref = s->ref[stream];
+    int32_t *step = &s->step[stream];
+    double values[TELEMETRY_MAX_CHANNELS];
+    size_t pos = 0;
+    int32_t n = 0;
+
+    while (pos < len)
+    {
+        for (uint8_t i = 0; i < schema->count; i++)
+        {
+            int32_t delta;
+            int32_t used = telemetry_varint_decode(&p[pos], (uint32_t)(len - pos), &delta);
+
+            if (used < 0)
+            {
+                return -1;
+            }
+            pos += (size_t)used;
+            if (i == 0 && schema->channels[0].type == TELEMETRY_TYPE_U32)
+            {
+                *step = (int32_t)((uint32_t)*step + (uint32_t)delta);
+                delta = *step;
+            }
+            ref[i] = (int32_t)((uint32_t)ref[i] + (uint32_t)delta);
+        }
+
+        if (synced)
+        {
+            tlm_scale(schema, ref, values);
+            s->stats.samples++;
+            if (s->cb.sample)
+            {
+                s->cb.sample(s->ctx, stream, (uint16_t)(seq + n), schema, values);
+            }
+        }
+        else
+        {
+            s->stats.stale++;
+        }
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Check whether a piece is printable text
+ *
+ * @param p Piece
+ * @param len Length
+ * @return 1 if text, 0 otherwise
+ */
+static int tlm_is_text(const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isprint(p[i]) && !isspace(p[i]))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Handle one piece between two delimiters
+ *
+ * @param s Pointer to decoder structure
+ */
+static void tlm_piece(tlm_stream_t *s)
+{
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    int32_t len = telemetry_cobs_decode(s->chunk, (uint32_t)s->len, frame, sizeof(frame));
+    double values[TELEMETRY_MAX_CHANNELS];
+    const uint8_t *payload;
+    tlm_schema_t *schema;
+    size_t payload_len;
+    uint8_t stream;
+    uint16_t seq;
+    uint16_t gap = 0;
+    int32_t n;
+
+    if (len < TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE ||
+        telemetry_crc16(0xFFFF, frame, (uint32_t)len - TELEMETRY_CRC_SIZE) !=
+            tlm_get(&frame[len - TELEMETRY_CRC_SIZE], 2) ||
+        (frame[0] != TELEMETRY_FRAME_SCHEMA && frame[0] != TELEMETRY_FRAME_SAMPLE &&
+         frame[0] != TELEMETRY_FRAME_DELTA))
+    {
+        if (tlm_is_text(s->chunk, s->len))
+        {
+            s->stats.text++;
+            if (s->cb.text)
+            {
+                s->cb.text(s->ctx, (const char *)s->chunk, s->len);
+            }
+        }
+        else
+        {
+            s->stats.corrupt++;
+        }
+        return;
+    }
+
+    stream = frame[2];
+    seq = (uint16_t)tlm_get(&frame[3], 2);
+    payload = &frame[TELEMETRY_HEADER_SIZE];
+    payload_len = (size_t)len - TELEMETRY_HEADER_SIZE - TELEMETRY_CRC_SIZE;
+    schema = &s->schema[stream];
+
+    /* Frames missing since the last one of this stream */
+    if (s->next_seq[stream] >= 0)
+    {
+        gap = (uint16_t)(seq - (uint16_t)s->next_seq[stream]);
+        s->stats.lost += gap;
+    }
+    s->next_seq[stream] = (uint16_t)(seq + 1);
+
+    if (frame[0] == TELEMETRY_FRAME_SCHEMA)
+    {
+        uint8_t changed = !schema->valid || schema->id != frame[1];
+
+        if (!tlm_parse_schema(schema, frame[1], payload, payload_len))
+        {
+            s->stats.corrupt++;
+            return;
+        }
+        if (changed)
+        {
+            s->ref_valid[stream] = 0;
+        }
+        s->stats.schemas++;
+        if (changed && s->cb.schema)
+        {
+            s->cb.schema(s->ctx, stream, schema);
+        }
+        return;
+    }
+
+    if (!schema->valid || schema->id != frame[1])
+    {
+        s->stats.unknown_schema++;
+        s->ref_valid[stream] = 0;
+        return;
+    }
+
+    /* A delta frame carries several samples; a gap breaks the chain of deltas */
+    if (frame[0] == TELEMETRY_FRAME_DELTA)
+    {
+        if (gap > 0)
+        {
+            s->ref_valid[stream] = 0;
+        }
+        n = tlm_parse_delta(s, stream, seq, payload, payload_len, s->ref_valid[stream]);
+        if (n <= 0)
+        {
+            s->stats.corrupt++;
+            s->ref_valid[stream] = 0;
+            return;
+        }
+        s->stats.delta_frames++;
+        s->next_seq[stream] = (uint16_t)(seq + n);
+        return;
+    }
+
+    if (payload_len != schema->sample_size)
+    {
+        s->stats.unknown_schema++;
+        s->ref_valid[stream] = 0;
+        return;
+    }
+
+    tlm_parse_sample(schema, payload, s->ref[stream]);
+    s->step[stream] = 0;
+    s->ref_valid[stream] = 1;
+    tlm_scale(schema, s->ref[stream], values);
+    s->stats.samples++;
+    if (s->cb.sample)
+    {
+        s->cb.sample(s->ctx, stream, seq, schema, values);
+    }
+}
+
+/**
+ * @brief Initialize the decoder
+ *
+ * @param[out] s Pointer to decoder structure
+ * @param[in] cb Callbacks (copied; NULL for none)
+ * @param[in] ctx Context passed to the callbacks
+ */
+void tlm_stream_init(tlm_stream_t *s, const tlm_callbacks_t *cb, void *ctx)
+{
+    memset(s, 0, sizeof(*s));
+    if (cb)
+    {
+        s->cb = *cb;
+    }
+    s->ctx = ctx;
+
+    for (int i = 0; i < TLM_STREAM_IDS; i++)
+    {
+        s->next_seq[i] = -1;
+    }
+}
+
+/**
+ * @brief Feed received bytes
+ *
+ * @param[in,out] s Pointer to decoder structure
+ * @param[in] data Received bytes
+ * @param[in] len Number of bytes
+ */
+void tlm_stream_feed(tlm_stream_t *s, const uint8_t *data, size_t len)
+{
+    s->stats.bytes += len;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] != 0)
+        {
+            if (s->len < sizeof(s->chunk))
+            {
+                s->chunk[s->len++] = data[i];
+            }
+            else
+            {
+                s->overflow = 1;
+            }
+            if (!isprint(data[i]) && !isspace(data[i]))
+            {
+                s->binary = 1;
+            }
+
+            /*
+             * A complete text line goes out at once. A frame starts with its
+             * COBS code byte, which may be '\n', then the type byte, which is
+             * never text: a line needs two bytes to tell it from a frame.
+             */
+            if (data[i] == '\n' && s->len > 1 && !s->binary && !s->overflow)
+            {
+                s->stats.text++;
+                if (s->cb.text)
+                {
+                    s->cb.text(s->ctx, (const char *)s->chunk, s->len);
+                }
+                s->len = 0;
+            }
+            continue;
+        }
+
+        /* Delimiter: back-to-back delimiters leave empty pieces */
+        if (s->overflow)
+        {
+            s->stats.corrupt++;
+        }
+        else if (s->len > 0)
+        {
+            tlm_piece(s);
+        }
+        s->len = 0;
+        s->overflow = 0;
+        s->binary = 0;
+    }
+}
+
+/**
+ * @brief Handle the bytes after the last delimiter (end of input)
+ *
+ * @param[in,out] s Pointer to decoder structure
+ */
+void tlm_stream_flush(tlm_stream_t *s)
+{
+    static const uint8_t delimiter = 0;
+
+    tlm_stream_feed(s, &delimiter, 1);
+    s->stats.bytes--;
+}
+
+/**
+ * @brief Decimal places that resolve a channel (at least 2, like the text log)
+ *
+ * @param[in] ch Pointer to channel description
+ *
+ * @return Number of decimal places (0 for integer channels)
+ */
+int tlm_channel_decimals(const tlm_channel_t *ch)
+{
+    /* One decimal per 3.32 bits */
+    int decimals = (ch->frac_bits * 3 + 9) / 10;
+
+    if (ch->type == TELEMETRY_TYPE_U32 || ch->frac_bits == 0)
+    {
+        return 0;
+    }
+
+    return decimals < 2 ? 2 : decimals;
+}
@@ -0,0 +1,173 @@
+/**
+ * @brief Check of the setpoint generator limits (Linux host)
+ *
+ * Runs single moves from rest over a grid of limits (velocity, acceleration,
+ * jerk), distances and both directions through traj_step at the firmware
+ * control rate and checks every tick: the velocity stays within vel_max, the
+ * acceleration within acc_max, and on the S-curve the acceleration changes
+ * by at most one jerk step per tick (jerk_max / rate, plus one LSB of
+ * rounding), including the tick that snaps onto the target. Each move has
+ * to end on the target at rest.
+ *
+ * Usage: traj_check [-v]
+ *   -v  print every violating move, not only the first 20
+ *
+ * Exit status: 0 if every move kept the limits, 1 on a violation, 2 on errors.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trajectory.h"
+
+/**
+ * @brief Tick rate of the check (CONTROL_RATE_HZ of the firmware)
+ */
+#define CHECK_RATE_HZ 1000
+
+/**
+ * @brief Grid of the check (deg/s, deg/s^2, deg/s^3, deg)
+ */
+static const float vel_grid[] = {1, 10, 90, 500, 10000};
+static const float acc_grid[] = {1, 30, 300, 3000, 10000};
+static const float jerk_grid[] = {1, 100, 3000, 30000};
+static const float dist_grid[] = {0.02f, 0.1f, 1, 30, 180, 1000};
+
+/**
+ * @brief Worst value of a move relative to its limit
+ */
+typedef struct
+{
+    double vel;  /* max |vel| / vel_max */
+    double acc;  /* max |acc| / acc_max */
+    double jerk; /* max |dacc| / jerk step */
+} worst_t;
+
+/**
+ * @brief Run one move from rest and track the worst ratios
+ *
+ * @param profile Profile type
+ * @param vel_max Velocity limit (deg/s)
+ * @param acc_max Acceleration limit (deg/s^2)
+ * @param jerk_max Jerk limit (deg/s^3)
+ * @param dist Signed distance (deg)
+ * @param worst Output, worst ratios of the move
+ * @return Number of ticks, -1 if the move did not end on the target
+ */
+static long run_move(traj_profile_t profile, float vel_max, float acc_max, float jerk_max,
+                     float dist, worst_t *worst)
+{
+    const fix16_t start = FIX16_FROM_FLOAT(-dist / 2);
+    const fix16_t target = start + FIX16_FROM_FLOAT(dist);
+    fix16_t vel_lim, acc_lim, jerk_step, acc_prev;
+    long max_ticks, ticks = 0;
+    traj_t traj;
+
+    traj_init(&traj, CHECK_RATE_HZ, start);
+    traj_set_limits(&traj, profile, FIX16_FROM_FLOAT(vel_max), FIX16_FROM_FLOAT(acc_max),
+                    FIX16_FROM_FLOAT(jerk_max));
+    traj_set_target(&traj, target);
+
+    vel_lim = traj.vel_max;
+    acc_lim = traj.acc_max;
+    jerk_step = traj.jerk_max / CHECK_RATE_HZ + 1;
+    acc_prev = 0;
+    memset(worst, 0, sizeof(*worst));
+
+    /* Generous bound: ten times the move along a trapezoid at half the limits */
+    max_ticks = (long)(10.0 * CHECK_RATE_HZ *
+                       (2 * (dist < 0 ? -dist : dist) / vel_max + 4 * vel_max / acc_max + 4 * acc_max / jerk_max)) +
+                10 * CHECK_RATE_HZ;
+
+    while (!traj.done && ticks < max_ticks)
+    {
+        double ratio;
+
+        traj_step(&traj);
+        ticks++;
+
+        ratio = fix16_abs(traj.vel) / (double)vel_lim;
+        worst->vel = ratio > worst->vel ? ratio : worst->vel;
+        ratio = fix16_abs(traj.acc) / (double)acc_lim;
+        worst->acc = ratio > worst->acc ? ratio : worst->acc;
+        if (profile == TRAJ_PROFILE_SCURVE)
+        {
+            ratio = fix16_abs(traj.acc - acc_prev) / (double)jerk_step;
+            worst->jerk = ratio > worst->jerk ? ratio : worst->jerk;
+        }
+        acc_prev = traj.acc;
+    }
+
+    return traj.done && traj.pos == target ? ticks : -1;
+}
+
+int main(int argc, char **argv)
+{
+    static const traj_profile_t profiles[] = {TRAJ_PROFILE_TRAPEZOID, TRAJ_PROFILE_SCURVE};
+    static const char *const names[] = {"trapezoid", "S-curve"};
+    int verbose = 0;
+    unsigned long moves = 0, violations = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            verbose = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++)
+    {
+        worst_t total;
+
+        memset(&total, 0, sizeof(total));
+        for (size_t v = 0; v < sizeof(vel_grid) / sizeof(vel_grid[0]); v++)
+        {
+            for (size_t a = 0; a < sizeof(acc_grid) / sizeof(acc_grid[0]); a++)
+            {
+                for (size_t j = 0; j < sizeof(jerk_grid) / sizeof(jerk_grid[0]); j++)
+                {
+                    for (size_t d = 0; d < 2 * sizeof(dist_grid) / sizeof(dist_grid[0]); d++)
+                    {
+                        float dist = d % 2 ? -dist_grid[d / 2] : dist_grid[d / 2];
+                        worst_t worst;
+                        long ticks = run_move(profiles[p], vel_grid[v], acc_grid[a], jerk_grid[j], dist, &worst);
+
+                        moves++;
+                        total.vel = worst.vel > total.vel ? worst.vel : total.vel;
+                        total.acc = worst.acc > total.acc ? worst.acc : total.acc;
+                        total.jerk = worst.jerk > total.jerk ? worst.jerk : total.jerk;
+                        if (ticks < 0 || worst.vel > 1.0 || worst.acc > 1.0 || worst.jerk > 1.0)
+                        {
+                            if (verbose || violations < 20)
+                            {
+                                fprintf(stderr,
+                                        "%s vel %g acc %g jerk %g dist %g: vel %.4f acc %.4f jerk %.4f x limit%s\n",
+                                        names[p], vel_grid[v], acc_grid[a], jerk_grid[j], dist, worst.vel,
+                                        worst.acc, worst.jerk, ticks < 0 ? ", target not reached" : "");
+                            }
+                            violations++;
+                        }
+                    }
+                }
+            }
+        }
+        printf("%s: worst vel %.3f, acc %.3f", names[p], total.vel, total.acc);
+        if (profiles[p] == TRAJ_PROFILE_SCURVE)
+        {
+            printf(", jerk %.3f", total.jerk);
+        }
+        printf(" x limit\n");
+    }
+
+    printf("Checked %lu moves: %lu violate a limit\n", moves, violations);
+    printf("%s\n", violations ? "FAIL" : "PASS");
+
+    return violations ? 1 : 0;
+}
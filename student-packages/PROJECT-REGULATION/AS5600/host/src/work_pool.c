@@ -0,0 +1,252 @@
+/**
+ * @file work_pool.c
+ * @brief Work-stealing thread pool implementation
+ */
+
+#include <unistd.h>
+
+#include "work_pool.h"
+
+/**
+ * @brief Worker thread argument
+ */
+typedef struct
+{
+    work_pool_t *pool; /* Owning pool */
+    uint32_t index;    /* Worker index */
+} work_pool_worker_t;
+
+/**
+ * @brief Take one job from the back of a worker's own queue
+ *
+ * @param[in,out] q Queue
+ * @param[out] job Job index
+ *
+ * @return 1 if a job was taken, 0 if the queue is empty
+ */
+static int work_queue_pop(work_queue_t *q, uint32_t *job)
+{
+    int taken = 0;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->tail > q->head)
+    {
+        *job = --q->tail;
+        taken = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return taken;
+}
+
+/**
+ * @brief Move half of the jobs of the fullest other queue into an empty queue
+ *
+ * @param[in,out] pool Pointer to pool structure
+ * @param[in] self Index of the thief
+ *
+ * @return 1 if jobs were stolen, 0 if all queues are empty
+ */
+static int work_pool_steal(work_pool_t *pool, uint32_t self)
+{
+    for (;;)
+    {
+        uint32_t victim = self;
+        uint32_t most = 0;
+        uint32_t first, last;
+        work_queue_t *q;
+
+        /* Pick the fullest queue; it is checked again when the jobs are taken */
+        for (uint32_t i = 0; i < pool->workers; i++)
+        {
+            uint32_t left;
+
+            if (i == self)
+            {
+                continue;
+            }
+
+            pthread_mutex_lock(&pool->queues[i].lock);
+            left = pool->queues[i].tail - pool->queues[i].head;
+            pthread_mutex_unlock(&pool->queues[i].lock);
+
+            if (left > most)
+            {
+                most = left;
+                victim = i;
+            }
+        }
+
+        if (victim == self)
+        {
+            return 0;
+        }
+
+        q = &pool->queues[victim];
+        pthread_mutex_lock(&q->lock);
+        if (q->tail <= q->head)
+        {
+            pthread_mutex_unlock(&q->lock);
+            continue; /* Drained meanwhile, look again */
+        }
+        first = q->head;
+        last = q->head + (q->tail - q->head + 1) / 2;
+        q->head = last;
+        pthread_mutex_unlock(&q->lock);
+
+        q = &pool->queues[self];
+        pthread_mutex_lock(&q->lock);
+        q->head = first;
+        q->tail = last;
+        pthread_mutex_unlock(&q->lock);
+
+        pthread_mutex_lock(&pool->stats_lock);
+        pool->steals++;
+        pthread_mutex_unlock(&pool->stats_lock);
+
+        return 1;
+    }
+}
+
+/**
+ * @brief Worker thread: run own jobs, then steal until every queue is empty
+ *
+ * @param[in] arg Worker argument
+ *
+ * @return NULL
+ */
+static void *work_pool_worker(void *arg)
+{
+    work_pool_worker_t *w = arg;
+    work_pool_t *pool = w->pool;
+    uint32_t job;
+
+    do
+    {
+        while (work_queue_pop(&pool->queues[w->index], &job))
+        {
+            pool->fn(pool->ctx, job, w->index);
+        }
+    } while (work_pool_steal(pool, w->index));
+
+    return NULL;
+}
+
+/**
+ * @brief Initialize the pool
+ *
+ * @param[out] pool Pointer to pool structure
+ * @param[in] workers Number of worker threads (0 = one per online CPU)
+ *
+ * @return WORK_POOL_OK on success, error code on failure
+ */
+work_pool_err_t work_pool_init(work_pool_t *pool, uint32_t workers)
+{
+    if (!pool)
+    {
+        return WORK_POOL_ERR_INVALID_PARAM;
+    }
+
+    if (workers == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        workers = cpus > 0 ? (uint32_t)cpus : 1;
+    }
+    if (workers > WORK_POOL_MAX_WORKERS)
+    {
+        workers = WORK_POOL_MAX_WORKERS;
+    }
+
+    pool->workers = workers;
+    pool->fn = NULL;
+    pool->ctx = NULL;
+    pool->steals = 0;
+    pthread_mutex_init(&pool->stats_lock, NULL);
+    for (uint32_t i = 0; i < workers; i++)
+    {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+        pool->queues[i].head = 0;
+        pool->queues[i].tail = 0;
+    }
+
+    return WORK_POOL_OK;
+}
+
+/**
+ * @brief Run a batch of jobs and wait until all of them are done
+ *
+ * The calling thread works as worker 0, so a pool of one worker runs the
+ * batch without any extra thread.
+ *
+ * @param[in,out] pool Pointer to pool structure
+ * @param[in] count Number of jobs
+ * @param[in] fn Job function
+ * @param[in] ctx User context passed to the job function
+ *
+ * @return WORK_POOL_OK on success, error code on failure
+ */
+work_pool_err_t work_pool_run(work_pool_t *pool, uint32_t count, work_pool_fn_t fn, void *ctx)
+{
+    work_pool_worker_t args[WORK_POOL_MAX_WORKERS];
+    pthread_t threads[WORK_POOL_MAX_WORKERS];
+    work_pool_err_t rslt = WORK_POOL_OK;
+    uint32_t started = 1;
+
+    if (!pool || !fn)
+    {
+        return WORK_POOL_ERR_INVALID_PARAM;
+    }
+
+    pool->fn = fn;
+    pool->ctx = ctx;
+
+    /* Deal the jobs out in contiguous blocks */
+    for (uint32_t i = 0; i < pool->workers; i++)
+    {
+        pool->queues[i].head = (uint32_t)((uint64_t)count * i / pool->workers);
+        pool->queues[i].tail = (uint32_t)((uint64_t)count * (i + 1) / pool->workers);
+        args[i].pool = pool;
+        args[i].index = i;
+    }
+
+    for (uint32_t i = 1; i < pool->workers; i++)
+    {
+        if (pthread_create(&threads[i], NULL, work_pool_worker, &args[i]) != 0)
+        {
+            /* The jobs of the missing worker are stolen by the others */
+            rslt = WORK_POOL_ERR_THREAD;
+            break;
+        }
+        started++;
+    }
+
+    work_pool_worker(&args[0]);
+
+    for (uint32_t i = 1; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    return rslt;
+}
+
+/**
+ * @brief Release the pool resources
+ *
+ * @param[in,out] pool Pointer to pool structure
+ */
+void work_pool_deinit(work_pool_t *pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < pool->workers; i++)
+    {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_mutex_destroy(&pool->stats_lock);
+    pool->workers = 0;
+}
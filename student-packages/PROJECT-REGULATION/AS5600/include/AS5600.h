@@ -79,6 +79,12 @@ extern "C"
 #define AS5600_STATUS_ML (1 << 1) /* AGC Maximum Gain Overflow */
 #define AS5600_STATUS_MH (1 << 2) /* AGC Minimum Gain Overflow */
 
+/**
+ * @brief Fixed-point angle scaling
+ */
+#define AS5600_COUNTS 4096               /* Counts per revolution (12-bit) */
+#define AS5600_DEG_Q16_PER_COUNT 5760    /* 360 deg / 4096 counts in Q16.16 */
+
     /**
      * @brief Enumeration for Power Mode settings
      */
@@ -187,10 +193,12 @@ extern "C"
      * @param[in] reg_addr Register address to write to
      * @param[in] reg_data Pointer to data to write
      * @param[in] len Number of bytes to write
+     * @param[in] intf_ptr Interface context given to as5600_init()
      *
      * @return 0 on success, non-zero on failure
      */
-    typedef int8_t (*as5600_i2c_write_fptr_t)(uint8_t dev_addr, uint8_t reg_addr, const uint8_t *reg_data, uint32_t len);
+    typedef int8_t (*as5600_i2c_write_fptr_t)(uint8_t dev_addr, uint8_t reg_addr, const uint8_t *reg_data, uint32_t len,
+                                              void *intf_ptr);
 
     /**
      * @brief Function pointer for platform-specific I2C read operations
@@ -199,17 +207,20 @@ extern "C"
      * @param[in] reg_addr Register address to read from
      * @param[out] reg_data Pointer to store read data
      * @param[in] len Number of bytes to read
+     * @param[in] intf_ptr Interface context given to as5600_init()
      *
      * @return 0 on success, non-zero on failure
      */
-    typedef int8_t (*as5600_i2c_read_fptr_t)(uint8_t dev_addr, uint8_t reg_addr, uint8_t *reg_data, uint32_t len);
+    typedef int8_t (*as5600_i2c_read_fptr_t)(uint8_t dev_addr, uint8_t reg_addr, uint8_t *reg_data, uint32_t len,
+                                             void *intf_ptr);
 
     /**
      * @brief Function pointer for platform-specific delay function
      *
      * @param[in] ms Delay time in milliseconds
+     * @param[in] intf_ptr Interface context given to as5600_init()
      */
-    typedef void (*as5600_delay_fptr_t)(uint32_t ms);
+    typedef void (*as5600_delay_fptr_t)(uint32_t ms, void *intf_ptr);
 
     /**
      * @brief AS5600 device structure
@@ -219,6 +230,7 @@ extern "C"
         as5600_i2c_write_fptr_t write; /* I2C write function */
         as5600_i2c_read_fptr_t read;   /* I2C read function */
         as5600_delay_fptr_t delay_ms;  /* Delay function */
+        void *intf_ptr;                /* Interface context (bus, device instance) */
         as5600_config_t config;        /* Device configuration */
         uint8_t initialized;           /* Initialization flag */
     } as5600_dev_t;
@@ -230,13 +242,15 @@ extern "C"
      * @param[in] write_fptr Pointer to platform-specific I2C write function
      * @param[in] read_fptr Pointer to platform-specific I2C read function
      * @param[in] delay_fptr Pointer to platform-specific delay function
+     * @param[in] intf_ptr Interface context passed to the functions (e.g. the I2C bus)
      *
      * @return AS5600_OK on success, error code on failure
      */
     as5600_err_t as5600_init(as5600_dev_t *dev,
                              as5600_i2c_write_fptr_t write_fptr,
                              as5600_i2c_read_fptr_t read_fptr,
-                             as5600_delay_fptr_t delay_fptr);
+                             as5600_delay_fptr_t delay_fptr,
+                             void *intf_ptr);
 
     /**
      * @brief Configure the AS5600 device
@@ -298,6 +312,19 @@ extern "C"
      */
     as5600_err_t as5600_get_angle_degrees(const as5600_dev_t *dev, float *angle_deg);
 
+    /**
+     * @brief Get the angle value in degrees as Q16.16 fixed point
+     *
+     * Exact conversion of the 12-bit angle (1 count = 5760 / 65536 deg), intended
+     * for control code running without an FPU.
+     *
+     * @param[in] dev Pointer to device structure
+     * @param[out] angle_q16 Pointer to variable to store the angle in degrees (0-360) in Q16.16
+     *
+     * @return AS5600_OK on success, error code on failure
+     */
+    as5600_err_t as5600_get_angle_q16(const as5600_dev_t *dev, int32_t *angle_q16);
+
     /**
      * @brief Get the AGC value
      *
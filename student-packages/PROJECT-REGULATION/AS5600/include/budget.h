@@ -0,0 +1,103 @@
+/**
+ * @file budget.h
+ * @brief Per-loop CPU and bus time budget
+ *
+ * Several regulation loops share the two cores and the two I2C buses. To see
+ * how many loops fit at a given tick rate, every tick of a loop records
+ *
+ *   - how late it started relative to its scheduled slot (scheduler jitter),
+ *   - how long it ran (CPU time, I2C transfers included),
+ *   - how long it occupied its I2C bus,
+ *
+ * and the budget keeps the mean and the maximum of each over a window. The
+ * window runs until the owner has reported it and calls budget_reset().
+ * Loads are given in permille of the tick period, so the loads of all loops
+ * on one core (or one bus) add up to the load of that core (or bus).
+ *
+ * The module only accumulates numbers the platform measures; on the Pico
+ * the times come from the microsecond timer (see main.c).
+ */
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+    /**
+     * @brief Time budget of one loop
+     */
+    typedef struct
+    {
+        uint32_t period_us; /* Tick period the loads refer to */
+        uint32_t ticks;     /* Ticks in the window */
+        uint64_t cpu_sum;   /* Sum of the tick run times (us) */
+        uint32_t cpu_max;   /* Longest tick (us) */
+        uint64_t bus_sum;   /* Sum of the bus times (us) */
+        uint32_t bus_max;   /* Longest bus time of a tick (us) */
+        uint32_t late_max;  /* Latest start after the scheduled slot (us) */
+        uint32_t overruns;  /* Ticks that ended after the next slot had begun */
+    } budget_t;
+
+    /**
+     * @brief Initialize an empty budget
+     *
+     * @param[out] budget Pointer to budget structure
+     * @param[in] period_us Tick period in microseconds (> 0)
+     */
+    void budget_init(budget_t *budget, uint32_t period_us);
+
+    /**
+     * @brief Start a new window (the period is kept)
+     *
+     * @param[in,out] budget Pointer to budget structure
+     */
+    void budget_reset(budget_t *budget);
+
+    /**
+     * @brief Record one tick
+     *
+     * @param[in,out] budget Pointer to budget structure
+     * @param[in] late_us Start of the tick after its scheduled slot (us)
+     * @param[in] cpu_us Run time of the tick (us)
+     * @param[in] bus_us Time the tick occupied its bus (us)
+     */
+    void budget_add(budget_t *budget, uint32_t late_us, uint32_t cpu_us, uint32_t bus_us);
+
+    /**
+     * @brief Mean CPU time per tick over the window
+     *
+     * @param[in] budget Pointer to budget structure
+     *
+     * @return Mean run time in microseconds (0 without ticks)
+     */
+    uint32_t budget_cpu_mean(const budget_t *budget);
+
+    /**
+     * @brief Mean bus time per tick over the window
+     *
+     * @param[in] budget Pointer to budget structure
+     *
+     * @return Mean bus time in microseconds (0 without ticks)
+     */
+    uint32_t budget_bus_mean(const budget_t *budget);
+
+    /**
+     * @brief Share of the tick period taken by a time
+     *
+     * @param[in] budget Pointer to budget structure
+     * @param[in] time_us Time per tick in microseconds
+     *
+     * @return Load in permille of the period
+     */
+    uint32_t budget_load(const budget_t *budget, uint32_t time_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUDGET_H */
@@ -0,0 +1,93 @@
+/**
+ * @file calib_sweep.h
+ * @brief Open-loop calibration sweep of the propeller
+ *
+ * Steps the motor duty from a start to an end value. At every step the sweep
+ * waits for the pendulum to settle and then averages the angle, giving the
+ * static duty -> angle curve of the rig. The result feeds ff_build_table().
+ */
+
+#ifndef CALIB_SWEEP_H
+#define CALIB_SWEEP_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+#include "feedforward.h"
+
+/**
+ * @brief Maximum number of sweep steps
+ */
+#define CALIB_SWEEP_MAX_STEPS FF_CAL_MAX_POINTS
+
+    /**
+     * @brief Enumeration for sweep states
+     */
+    typedef enum
+    {
+        CALIB_SWEEP_IDLE = 0,    /* Not started */
+        CALIB_SWEEP_RUNNING = 1, /* Sweep in progress */
+        CALIB_SWEEP_DONE = 2,    /* All steps recorded */
+        CALIB_SWEEP_ABORTED = 3  /* Angle limit exceeded or aborted by the user */
+    } calib_sweep_state_t;
+
+    /**
+     * @brief Calibration sweep structure
+     */
+    typedef struct
+    {
+        calib_sweep_state_t state;            /* Current state */
+        fix16_t duty_start;                   /* Duty of the first step */
+        fix16_t duty_step;                    /* Duty increment per step */
+        uint8_t steps;                        /* Number of steps */
+        uint8_t index;                        /* Current step */
+        uint32_t settle_ticks;                /* Ticks to wait before averaging */
+        uint32_t avg_ticks;                   /* Ticks to average */
+        uint32_t tick;                        /* Tick within the current step */
+        int64_t acc;                          /* Angle accumulator */
+        fix16_t angle_limit;                  /* Abort above this angle */
+        fix16_t duty[CALIB_SWEEP_MAX_STEPS];  /* Recorded duties */
+        fix16_t angle[CALIB_SWEEP_MAX_STEPS]; /* Recorded settled angles */
+    } calib_sweep_t;
+
+    /**
+     * @brief Start a sweep
+     *
+     * @param[out] sweep Pointer to sweep structure
+     * @param[in] duty_start Duty of the first step
+     * @param[in] duty_end Duty of the last step
+     * @param[in] steps Number of steps (2 - CALIB_SWEEP_MAX_STEPS)
+     * @param[in] settle_ticks Ticks to wait after each duty change
+     * @param[in] avg_ticks Ticks to average the angle over
+     * @param[in] angle_limit Abort when the angle exceeds this value (degrees)
+     */
+    void calib_sweep_start(calib_sweep_t *sweep, fix16_t duty_start, fix16_t duty_end, uint8_t steps,
+                           uint32_t settle_ticks, uint32_t avg_ticks, fix16_t angle_limit);
+
+    /**
+     * @brief Abort a running sweep
+     *
+     * @param[in,out] sweep Pointer to sweep structure
+     */
+    void calib_sweep_abort(calib_sweep_t *sweep);
+
+    /**
+     * @brief Run one sweep tick
+     *
+     * @param[in,out] sweep Pointer to sweep structure
+     * @param[in] angle Measured angle in degrees
+     *
+     * @return Duty to apply this tick (0 once the sweep is no longer running)
+     */
+    fix16_t calib_sweep_tick(calib_sweep_t *sweep, fix16_t angle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CALIB_SWEEP_H */
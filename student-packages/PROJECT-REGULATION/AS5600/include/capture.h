@@ -0,0 +1,167 @@
+/**
+ * @file capture.h
+ * @brief Triggered full-rate capture with pre-trigger history
+ *
+ * The live log is decimated; a step response needs every tick around the
+ * event. Once armed, every tick (setpoint, angle, motor command and the
+ * timing of the tick) is written into a circular buffer in RAM, so the
+ * buffer always holds the latest history. A trigger - a new target, the
+ * control error leaving a band, or a manual request - marks the trigger
+ * sample; recording goes on for the post-trigger depth and then stops with
+ * up to `pre` samples before the trigger and `post` samples from it on, like
+ * a logic analyzer. The frozen capture is read out at leisure while the loop
+ * keeps running.
+ *
+ * Samples are stored compactly as in sysid.h: angles in centidegrees, the
+ * command in Q1.15, times in microseconds (all saturated).
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+    /**
+     * @brief Enumeration for capture states
+     */
+    typedef enum
+    {
+        CAPTURE_IDLE = 0,      /* Not armed */
+        CAPTURE_ARMED = 1,     /* Recording the history, waiting for the trigger */
+        CAPTURE_TRIGGERED = 2, /* Recording the post-trigger samples */
+        CAPTURE_DONE = 3       /* Capture complete and frozen */
+    } capture_state_t;
+
+    /**
+     * @brief Enumeration for trigger causes
+     */
+    typedef enum
+    {
+        CAPTURE_CAUSE_NONE = 0,   /* Not triggered */
+        CAPTURE_CAUSE_MANUAL = 1, /* capture_trigger() */
+        CAPTURE_CAUSE_TARGET = 2, /* Target changed */
+        CAPTURE_CAUSE_ERROR = 3   /* |setpoint - angle| above the error band */
+    } capture_cause_t;
+
+    /**
+     * @brief Enumeration for capture error codes
+     */
+    typedef enum
+    {
+        CAPTURE_OK = 0,                /* Operation completed successfully */
+        CAPTURE_ERR_INVALID_PARAM = -1 /* No post-trigger samples or too deep for the buffer */
+    } capture_err_t;
+
+    /**
+     * @brief Capture settings
+     */
+    typedef struct
+    {
+        uint32_t pre;       /* Samples kept before the trigger */
+        uint32_t post;      /* Samples from the trigger on (trigger sample included, >= 1) */
+        uint8_t on_target;  /* Trigger when the target changes */
+        fix16_t error_band; /* Trigger when |setpoint - angle| exceeds it (deg, 0 = off) */
+    } capture_config_t;
+
+    /**
+     * @brief One recorded tick
+     */
+    typedef struct
+    {
+        int16_t setpoint; /* Setpoint (centidegrees) */
+        int16_t angle;    /* Measured angle (centidegrees) */
+        int16_t command;  /* Motor command (Q1.15) */
+        uint16_t late_us; /* Start of the tick after its scheduled slot (us) */
+        uint16_t cpu_us;  /* Run time of the tick (us) */
+    } capture_sample_t;
+
+    /**
+     * @brief Capture structure
+     */
+    typedef struct
+    {
+        capture_state_t state;   /* Current state */
+        capture_config_t cfg;    /* Active settings */
+        capture_sample_t *buf;   /* Circular buffer */
+        uint32_t capacity;       /* Number of samples the buffer holds */
+        uint32_t head;           /* Buffer position of the next sample */
+        uint32_t recorded;       /* Samples recorded since armed (up to the capacity) */
+        uint32_t remaining;      /* Post-trigger samples still to record */
+        uint32_t start;          /* Buffer position of the first captured sample */
+        uint32_t pre_count;      /* Captured samples before the trigger (up to cfg.pre) */
+        uint32_t length;         /* Captured samples once done */
+        capture_cause_t cause;   /* What triggered */
+        fix16_t target;          /* Target of the previous tick */
+        volatile uint8_t manual; /* Manual trigger requested */
+    } capture_t;
+
+    /**
+     * @brief Initialize the capture (idle)
+     *
+     * @param[out] cap Pointer to capture structure
+     * @param[in] buf Circular buffer (kept by reference)
+     * @param[in] capacity Number of samples the buffer holds
+     */
+    void capture_init(capture_t *cap, capture_sample_t *buf, uint32_t capacity);
+
+    /**
+     * @brief Start recording and wait for a trigger (discards a previous capture)
+     *
+     * @param[in,out] cap Pointer to capture structure
+     * @param[in] cfg Capture settings
+     *
+     * @return CAPTURE_OK on success, CAPTURE_ERR_INVALID_PARAM if post is 0 or
+     *         pre + post exceeds the capacity
+     */
+    capture_err_t capture_arm(capture_t *cap, const capture_config_t *cfg);
+
+    /**
+     * @brief Trigger an armed capture at the next recorded tick
+     *
+     * @param[in,out] cap Pointer to capture structure
+     */
+    void capture_trigger(capture_t *cap);
+
+    /**
+     * @brief Stop recording (a complete capture stays readable)
+     *
+     * @param[in,out] cap Pointer to capture structure
+     */
+    void capture_disarm(capture_t *cap);
+
+    /**
+     * @brief Record one tick (does nothing unless armed or triggered)
+     *
+     * @param[in,out] cap Pointer to capture structure
+     * @param[in] target Commanded target (deg)
+     * @param[in] setpoint Setpoint of the tick (deg)
+     * @param[in] angle Measured angle (deg)
+     * @param[in] command Motor command (duty)
+     * @param[in] late_us Start of the tick after its scheduled slot (us)
+     * @param[in] cpu_us Run time of the tick (us)
+     */
+    void capture_record(capture_t *cap, fix16_t target, fix16_t setpoint, fix16_t angle, fix16_t command,
+                        uint32_t late_us, uint32_t cpu_us);
+
+    /**
+     * @brief Sample of a complete capture
+     *
+     * @param[in] cap Pointer to capture structure
+     * @param[in] index Sample number, 0 for the oldest; the trigger sample is cap->pre_count
+     *
+     * @return Pointer to the sample, NULL if the capture is not complete or index is out of range
+     */
+    const capture_sample_t *capture_get(const capture_t *cap, uint32_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,201 @@
+/**
+ * @file controller.h
+ * @brief Pendulum angle controller (PID with optional gain scheduling, feedforward
+ *        and disturbance observer, or observer-based state feedback)
+ *
+ * Pure fixed-point computation without any hardware access: one call to
+ * controller_step() per control tick maps the measured angle to a motor command.
+ * A new target is not applied as a step, the trajectory generator moves the
+ * setpoint there along the configured profile.
+ */
+
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+#include "pid.h"
+#include "gain_schedule.h"
+#include "feedforward.h"
+#include "dob.h"
+#include "lqr.h"
+#include "predictor.h"
+#include "trajectory.h"
+#include "ctrl_params.h"
+
+/**
+ * @brief Controller modes acting on the latency-compensated angle (bit mask)
+ */
+#define CONTROLLER_PRED_PID 0x01u /* PID stage */
+#define CONTROLLER_PRED_LQR 0x02u /* State feedback */
+
+    /**
+     * @brief Controller structure
+     */
+    typedef struct
+    {
+        pid_ctrl_t pid;        /* PID stage */
+        gain_sched_t sched;    /* Gain schedule */
+        pid_gains_t gains;     /* Fixed gains used while the schedule is off */
+        pid_coeffs_t coeffs;   /* Fixed gains discretized for the tick rate */
+        uint8_t sched_enabled; /* Gain schedule enabled flag */
+        feedforward_t ff;      /* Gravity/thrust feedforward */
+        uint8_t ff_enabled;    /* Feedforward enabled flag */
+        fix16_t ff_term;       /* Last feedforward output */
+        dob_t dob;             /* Disturbance observer */
+        uint8_t dob_enabled;   /* Disturbance compensation enabled flag */
+        fix16_t dob_term;      /* Last disturbance compensation (duty) */
+        lqr_t lqr;             /* State feedback gain table */
+        uint8_t lqr_enabled;   /* State feedback replaces the PID stage */
+        predictor_t pred;      /* Measurement latency compensation */
+        uint8_t pred_modes;    /* Modes using the predicted angle (CONTROLLER_PRED_*) */
+        fix16_t gain_scale;    /* Loop gain scale of the oscillation back-off (1.0 = nominal) */
+        traj_t traj;           /* Setpoint trajectory generator */
+        uint32_t rate_hz;      /* Tick rate */
+        fix16_t target;        /* Commanded target in degrees */
+        fix16_t setpoint;      /* Current setpoint (trajectory reference) in degrees */
+        fix16_t angle;         /* Last measured angle in degrees */
+        fix16_t output;        /* Last output (motor duty, Q16.16) */
+    } controller_t;
+
+    /**
+     * @brief Initialize the controller
+     *
+     * @param[out] ctrl Pointer to controller structure
+     * @param[in] gains Fixed PID gains (used while the schedule is off)
+     * @param[in] rate_hz Tick rate in Hz
+     * @param[in] out_min Output lower limit
+     * @param[in] out_max Output upper limit
+     */
+    void controller_init(controller_t *ctrl, const pid_gains_t *gains, uint32_t rate_hz,
+                         fix16_t out_min, fix16_t out_max);
+
+    /**
+     * @brief Set the fixed PID gains (bumpless)
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] gains New gains
+     */
+    void controller_set_gains(controller_t *ctrl, const pid_gains_t *gains);
+
+    /**
+     * @brief Enable or disable the gain schedule (bumpless)
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] enable 1 to schedule gains from the table, 0 to use the fixed gains
+     */
+    void controller_enable_schedule(controller_t *ctrl, uint8_t enable);
+
+    /**
+     * @brief Enable or disable the feedforward (bumpless)
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] enable 1 to add the feedforward to the output, 0 to disable it
+     */
+    void controller_enable_feedforward(controller_t *ctrl, uint8_t enable);
+
+    /**
+     * @brief Enable or disable the disturbance compensation (bumpless)
+     *
+     * The observer runs in every tick either way, so its estimate is settled
+     * when the compensation is switched on (A/B comparison at runtime).
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] enable 1 to cancel the estimated disturbance, 0 to disable it
+     */
+    void controller_enable_dob(controller_t *ctrl, uint8_t enable);
+
+    /**
+     * @brief Switch between the PID stage and the state feedback
+     *
+     * The state feedback has no integrator, so switching it on is not
+     * bumpless; switching back preloads the PID integrator with the last
+     * output. An empty gain table cannot be enabled.
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] enable 1 to run the state feedback, 0 to run the PID stage
+     */
+    void controller_enable_lqr(controller_t *ctrl, uint8_t enable);
+
+    /**
+     * @brief Select the controller modes that act on the latency-compensated angle
+     *
+     * The PID derivative restarts from the new measurement, so switching the
+     * compensation of the running mode does not kick the output.
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] modes Bit mask of CONTROLLER_PRED_PID and CONTROLLER_PRED_LQR
+     */
+    void controller_enable_predictor(controller_t *ctrl, uint8_t modes);
+
+    /**
+     * @brief Scale the feedback gains of the PID stage and the state feedback (bumpless)
+     *
+     * Applied on top of the fixed, scheduled or tabulated gains until changed
+     * again; the feedforward and the disturbance compensation are not scaled.
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] scale Gain scale (Q16.16, 1.0 = nominal, > 0)
+     */
+    void controller_set_gain_scale(controller_t *ctrl, fix16_t scale);
+
+    /**
+     * @brief Read the active settings as a parameter set
+     *
+     * @param[in] ctrl Pointer to controller structure
+     * @param[out] params Parameter set
+     */
+    void controller_get_params(const controller_t *ctrl, ctrl_params_t *params);
+
+    /**
+     * @brief Apply a complete parameter set (bumpless)
+     *
+     * Meant to be called at a tick boundary with a set taken from the
+     * parameter block. Gains, derivative filter and the switches go through
+     * the bumpless paths; the setpoint only replans when the target changed.
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] params Parameter set
+     */
+    void controller_apply_params(controller_t *ctrl, const ctrl_params_t *params);
+
+    /**
+     * @brief Set the target; the setpoint follows along the trajectory profile
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] setpoint Target in degrees
+     */
+    void controller_set_setpoint(controller_t *ctrl, fix16_t setpoint);
+
+    /**
+     * @brief Reset the controller state
+     *
+     * The trajectory restarts at rest from the measured angle towards the target.
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] angle Measured angle in degrees
+     * @param[in] output Integrator preload (the feedforward is added on top)
+     */
+    void controller_reset(controller_t *ctrl, fix16_t angle, fix16_t output);
+
+    /**
+     * @brief Run one control tick
+     *
+     * @param[in,out] ctrl Pointer to controller structure
+     * @param[in] angle Measured angle in degrees
+     *
+     * @return Motor duty (Q16.16)
+     */
+    fix16_t controller_step(controller_t *ctrl, fix16_t angle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTROLLER_H */
@@ -0,0 +1,135 @@
+/**
+ * @file ctrl_params.h
+ * @brief Double-buffered controller parameter block
+ *
+ * Multi-field settings (gains, limits, target, switches) are changed from the
+ * command side while the control loop keeps running. The command side edits
+ * a private shadow copy and publishes it into one of two slots together with
+ * a new generation number; the control tick picks the newest generation up
+ * at its start and applies it as a whole, so a tick never sees half an update.
+ *
+ * Single writer (command side), single reader (control tick), possibly on
+ * different cores. Only 32-bit loads and stores of the generation counters
+ * are shared, no read-modify-write: the Cortex-M0+ has no exclusive access
+ * instructions and neither side ever waits for the other. Generation g lives
+ * in slot[g & 1]; a publish is refused while the reader may still be copying
+ * the slot it would overwrite, and the shadow simply stays pending until the
+ * next attempt (edits in between are coalesced into one generation).
+ */
+
+#ifndef CTRL_PARAMS_H
+#define CTRL_PARAMS_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+#include "pid.h"
+#include "trajectory.h"
+
+/**
+ * @brief Memory barrier between the slot contents and the generation counters
+ *
+ * The RP2040 has no data cache, so ordering the accesses (compiler and bus)
+ * is all both cores need.
+ */
+#ifndef CTRL_PARAMS_BARRIER
+#define CTRL_PARAMS_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        CTRL_PARAMS_OK = 0,       /* Operation completed successfully */
+        CTRL_PARAMS_ERR_BUSY = -1 /* Previous generation not picked up yet, retry later */
+    } ctrl_params_err_t;
+
+    /**
+     * @brief Controller parameter set (applied as a whole at a tick boundary)
+     */
+    typedef struct
+    {
+        pid_gains_t gains;         /* Fixed PID gains */
+        fix16_t d_alpha;           /* Derivative low-pass coefficient (0-1) */
+        fix16_t i_limit;           /* Integrator limit (output units) */
+        fix16_t target;            /* Target angle (deg) */
+        traj_profile_t profile;    /* Setpoint profile */
+        fix16_t vel_max;           /* Setpoint velocity limit (deg/s) */
+        fix16_t acc_max;           /* Setpoint acceleration limit (deg/s^2) */
+        fix16_t jerk_max;          /* Setpoint jerk limit (deg/s^3) */
+        int32_t ff_k_vel;          /* Feedforward thrust per deg/s (Q8.24) */
+        int32_t ff_k_acc;          /* Feedforward thrust per deg/s^2 (Q8.24) */
+        uint16_t dob_bandwidth;    /* Disturbance observer bandwidth (rad/s) */
+        uint16_t dob_motor_tau_ms; /* Disturbance observer motor lag (ms) */
+        uint8_t sched_enabled;     /* Gain schedule enabled flag */
+        uint8_t ff_enabled;        /* Feedforward enabled flag */
+        uint8_t dob_enabled;       /* Disturbance compensation enabled flag */
+        uint8_t lqr_enabled;       /* State feedback instead of the PID stage */
+        uint32_t pred_delay_us;    /* Measurement latency to compensate (us) */
+        uint8_t pred_modes;        /* Modes acting on the predicted angle (bit mask) */
+    } ctrl_params_t;
+
+    /**
+     * @brief Parameter block shared between the command side and the control tick
+     */
+    typedef struct
+    {
+        ctrl_params_t slot[2]; /* Published sets, generation g in slot[g & 1] */
+        ctrl_params_t shadow;  /* Command-side working copy */
+        volatile uint32_t gen; /* Last published generation (written by the command side) */
+        volatile uint32_t ack; /* Last applied generation (written by the control tick) */
+        uint8_t dirty;         /* Shadow edited since the last publish */
+    } ctrl_params_block_t;
+
+    /**
+     * @brief Initialize the block with the active parameter set (generation 0)
+     *
+     * @param[out] pb Pointer to parameter block
+     * @param[in] params Parameters the controller runs with
+     */
+    void ctrl_params_init(ctrl_params_block_t *pb, const ctrl_params_t *params);
+
+    /**
+     * @brief Shadow copy to edit (command side)
+     *
+     * Marks the shadow as pending; the edits take effect with the next
+     * successful ctrl_params_publish().
+     *
+     * @param[in,out] pb Pointer to parameter block
+     *
+     * @return Pointer to the shadow parameter set
+     */
+    ctrl_params_t *ctrl_params_edit(ctrl_params_block_t *pb);
+
+    /**
+     * @brief Publish the edited shadow as a new generation (command side)
+     *
+     * @param[in,out] pb Pointer to parameter block
+     *
+     * @return CTRL_PARAMS_OK if published or nothing was pending,
+     *         CTRL_PARAMS_ERR_BUSY if the tick has not picked up the previous
+     *         generation yet (the shadow stays pending, call again later)
+     */
+    ctrl_params_err_t ctrl_params_publish(ctrl_params_block_t *pb);
+
+    /**
+     * @brief Take the newest published generation (control tick)
+     *
+     * @param[in,out] pb Pointer to parameter block
+     * @param[out] params Copy of the new parameter set
+     *
+     * @return 1 if a new generation was copied, 0 if nothing changed
+     */
+    uint8_t ctrl_params_acquire(ctrl_params_block_t *pb, ctrl_params_t *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CTRL_PARAMS_H */
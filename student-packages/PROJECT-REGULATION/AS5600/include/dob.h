@@ -0,0 +1,137 @@
+/**
+ * @file dob.h
+ * @brief Disturbance observer for the pendulum
+ *
+ * Extended state observer on the feedforward model of the pendulum
+ * (thrust in gravity units, see feedforward.h):
+ *
+ *   angle'' = (thrust + disturbance - sin(angle - neutral) - k_vel * angle') / k_acc
+ *
+ * The states angle, angular velocity and disturbance are estimated from the
+ * measured angle alone (no numeric differentiation of the quantized angle).
+ * The thrust input follows the applied duty through the forward thrust table
+ * and a first-order motor lag. All three observer poles sit at -bandwidth, so
+ * the disturbance estimate follows an external torque (a manual push) with a
+ * delay of roughly 3 / bandwidth.
+ *
+ * The estimate is fed forward by the controller as a duty correction. The
+ * states are kept in Q32.32 so the small per-tick increments at 1 kHz are
+ * not lost; one update costs a sine lookup, a table bisection, one 64-bit
+ * division and a handful of 64-bit multiplications.
+ */
+
+#ifndef DOB_H
+#define DOB_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+#include "feedforward.h"
+
+/**
+ * @brief Default observer settings
+ */
+#define DOB_BANDWIDTH_DEFAULT 50    /* rad/s */
+#define DOB_MOTOR_TAU_MS_DEFAULT 60 /* ms */
+#define DOB_MOTOR_TAU_MS_MAX 1000   /* ms */
+
+/**
+ * @brief Highest bandwidth as a fraction of the tick rate (keeps the forward Euler update accurate)
+ */
+#define DOB_BANDWIDTH_RATE_DIVIDER 8
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        DOB_OK = 0,                /* Operation completed successfully */
+        DOB_ERR_INVALID_PARAM = -1 /* Invalid parameter */
+    } dob_err_t;
+
+    /**
+     * @brief Disturbance observer structure
+     */
+    typedef struct
+    {
+        uint32_t rate_hz;      /* Tick rate */
+        uint16_t bandwidth;    /* Observer bandwidth (rad/s) */
+        uint16_t motor_tau_ms; /* Modelled motor time constant (0 = no lag) */
+        int64_t l_pos;         /* Angle correction per tick (Q32.32) */
+        int64_t l_vel;         /* Velocity correction per tick (1/s, Q32.32) */
+        int64_t l_dist;        /* Disturbance correction per tick (gravity units per deg, Q32.32) */
+        int64_t dt;            /* Tick period (s, Q32.32) */
+        int64_t b;             /* Acceleration per tick per gravity unit (deg/s, Q32.32) */
+        int32_t k_acc;         /* Model inertia the gains were computed for (Q8.24) */
+        fix16_t lag;           /* Motor lag filter coefficient per tick */
+        int64_t pos;           /* Estimated angle (deg, Q32.32) */
+        int64_t vel;           /* Estimated velocity (deg/s, Q32.32) */
+        int64_t dist;          /* Estimated disturbance (gravity units, Q32.32) */
+        fix16_t thrust;        /* Modelled thrust after the motor lag (gravity units) */
+        fix16_t estimate;      /* Last disturbance estimate (gravity units) */
+    } dob_t;
+
+    /**
+     * @brief Initialize the observer with the default settings
+     *
+     * @param[out] dob Pointer to observer structure
+     * @param[in] rate_hz Tick rate in Hz
+     */
+    void dob_init(dob_t *dob, uint32_t rate_hz);
+
+    /**
+     * @brief Set the observer bandwidth and the modelled motor lag
+     *
+     * @param[in,out] dob Pointer to observer structure
+     * @param[in] bandwidth Observer bandwidth in rad/s (1 to rate_hz / DOB_BANDWIDTH_RATE_DIVIDER)
+     * @param[in] motor_tau_ms Motor time constant in ms (0 to DOB_MOTOR_TAU_MS_MAX)
+     *
+     * @return DOB_OK on success, DOB_ERR_INVALID_PARAM if out of range (unchanged)
+     */
+    dob_err_t dob_configure(dob_t *dob, uint16_t bandwidth, uint16_t motor_tau_ms);
+
+    /**
+     * @brief Restart the observer at rest
+     *
+     * @param[in,out] dob Pointer to observer structure
+     * @param[in] angle Measured angle in degrees
+     * @param[in] thrust Thrust of the current duty (gravity units)
+     */
+    void dob_reset(dob_t *dob, fix16_t angle, fix16_t thrust);
+
+    /**
+     * @brief Run one observer tick
+     *
+     * @param[in,out] dob Pointer to observer structure
+     * @param[in] ff Model (neutral, thrust table, velocity and inertia coefficients)
+     * @param[in] angle Measured angle in degrees
+     * @param[in] duty Duty applied since the previous tick
+     *
+     * @return Disturbance estimate (gravity units, positive acts like extra thrust)
+     */
+    fix16_t dob_update(dob_t *dob, const feedforward_t *ff, fix16_t angle, fix16_t duty);
+
+    /**
+     * @brief Duty correction cancelling the estimated disturbance
+     *
+     * The thrust correction is converted through the thrust table around the
+     * operating duty, so it follows the local slope of the thrust curve.
+     *
+     * @param[in] dob Pointer to observer structure
+     * @param[in] ff Thrust table
+     * @param[in] duty Operating duty
+     *
+     * @return Duty to add to the operating duty
+     */
+    fix16_t dob_correction(const dob_t *dob, const feedforward_t *ff, fix16_t duty);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOB_H */
@@ -0,0 +1,174 @@
+/**
+ * @file feedforward.h
+ * @brief Gravity and thrust feedforward for the pendulum
+ *
+ * Holding the pendulum at an angle needs a static thrust proportional to
+ * sin(angle - neutral). Thrust is expressed in "gravity units": 1.0 is the
+ * thrust that holds the pendulum 90 degrees away from the neutral position.
+ * A calibrated inverse table maps the required thrust to a motor duty, which
+ * takes care of the roughly quadratic thrust(PWM) curve and the dead zone.
+ * While following a trajectory, the thrust for the reference velocity
+ * (damping) and acceleration (inertia) is added on top.
+ */
+
+#ifndef FEEDFORWARD_H
+#define FEEDFORWARD_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Number of points of the thrust -> duty table
+ */
+#define FF_THRUST_POINTS 17
+
+/**
+ * @brief Maximum number of calibration points accepted by ff_build_table()
+ */
+#define FF_CAL_MAX_POINTS 32
+
+/**
+ * @brief Conversion of the velocity/acceleration coefficients to Q8.24
+ */
+#define FF_K_FROM_FLOAT(x) ((int32_t)((x) * 16777216.0f))
+#define FF_K_TO_FLOAT(x) ((float)(x) / 16777216.0f)
+#define FF_K_FLOAT_LIMIT 128.0f /* FF_K_FROM_FLOAT() needs a smaller magnitude */
+
+/**
+ * @brief Default acceleration coefficient: g / l for a ~0.2 m arm is ~2800 deg/s^2
+ * per gravity unit
+ */
+#define FF_K_ACC_DEFAULT FF_K_FROM_FLOAT(0.00035)
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        FF_OK = 0,                 /* Operation completed successfully */
+        FF_ERR_INVALID_PARAM = -1, /* Invalid parameter */
+        FF_ERR_NO_RANGE = -2,      /* Calibration data has no usable thrust range */
+        FF_ERR_NO_DEADZONE = -3    /* First point already moved the pendulum: no zero-thrust duty */
+    } ff_err_t;
+
+    /**
+     * @brief Feedforward structure
+     */
+    typedef struct
+    {
+        fix16_t neutral;                /* Angle with zero gravity torque (degrees) */
+        fix16_t gain;                   /* Feedforward scale (0-1) */
+        fix16_t thrust_max;             /* Thrust at the last table point (gravity units) */
+        fix16_t inv_step;               /* (FF_THRUST_POINTS - 1) / thrust_max */
+        fix16_t duty[FF_THRUST_POINTS]; /* Duty at thrust = i * thrust_max / (FF_THRUST_POINTS - 1) */
+        int32_t k_vel;                  /* Thrust per deg/s (gravity units, Q8.24) */
+        int32_t k_acc;                  /* Thrust per deg/s^2 (gravity units, Q8.24) */
+    } feedforward_t;
+
+    /**
+     * @brief Initialize the feedforward with an uncalibrated quadratic thrust model
+     *
+     * Assumes thrust = thrust_max * duty^2 until a calibration sweep replaces the table.
+     * The velocity coefficient starts at 0, the acceleration one at FF_K_ACC_DEFAULT.
+     *
+     * @param[out] ff Pointer to feedforward structure
+     * @param[in] neutral Angle with zero gravity torque (degrees)
+     * @param[in] thrust_max Thrust at full duty (gravity units)
+     */
+    void ff_init(feedforward_t *ff, fix16_t neutral, fix16_t thrust_max);
+
+    /**
+     * @brief Build the thrust -> duty table from a calibration sweep
+     *
+     * At each equilibrium of the sweep the thrust equals sin(angle - neutral).
+     * Points must be ordered by increasing duty. The last point before the
+     * first one outside the dead zone anchors zero thrust, so the sweep must
+     * start inside the dead zone; later points that do not increase the
+     * thrust (noise) are skipped.
+     *
+     * @param[in,out] ff Pointer to feedforward structure
+     * @param[in] duty Applied duties (Q16.16)
+     * @param[in] angle Settled angles in degrees (Q16.16)
+     * @param[in] count Number of points
+     *
+     * @return FF_OK on success, error code on failure (table unchanged)
+     */
+    ff_err_t ff_build_table(feedforward_t *ff, const fix16_t *duty, const fix16_t *angle, uint8_t count);
+
+    /**
+     * @brief Thrust needed to hold an angle against gravity
+     *
+     * @param[in] ff Pointer to feedforward structure
+     * @param[in] angle Angle in degrees (Q16.16)
+     *
+     * @return Thrust in gravity units (Q16.16)
+     */
+    fix16_t ff_gravity_thrust(const feedforward_t *ff, fix16_t angle);
+
+    /**
+     * @brief Duty producing a thrust (inverse table lookup)
+     *
+     * @param[in] ff Pointer to feedforward structure
+     * @param[in] thrust Thrust in gravity units (Q16.16); non-positive thrust gives 0
+     *
+     * @return Motor duty (Q16.16)
+     */
+    fix16_t ff_thrust_to_duty(const feedforward_t *ff, fix16_t thrust);
+
+    /**
+     * @brief Thrust produced by a duty (forward table lookup)
+     *
+     * @param[in] ff Pointer to feedforward structure
+     * @param[in] duty Motor duty (Q16.16); duties in the dead zone give 0
+     *
+     * @return Thrust in gravity units (Q16.16), thrust_max above the table
+     */
+    fix16_t ff_duty_to_thrust(const feedforward_t *ff, fix16_t duty);
+
+    /**
+     * @brief Set the velocity and acceleration coefficients
+     *
+     * @param[in,out] ff Pointer to feedforward structure
+     * @param[in] k_vel Thrust per deg/s (gravity units, Q8.24)
+     * @param[in] k_acc Thrust per deg/s^2 (gravity units, Q8.24)
+     */
+    void ff_set_dynamics(feedforward_t *ff, int32_t k_vel, int32_t k_acc);
+
+    /**
+     * @brief Thrust for a reference position, velocity and acceleration
+     *
+     * Gravity plus the damping and inertia thrust of the reference motion,
+     * not scaled by the feedforward gain.
+     *
+     * @param[in] ff Pointer to feedforward structure
+     * @param[in] pos Reference angle in degrees (Q16.16)
+     * @param[in] vel Reference velocity in deg/s (Q16.16)
+     * @param[in] acc Reference acceleration in deg/s^2 (Q16.16)
+     *
+     * @return Thrust in gravity units (Q16.16)
+     */
+    fix16_t ff_reference_thrust(const feedforward_t *ff, fix16_t pos, fix16_t vel, fix16_t acc);
+
+    /**
+     * @brief Feedforward duty for a reference position, velocity and acceleration
+     *
+     * @param[in] ff Pointer to feedforward structure
+     * @param[in] pos Reference angle in degrees (Q16.16)
+     * @param[in] vel Reference velocity in deg/s (Q16.16)
+     * @param[in] acc Reference acceleration in deg/s^2 (Q16.16)
+     *
+     * @return Motor duty (Q16.16), scaled by the feedforward gain
+     */
+    fix16_t ff_eval(const feedforward_t *ff, fix16_t pos, fix16_t vel, fix16_t acc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FEEDFORWARD_H */
@@ -0,0 +1,180 @@
+/**
+ * @file fixed.h
+ * @brief Q16.16 fixed-point helpers for the control path
+ *
+ * The RP2040 Cortex-M0+ has no FPU, so every float operation in the control
+ * tick ends up in a soft-float routine. All control code works on Q16.16
+ * values instead (angles in degrees, motor command as a fraction of full scale).
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Q16.16 constants
+ */
+#define FIX16_SHIFT 16
+#define FIX16_ONE (1 << FIX16_SHIFT)
+#define FIX16_HALF (1 << (FIX16_SHIFT - 1))
+#define FIX16_MAX INT32_MAX
+#define FIX16_MIN INT32_MIN
+
+/**
+ * @brief Conversion macros (intended for compile-time constants)
+ */
+#define FIX16_FROM_INT(x) ((fix16_t)((x) * FIX16_ONE))
+#define FIX16_FROM_FLOAT(x) ((fix16_t)((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+#define FIX16_TO_FLOAT(x) ((float)(x) / 65536.0f)
+#define FIX16_TO_INT(x) ((int32_t)((x) >> FIX16_SHIFT))
+
+    /**
+     * @brief Signed Q16.16 fixed-point value
+     */
+    typedef int32_t fix16_t;
+
+    /**
+     * @brief Saturate a 64-bit intermediate to the Q16.16 range
+     *
+     * @param[in] x Value to saturate
+     *
+     * @return Saturated value
+     */
+    static inline fix16_t fix16_sat(int64_t x)
+    {
+        if (x > FIX16_MAX)
+        {
+            return FIX16_MAX;
+        }
+        if (x < FIX16_MIN)
+        {
+            return FIX16_MIN;
+        }
+        return (fix16_t)x;
+    }
+
+    /**
+     * @brief Multiply two Q16.16 values (rounded, saturated)
+     */
+    static inline fix16_t fix16_mul(fix16_t a, fix16_t b)
+    {
+        return fix16_sat(((int64_t)a * b + FIX16_HALF) >> FIX16_SHIFT);
+    }
+
+    /**
+     * @brief Divide two Q16.16 values (saturated, b must not be 0)
+     */
+    static inline fix16_t fix16_div(fix16_t a, fix16_t b)
+    {
+        return fix16_sat((int64_t)a * FIX16_ONE / b);
+    }
+
+    /**
+     * @brief Saturating addition of two Q16.16 values
+     */
+    static inline fix16_t fix16_add(fix16_t a, fix16_t b)
+    {
+        return fix16_sat((int64_t)a + b);
+    }
+
+    /**
+     * @brief Clamp a Q16.16 value between a minimum and maximum
+     */
+    static inline fix16_t fix16_clamp(fix16_t x, fix16_t min, fix16_t max)
+    {
+        return x < min ? min : (x > max ? max : x);
+    }
+
+    /**
+     * @brief Absolute value of a Q16.16 value
+     */
+    static inline fix16_t fix16_abs(fix16_t x)
+    {
+        return x < 0 ? -x : x;
+    }
+
+    /**
+     * @brief Linear interpolation a + (b - a) * t, with t in [0, 1] as Q16.16
+     */
+    static inline fix16_t fix16_lerp(fix16_t a, fix16_t b, fix16_t t)
+    {
+        return (fix16_t)(a + (((int64_t)(b - a) * t) >> FIX16_SHIFT));
+    }
+
+    /**
+     * @brief Wrap an angle in degrees (Q16.16) into the range [-180, 180)
+     */
+    static inline fix16_t fix16_wrap_deg(fix16_t deg)
+    {
+        const fix16_t full = FIX16_FROM_INT(360);
+        const fix16_t half = FIX16_FROM_INT(180);
+
+        while (deg >= half)
+        {
+            deg -= full;
+        }
+        while (deg < -half)
+        {
+            deg += full;
+        }
+        return deg;
+    }
+
+    /**
+     * @brief Sine of an angle in degrees (lookup table, see fixed.c)
+     *
+     * @param[in] deg Angle in degrees (Q16.16)
+     *
+     * @return sin(deg) in Q16.16
+     */
+    fix16_t fix16_sin_deg(fix16_t deg);
+
+    /**
+     * @brief Cosine of an angle in degrees (lookup table, see fixed.c)
+     *
+     * @param[in] deg Angle in degrees (Q16.16)
+     *
+     * @return cos(deg) in Q16.16
+     */
+    fix16_t fix16_cos_deg(fix16_t deg);
+
+    /**
+     * @brief Integer square root of a 64-bit value (see fixed.c)
+     *
+     * The square root of a Q32.32 value is its Q16.16 square root.
+     *
+     * @param[in] x Value
+     *
+     * @return floor(sqrt(x))
+     */
+    uint32_t fix16_isqrt64(uint64_t x);
+
+    /**
+     * @brief Base-2 logarithm of a Q16.16 value (see fixed.c)
+     *
+     * @param[in] x Value (must be > 0)
+     *
+     * @return log2(x) in Q16.16
+     */
+    fix16_t fix16_log2(fix16_t x);
+
+    /**
+     * @brief Base-2 exponential of a Q16.16 value (see fixed.c)
+     *
+     * @param[in] x Exponent
+     *
+     * @return 2^x in Q16.16 (saturated)
+     */
+    fix16_t fix16_exp2(fix16_t x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIXED_H */
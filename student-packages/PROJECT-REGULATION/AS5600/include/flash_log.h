@@ -0,0 +1,268 @@
+/**
+ * @file flash_log.h
+ * @brief Log-structured record logger for NOR flash
+ *
+ * Appends short records to a flash region for sessions longer than any RAM
+ * buffer and independent of the USB link. Records (up to
+ * FLASH_LOG_RECORD_MAX bytes, opaque to the logger) are packed into a page
+ * buffer; a full page gets a header
+ *
+ *   magic (LE16) | sequence number (LE32) | used bytes (LE16) | CRC-16 (LE16)
+ *
+ * and is queued for programming. Page n of the log always lives at page
+ * n % pages of the region, so the log is a ring over the whole region: every
+ * sector is erased once per lap, which levels the wear without any mapping
+ * table. The writer keeps the next sector erased ahead of the page being
+ * filled; the oldest sector is given up for it.
+ *
+ * Flash operations only ever start in flash_log_poll() and are polled for
+ * completion, never waited for, so neither an append nor the poll blocks:
+ * pages wait in a queue of FLASH_LOG_QUEUE pages while an erase runs, and a
+ * record that finds the queue full is dropped and counted. At start-up the
+ * region is scanned for the newest page; a new session starts at the next
+ * sector boundary, so a page torn by a power loss is never programmed over.
+ *
+ * Like the drivers, the module is platform-independent: the user provides
+ * functions that start an erase or a page program, report whether the flash
+ * is busy, and read.
+ */
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Flash geometry (program page and erase sector)
+ */
+#define FLASH_LOG_PAGE_SIZE 256
+#define FLASH_LOG_SECTOR_SIZE 4096
+#define FLASH_LOG_PAGES_PER_SECTOR (FLASH_LOG_SECTOR_SIZE / FLASH_LOG_PAGE_SIZE)
+
+/**
+ * @brief Page layout
+ */
+#define FLASH_LOG_MAGIC 0x4C46
+#define FLASH_LOG_HEADER_SIZE 10
+#define FLASH_LOG_PAYLOAD_SIZE (FLASH_LOG_PAGE_SIZE - FLASH_LOG_HEADER_SIZE)
+
+/**
+ * @brief Longest record (stored with a length byte)
+ */
+#define FLASH_LOG_RECORD_MAX 64
+
+/**
+ * @brief Full pages waiting for programming
+ */
+#define FLASH_LOG_QUEUE 8
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        FLASH_LOG_OK = 0,                 /* Operation completed successfully */
+        FLASH_LOG_ERR_INVALID_PARAM = -1, /* Invalid parameter or region */
+        FLASH_LOG_ERR_STOPPED = -2,       /* Logging not started */
+        FLASH_LOG_ERR_FULL = -3,          /* Page queue full, record dropped */
+        FLASH_LOG_ERR_BUSY = -4,          /* Flash operation or queued pages pending */
+        FLASH_LOG_ERR_END = -5            /* No more records */
+    } flash_log_err_t;
+
+    /**
+     * @brief Function pointer to start erasing one sector (returns without waiting)
+     *
+     * @param[in] addr Region-relative sector address
+     * @param[in] intf_ptr Interface context given to flash_log_init()
+     *
+     * @return 0 on success, non-zero on failure
+     */
+    typedef int8_t (*flash_log_erase_fptr_t)(uint32_t addr, void *intf_ptr);
+
+    /**
+     * @brief Function pointer to start programming one page (returns without waiting)
+     *
+     * @param[in] addr Region-relative page address
+     * @param[in] data FLASH_LOG_PAGE_SIZE bytes
+     * @param[in] intf_ptr Interface context given to flash_log_init()
+     *
+     * @return 0 on success, non-zero on failure
+     */
+    typedef int8_t (*flash_log_program_fptr_t)(uint32_t addr, const uint8_t *data, void *intf_ptr);
+
+    /**
+     * @brief Function pointer to check for a running erase or program
+     *
+     * @param[in] intf_ptr Interface context given to flash_log_init()
+     *
+     * @return Non-zero while the flash is busy
+     */
+    typedef uint8_t (*flash_log_busy_fptr_t)(void *intf_ptr);
+
+    /**
+     * @brief Function pointer to read (only called while the flash is not busy)
+     *
+     * @param[in] addr Region-relative address
+     * @param[out] data Output
+     * @param[in] len Number of bytes
+     * @param[in] intf_ptr Interface context given to flash_log_init()
+     */
+    typedef void (*flash_log_read_fptr_t)(uint32_t addr, uint8_t *data, uint32_t len, void *intf_ptr);
+
+    /**
+     * @brief Platform functions
+     */
+    typedef struct
+    {
+        flash_log_erase_fptr_t erase;     /* Start a sector erase */
+        flash_log_program_fptr_t program; /* Start a page program */
+        flash_log_busy_fptr_t busy;       /* Operation in progress */
+        flash_log_read_fptr_t read;       /* Read */
+    } flash_log_ops_t;
+
+    /**
+     * @brief Logger structure
+     */
+    typedef struct
+    {
+        flash_log_ops_t ops;                                 /* Platform functions */
+        void *intf_ptr;                                      /* Interface context */
+        uint32_t pages;                                      /* Pages in the region */
+        uint32_t next_seq;                                   /* Sequence number of the page being filled */
+        uint32_t erased_to;                                  /* Pages below this sequence number are writable */
+        uint8_t running;                                     /* Appending enabled */
+        uint8_t op_busy;                                     /* Erase or program started, not yet complete */
+        uint8_t fill[FLASH_LOG_PAGE_SIZE];                   /* Page being filled */
+        uint16_t fill_len;                                   /* Record bytes in fill */
+        uint8_t queue[FLASH_LOG_QUEUE][FLASH_LOG_PAGE_SIZE]; /* Full pages waiting for programming */
+        uint8_t q_head;                                      /* Next free queue slot */
+        uint8_t q_count;                                     /* Pages in the queue */
+        uint32_t records;                                    /* Records appended */
+        uint32_t dropped;                                    /* Records dropped (queue full) */
+        uint32_t programs;                                   /* Pages programmed */
+        uint32_t erases;                                     /* Sectors erased */
+    } flash_log_t;
+
+    /**
+     * @brief Position of a read-out
+     */
+    typedef struct
+    {
+        uint32_t seq;                      /* Sequence number of the next page to read */
+        uint32_t end;                      /* Sequence number after the newest page */
+        uint16_t pos;                      /* Read position in the page payload */
+        uint16_t used;                     /* Record bytes of the page */
+        uint8_t page[FLASH_LOG_PAGE_SIZE]; /* Page loaded */
+        uint32_t corrupt;                  /* Pages or records skipped as corrupt */
+    } flash_log_reader_t;
+
+    /**
+     * @brief Initialize the logger and find the end of the log in the region
+     *
+     * @param[out] log Pointer to logger structure
+     * @param[in] ops Platform functions (copied)
+     * @param[in] size Region size in bytes (a multiple of FLASH_LOG_SECTOR_SIZE, at least two sectors)
+     * @param[in] intf_ptr Interface context passed to the platform functions
+     *
+     * @return FLASH_LOG_OK on success, FLASH_LOG_ERR_INVALID_PARAM on invalid parameters
+     */
+    flash_log_err_t flash_log_init(flash_log_t *log, const flash_log_ops_t *ops, uint32_t size, void *intf_ptr);
+
+    /**
+     * @brief Enable appending (the sector ahead is erased in the background)
+     *
+     * @param[in,out] log Pointer to logger structure
+     */
+    void flash_log_start(flash_log_t *log);
+
+    /**
+     * @brief Disable appending and queue the partly filled page
+     *
+     * @param[in,out] log Pointer to logger structure
+     */
+    void flash_log_stop(flash_log_t *log);
+
+    /**
+     * @brief Forget the whole log: later read-outs start after this point
+     *
+     * The old pages stay in flash but fall out of the log window; an empty
+     * page marks the point so the clear survives a restart once it has been
+     * programmed.
+     *
+     * @param[in,out] log Pointer to logger structure
+     */
+    void flash_log_clear(flash_log_t *log);
+
+    /**
+     * @brief Append one record (never waits)
+     *
+     * @param[in,out] log Pointer to logger structure
+     * @param[in] data Record
+     * @param[in] len Record length (1 - FLASH_LOG_RECORD_MAX)
+     *
+     * @return FLASH_LOG_OK if buffered, FLASH_LOG_ERR_STOPPED if not started,
+     *         FLASH_LOG_ERR_FULL if the page queue is full (record dropped),
+     *         FLASH_LOG_ERR_INVALID_PARAM for a bad length
+     */
+    flash_log_err_t flash_log_append(flash_log_t *log, const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief Advance the flash operations: start the next program or erase once the flash is idle
+     *
+     * Call often (e.g. every pass of the main loop); returns at once.
+     *
+     * @param[in,out] log Pointer to logger structure
+     */
+    void flash_log_poll(flash_log_t *log);
+
+    /**
+     * @brief Check that nothing is pending (stopped, queue empty, flash idle)
+     *
+     * @param[in] log Pointer to logger structure
+     *
+     * @return 1 if idle, 0 otherwise
+     */
+    uint8_t flash_log_idle(const flash_log_t *log);
+
+    /**
+     * @brief Number of pages the log currently spans
+     *
+     * @param[in] log Pointer to logger structure
+     *
+     * @return Page count (including pages never written or skipped)
+     */
+    uint32_t flash_log_span(const flash_log_t *log);
+
+    /**
+     * @brief Start reading the log from the oldest record (logger must be idle)
+     *
+     * @param[in] log Pointer to logger structure
+     * @param[out] rd Pointer to reader structure
+     *
+     * @return FLASH_LOG_OK on success, FLASH_LOG_ERR_BUSY if the logger is not idle
+     */
+    flash_log_err_t flash_log_read_begin(const flash_log_t *log, flash_log_reader_t *rd);
+
+    /**
+     * @brief Read the next record
+     *
+     * @param[in] log Pointer to logger structure
+     * @param[in,out] rd Pointer to reader structure
+     * @param[out] data Pointer set to the record (valid until the next call)
+     * @param[out] len Record length
+     *
+     * @return FLASH_LOG_OK if a record was read, FLASH_LOG_ERR_END at the end of the log
+     */
+    flash_log_err_t flash_log_read_next(const flash_log_t *log, flash_log_reader_t *rd, const uint8_t **data,
+                                        uint8_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_LOG_H */
@@ -0,0 +1,151 @@
+/**
+ * @file fmt.h
+ * @brief Integer and fixed-point text formatting without printf
+ *
+ * The text log (CSV and serial-plotter lines) used printf with "%.2f" on
+ * Q16.16 values converted to float: on the Cortex-M0+ every such value goes
+ * through the soft-float conversion and the float formatter. These functions
+ * append integers, Q16.16 values, strings and "name:value" pairs to a
+ * caller-supplied line buffer with integer arithmetic only: no varargs, no
+ * floats, no format string to parse.
+ *
+ * The output is the same, character for character, as printf("%.*f") of
+ * FIX16_TO_FLOAT(value): the float conversion keeps 24 significant bits, and
+ * the decimal rounding is exact, ties to even, as in the C library.
+ *
+ * A line that does not fit is cut off and reported by fmt_end(); the buffer
+ * always stays null-terminated.
+ */
+
+#ifndef FMT_H
+#define FMT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Most decimal places of fmt_fix16() and fmt_decimal()
+ */
+#define FMT_DECIMALS_MAX 9
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        FMT_OK = 0,           /* Line complete */
+        FMT_ERR_OVERFLOW = -1 /* Line cut off at the end of the buffer */
+    } fmt_err_t;
+
+    /**
+     * @brief Line being formatted
+     */
+    typedef struct
+    {
+        char *buf;        /* Caller's buffer */
+        uint16_t size;    /* Buffer size including the terminator */
+        uint16_t len;     /* Characters written */
+        uint8_t overflow; /* Something did not fit */
+    } fmt_line_t;
+
+    /**
+     * @brief Start a line in a buffer
+     *
+     * @param[out] line Pointer to line structure
+     * @param[in] buf Buffer (at least one byte)
+     * @param[in] size Buffer size in bytes
+     */
+    void fmt_init(fmt_line_t *line, char *buf, uint16_t size);
+
+    /**
+     * @brief Append a character
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] c Character
+     */
+    void fmt_char(fmt_line_t *line, char c);
+
+    /**
+     * @brief Append a null-terminated string
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] s String
+     */
+    void fmt_str(fmt_line_t *line, const char *s);
+
+    /**
+     * @brief Append an unsigned integer (as printf "%lu")
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] value Value
+     */
+    void fmt_u32(fmt_line_t *line, uint32_t value);
+
+    /**
+     * @brief Append a signed integer (as printf "%ld")
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] value Value
+     */
+    void fmt_i32(fmt_line_t *line, int32_t value);
+
+    /**
+     * @brief Append a Q16.16 value (as printf "%.*f" of FIX16_TO_FLOAT(value))
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] value Q16.16 value
+     * @param[in] decimals Decimal places (up to FMT_DECIMALS_MAX)
+     */
+    void fmt_fix16(fmt_line_t *line, fix16_t value, uint8_t decimals);
+
+    /**
+     * @brief Append an integer in units of 10^-decimals (e.g. centidegrees with 2)
+     *
+     * Same as printf "%.*f" of value / 10^decimals computed in float for
+     * |value| below 2^23.
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] value Value in units of 10^-decimals
+     * @param[in] decimals Decimal places (up to FMT_DECIMALS_MAX)
+     */
+    void fmt_decimal(fmt_line_t *line, int32_t value, uint8_t decimals);
+
+    /**
+     * @brief Append a serial-plotter pair ">name:value" (first) or ",name:value" (Q16.16 value)
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] name Variable name
+     * @param[in] value Q16.16 value
+     * @param[in] decimals Decimal places
+     */
+    void fmt_plot_fix16(fmt_line_t *line, const char *name, fix16_t value, uint8_t decimals);
+
+    /**
+     * @brief Append a serial-plotter pair ">name:value" (first) or ",name:value" (integer value)
+     *
+     * @param[in,out] line Pointer to line structure
+     * @param[in] name Variable name
+     * @param[in] value Value
+     */
+    void fmt_plot_u32(fmt_line_t *line, const char *name, uint32_t value);
+
+    /**
+     * @brief Finish a line
+     *
+     * @param[in] line Pointer to line structure
+     *
+     * @return FMT_OK if everything fit, FMT_ERR_OVERFLOW if the line was cut off
+     */
+    fmt_err_t fmt_end(const fmt_line_t *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FMT_H */
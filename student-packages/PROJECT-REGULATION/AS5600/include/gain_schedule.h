@@ -0,0 +1,118 @@
+/**
+ * @file gain_schedule.h
+ * @brief Angle-scheduled PID gain table
+ *
+ * Gravity torque scales with sin(angle) and propeller thrust is roughly
+ * quadratic in PWM, so the loop gain of the pendulum changes with the operating
+ * point. The schedule holds a small table of gain sets indexed by angle and
+ * blends between neighbouring entries with a smoothstep, so the gains (and
+ * their slope) are continuous as the operating point moves.
+ */
+
+#ifndef GAIN_SCHEDULE_H
+#define GAIN_SCHEDULE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+#include "pid.h"
+
+/**
+ * @brief Maximum number of table entries
+ */
+#define GAIN_SCHED_MAX_POINTS 8
+
+/**
+ * @brief Default low-pass coefficient of the scheduling variable (Q16.16)
+ */
+#define GAIN_SCHED_ALPHA_DEFAULT FIX16_FROM_FLOAT(0.05)
+
+    /**
+     * @brief Variable the table is indexed by
+     */
+    typedef enum
+    {
+        GAIN_SCHED_SRC_SETPOINT = 0, /* Scheduled on the setpoint */
+        GAIN_SCHED_SRC_ANGLE = 1     /* Scheduled on the measured angle */
+    } gain_sched_source_t;
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        GAIN_SCHED_OK = 0,                 /* Operation completed successfully */
+        GAIN_SCHED_ERR_INVALID_PARAM = -1, /* Invalid parameter */
+        GAIN_SCHED_ERR_FULL = -2           /* Table is full */
+    } gain_sched_err_t;
+
+    /**
+     * @brief Gain schedule structure
+     */
+    typedef struct
+    {
+        fix16_t angle[GAIN_SCHED_MAX_POINTS];       /* Breakpoints in degrees, strictly increasing */
+        fix16_t inv_width[GAIN_SCHED_MAX_POINTS];   /* 1 / (angle[i + 1] - angle[i]) */
+        pid_gains_t gains[GAIN_SCHED_MAX_POINTS];   /* Gains as entered */
+        pid_coeffs_t coeffs[GAIN_SCHED_MAX_POINTS]; /* Gains discretized for the tick rate */
+        uint8_t count;                              /* Number of entries */
+        uint8_t seg;                                /* Cached segment of the last lookup */
+        uint8_t primed;                             /* Scheduling variable initialized */
+        gain_sched_source_t source;                 /* Scheduling variable */
+        fix16_t alpha;                              /* Scheduling variable low-pass coefficient */
+        fix16_t var;                                /* Filtered scheduling variable */
+        uint32_t rate_hz;                           /* Tick rate used for discretization */
+    } gain_sched_t;
+
+    /**
+     * @brief Initialize an empty gain schedule
+     *
+     * @param[out] sched Pointer to schedule structure
+     * @param[in] source Scheduling variable
+     * @param[in] rate_hz Tick rate of the controller
+     */
+    void gain_sched_init(gain_sched_t *sched, gain_sched_source_t source, uint32_t rate_hz);
+
+    /**
+     * @brief Insert or replace a table entry
+     *
+     * Entries are kept sorted by angle; an entry with the same angle is replaced.
+     *
+     * @param[in,out] sched Pointer to schedule structure
+     * @param[in] angle Breakpoint in degrees
+     * @param[in] gains Gains at the breakpoint
+     *
+     * @return GAIN_SCHED_OK on success, error code on failure
+     */
+    gain_sched_err_t gain_sched_set_point(gain_sched_t *sched, fix16_t angle, const pid_gains_t *gains);
+
+    /**
+     * @brief Remove all table entries
+     *
+     * @param[in,out] sched Pointer to schedule structure
+     */
+    void gain_sched_clear(gain_sched_t *sched);
+
+    /**
+     * @brief Evaluate the schedule for the current tick
+     *
+     * Outside the table the first/last entry is held.
+     *
+     * @param[in,out] sched Pointer to schedule structure
+     * @param[in] var Scheduling variable in degrees (setpoint or angle, see source)
+     * @param[out] coeffs Interpolated coefficients
+     *
+     * @return GAIN_SCHED_OK on success, GAIN_SCHED_ERR_INVALID_PARAM for an empty table
+     */
+    gain_sched_err_t gain_sched_eval(gain_sched_t *sched, fix16_t var, pid_coeffs_t *coeffs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAIN_SCHEDULE_H */
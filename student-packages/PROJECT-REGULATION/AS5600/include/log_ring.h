@@ -0,0 +1,140 @@
+/**
+ * @file log_ring.h
+ * @brief Wait-free single-producer single-consumer ring of log records
+ *
+ * printf in the control tick waits whenever the USB host does not read fast
+ * enough. Instead, the tick pushes fixed-size records into a ring and the
+ * output side (the main loop, possibly on the other core) pops them and
+ * formats them as far as the output has room.
+ *
+ * One producer, one consumer, possibly on different cores. As in
+ * ctrl_params.h, only 32-bit loads and stores of the free-running indices
+ * are shared, no read-modify-write, and neither side ever waits:
+ *
+ *   - LOG_RING_DROP_NEWEST: a push into a full ring is refused and counted;
+ *     the records already queued are kept.
+ *   - LOG_RING_DROP_OLDEST: a push always succeeds and overwrites the oldest
+ *     record. The consumer notices the overrun from the head index, skips
+ *     what was overwritten and re-checks the head after copying a record,
+ *     discarding the copy if the producer may have written into it meanwhile.
+ *
+ * Either way the lost records are counted (log_ring_dropped()).
+ */
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Memory barrier between the record contents and the indices
+ *
+ * The RP2040 has no data cache, so ordering the accesses (compiler and bus)
+ * is all both cores need.
+ */
+#ifndef LOG_RING_BARRIER
+#define LOG_RING_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+/**
+ * @brief Values carried by one record
+ */
+#define LOG_RING_VALUES 8
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        LOG_RING_OK = 0,                 /* Operation completed successfully */
+        LOG_RING_ERR_INVALID_PARAM = -1, /* Capacity not a power of two */
+        LOG_RING_ERR_FULL = -2,          /* Ring full, record dropped (drop-newest policy) */
+        LOG_RING_ERR_EMPTY = -3          /* No record to pop */
+    } log_ring_err_t;
+
+    /**
+     * @brief What to drop when the consumer falls behind
+     */
+    typedef enum
+    {
+        LOG_RING_DROP_NEWEST = 0, /* Refuse new records, keep the queued ones */
+        LOG_RING_DROP_OLDEST = 1  /* Overwrite the oldest records, keep the latest */
+    } log_ring_policy_t;
+
+    /**
+     * @brief Log record (meaning of kind, code and values is up to the user)
+     */
+    typedef struct
+    {
+        uint32_t time;                   /* Time stamp (e.g. ms) */
+        uint8_t source;                  /* Producer id (e.g. rig number) */
+        uint8_t kind;                    /* Record type */
+        int16_t code;                    /* Small integer payload (flags, error code) */
+        int32_t values[LOG_RING_VALUES]; /* Values (e.g. Q16.16) */
+    } log_record_t;
+
+    /**
+     * @brief Ring structure
+     */
+    typedef struct
+    {
+        log_record_t *slots;           /* Record storage */
+        uint32_t mask;                 /* Capacity - 1 */
+        log_ring_policy_t policy;      /* Overrun policy */
+        volatile uint32_t head;        /* Records pushed (written by the producer) */
+        volatile uint32_t tail;        /* Records popped or skipped (written by the consumer) */
+        volatile uint32_t refused;     /* Records refused when full (written by the producer) */
+        volatile uint32_t overwritten; /* Records overwritten before popped (written by the consumer) */
+    } log_ring_t;
+
+    /**
+     * @brief Initialize an empty ring
+     *
+     * @param[out] ring Pointer to ring structure
+     * @param[in] slots Record storage (kept by reference)
+     * @param[in] capacity Number of records in slots (power of two)
+     * @param[in] policy Overrun policy
+     *
+     * @return LOG_RING_OK on success, LOG_RING_ERR_INVALID_PARAM on invalid parameters
+     */
+    log_ring_err_t log_ring_init(log_ring_t *ring, log_record_t *slots, uint32_t capacity, log_ring_policy_t policy);
+
+    /**
+     * @brief Queue a record (producer side, wait-free)
+     *
+     * @param[in,out] ring Pointer to ring structure
+     * @param[in] rec Record to copy in
+     *
+     * @return LOG_RING_OK if queued, LOG_RING_ERR_FULL if refused (drop-newest policy)
+     */
+    log_ring_err_t log_ring_push(log_ring_t *ring, const log_record_t *rec);
+
+    /**
+     * @brief Take the oldest queued record (consumer side, never waits for the producer)
+     *
+     * @param[in,out] ring Pointer to ring structure
+     * @param[out] rec Record copied out
+     *
+     * @return LOG_RING_OK if a record was copied, LOG_RING_ERR_EMPTY if none is queued
+     */
+    log_ring_err_t log_ring_pop(log_ring_t *ring, log_record_t *rec);
+
+    /**
+     * @brief Number of records lost so far (refused and overwritten)
+     *
+     * @param[in] ring Pointer to ring structure
+     *
+     * @return Record count
+     */
+    uint32_t log_ring_dropped(const log_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_RING_H */
@@ -0,0 +1,143 @@
+/**
+ * @file lqr.h
+ * @brief Observer-based state feedback (LQR) for the pendulum
+ *
+ * Alternative to the PID stage. The disturbance observer (dob.h) already
+ * estimates the full state of the model: angle, angular velocity, the thrust
+ * behind the motor lag and an external bias. The state feedback acts on the
+ * deviation of that state from the reference:
+ *
+ *   T_ss = thrust(ref pos, ref vel, ref acc) - bias
+ *   T    = T_ss - k_pos * (angle - ref pos) - k_vel * (velocity - ref vel)
+ *              - k_thr * (thrust - T_ss)
+ *
+ * and maps the commanded thrust to a duty through the thrust table. The bias
+ * estimate removes the steady-state error, so there is no integrator to wind
+ * up when the duty saturates.
+ *
+ * The gains are designed offline (host/src/lqr_design.c solves the discrete
+ * Riccati equation on the identified model linearized at a grid of angles)
+ * and stored here as a small table indexed by the reference angle, linearly
+ * interpolated between the entries. One evaluation costs a table lookup, a
+ * sine lookup, a table bisection for the duty and a few 64-bit multiplications.
+ */
+
+#ifndef LQR_H
+#define LQR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+#include "feedforward.h"
+#include "dob.h"
+
+/**
+ * @brief Maximum number of table entries
+ */
+#define LQR_MAX_POINTS 16
+
+/**
+ * @brief Conversion of the angle and velocity gains to Q8.24
+ */
+#define LQR_K_FROM_FLOAT(x) ((int32_t)((x) * 16777216.0f))
+#define LQR_K_TO_FLOAT(x) ((float)(x) / 16777216.0f)
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        LQR_OK = 0,                 /* Operation completed successfully */
+        LQR_ERR_INVALID_PARAM = -1, /* Invalid parameter */
+        LQR_ERR_FULL = -2           /* Table is full */
+    } lqr_err_t;
+
+    /**
+     * @brief State feedback gains of one operating point
+     */
+    typedef struct
+    {
+        int32_t k_pos; /* Thrust per degree of angle error (gravity units, Q8.24) */
+        int32_t k_vel; /* Thrust per deg/s of velocity error (gravity units, Q8.24) */
+        fix16_t k_thr; /* Feedback of the lagged thrust deviation (Q16.16) */
+    } lqr_gains_t;
+
+    /**
+     * @brief Gain table structure
+     */
+    typedef struct
+    {
+        fix16_t angle[LQR_MAX_POINTS];     /* Breakpoints in degrees, strictly increasing */
+        fix16_t inv_width[LQR_MAX_POINTS]; /* 1 / (angle[i + 1] - angle[i]) */
+        lqr_gains_t gains[LQR_MAX_POINTS]; /* Gains at the breakpoints */
+        uint8_t count;                     /* Number of entries */
+        uint8_t seg;                       /* Cached segment of the last lookup */
+    } lqr_t;
+
+    /**
+     * @brief Initialize an empty gain table
+     *
+     * @param[out] lqr Pointer to gain table structure
+     */
+    void lqr_init(lqr_t *lqr);
+
+    /**
+     * @brief Insert or replace a table entry
+     *
+     * Entries are kept sorted by angle; an entry with the same angle is replaced.
+     *
+     * @param[in,out] lqr Pointer to gain table structure
+     * @param[in] angle Breakpoint in degrees
+     * @param[in] gains Gains at the breakpoint (k_pos, k_vel and k_thr not negative)
+     *
+     * @return LQR_OK on success, error code on failure
+     */
+    lqr_err_t lqr_set_point(lqr_t *lqr, fix16_t angle, const lqr_gains_t *gains);
+
+    /**
+     * @brief Remove all table entries
+     *
+     * @param[in,out] lqr Pointer to gain table structure
+     */
+    void lqr_clear(lqr_t *lqr);
+
+    /**
+     * @brief Interpolate the gains for an operating point
+     *
+     * Outside the table the first/last entry is held.
+     *
+     * @param[in,out] lqr Pointer to gain table structure
+     * @param[in] angle Reference angle in degrees
+     * @param[out] gains Interpolated gains
+     *
+     * @return LQR_OK on success, LQR_ERR_INVALID_PARAM for an empty table
+     */
+    lqr_err_t lqr_eval(lqr_t *lqr, fix16_t angle, lqr_gains_t *gains);
+
+    /**
+     * @brief Thrust command of the state feedback
+     *
+     * @param[in] gains Gains of the operating point
+     * @param[in] ff Model (neutral, thrust table, velocity and inertia coefficients)
+     * @param[in] dob Observer (disturbance and lagged thrust estimates)
+     * @param[in] angle Angle estimate in degrees
+     * @param[in] rate Velocity estimate in deg/s
+     * @param[in] pos Reference angle in degrees
+     * @param[in] vel Reference velocity in deg/s
+     * @param[in] acc Reference acceleration in deg/s^2
+     *
+     * @return Commanded thrust (gravity units)
+     */
+    fix16_t lqr_thrust(const lqr_gains_t *gains, const feedforward_t *ff, const dob_t *dob,
+                       fix16_t angle, fix16_t rate, fix16_t pos, fix16_t vel, fix16_t acc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LQR_H */
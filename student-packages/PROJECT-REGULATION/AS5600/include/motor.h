@@ -0,0 +1,114 @@
+/**
+ * @file motor.h
+ * @brief DRV8871 H-bridge motor driver
+ *
+ * The DRV8871 is controlled by two logic inputs:
+ *   IN1 = PWM, IN2 = 0 : forward, coast during the off phase
+ *   IN1 = 0, IN2 = PWM : reverse, coast during the off phase
+ *   IN1 = 0, IN2 = 0   : coast (outputs Hi-Z)
+ *   IN1 = 1, IN2 = 1   : brake (low-side slow decay)
+ *
+ * Like the AS5600 driver, the library is platform-independent; the user
+ * provides a function that sets the PWM compare levels of both inputs.
+ */
+
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+    /**
+     * @brief Enumeration for bridge states
+     */
+    typedef enum
+    {
+        MOTOR_STATE_COAST = 0, /* Both inputs low, motor free-wheels */
+        MOTOR_STATE_DRIVE = 1, /* One input driven with PWM */
+        MOTOR_STATE_BRAKE = 2  /* Both inputs high, motor shorted */
+    } motor_state_t;
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        MOTOR_OK = 0,                  /* Operation completed successfully */
+        MOTOR_ERR_INVALID_PARAM = -1,  /* Invalid parameter */
+        MOTOR_ERR_NOT_INITIALIZED = -2 /* Device not initialized */
+    } motor_err_t;
+
+    /**
+     * @brief Function pointer for platform-specific PWM level update
+     *
+     * @param[in] in1_level Compare level of the IN1 pin (0 - wrap)
+     * @param[in] in2_level Compare level of the IN2 pin (0 - wrap)
+     * @param[in] intf_ptr Interface context given to motor_init()
+     */
+    typedef void (*motor_set_levels_fptr_t)(uint16_t in1_level, uint16_t in2_level, void *intf_ptr);
+
+    /**
+     * @brief Motor device structure
+     */
+    typedef struct
+    {
+        motor_set_levels_fptr_t set_levels; /* PWM level update function */
+        void *intf_ptr;                     /* Interface context (PWM slice, bridge instance) */
+        uint16_t wrap;                      /* PWM counter top (level for 100 % duty) */
+        motor_state_t state;                /* Current bridge state */
+        fix16_t duty;                       /* Last commanded duty (-1 to 1) */
+        uint8_t initialized;                /* Initialization flag */
+    } motor_dev_t;
+
+    /**
+     * @brief Initialize the motor driver, leaving the bridge in coast
+     *
+     * @param[out] dev Pointer to device structure
+     * @param[in] set_levels_fptr Pointer to platform-specific PWM level function
+     * @param[in] wrap PWM counter top (below 65535)
+     * @param[in] intf_ptr Interface context passed to the level function
+     *
+     * @return MOTOR_OK on success, error code on failure
+     */
+    motor_err_t motor_init(motor_dev_t *dev, motor_set_levels_fptr_t set_levels_fptr, uint16_t wrap,
+                           void *intf_ptr);
+
+    /**
+     * @brief Set the motor duty
+     *
+     * @param[in,out] dev Pointer to device structure
+     * @param[in] duty Duty in Q16.16, -1 (full reverse) to 1 (full forward); clamped
+     *
+     * @return MOTOR_OK on success, error code on failure
+     */
+    motor_err_t motor_set_duty(motor_dev_t *dev, fix16_t duty);
+
+    /**
+     * @brief Put the bridge into coast (both outputs Hi-Z)
+     *
+     * @param[in,out] dev Pointer to device structure
+     *
+     * @return MOTOR_OK on success, error code on failure
+     */
+    motor_err_t motor_coast(motor_dev_t *dev);
+
+    /**
+     * @brief Put the bridge into brake (both low-side switches on)
+     *
+     * @param[in,out] dev Pointer to device structure
+     *
+     * @return MOTOR_OK on success, error code on failure
+     */
+    motor_err_t motor_brake(motor_dev_t *dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOTOR_H */
@@ -0,0 +1,144 @@
+/**
+ * @file osc_detect.h
+ * @brief On-line oscillation (limit cycle) detector for the regulation loop
+ *
+ * Watches the control error for sustained oscillation, as caused by gains
+ * that are too high for the actual plant or for the measurement delay. The
+ * error is averaged down to about OSC_DETECT_RATE_HZ and fed to one Goertzel
+ * filter per candidate frequency. Each filter integrates over a block of
+ * exactly two periods of its frequency, so a constant error (steady-state
+ * offset, hold at the target) does not leak into any bin, and its amplitude
+ * is available after every block:
+ *
+ *   s[n] = x[n] + c * s[n - 1] - s[n - 2],  c = 2 cos(2 pi * 2 / N)
+ *   |X|^2 = s1^2 + s2^2 - c * s1 * s2,      amplitude = 2 |X| / N
+ *
+ * A bin whose amplitude stays above the threshold for OSC_DETECT_CONFIRM
+ * blocks in a row is an oscillation; the strongest such bin is reported.
+ * A decaying step transient drops below the threshold within a block, a
+ * limit cycle does not. Detection takes OSC_DETECT_CONFIRM * 2 periods.
+ *
+ * With the back-off enabled, every confirmed detection scales the loop gain
+ * down by OSC_DETECT_BACKOFF (not below OSC_DETECT_SCALE_MIN) and restarts
+ * the confirmation, so the gain only keeps falling while the oscillation
+ * persists. The owner applies the scale (see controller_set_gain_scale()).
+ *
+ * A tick costs one addition; every OSC_DETECT_RATE_HZ sample one 64-bit
+ * multiplication per bin, and a block end one square root for that bin.
+ */
+
+#ifndef OSC_DETECT_H
+#define OSC_DETECT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Sample rate of the Goertzel filters (Hz, the tick rate is divided down to it)
+ */
+#define OSC_DETECT_RATE_HZ 250
+
+/**
+ * @brief Number of candidate frequencies (see osc_detect.c for the list)
+ */
+#define OSC_DETECT_BINS 8
+
+/**
+ * @brief Blocks in a row above the threshold that confirm an oscillation
+ */
+#define OSC_DETECT_CONFIRM 2
+
+/**
+ * @brief Default amplitude threshold (degrees, Q16.16)
+ */
+#define OSC_DETECT_THRESHOLD_DEFAULT FIX16_FROM_FLOAT(0.5)
+
+/**
+ * @brief Gain scale factor per confirmed detection and lowest gain scale (Q16.16)
+ */
+#define OSC_DETECT_BACKOFF FIX16_FROM_FLOAT(0.7)
+#define OSC_DETECT_SCALE_MIN FIX16_FROM_FLOAT(0.25)
+
+    /**
+     * @brief Goertzel filter of one candidate frequency
+     */
+    typedef struct
+    {
+        uint16_t freq_dhz; /* Candidate frequency (0.1 Hz) */
+        uint16_t len;      /* Block length (samples, two periods) */
+        int32_t coeff;     /* 2 cos(2 pi * 2 / len), Q2.29 */
+        int32_t s1;        /* Filter state s[n - 1] (deg, Q24.8) */
+        int32_t s2;        /* Filter state s[n - 2] (deg, Q24.8) */
+        uint16_t n;        /* Samples in the current block */
+        fix16_t amplitude; /* Amplitude of the last complete block (deg) */
+        uint8_t hits;      /* Consecutive blocks above the threshold */
+    } osc_bin_t;
+
+    /**
+     * @brief Oscillation detector structure
+     */
+    typedef struct
+    {
+        osc_bin_t bin[OSC_DETECT_BINS]; /* Candidate frequencies */
+        uint16_t decim;                 /* Ticks per filter sample */
+        uint16_t phase;                 /* Ticks accumulated into the current sample */
+        int32_t acc;                    /* Sum of the error over the current sample (Q16.16) */
+        fix16_t threshold;              /* Amplitude threshold (deg) */
+        uint8_t enabled;                /* Detector enabled flag */
+        uint8_t backoff;                /* Automatic gain back-off enabled flag */
+        uint8_t active;                 /* Oscillation confirmed in the last blocks */
+        fix16_t freq;                   /* Frequency of the strongest confirmed bin (Hz) */
+        fix16_t amplitude;              /* Its amplitude (deg) */
+        fix16_t scale;                  /* Gain scale after the back-off (1.0 = nominal) */
+        uint32_t detections;            /* Number of confirmed oscillations */
+    } osc_detect_t;
+
+    /**
+     * @brief Initialize the detector (disabled, nominal gain)
+     *
+     * @param[out] osc Pointer to detector structure
+     * @param[in] rate_hz Tick rate in Hz
+     */
+    void osc_detect_init(osc_detect_t *osc, uint32_t rate_hz);
+
+    /**
+     * @brief Enable or disable detection and back-off
+     *
+     * Restarts the detection and returns the gain scale to nominal.
+     *
+     * @param[in,out] osc Pointer to detector structure
+     * @param[in] enable 1 to watch the error, 0 to stop
+     * @param[in] backoff 1 to scale the gain down on every confirmed detection
+     * @param[in] threshold Amplitude threshold in degrees (0 keeps the current one)
+     */
+    void osc_detect_configure(osc_detect_t *osc, uint8_t enable, uint8_t backoff, fix16_t threshold);
+
+    /**
+     * @brief Restart the detection (filter states and confirmations, not the gain scale)
+     *
+     * @param[in,out] osc Pointer to detector structure
+     */
+    void osc_detect_reset(osc_detect_t *osc);
+
+    /**
+     * @brief Feed one tick of the control error
+     *
+     * @param[in,out] osc Pointer to detector structure
+     * @param[in] error Setpoint minus angle in degrees
+     *
+     * @return 1 if an oscillation was confirmed in this tick (osc->freq,
+     *         osc->amplitude and, with back-off, osc->scale updated), 0 otherwise
+     */
+    uint8_t osc_detect_tick(osc_detect_t *osc, fix16_t error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OSC_DETECT_H */
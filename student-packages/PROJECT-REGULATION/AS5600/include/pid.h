@@ -0,0 +1,156 @@
+/**
+ * @file pid.h
+ * @brief Fixed-point PID controller with anti-windup and bumpless gain changes
+ *
+ * The controller runs at a fixed rate. Gains are given in continuous units and
+ * discretized once into per-tick coefficients, so the step itself is a handful
+ * of integer multiplies.
+ */
+
+#ifndef PID_H
+#define PID_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Default derivative filter coefficient (Q16.16, 1 = no filtering)
+ */
+#define PID_D_ALPHA_DEFAULT FIX16_FROM_FLOAT(0.2)
+
+/**
+ * @brief Default integrator limit (Q16.16, full scale = limited by the output range only)
+ */
+#define PID_I_LIMIT_DEFAULT FIX16_ONE
+
+    /**
+     * @brief PID gains in continuous units (angle in degrees, output as a fraction of full scale)
+     */
+    typedef struct
+    {
+        fix16_t kp; /* Proportional gain [1/deg] */
+        fix16_t ki; /* Integral gain [1/(deg*s)] */
+        fix16_t kd; /* Derivative gain [s/deg] */
+    } pid_gains_t;
+
+    /**
+     * @brief PID coefficients discretized for a fixed tick rate
+     */
+    typedef struct
+    {
+        fix16_t kp; /* Proportional gain, Q16.16 */
+        int32_t ki; /* Integral gain times tick period, Q8.24 */
+        fix16_t kd; /* Derivative gain divided by tick period, Q16.16 */
+    } pid_coeffs_t;
+
+    /**
+     * @brief PID controller state
+     */
+    typedef struct
+    {
+        pid_coeffs_t coeffs; /* Active coefficients */
+        uint32_t rate_hz;    /* Tick rate */
+        fix16_t d_alpha;     /* Derivative low-pass coefficient (0-1) */
+        fix16_t i_limit;     /* Integrator magnitude limit (output units) */
+        fix16_t out_min;     /* Output lower limit */
+        fix16_t out_max;     /* Output upper limit */
+        int64_t integ;       /* Integrator state (output units, Q32.32) */
+        fix16_t error;       /* Last error */
+        fix16_t prev_meas;   /* Last measurement */
+        fix16_t dmeas;       /* Filtered measurement change per tick */
+        fix16_t p_term;      /* Last proportional term */
+        fix16_t i_term;      /* Last integral term */
+        fix16_t d_term;      /* Last derivative term */
+        fix16_t ff;          /* Last feedforward */
+        fix16_t output;      /* Last (saturated) output */
+        uint8_t primed;      /* Set after the first step following a reset */
+    } pid_ctrl_t;
+
+    /**
+     * @brief Initialize the PID controller
+     *
+     * @param[out] pid Pointer to controller structure
+     * @param[in] gains Initial gains
+     * @param[in] rate_hz Tick rate in Hz
+     * @param[in] out_min Output lower limit
+     * @param[in] out_max Output upper limit
+     */
+    void pid_init(pid_ctrl_t *pid, const pid_gains_t *gains, uint32_t rate_hz,
+                  fix16_t out_min, fix16_t out_max);
+
+    /**
+     * @brief Convert continuous gains into per-tick coefficients
+     *
+     * @param[in] gains Continuous gains
+     * @param[in] rate_hz Tick rate in Hz
+     * @param[out] coeffs Discretized coefficients
+     */
+    void pid_discretize(const pid_gains_t *gains, uint32_t rate_hz, pid_coeffs_t *coeffs);
+
+    /**
+     * @brief Change the active coefficients without a bump in the output
+     *
+     * The change of the proportional and derivative terms for the current
+     * error is absorbed by the integrator, so the next output continues from
+     * the last one.
+     *
+     * @param[in,out] pid Pointer to controller structure
+     * @param[in] coeffs New coefficients
+     */
+    void pid_set_coeffs(pid_ctrl_t *pid, const pid_coeffs_t *coeffs);
+
+    /**
+     * @brief Set the derivative filter and the integrator limit
+     *
+     * The integrator is kept within +-i_limit in addition to the output range
+     * left over by the feedforward; a lower limit reduces windup on large steps
+     * at the cost of the steady-state load the integrator can carry.
+     *
+     * @param[in,out] pid Pointer to controller structure
+     * @param[in] d_alpha Derivative low-pass coefficient (Q16.16, 0-1, 1 = no filtering)
+     * @param[in] i_limit Integrator limit (Q16.16, output units, > 0)
+     */
+    void pid_set_tuning(pid_ctrl_t *pid, fix16_t d_alpha, fix16_t i_limit);
+
+    /**
+     * @brief Switch the feedforward to a new value without a bump in the output
+     *
+     * Used when the feedforward is switched on or off; the difference is
+     * absorbed by the integrator.
+     *
+     * @param[in,out] pid Pointer to controller structure
+     * @param[in] ff New feedforward value
+     */
+    void pid_transfer_ff(pid_ctrl_t *pid, fix16_t ff);
+
+    /**
+     * @brief Reset the controller state
+     *
+     * @param[in,out] pid Pointer to controller structure
+     * @param[in] output Output to continue from (preloaded into the integrator)
+     */
+    void pid_reset(pid_ctrl_t *pid, fix16_t output);
+
+    /**
+     * @brief Run one controller tick
+     *
+     * @param[in,out] pid Pointer to controller structure
+     * @param[in] setpoint Setpoint in degrees
+     * @param[in] meas Measured angle in degrees
+     * @param[in] ff Feedforward added to the output (taken into account by the anti-windup)
+     *
+     * @return Saturated controller output
+     */
+    fix16_t pid_step(pid_ctrl_t *pid, fix16_t setpoint, fix16_t meas, fix16_t ff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PID_H */
@@ -0,0 +1,110 @@
+/**
+ * @file predictor.h
+ * @brief Measurement latency compensation (Smith-type predictor)
+ *
+ * The angle the controller receives is older than the tick that acts on it:
+ * the AS5600 slow filter lags the magnet by up to 2.2 ms (SF 16x) and the
+ * blocking I2C read adds its transfer time. The predictor carries the delayed
+ * measurement forward over that delay on the feedforward model of the
+ * pendulum (see dob.h), driven by the thrust history the disturbance observer
+ * recorded for the same ticks:
+ *
+ *   angle'' = (thrust[k] + disturbance - sin(angle - neutral) - k_vel * angle') / k_acc
+ *
+ * Only the model's motion over the last few ticks is added to the
+ * measurement, so model errors cannot accumulate the way they would in an
+ * open-loop model. The delay is split into whole ticks and a fraction; the
+ * cost is one sine lookup and two 64-bit multiplications per tick of delay.
+ */
+
+#ifndef PREDICTOR_H
+#define PREDICTOR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+#include "feedforward.h"
+#include "dob.h"
+
+/**
+ * @brief Length of the thrust history (longest delay in ticks)
+ */
+#define PREDICTOR_MAX_TICKS 8
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        PREDICTOR_OK = 0,                /* Operation completed successfully */
+        PREDICTOR_ERR_INVALID_PARAM = -1 /* Delay longer than the history */
+    } predictor_err_t;
+
+    /**
+     * @brief Predictor structure
+     */
+    typedef struct
+    {
+        uint32_t rate_hz;                    /* Tick rate */
+        uint32_t delay_us;                   /* Compensated delay */
+        uint8_t ticks;                       /* Whole ticks of the delay */
+        fix16_t frac;                        /* Remaining fraction of a tick */
+        fix16_t thrust[PREDICTOR_MAX_TICKS]; /* Modelled thrust of the last ticks (ring) */
+        uint8_t head;                        /* Slot of the newest thrust */
+        fix16_t angle;                       /* Last predicted angle (deg) */
+        fix16_t rate;                        /* Last predicted velocity (deg/s) */
+    } predictor_t;
+
+    /**
+     * @brief Initialize the predictor without delay
+     *
+     * @param[out] pred Pointer to predictor structure
+     * @param[in] rate_hz Tick rate in Hz
+     */
+    void predictor_init(predictor_t *pred, uint32_t rate_hz);
+
+    /**
+     * @brief Set the delay to compensate
+     *
+     * @param[in,out] pred Pointer to predictor structure
+     * @param[in] delay_us Age of the measurement when the output is applied (us)
+     *
+     * @return PREDICTOR_OK on success, PREDICTOR_ERR_INVALID_PARAM if longer
+     *         than PREDICTOR_MAX_TICKS ticks (unchanged)
+     */
+    predictor_err_t predictor_set_delay(predictor_t *pred, uint32_t delay_us);
+
+    /**
+     * @brief Record the thrust acting on the pendulum during the current tick
+     *
+     * @param[in,out] pred Pointer to predictor structure
+     * @param[in] thrust Modelled thrust after the motor lag (gravity units)
+     */
+    void predictor_push(predictor_t *pred, fix16_t thrust);
+
+    /**
+     * @brief Carry a delayed state forward over the delay
+     *
+     * The result is also kept in pred->angle and pred->rate.
+     *
+     * @param[in,out] pred Pointer to predictor structure
+     * @param[in] ff Model (neutral, velocity and inertia coefficients)
+     * @param[in] dob Observer (disturbance estimate and per-tick scaling)
+     * @param[in] angle Delayed angle in degrees
+     * @param[in] rate Delayed velocity in deg/s
+     *
+     * @return Predicted current angle in degrees
+     */
+    fix16_t predictor_run(predictor_t *pred, const feedforward_t *ff, const dob_t *dob, fix16_t angle,
+                          fix16_t rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PREDICTOR_H */
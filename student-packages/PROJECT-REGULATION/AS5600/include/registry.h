@@ -0,0 +1,198 @@
+/**
+ * @file registry.h
+ * @brief Registry of loggable variables with runtime selection and decimation
+ *
+ * The log has a fixed set of columns. Instead, firmware variables (angle,
+ * setpoint, PID terms, duty, tick timing, AGC, ...) are registered once with
+ * a name and a wire format; at runtime any of them can be switched on with
+ * its own decimation (ticks per sample). Nothing is read, formatted or sent
+ * for a variable that is off.
+ *
+ * Enabled variables with the same decimation form a group; each group is one
+ * telemetry stream (a schema of up to REGISTRY_GROUP_VARS channels), so the
+ * host gets every variable at its own rate without per-sample bookkeeping.
+ *
+ * The selection is changed and the variables are read in the context of the
+ * control tick (single writer). The output side, possibly on the other core,
+ * copies the layout of a group with registry_layout(): the writer makes the
+ * generation number odd while it rebuilds the groups, and the reader accepts
+ * a copy only if the generation was the same even number before and after
+ * it, so neither side waits. Samples carry the generation they were taken
+ * with, and samples of an older layout are dropped by the reader.
+ */
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "telemetry.h"
+
+/**
+ * @brief Memory barrier between the group layout and the generation number
+ */
+#ifndef REGISTRY_BARRIER
+#define REGISTRY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+/**
+ * @brief Limits
+ */
+#define REGISTRY_MAX_VARS 20
+#define REGISTRY_MAX_GROUPS 4
+#define REGISTRY_GROUP_VARS (TELEMETRY_MAX_CHANNELS - 1) /* One channel is left for the time stamp */
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        REGISTRY_OK = 0,                 /* Operation completed successfully */
+        REGISTRY_ERR_INVALID_PARAM = -1, /* Invalid parameter or wire format */
+        REGISTRY_ERR_FULL = -2,          /* Too many variables, groups or variables in a group */
+        REGISTRY_ERR_UNKNOWN = -3,       /* No variable of that name */
+        REGISTRY_ERR_STALE = -4          /* Layout changed or being changed */
+    } registry_err_t;
+
+    /**
+     * @brief Type of a registered variable
+     */
+    typedef enum
+    {
+        REGISTRY_SRC_FIX16 = 0, /* fix16_t (Q16.16) */
+        REGISTRY_SRC_Q32 = 1,   /* int64_t Q32.32, read as saturated Q16.16 */
+        REGISTRY_SRC_U32 = 2,   /* uint32_t integer */
+        REGISTRY_SRC_U8 = 3     /* uint8_t integer */
+    } registry_src_t;
+
+    /**
+     * @brief Registered variable
+     */
+    typedef struct
+    {
+        telemetry_channel_t channel; /* Name and wire format */
+        const void *ptr;             /* Variable */
+        registry_src_t src;          /* Type of the variable */
+        uint16_t divider;            /* Ticks per sample, 0 = off */
+    } registry_var_t;
+
+    /**
+     * @brief Enabled variables sharing one decimation
+     */
+    typedef struct
+    {
+        uint16_t divider;                  /* Ticks per sample */
+        uint16_t count;                    /* Ticks since the last sample */
+        uint8_t nvars;                     /* Number of variables */
+        uint8_t vars[REGISTRY_GROUP_VARS]; /* Indices into the variable table */
+    } registry_group_t;
+
+    /**
+     * @brief Registry structure
+     */
+    typedef struct
+    {
+        registry_var_t vars[REGISTRY_MAX_VARS];       /* Variable table (fixed after start-up) */
+        uint8_t count;                                /* Number of variables */
+        registry_group_t groups[REGISTRY_MAX_GROUPS]; /* Enabled variables by decimation */
+        uint8_t ngroups;                              /* Number of groups */
+        volatile uint32_t gen;                        /* Layout generation, odd while it changes */
+    } registry_t;
+
+    /**
+     * @brief Copy of a group layout for the output side
+     */
+    typedef struct
+    {
+        uint16_t divider;                                  /* Ticks per sample */
+        uint8_t count;                                     /* Number of channels */
+        telemetry_channel_t channels[REGISTRY_GROUP_VARS]; /* Channels in sample order */
+    } registry_layout_t;
+
+    /**
+     * @brief Initialize an empty registry
+     *
+     * @param[out] reg Pointer to registry structure
+     */
+    void registry_init(registry_t *reg);
+
+    /**
+     * @brief Register a variable (off)
+     *
+     * @param[in,out] reg Pointer to registry structure
+     * @param[in] name Channel name (kept by reference, up to TELEMETRY_NAME_MAX characters)
+     * @param[in] ptr Variable (kept by reference)
+     * @param[in] src Type of the variable
+     * @param[in] type Wire type (TELEMETRY_TYPE_U32 for the integer types)
+     * @param[in] frac_bits Fractional bits on the wire
+     *
+     * @return REGISTRY_OK on success, REGISTRY_ERR_FULL if the table is full,
+     *         REGISTRY_ERR_INVALID_PARAM on invalid parameters
+     */
+    registry_err_t registry_add(registry_t *reg, const char *name, const void *ptr, registry_src_t src,
+                                telemetry_type_t type, uint8_t frac_bits);
+
+    /**
+     * @brief Switch a variable on or off (control tick context)
+     *
+     * @param[in,out] reg Pointer to registry structure
+     * @param[in] name Channel name
+     * @param[in] divider Ticks per sample, 0 to switch it off
+     *
+     * @return REGISTRY_OK on success, REGISTRY_ERR_UNKNOWN for an unknown name,
+     *         REGISTRY_ERR_FULL if the selection does not fit into the groups
+     *         (the variable keeps its previous setting)
+     */
+    registry_err_t registry_set(registry_t *reg, const char *name, uint16_t divider);
+
+    /**
+     * @brief Switch all variables off (control tick context)
+     *
+     * @param[in,out] reg Pointer to registry structure
+     */
+    void registry_clear(registry_t *reg);
+
+    /**
+     * @brief Count one tick for a group (control tick)
+     *
+     * @param[in,out] reg Pointer to registry structure
+     * @param[in] group Group number (below reg->ngroups)
+     *
+     * @return 1 if the group is due for a sample, 0 otherwise
+     */
+    uint8_t registry_tick(registry_t *reg, uint8_t group);
+
+    /**
+     * @brief Read the variables of a group (control tick)
+     *
+     * @param[in] reg Pointer to registry structure
+     * @param[in] group Group number (below reg->ngroups)
+     * @param[out] values One value per variable (integers as is, fixed-point in Q16.16)
+     *
+     * @return Number of values
+     */
+    uint8_t registry_read(const registry_t *reg, uint8_t group, int32_t *values);
+
+    /**
+     * @brief Copy the layout of a group (output side, never waits)
+     *
+     * @param[in] reg Pointer to registry structure
+     * @param[in] gen Generation the sample was taken with
+     * @param[in] group Group number
+     * @param[out] layout Copy of the layout
+     *
+     * @return REGISTRY_OK on success, REGISTRY_ERR_STALE if the layout is no
+     *         longer (or not yet) that of generation gen
+     */
+    registry_err_t registry_layout(const registry_t *reg, uint32_t gen, uint8_t group, registry_layout_t *layout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REGISTRY_H */
@@ -0,0 +1,238 @@
+/**
+ * @file regulator.h
+ * @brief Pendulum regulation loop (AS5600 sensor -> controller -> DRV8871 motor)
+ *
+ * Ties one sensor, one controller and one motor together. The loop itself is
+ * platform-independent: all hardware access goes through the AS5600 and motor
+ * driver function pointers, the caller only has to call regulator_tick() at
+ * the configured rate. Controller settings are changed through the
+ * double-buffered reg->params block (see ctrl_params.h), so the loop never
+ * has to stop and never runs a tick with half an update.
+ */
+
+#ifndef REGULATOR_H
+#define REGULATOR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "AS5600.h"
+#include "motor.h"
+#include "supply.h"
+#include "controller.h"
+#include "calib_sweep.h"
+#include "step_analyzer.h"
+#include "supervisor.h"
+#include "osc_detect.h"
+#include "sysid.h"
+#include "fixed.h"
+
+/**
+ * @brief Pendulum angle at the neutral position (motor off), in degrees
+ */
+#define REGULATOR_NEUTRAL_DEG 30
+
+/**
+ * @brief Motor command limits (propeller only pushes in one direction)
+ */
+#define REGULATOR_OUT_MIN 0
+#define REGULATOR_OUT_MAX FIX16_ONE
+
+/**
+ * @brief Initial thrust at full duty (gravity units) until a calibration sweep is run
+ */
+#define REGULATOR_THRUST_MAX_DEFAULT FIX16_FROM_FLOAT(1.5)
+
+/**
+ * @brief Calibration sweep defaults
+ */
+#define REGULATOR_SWEEP_STEPS 24
+#define REGULATOR_SWEEP_SETTLE_MS 1500
+#define REGULATOR_SWEEP_AVG_MS 500
+#define REGULATOR_SWEEP_ANGLE_LIMIT_DEG 150
+
+/**
+ * @brief Ticks between two magnet checks (STATUS and AGC reads) while running
+ */
+#define REGULATOR_MAGNET_CHECK_TICKS 100
+
+/**
+ * @brief Step-response analysis defaults
+ */
+#define REGULATOR_STEP_BAND FIX16_FROM_INT(1)
+#define REGULATOR_STEP_HOLD_MS 500
+#define REGULATOR_STEP_TIMEOUT_MS 10000
+
+    /**
+     * @brief Enumeration for regulator modes
+     */
+    typedef enum
+    {
+        REGULATOR_MODE_CONTROL = 0, /* Closed-loop control */
+        REGULATOR_MODE_SWEEP = 1,   /* Open-loop calibration sweep */
+        REGULATOR_MODE_SYSID = 2    /* Open-loop identification capture */
+    } regulator_mode_t;
+
+    /**
+     * @brief Regulation loop structure
+     */
+    typedef struct
+    {
+        as5600_dev_t *sensor;       /* Angle sensor */
+        motor_dev_t *motor;         /* Propeller motor */
+        supply_t *supply;           /* Motor supply monitor */
+        controller_t ctrl;          /* Controller */
+        ctrl_params_block_t params; /* Controller settings published by the command side */
+        calib_sweep_t sweep;        /* Calibration sweep */
+        ff_err_t sweep_result;      /* Thrust table rebuild of the last complete sweep */
+        step_analyzer_t analyzer;   /* Step-response analysis of the closed loop */
+        supervisor_t sup;           /* Safety supervisor */
+        osc_detect_t osc;           /* Oscillation detector and gain back-off */
+        sysid_t sysid;              /* Identification capture */
+        regulator_mode_t mode;      /* Current mode */
+        uint32_t rate_hz;           /* Tick rate */
+        int32_t zero_q16;           /* Sensor angle at the neutral position (Q16.16 deg) */
+        fix16_t neutral;            /* Pendulum angle assigned to the neutral position */
+        int8_t direction;           /* Sensor direction (+1 or -1) */
+        uint8_t enabled;            /* Motor output enabled flag */
+        fix16_t angle;              /* Last measured pendulum angle in degrees */
+        fix16_t command;            /* Last motor command (Q16.16 duty) */
+        uint8_t agc;                /* Last AGC value read from the sensor */
+        as5600_err_t sensor_err;    /* Result of the last sensor read */
+        uint32_t ticks;             /* Number of executed ticks */
+    } regulator_t;
+
+    /**
+     * @brief Initialize the regulation loop (motor disabled)
+     *
+     * @param[out] reg Pointer to regulator structure
+     * @param[in] sensor Initialized AS5600 device
+     * @param[in] motor Initialized motor device
+     * @param[in] supply Initialized supply monitor (updated every tick)
+     * @param[in] gains Initial PID gains
+     * @param[in] rate_hz Tick rate in Hz
+     */
+    void regulator_init(regulator_t *reg, as5600_dev_t *sensor, motor_dev_t *motor, supply_t *supply,
+                        const pid_gains_t *gains, uint32_t rate_hz);
+
+    /**
+     * @brief Calibrate the sensor offset with the pendulum at the neutral position
+     *
+     * The current reading becomes REGULATOR_NEUTRAL_DEG.
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     *
+     * @return AS5600_OK on success, error code on failure
+     */
+    as5600_err_t regulator_calibrate(regulator_t *reg);
+
+    /**
+     * @brief Read the calibrated pendulum angle
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     * @param[out] angle Pendulum angle in degrees (Q16.16)
+     *
+     * @return AS5600_OK on success, error code on failure
+     */
+    as5600_err_t regulator_read_angle(regulator_t *reg, fix16_t *angle);
+
+    /**
+     * @brief Set the measurement latency compensated by the predictor
+     *
+     * The latency is the step-response delay of the slow filter configured in
+     * the sensor plus the measured time from the start of the angle read to
+     * the motor update. Published through reg->params like the other settings
+     * (command side).
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     * @param[in] transfer_us Measured read and compute time (us)
+     *
+     * @return Total latency (us)
+     */
+    uint32_t regulator_set_latency(regulator_t *reg, uint32_t transfer_us);
+
+    /**
+     * @brief Configure the oscillation detector
+     *
+     * Restarts the detection and returns the loop gain to nominal. With the
+     * back-off enabled, every confirmed oscillation scales the feedback gains
+     * down (see osc_detect.h) until the detector is configured again.
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     * @param[in] enable 1 to watch the control error, 0 to stop
+     * @param[in] backoff 1 to reduce the gain automatically
+     * @param[in] threshold Amplitude threshold in degrees (0 keeps the current one)
+     */
+    void regulator_configure_osc(regulator_t *reg, uint8_t enable, uint8_t backoff, fix16_t threshold);
+
+    /**
+     * @brief Enable or disable the motor output
+     *
+     * Enabling restarts the controller from zero output and evaluates the
+     * approach to the target as a step; it is refused (reg->enabled stays 0)
+     * while the supervisor has latched faults. Disabling coasts the motor.
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     * @param[in] enable 1 to enable, 0 to disable
+     */
+    void regulator_enable(regulator_t *reg, uint8_t enable);
+
+    /**
+     * @brief Start the calibration sweep
+     *
+     * Runs the motor open loop from 0 to full duty with the pendulum free to
+     * swing. When the sweep completes, the feedforward thrust table is rebuilt
+     * from the measured equilibria and the motor is disabled. Refused while
+     * the supervisor has latched faults.
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     */
+    void regulator_start_sweep(regulator_t *reg);
+
+    /**
+     * @brief Start an identification capture
+     *
+     * Runs the motor open loop around the operating-point duty with the
+     * configured excitation and records every tick into the buffer. The motor
+     * is disabled when the capture is complete. Refused while the supervisor
+     * has latched faults (reg->mode stays REGULATOR_MODE_CONTROL).
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     * @param[in] cfg Excitation settings
+     * @param[out] buf Capture buffer
+     * @param[in] capacity Number of samples the buffer holds
+     *
+     * @return SYSID_OK if started or refused by the supervisor, error code for invalid settings
+     */
+    sysid_err_t regulator_start_sysid(regulator_t *reg, const sysid_config_t *cfg, sysid_sample_t *buf,
+                                      uint32_t capacity);
+
+    /**
+     * @brief Run one regulation tick: read angle, step the controller, drive the motor
+     *
+     * A parameter generation published to reg->params since the previous
+     * tick is applied first, as a whole.
+     *
+     * The supply voltage is sampled in every tick; with the compensation
+     * enabled, every duty is scaled to the nominal supply before it reaches
+     * the motor (reg->command keeps the uncompensated value).
+     *
+     * On a sensor error the motor is coasted for this tick. Every sample is
+     * checked by the supervisor; a fault stops the regulation (the supervisor
+     * has already put the bridge into its safe state).
+     *
+     * @param[in,out] reg Pointer to regulator structure
+     *
+     * @return AS5600_OK on success, sensor error code on failure
+     */
+    as5600_err_t regulator_tick(regulator_t *reg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REGULATOR_H */
@@ -0,0 +1,212 @@
+/**
+ * @file span.h
+ * @brief Cycle-count spans of the hot path with per-stage histograms
+ *
+ * The budget (budget.h) tells how long a whole tick takes in microseconds.
+ * Spans split it up: sensing, control, actuation, logging and telemetry are
+ * marked with SPAN_BEGIN() / SPAN_END() pairs, and every pair adds the cycles
+ * between its markers to the statistics of its stage: count, min, max, sum
+ * and a histogram with one bucket per power of two (bucket b holds
+ * 2^b to 2^(b+1) - 1 cycles, bucket 0 also 0).
+ *
+ * Each core keeps its own table, written only by that core, so the markers
+ * need no locking. The owner reads the tables while they run (a window may
+ * be off by the span in progress) and asks each core to clear its table.
+ *
+ * The markers compile to nothing unless SPAN_ENABLED is 1 (CMake option
+ * SPAN_PROFILING). Enabled, a marker is one load of a free-running counter;
+ * SPAN_END() also sorts the span into its bucket (a few compares, the M0+
+ * has no count-leading-zeros instruction) and updates the table.
+ *
+ * Platform hooks, defaults for the RP2040:
+ *
+ *   - SPAN_COUNTER(): the Cortex-M0+ SysTick counter, 24 bits counting down
+ *     at the system clock. Each core has its own SysTick; the platform starts
+ *     it (reload 0xFFFFFF) on both. Spans longer than 2^24 cycles (134 ms at
+ *     125 MHz) wrap.
+ *   - SPAN_ELAPSED(begin, end): cycles between two counter readings.
+ *   - SPAN_CORE(): number of the running core (SIO CPUID register).
+ */
+
+#ifndef SPAN_H
+#define SPAN_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#ifndef SPAN_ENABLED
+#define SPAN_ENABLED 0
+#endif
+
+#if SPAN_ENABLED
+#if !defined(SPAN_COUNTER) && !defined(__arm__)
+#error "SPAN_ENABLED needs SPAN_COUNTER(), SPAN_ELAPSED() and SPAN_CORE() for this platform"
+#endif
+
+#ifndef SPAN_COUNTER
+#define SPAN_COUNTER() (*(volatile uint32_t *)0xE000E018u)
+#endif
+
+#ifndef SPAN_ELAPSED
+#define SPAN_ELAPSED(begin, end) (((begin) - (end)) & 0xFFFFFFu)
+#endif
+
+#ifndef SPAN_CORE
+#define SPAN_CORE() (*(volatile uint32_t *)0xD0000000u)
+#endif
+
+/**
+ * @brief Start a span: declares the counter reading mark
+ */
+#define SPAN_BEGIN(mark) uint32_t mark = SPAN_COUNTER()
+
+/**
+ * @brief End the span started as mark and add it to a stage of the running core
+ */
+#define SPAN_END(stage, mark) span_add(&span_stats[SPAN_CORE()][(stage)], SPAN_ELAPSED((mark), SPAN_COUNTER()))
+#else
+#define SPAN_BEGIN(mark)
+#define SPAN_END(stage, mark)
+#endif
+
+/**
+ * @brief Cores with a table
+ */
+#define SPAN_CORES 2
+
+/**
+ * @brief Histogram buckets (powers of two up to the 24-bit counter range)
+ */
+#define SPAN_BUCKETS 24
+
+    /**
+     * @brief Marked stages of the hot path
+     */
+    typedef enum
+    {
+        SPAN_TICK = 0,  /* Regulation tick (regulator_tick): sensing, control and actuation */
+        SPAN_SENSOR,    /* Angle read (as5600_get_angle_q16 over I2C) */
+        SPAN_MAGNET,    /* Magnet status and AGC read (as5600_get_status, as5600_get_agc) */
+        SPAN_CONTROL,   /* Controller step */
+        SPAN_MOTOR,     /* Supply compensation and bridge output */
+        SPAN_REPORT,    /* Events and log records of the tick (queued for the output) */
+        SPAN_LOG,       /* Output of one log record (text line or frame) */
+        SPAN_TELEMETRY, /* Encoding and writing of one binary sample */
+        SPAN_STAGES
+    } span_stage_t;
+
+    /**
+     * @brief Statistics of one stage
+     */
+    typedef struct
+    {
+        uint32_t count;              /* Spans in the window */
+        uint32_t min;                /* Shortest span (cycles) */
+        uint32_t max;                /* Longest span (cycles) */
+        uint64_t sum;                /* Sum of the spans (cycles) */
+        uint32_t hist[SPAN_BUCKETS]; /* Spans per power-of-two bucket */
+    } span_stats_t;
+
+    /**
+     * @brief Tables of all cores, each written only by its own core
+     */
+    extern span_stats_t span_stats[SPAN_CORES][SPAN_STAGES];
+
+    /**
+     * @brief Stage names for reports
+     */
+    extern const char *const span_stage_names[SPAN_STAGES];
+
+    /**
+     * @brief Histogram bucket of a span: floor(log2(cycles)), 0 for 0 and 1
+     *
+     * @param[in] cycles Span length (< 2^24)
+     *
+     * @return Bucket index
+     */
+    static inline uint8_t span_bucket(uint32_t cycles)
+    {
+        uint8_t b = 0;
+
+        if (cycles >= 1u << 16)
+        {
+            b += 16;
+            cycles >>= 16;
+        }
+        if (cycles >= 1u << 8)
+        {
+            b += 8;
+            cycles >>= 8;
+        }
+        if (cycles >= 1u << 4)
+        {
+            b += 4;
+            cycles >>= 4;
+        }
+        if (cycles >= 1u << 2)
+        {
+            b += 2;
+            cycles >>= 2;
+        }
+        if (cycles >= 1u << 1)
+        {
+            b += 1;
+        }
+        return b < SPAN_BUCKETS ? b : SPAN_BUCKETS - 1;
+    }
+
+    /**
+     * @brief Add one span to the statistics of a stage
+     *
+     * @param[in,out] stats Pointer to stage statistics
+     * @param[in] cycles Span length
+     */
+    static inline void span_add(span_stats_t *stats, uint32_t cycles)
+    {
+        stats->count++;
+        stats->sum += cycles;
+        if (cycles < stats->min)
+        {
+            stats->min = cycles;
+        }
+        if (cycles > stats->max)
+        {
+            stats->max = cycles;
+        }
+        stats->hist[span_bucket(cycles)]++;
+    }
+
+    /**
+     * @brief Clear the statistics of one stage (start a new window)
+     *
+     * @param[out] stats Pointer to stage statistics
+     */
+    void span_stats_reset(span_stats_t *stats);
+
+    /**
+     * @brief Clear the table of one core
+     *
+     * Call on that core: its markers write the table without locking.
+     *
+     * @param[in] core Core number (< SPAN_CORES)
+     */
+    void span_reset(uint8_t core);
+
+    /**
+     * @brief Mean span of a stage over the window
+     *
+     * @param[in] stats Pointer to stage statistics
+     *
+     * @return Mean length in cycles (0 without spans)
+     */
+    uint32_t span_mean(const span_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPAN_H */
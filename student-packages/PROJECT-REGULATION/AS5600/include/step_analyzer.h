@@ -0,0 +1,126 @@
+/**
+ * @file step_analyzer.h
+ * @brief On-line step-response analysis of the regulation loop
+ *
+ * Detects changes of the target angle and evaluates the response to each of
+ * them tick by tick: 10-90 % rise time, peak overshoot, settling time,
+ * steady-state error, IAE and ISE. A step is complete once the angle has
+ * stayed within the settling band for the hold time (or the timeout runs
+ * out), and its summary is then available until the next step starts.
+ * Each tick costs a handful of integer operations; nothing is buffered.
+ */
+
+#ifndef STEP_ANALYZER_H
+#define STEP_ANALYZER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Smallest target change treated as a new step (degrees, Q16.16)
+ */
+#define STEP_ANALYZER_MIN_STEP FIX16_FROM_FLOAT(0.5)
+
+    /**
+     * @brief Enumeration for analyzer states
+     */
+    typedef enum
+    {
+        STEP_ANALYZER_IDLE = 0,     /* Not armed (no step started since init or abort) */
+        STEP_ANALYZER_TRACKING = 1, /* Step in progress */
+        STEP_ANALYZER_DONE = 2      /* Summary of the last step available */
+    } step_analyzer_state_t;
+
+    /**
+     * @brief Summary of one step
+     */
+    typedef struct
+    {
+        fix16_t from;       /* Target before the step (deg) */
+        fix16_t to;         /* Target after the step (deg) */
+        uint32_t rise_ms;   /* 10-90 % rise time, UINT32_MAX if 90 % was not reached */
+        fix16_t overshoot;  /* Peak overshoot in % of the step */
+        uint32_t settle_ms; /* Time to the last entry into the band, UINT32_MAX if not settled */
+        fix16_t ss_error;   /* Mean error (target - angle) over the hold time (deg) */
+        fix16_t iae;        /* Integral of |error| until the step completes (deg*s) */
+        fix16_t ise;        /* Integral of error^2 until the step completes (deg^2*s) */
+        uint8_t settled;    /* Settled within the timeout */
+    } step_summary_t;
+
+    /**
+     * @brief Step analyzer structure
+     */
+    typedef struct
+    {
+        step_analyzer_state_t state; /* Current state */
+        uint32_t rate_hz;            /* Tick rate */
+        fix16_t band;                /* Settling band (deg) */
+        uint32_t hold_ticks;         /* Ticks within the band to count as settled */
+        uint32_t timeout_ticks;      /* Give up after this many ticks */
+        fix16_t from;                /* Start of the step in progress */
+        fix16_t target;              /* Target of the step in progress */
+        fix16_t step;                /* Signed step size */
+        uint32_t tick;               /* Ticks since the step */
+        uint32_t t10;                /* Tick of the 10 % crossing (0 = not yet) */
+        uint32_t t90;                /* Tick of the 90 % crossing (0 = not yet) */
+        uint32_t in_band;            /* Tick of the last entry into the band (0 = outside) */
+        fix16_t peak;                /* Largest excursion beyond the target */
+        int64_t iae_acc;             /* Sum of |error| (Q16.16 deg per tick) */
+        int64_t ise_acc;             /* Sum of error^2 (Q16.16 deg^2 per tick) */
+        int64_t ss_acc;              /* Sum of the error while in the band */
+        step_summary_t summary;      /* Summary of the last completed step */
+    } step_analyzer_t;
+
+    /**
+     * @brief Initialize the analyzer
+     *
+     * @param[out] sa Pointer to analyzer structure
+     * @param[in] rate_hz Tick rate in Hz
+     * @param[in] band Settling band (degrees, Q16.16)
+     * @param[in] hold_ms Time within the band to count as settled
+     * @param[in] timeout_ms Longest evaluated response
+     */
+    void step_analyzer_init(step_analyzer_t *sa, uint32_t rate_hz, fix16_t band,
+                            uint32_t hold_ms, uint32_t timeout_ms);
+
+    /**
+     * @brief Start evaluating a step explicitly (e.g. when the regulation is enabled)
+     *
+     * @param[in,out] sa Pointer to analyzer structure
+     * @param[in] from Angle the step starts from (deg)
+     * @param[in] target Target angle (deg)
+     */
+    void step_analyzer_start(step_analyzer_t *sa, fix16_t from, fix16_t target);
+
+    /**
+     * @brief Stop evaluating without a summary (e.g. when the regulation is disabled)
+     *
+     * @param[in,out] sa Pointer to analyzer structure
+     */
+    void step_analyzer_abort(step_analyzer_t *sa);
+
+    /**
+     * @brief Run one analyzer tick
+     *
+     * A change of the target by at least STEP_ANALYZER_MIN_STEP starts a new
+     * step, dropping an unfinished one.
+     *
+     * @param[in,out] sa Pointer to analyzer structure
+     * @param[in] target Current target angle (deg)
+     * @param[in] angle Measured angle (deg)
+     *
+     * @return 1 when a step has just completed and sa->summary holds its result, 0 otherwise
+     */
+    uint8_t step_analyzer_tick(step_analyzer_t *sa, fix16_t target, fix16_t angle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STEP_ANALYZER_H */
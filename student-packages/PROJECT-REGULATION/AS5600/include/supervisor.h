@@ -0,0 +1,206 @@
+/**
+ * @file supervisor.h
+ * @brief Safety supervisor of the regulation loop
+ *
+ * Latches faults and cuts the motor (coast or brake) as soon as one is seen:
+ *   - the regulation loop stops delivering samples (stale, checked from a
+ *     periodic high-priority interrupt, independent of the main loop),
+ *   - repeated sensor read errors, magnet lost, too weak or too strong
+ *     (STATUS MD/ML/MH) or AGC out of range,
+ *   - pendulum angle out of limits or angular rate too high,
+ *   - a control tick finishing after its deadline.
+ *
+ * The per-sample checks are a fixed handful of compares (no division, no
+ * loops), so they add a bounded number of cycles to every tick. A latched
+ * fault keeps the motor off until it is cleared explicitly.
+ *
+ * The supervisor interrupt also counts heartbeats; the main loop feeds the
+ * hardware watchdog only while they keep coming, so a stuck interrupt or a
+ * stuck main loop both end in a watchdog reset (which releases the bridge).
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "AS5600.h"
+#include "motor.h"
+#include "fixed.h"
+
+/**
+ * @brief Default limits
+ */
+#define SUPERVISOR_ANGLE_MIN_DEFAULT FIX16_FROM_INT(0)   /* deg */
+#define SUPERVISOR_ANGLE_MAX_DEFAULT FIX16_FROM_INT(150) /* deg */
+#define SUPERVISOR_RATE_MAX_DEFAULT FIX16_FROM_INT(1000) /* deg/s */
+#define SUPERVISOR_AGC_MIN_DEFAULT 40
+#define SUPERVISOR_AGC_MAX_DEFAULT 220
+#define SUPERVISOR_READ_ERRORS_DEFAULT 3   /* Consecutive failed reads */
+#define SUPERVISOR_STALE_PERIODS_DEFAULT 8 /* Interrupt periods without a sample (2 ticks at 4 per tick) */
+
+    /**
+     * @brief Fault flags
+     */
+    typedef enum
+    {
+        SUPERVISOR_FAULT_STALE = 1 << 0,    /* No sample from the regulation loop */
+        SUPERVISOR_FAULT_SENSOR = 1 << 1,   /* Repeated sensor read errors */
+        SUPERVISOR_FAULT_MAGNET = 1 << 2,   /* Magnet not detected, too weak or too strong */
+        SUPERVISOR_FAULT_AGC = 1 << 3,      /* AGC out of range */
+        SUPERVISOR_FAULT_ANGLE = 1 << 4,    /* Angle out of limits */
+        SUPERVISOR_FAULT_RATE = 1 << 5,     /* Angular rate too high */
+        SUPERVISOR_FAULT_DEADLINE = 1 << 6  /* Control tick finished late */
+    } supervisor_fault_t;
+
+    /**
+     * @brief Enumeration for the reaction to a fault
+     */
+    typedef enum
+    {
+        SUPERVISOR_ACTION_COAST = 0, /* Outputs Hi-Z, the pendulum falls back freely */
+        SUPERVISOR_ACTION_BRAKE = 1  /* Motor shorted, the propeller stops quickly */
+    } supervisor_action_t;
+
+    /**
+     * @brief Supervisor limits
+     */
+    typedef struct
+    {
+        fix16_t angle_min;          /* Lowest allowed angle (deg) */
+        fix16_t angle_max;          /* Highest allowed angle (deg) */
+        fix16_t rate_max;           /* Highest allowed angular rate (deg/s) */
+        uint8_t agc_min;            /* Lowest allowed AGC value */
+        uint8_t agc_max;            /* Highest allowed AGC value */
+        uint8_t read_errors;        /* Consecutive failed reads that trip */
+        uint8_t stale_periods;      /* Interrupt periods without a sample that trip */
+        uint32_t deadline_us;       /* Longest allowed tick completion time */
+        supervisor_action_t action; /* Reaction to a fault */
+    } supervisor_limits_t;
+
+    /**
+     * @brief Supervisor structure (shared between the main loop and the interrupt)
+     */
+    typedef struct
+    {
+        supervisor_limits_t lim;      /* Limits */
+        motor_dev_t *motor;           /* Motor to cut */
+        fix16_t step_max;             /* Angle change per tick at the rate limit */
+        volatile uint32_t faults;     /* Latched fault flags (set by the main loop) */
+        volatile uint32_t isr_faults; /* Latched fault flags (set by the interrupt) */
+        volatile uint8_t armed;       /* Watching (regulation running) */
+        volatile uint8_t idle;        /* Interrupt periods since the last sample */
+        volatile uint32_t heartbeat;  /* Interrupt counter for the watchdog feed */
+        uint8_t read_errors;          /* Consecutive failed reads */
+        uint8_t primed;               /* Previous angle valid */
+        fix16_t prev_angle;           /* Previous angle */
+        fix16_t fault_angle;          /* Angle when the first fault tripped */
+        uint32_t trips;               /* Number of trips since init */
+    } supervisor_t;
+
+    /**
+     * @brief Fill the limits with the default values
+     *
+     * @param[out] lim Pointer to limits structure
+     * @param[in] rate_hz Control tick rate in Hz (sets the deadline to one tick)
+     */
+    void supervisor_default_limits(supervisor_limits_t *lim, uint32_t rate_hz);
+
+    /**
+     * @brief Initialize the supervisor (disarmed, no faults)
+     *
+     * @param[out] sup Pointer to supervisor structure
+     * @param[in] motor Motor cut on a fault
+     * @param[in] lim Limits
+     * @param[in] rate_hz Control tick rate in Hz
+     */
+    void supervisor_init(supervisor_t *sup, motor_dev_t *motor, const supervisor_limits_t *lim,
+                         uint32_t rate_hz);
+
+    /**
+     * @brief Start or stop watching
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     * @param[in] arm 1 to arm, 0 to disarm
+     *
+     * @return 1 if armed, 0 if arming was refused because of latched faults
+     */
+    uint8_t supervisor_arm(supervisor_t *sup, uint8_t arm);
+
+    /**
+     * @brief Clear the latched faults
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     */
+    void supervisor_clear(supervisor_t *sup);
+
+    /**
+     * @brief Check one sample of the regulation loop (called every tick)
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     * @param[in] rslt Result of the sensor read
+     * @param[in] angle Measured angle (deg, ignored on a read error)
+     *
+     * @return Latched fault flags of both sources (0 if the loop may drive the motor)
+     */
+    uint32_t supervisor_check_sample(supervisor_t *sup, as5600_err_t rslt, fix16_t angle);
+
+    /**
+     * @brief Check the magnet status (STATUS register and AGC)
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     * @param[in] status STATUS register value
+     * @param[in] agc AGC register value
+     *
+     * @return Latched fault flags
+     */
+    uint32_t supervisor_check_magnet(supervisor_t *sup, uint8_t status, uint8_t agc);
+
+    /**
+     * @brief Check the completion time of a control tick
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     * @param[in] latency_us Time from the scheduled tick start to the end of the tick
+     *
+     * @return Latched fault flags
+     */
+    uint32_t supervisor_check_deadline(supervisor_t *sup, uint32_t latency_us);
+
+    /**
+     * @brief Periodic check from the highest-priority interrupt
+     *
+     * Trips when the regulation loop has not delivered a sample for the
+     * configured number of periods. Must run more often than the control tick.
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     */
+    void supervisor_isr(supervisor_t *sup);
+
+    /**
+     * @brief Latch a fault and cut the motor
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     * @param[in] faults Fault flags to latch
+     */
+    void supervisor_trip(supervisor_t *sup, uint32_t faults);
+
+    /**
+     * @brief Cut the motor again if a fault is latched
+     *
+     * Called after every motor update of the main loop: an interrupt trip
+     * that lands in the middle of the update is not overwritten by it.
+     *
+     * @param[in,out] sup Pointer to supervisor structure
+     */
+    void supervisor_enforce(supervisor_t *sup);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SUPERVISOR_H */
@@ -0,0 +1,128 @@
+/**
+ * @file supply.h
+ * @brief Motor supply voltage monitor and duty compensation
+ *
+ * The propeller thrust depends on the voltage across the motor, i.e. on the
+ * PWM duty times the supply voltage. When the supply sags under load, the
+ * same duty gives less thrust: the loop gain drops and the feedforward thrust
+ * table no longer matches. The monitor low-pass filters the supply voltage
+ * measured through a resistor divider and, with the compensation enabled,
+ * scales every motor duty by
+ *
+ *   duty' = duty * V_nominal / V_filtered
+ *
+ * so the motor sees the same mean voltage as at the nominal supply (the
+ * voltage the thrust table was calibrated at). Below half the nominal
+ * voltage the motor supply is treated as switched off and nothing is scaled.
+ *
+ * Like the AS5600 and motor drivers, the module is platform-independent; the
+ * user provides a function returning the mean ADC reading of the divider
+ * (on the Pico from a DMA ring filled by the free-running ADC, see main.c).
+ */
+
+#ifndef SUPPLY_H
+#define SUPPLY_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Time constant of the voltage filter (ms)
+ */
+#define SUPPLY_FILTER_TAU_MS 20
+
+/**
+ * @brief Limits of the compensation gain (Q16.16)
+ */
+#define SUPPLY_GAIN_MIN FIX16_FROM_FLOAT(0.5)
+#define SUPPLY_GAIN_MAX FIX16_FROM_FLOAT(2.0)
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        SUPPLY_OK = 0,                /* Operation completed successfully */
+        SUPPLY_ERR_INVALID_PARAM = -1 /* Invalid parameter */
+    } supply_err_t;
+
+    /**
+     * @brief Function pointer for the platform-specific ADC reading
+     *
+     * @param[in] intf_ptr Interface context given to supply_init()
+     *
+     * @return Mean ADC reading of the supply divider (counts)
+     */
+    typedef uint16_t (*supply_read_fptr_t)(void *intf_ptr);
+
+    /**
+     * @brief Supply monitor structure
+     */
+    typedef struct
+    {
+        supply_read_fptr_t read; /* ADC reading function */
+        void *intf_ptr;          /* Interface context (ADC channel, sample buffer) */
+        fix16_t mv_per_count;    /* Supply millivolts per ADC count (divider included) */
+        fix16_t alpha;           /* Filter coefficient per update */
+        fix16_t nominal;         /* Supply voltage the duty is compensated to (V) */
+        fix16_t voltage;         /* Filtered supply voltage (V) */
+        fix16_t gain;            /* Duty scale nominal / voltage (1.0 while not compensating) */
+        uint8_t primed;          /* Filter holds a measurement */
+        uint8_t present;         /* Supply above half the nominal voltage */
+        uint8_t compensate;      /* Compensation enabled flag */
+    } supply_t;
+
+    /**
+     * @brief Initialize the monitor (compensation disabled)
+     *
+     * @param[out] supply Pointer to supply monitor structure
+     * @param[in] read_fptr Pointer to platform-specific ADC reading function
+     * @param[in] mv_per_count Supply millivolts per ADC count (Q16.16, > 0)
+     * @param[in] nominal Nominal supply voltage in volts (Q16.16, > 0)
+     * @param[in] rate_hz Update rate in Hz
+     * @param[in] intf_ptr Interface context passed to the reading function
+     *
+     * @return SUPPLY_OK on success, SUPPLY_ERR_INVALID_PARAM on invalid parameters
+     */
+    supply_err_t supply_init(supply_t *supply, supply_read_fptr_t read_fptr, fix16_t mv_per_count,
+                             fix16_t nominal, uint32_t rate_hz, void *intf_ptr);
+
+    /**
+     * @brief Enable or disable the compensation
+     *
+     * @param[in,out] supply Pointer to supply monitor structure
+     * @param[in] enable 1 to scale the duty to the nominal voltage, 0 to pass it through
+     * @param[in] nominal Nominal voltage in volts (Q16.16); 0 takes the present filtered voltage
+     */
+    void supply_configure(supply_t *supply, uint8_t enable, fix16_t nominal);
+
+    /**
+     * @brief Read and filter the supply voltage, update the compensation gain
+     *
+     * @param[in,out] supply Pointer to supply monitor structure
+     *
+     * @return Filtered supply voltage in volts (Q16.16)
+     */
+    fix16_t supply_update(supply_t *supply);
+
+    /**
+     * @brief Scale a duty to constant effective motor voltage
+     *
+     * @param[in] supply Pointer to supply monitor structure
+     * @param[in] duty Duty at the nominal voltage (Q16.16)
+     *
+     * @return Duty to apply at the present voltage (the motor driver clamps it)
+     */
+    fix16_t supply_compensate(const supply_t *supply, fix16_t duty);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SUPPLY_H */
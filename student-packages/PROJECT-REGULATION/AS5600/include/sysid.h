@@ -0,0 +1,172 @@
+/**
+ * @file sysid.h
+ * @brief System-identification excitation and capture
+ *
+ * Drives the motor open loop around an operating-point duty with a known
+ * excitation and records the applied duty and the measured angle of every
+ * tick into a caller-supplied RAM buffer:
+ *   - PRBS: +/- amplitude, bits from a 16-bit LFSR held for 1 / (2 * f_max),
+ *   - multisine: SYSID_SINES log-spaced harmonics of f_min up to f_max with
+ *     Schroeder phases, scaled to the peak of the sum measured while settling,
+ *   - chirp: sine sweeping logarithmically from f_min to f_max over the capture.
+ *
+ * The pendulum first settles at the operating point for the settle time (not
+ * recorded). Everything runs in fixed point from phase accumulators, so a
+ * tick costs at most SYSID_SINES table lookups. The buffer is read out once
+ * the capture is complete; a host tool fits the plant model to it.
+ */
+
+#ifndef SYSID_H
+#define SYSID_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Number of sines of the multisine excitation
+ */
+#define SYSID_SINES 8
+
+/**
+ * @brief PRBS generator (16-bit Galois LFSR, maximum length) and its seed
+ */
+#define SYSID_PRBS_TAPS 0xB400u
+#define SYSID_PRBS_SEED 0xACE1u
+
+    /**
+     * @brief Enumeration for excitation signals
+     */
+    typedef enum
+    {
+        SYSID_SIGNAL_PRBS = 0,      /* Pseudo-random binary sequence */
+        SYSID_SIGNAL_MULTISINE = 1, /* Sum of sines with Schroeder phases */
+        SYSID_SIGNAL_CHIRP = 2      /* Logarithmic frequency sweep */
+    } sysid_signal_t;
+
+    /**
+     * @brief Enumeration for capture states
+     */
+    typedef enum
+    {
+        SYSID_IDLE = 0,     /* Not started */
+        SYSID_SETTLING = 1, /* Holding the operating point, not recording */
+        SYSID_RUNNING = 2,  /* Exciting and recording */
+        SYSID_DONE = 3,     /* Capture complete */
+        SYSID_ABORTED = 4   /* Aborted before the capture was complete */
+    } sysid_state_t;
+
+    /**
+     * @brief Enumeration for sysid error codes
+     */
+    typedef enum
+    {
+        SYSID_OK = 0,                 /* Operation completed successfully */
+        SYSID_ERR_INVALID_PARAM = -1, /* Invalid parameter */
+        SYSID_ERR_BUFFER = -2         /* Capture does not fit into the buffer */
+    } sysid_err_t;
+
+    /**
+     * @brief Excitation settings
+     */
+    typedef struct
+    {
+        sysid_signal_t signal; /* Excitation signal */
+        fix16_t u0;            /* Operating-point duty */
+        fix16_t amp;           /* Excitation amplitude (duty) */
+        fix16_t f_min;         /* Lowest excited frequency (Hz) */
+        fix16_t f_max;         /* Highest excited frequency (Hz) */
+        uint32_t settle_ticks; /* Ticks at the operating point before recording */
+        uint32_t samples;      /* Ticks to record */
+    } sysid_config_t;
+
+    /**
+     * @brief One recorded tick
+     */
+    typedef struct
+    {
+        int16_t duty;  /* Applied duty (Q1.15, saturated) */
+        int16_t angle; /* Measured angle (centidegrees) */
+    } sysid_sample_t;
+
+    /**
+     * @brief Identification structure
+     */
+    typedef struct
+    {
+        sysid_state_t state;         /* Current state */
+        sysid_config_t cfg;          /* Active settings */
+        uint32_t rate_hz;            /* Tick rate */
+        fix16_t out_min;             /* Lowest motor command */
+        fix16_t out_max;             /* Highest motor command */
+        sysid_sample_t *buf;         /* Capture buffer */
+        uint32_t count;              /* Recorded samples */
+        uint32_t tick;               /* Ticks since the start */
+        uint16_t lfsr;               /* PRBS shift register */
+        uint32_t hold_ticks;         /* Ticks per PRBS bit */
+        uint32_t hold;               /* Ticks left in the current bit */
+        fix16_t level;               /* Current PRBS level */
+        uint8_t sines;               /* Number of multisine components */
+        uint32_t phase[SYSID_SINES]; /* Phase accumulators (full turn = 2^32) */
+        uint32_t inc[SYSID_SINES];   /* Phase increments per tick */
+        fix16_t peak;                /* Largest multisine sum seen while settling */
+        fix16_t gain;                /* Multisine component amplitude */
+        uint32_t chirp_inc0;         /* Chirp phase increment at f_min */
+        int64_t chirp_oct;           /* Chirp position in octaves above f_min (Q32.32) */
+        int64_t chirp_step;          /* Octaves per tick (Q32.32) */
+    } sysid_t;
+
+    /**
+     * @brief Initialize the identification (idle)
+     *
+     * @param[out] id Pointer to identification structure
+     * @param[in] rate_hz Tick rate in Hz
+     * @param[in] out_min Lowest motor command
+     * @param[in] out_max Highest motor command
+     */
+    void sysid_init(sysid_t *id, uint32_t rate_hz, fix16_t out_min, fix16_t out_max);
+
+    /**
+     * @brief Start an excitation and capture
+     *
+     * @param[in,out] id Pointer to identification structure
+     * @param[in] cfg Excitation settings
+     * @param[out] buf Capture buffer
+     * @param[in] capacity Number of samples the buffer holds
+     *
+     * @return SYSID_OK on success, SYSID_ERR_INVALID_PARAM for bad frequencies
+     *         or duties, SYSID_ERR_BUFFER if cfg->samples exceeds the capacity
+     */
+    sysid_err_t sysid_start(sysid_t *id, const sysid_config_t *cfg, sysid_sample_t *buf, uint32_t capacity);
+
+    /**
+     * @brief Abort a running capture (the samples recorded so far stay valid)
+     *
+     * @param[in,out] id Pointer to identification structure
+     */
+    void sysid_abort(sysid_t *id);
+
+    /**
+     * @brief Run one tick: record the sample and return the motor command
+     *
+     * The angle measured in this tick is recorded together with the duty
+     * returned for it, so the response to a duty shows up from the next
+     * sample on.
+     *
+     * @param[in,out] id Pointer to identification structure
+     * @param[in] angle Measured angle (deg)
+     *
+     * @return Motor command for this tick (the operating point once done)
+     */
+    fix16_t sysid_tick(sysid_t *id, fix16_t angle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSID_H */
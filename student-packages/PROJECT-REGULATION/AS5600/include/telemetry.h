@@ -0,0 +1,305 @@
+/**
+ * @file telemetry.h
+ * @brief Binary framed telemetry (COBS, CRC-16, fixed-point channels)
+ *
+ * The text log (printf with %f) costs tens of microseconds of soft-float
+ * formatting per line and about 30 bytes per sample, which limits it to
+ * about 30 Hz. The binary telemetry sends the same columns at the control
+ * rate: every sample is a frame of fixed-point integers,
+ *
+ *   type | schema id | stream | seq (LE16) | payload | CRC-16 (LE16)
+ *
+ * COBS encoded so it contains no zero byte, with a zero delimiter before
+ * and after it. Text printed on the same serial line (command replies) ends
+ * up between two delimiters and is told apart from frames by the CRC, so
+ * both can share the port.
+ *
+ * A schema frame describes the channels of a stream (name, wire type and
+ * fractional bits); its id, the low byte of the CRC of the channel list, is
+ * repeated in every sample frame. The schema is sent with the first sample
+ * and every TELEMETRY_SCHEMA_INTERVAL samples, so a decoder that attaches
+ * late starts within a second at 1 kHz. The sequence number lets it count
+ * lost frames. CRC is CRC-16/CCITT-FALSE over the unencoded frame.
+ *
+ * Delta compression (telemetry_set_batch()): consecutive samples differ by
+ * a few counts, so after a keyframe (a plain sample frame) the following
+ * samples are sent as the difference of every wire value to the previous
+ * sample, zig-zag mapped and as a base-128 varint (1 byte for -64..63).
+ * A time stamp in the first channel (U32) advances by a whole tick period
+ * (1000 us at 1 kHz, 2 bytes), so it is sent as the change of that step
+ * instead: 0 for a steady tick. Several samples share one delta frame; its sequence number is that of its
+ * first sample, the others follow on. A keyframe goes out every
+ * TELEMETRY_KEYFRAME_INTERVAL samples and after a lost frame, so a decoder
+ * that misses a frame (sequence gap) drops deltas until the next keyframe.
+ * The regulation log at 1 kHz shrinks from 22 to about 6 bytes per sample.
+ *
+ * Channel values are passed as int32: integer channels as they are, the
+ * fixed-point ones in Q16.16 (converted to the wire format with rounding
+ * and saturation). Like the drivers, the module is platform-independent;
+ * the user provides the function that writes the encoded bytes.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Limits of a schema
+ */
+#define TELEMETRY_MAX_CHANNELS 8
+#define TELEMETRY_NAME_MAX 15
+
+/**
+ * @brief Frame layout (bytes)
+ */
+#define TELEMETRY_HEADER_SIZE 5
+#define TELEMETRY_CRC_SIZE 2
+#define TELEMETRY_PAYLOAD_MAX (2 + TELEMETRY_MAX_CHANNELS * (3 + TELEMETRY_NAME_MAX))
+#define TELEMETRY_FRAME_MAX (TELEMETRY_HEADER_SIZE + TELEMETRY_PAYLOAD_MAX + TELEMETRY_CRC_SIZE)
+
+/**
+ * @brief Longest encoded frame: COBS overhead and both delimiters
+ */
+#define TELEMETRY_ENCODED_MAX (TELEMETRY_FRAME_MAX + TELEMETRY_FRAME_MAX / 254 + 1 + 2)
+
+/**
+ * @brief Version of the schema frame layout
+ */
+#define TELEMETRY_SCHEMA_VERSION 2
+
+/**
+ * @brief Samples between two schema frames
+ */
+#define TELEMETRY_SCHEMA_INTERVAL 1000
+
+/**
+ * @brief Samples between two keyframes of a delta-compressed stream
+ */
+#define TELEMETRY_KEYFRAME_INTERVAL 250
+
+/**
+ * @brief Most samples in one delta frame (fewer if the payload fills up)
+ */
+#define TELEMETRY_BATCH_MAX 32
+
+/**
+ * @brief Longest varint (32-bit value)
+ */
+#define TELEMETRY_VARINT_MAX 5
+
+/**
+ * @brief Channels of the regulation log (the CSV columns of DATA_LOGGING.md)
+ */
+#define TELEMETRY_LOG_CHANNELS 5
+
+    /**
+     * @brief Enumeration for function return codes
+     */
+    typedef enum
+    {
+        TELEMETRY_OK = 0,                /* Operation completed successfully */
+        TELEMETRY_ERR_INVALID_PARAM = -1 /* Invalid parameter or channel list */
+    } telemetry_err_t;
+
+    /**
+     * @brief Frame types
+     */
+    typedef enum
+    {
+        TELEMETRY_FRAME_SCHEMA = 1, /* Channel list of a stream */
+        TELEMETRY_FRAME_SAMPLE = 2, /* One value per channel (keyframe of a delta-compressed stream) */
+        TELEMETRY_FRAME_DELTA = 3   /* Samples as varint differences to the previous sample */
+    } telemetry_frame_t;
+
+    /**
+     * @brief Wire types of a channel
+     */
+    typedef enum
+    {
+        TELEMETRY_TYPE_U32 = 0, /* Unsigned integer, sent as is */
+        TELEMETRY_TYPE_Q16 = 1, /* Q16.16 value sent as int16 with frac_bits fractional bits */
+        TELEMETRY_TYPE_Q32 = 2  /* Q16.16 value sent as int32 with frac_bits fractional bits */
+    } telemetry_type_t;
+
+    /**
+     * @brief Channel description
+     */
+    typedef struct
+    {
+        const char *name;  /* Column name (up to TELEMETRY_NAME_MAX characters) */
+        uint8_t type;      /* Wire type (telemetry_type_t) */
+        uint8_t frac_bits; /* Fractional bits on the wire (0 - 16, 0 for U32) */
+    } telemetry_channel_t;
+
+    /**
+     * @brief Function pointer for the platform-specific output
+     *
+     * @param[in] data Encoded frame, delimiters included
+     * @param[in] len Number of bytes
+     * @param[in] intf_ptr Interface context given to telemetry_init()
+     *
+     * @return 0 on success, non-zero if the bytes were not sent
+     */
+    typedef int8_t (*telemetry_write_fptr_t)(const uint8_t *data, uint32_t len, void *intf_ptr);
+
+    /**
+     * @brief Telemetry stream structure
+     */
+    typedef struct
+    {
+        telemetry_write_fptr_t write;        /* Output function */
+        void *intf_ptr;                      /* Interface context of the output */
+        const telemetry_channel_t *channels; /* Channel list */
+        uint8_t count;                       /* Number of channels */
+        uint8_t stream;                      /* Stream id (e.g. the rig number) */
+        uint8_t schema_id;                   /* Id of the channel list */
+        uint16_t seq;                        /* Sequence number of the next frame */
+        uint16_t since_schema;               /* Samples since the last schema frame */
+        uint8_t batch;                       /* Samples per delta frame, 0 = no compression */
+        uint8_t pending;                     /* Samples in the open delta frame */
+        uint16_t pending_len;                /* Payload bytes of the open delta frame */
+        uint16_t pending_seq;                /* Sequence number of its first sample */
+        uint16_t since_key;                  /* Samples since the last keyframe */
+        int32_t ref[TELEMETRY_MAX_CHANNELS]; /* Wire values of the previous sample */
+        int32_t step;                        /* Last difference of the time stamp channel */
+        uint8_t frame[TELEMETRY_FRAME_MAX];  /* Open delta frame */
+        uint32_t frames;                     /* Frames sent */
+        uint32_t errors;                     /* Frames the output refused */
+    } telemetry_t;
+
+    /**
+     * @brief Channels of the regulation log: Timestamp (ms), TargetAngle,
+     *        CurrentAngle (deg), MotorPower (duty), SupplyVoltage (V)
+     */
+    extern const telemetry_channel_t telemetry_log_channels[TELEMETRY_LOG_CHANNELS];
+
+    /**
+     * @brief Channels of the live binary log: as telemetry_log_channels, with
+     *        Timestamp_us (us since boot, low 32 bits) instead of Timestamp (ms)
+     */
+    extern const telemetry_channel_t telemetry_log_channels_us[TELEMETRY_LOG_CHANNELS];
+
+    /**
+     * @brief Initialize a stream (the schema goes out with the first sample)
+     *
+     * @param[out] tlm Pointer to telemetry structure
+     * @param[in] channels Channel list (kept by reference)
+     * @param[in] count Number of channels (1 - TELEMETRY_MAX_CHANNELS)
+     * @param[in] stream Stream id
+     * @param[in] write_fptr Pointer to platform-specific output function
+     * @param[in] intf_ptr Interface context passed to the output function
+     *
+     * @return TELEMETRY_OK on success, TELEMETRY_ERR_INVALID_PARAM on invalid parameters
+     */
+    telemetry_err_t telemetry_init(telemetry_t *tlm, const telemetry_channel_t *channels, uint8_t count,
+                                   uint8_t stream, telemetry_write_fptr_t write_fptr, void *intf_ptr);
+
+    /**
+     * @brief Send the schema with the next sample (e.g. when the output is switched on)
+     *
+     * @param[in,out] tlm Pointer to telemetry structure
+     */
+    void telemetry_restart(telemetry_t *tlm);
+
+    /**
+     * @brief Send one sample (preceded by the schema when it is due)
+     *
+     * With delta compression the sample may wait in the open delta frame
+     * until the frame is full; telemetry_flush() sends it at once.
+     *
+     * @param[in,out] tlm Pointer to telemetry structure
+     * @param[in] values One value per channel (integers as is, fixed-point in Q16.16)
+     */
+    void telemetry_send(telemetry_t *tlm, const int32_t *values);
+
+    /**
+     * @brief Switch delta compression on or off (sends the open delta frame)
+     *
+     * @param[in,out] tlm Pointer to telemetry structure
+     * @param[in] batch Samples per delta frame (1 - TELEMETRY_BATCH_MAX), 0 for plain sample frames
+     */
+    void telemetry_set_batch(telemetry_t *tlm, uint8_t batch);
+
+    /**
+     * @brief Send the open delta frame, if any
+     *
+     * @param[in,out] tlm Pointer to telemetry structure
+     */
+    void telemetry_flush(telemetry_t *tlm);
+
+    /**
+     * @brief Account for samples that were never sent (the decoder counts them as lost)
+     *
+     * @param[in,out] tlm Pointer to telemetry structure
+     * @param[in] count Number of samples skipped
+     */
+    void telemetry_skip(telemetry_t *tlm, uint16_t count);
+
+    /**
+     * @brief Update a CRC-16/CCITT-FALSE (start with 0xFFFF)
+     *
+     * @param[in] crc CRC of the preceding bytes
+     * @param[in] data Pointer to data
+     * @param[in] len Number of bytes
+     *
+     * @return Updated CRC
+     */
+    uint16_t telemetry_crc16(uint16_t crc, const uint8_t *data, uint32_t len);
+
+    /**
+     * @brief COBS encode a frame (without delimiters)
+     *
+     * @param[in] src Unencoded frame
+     * @param[in] len Number of bytes
+     * @param[out] dst Output, at least len + len / 254 + 1 bytes
+     *
+     * @return Encoded length
+     */
+    uint32_t telemetry_cobs_encode(const uint8_t *src, uint32_t len, uint8_t *dst);
+
+    /**
+     * @brief COBS decode a frame (the bytes between two delimiters)
+     *
+     * @param[in] src Encoded frame
+     * @param[in] len Number of bytes
+     * @param[out] dst Output
+     * @param[in] size Size of the output
+     *
+     * @return Decoded length, -1 if malformed or too long
+     */
+    int32_t telemetry_cobs_decode(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t size);
+
+    /**
+     * @brief Write a signed value as a zig-zag varint
+     *
+     * @param[in] value Value
+     * @param[out] dst Output, at least TELEMETRY_VARINT_MAX bytes
+     *
+     * @return Number of bytes written (1 - TELEMETRY_VARINT_MAX)
+     */
+    uint8_t telemetry_varint_encode(int32_t value, uint8_t *dst);
+
+    /**
+     * @brief Read a zig-zag varint
+     *
+     * @param[in] src Input
+     * @param[in] len Bytes available
+     * @param[out] value Value
+     *
+     * @return Number of bytes read, -1 if truncated or too long
+     */
+    int32_t telemetry_varint_decode(const uint8_t *src, uint32_t len, int32_t *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,119 @@
+/**
+ * @file trajectory.h
+ * @brief Rate-, acceleration- and jerk-limited setpoint generator
+ *
+ * Sits between the command interface and the controller: a new target angle
+ * is not applied as a step but approached along a trapezoidal (velocity and
+ * acceleration limited) or S-curve (additionally jerk limited) profile. The
+ * profile is computed incrementally, one tick at a time, in fixed point. The
+ * braking point is found from the remaining distance, so the target can be
+ * changed at any time, also while a move is in progress.
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/**
+ * @brief Default limits
+ */
+#define TRAJ_VEL_MAX_DEFAULT FIX16_FROM_INT(90)    /* deg/s */
+#define TRAJ_ACC_MAX_DEFAULT FIX16_FROM_INT(300)   /* deg/s^2 */
+#define TRAJ_JERK_MAX_DEFAULT FIX16_FROM_INT(3000) /* deg/s^3 */
+
+/**
+ * @brief Largest accepted limits (keep the braking arithmetic within Q16.16)
+ */
+#define TRAJ_VEL_MAX_LIMIT FIX16_FROM_INT(10000)  /* deg/s */
+#define TRAJ_ACC_MAX_LIMIT FIX16_FROM_INT(10000)  /* deg/s^2 */
+#define TRAJ_JERK_MAX_LIMIT FIX16_FROM_INT(30000) /* deg/s^3 */
+
+    /**
+     * @brief Enumeration for profile types
+     */
+    typedef enum
+    {
+        TRAJ_PROFILE_STEP = 0,      /* Target applied immediately */
+        TRAJ_PROFILE_TRAPEZOID = 1, /* Velocity and acceleration limited */
+        TRAJ_PROFILE_SCURVE = 2     /* Velocity, acceleration and jerk limited */
+    } traj_profile_t;
+
+    /**
+     * @brief Trajectory generator structure
+     */
+    typedef struct
+    {
+        traj_profile_t profile; /* Profile type */
+        uint32_t rate_hz;       /* Tick rate */
+        fix16_t vel_max;        /* Velocity limit (deg/s) */
+        fix16_t acc_max;        /* Acceleration limit (deg/s^2) */
+        fix16_t jerk_max;       /* Jerk limit (deg/s^3) */
+        fix16_t target;         /* Final target (deg) */
+        fix16_t pos;            /* Reference position (deg) */
+        fix16_t vel;            /* Reference velocity (deg/s) */
+        fix16_t acc;            /* Reference acceleration (deg/s^2) */
+        uint8_t done;           /* Target reached flag */
+    } traj_t;
+
+    /**
+     * @brief Initialize the generator at rest
+     *
+     * @param[out] traj Pointer to trajectory structure
+     * @param[in] rate_hz Tick rate in Hz
+     * @param[in] pos Initial position (deg)
+     */
+    void traj_init(traj_t *traj, uint32_t rate_hz, fix16_t pos);
+
+    /**
+     * @brief Set the profile type and limits
+     *
+     * Non-positive limits select the defaults, limits above TRAJ_*_MAX_LIMIT
+     * are reduced to them.
+     *
+     * @param[in,out] traj Pointer to trajectory structure
+     * @param[in] profile Profile type
+     * @param[in] vel_max Velocity limit (deg/s, > 0)
+     * @param[in] acc_max Acceleration limit (deg/s^2, > 0)
+     * @param[in] jerk_max Jerk limit (deg/s^3, > 0, S-curve only)
+     */
+    void traj_set_limits(traj_t *traj, traj_profile_t profile,
+                         fix16_t vel_max, fix16_t acc_max, fix16_t jerk_max);
+
+    /**
+     * @brief Set a new target; the reference moves there along the profile
+     *
+     * @param[in,out] traj Pointer to trajectory structure
+     * @param[in] target Target position (deg)
+     */
+    void traj_set_target(traj_t *traj, fix16_t target);
+
+    /**
+     * @brief Put the reference at a position at rest (target = position)
+     *
+     * @param[in,out] traj Pointer to trajectory structure
+     * @param[in] pos Position (deg)
+     */
+    void traj_reset(traj_t *traj, fix16_t pos);
+
+    /**
+     * @brief Advance the profile by one tick
+     *
+     * @param[in,out] traj Pointer to trajectory structure
+     *
+     * @return Reference position (deg); velocity and acceleration are in traj->vel / traj->acc
+     */
+    fix16_t traj_step(traj_t *traj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRAJECTORY_H */
@@ -3,7 +3,7 @@
  * @brief AS5600 12-Bit Programmable Contactless Potentiometer driver implementation
  */
 
-#include "as5600.h"
+#include "AS5600.h"
 
 /**
  * @brief Helper function to read a 16-bit value from two consecutive registers
@@ -29,7 +29,7 @@ static as5600_err_t as5600_read_word(const as5600_dev_t *dev, uint8_t reg_addr,
         return AS5600_ERR_NOT_INITIALIZED;
     }
 
-    rslt = dev->read(AS5600_I2C_ADDR, reg_addr, data, 2);
+    rslt = dev->read(AS5600_I2C_ADDR, reg_addr, data, 2, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
@@ -66,7 +66,7 @@ static as5600_err_t as5600_write_word(const as5600_dev_t *dev, uint8_t reg_addr,
     data[0] = (uint8_t)(value >> 8);
     data[1] = (uint8_t)(value & 0xFF);
 
-    rslt = dev->write(AS5600_I2C_ADDR, reg_addr, data, 2);
+    rslt = dev->write(AS5600_I2C_ADDR, reg_addr, data, 2, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
@@ -82,13 +82,15 @@ static as5600_err_t as5600_write_word(const as5600_dev_t *dev, uint8_t reg_addr,
  * @param[in] write_fptr Pointer to platform-specific I2C write function
  * @param[in] read_fptr Pointer to platform-specific I2C read function
  * @param[in] delay_fptr Pointer to platform-specific delay function
+ * @param[in] intf_ptr Interface context passed to the functions (e.g. the I2C bus)
  *
  * @return AS5600_OK on success, error code on failure
  */
 as5600_err_t as5600_init(as5600_dev_t *dev,
                          as5600_i2c_write_fptr_t write_fptr,
                          as5600_i2c_read_fptr_t read_fptr,
-                         as5600_delay_fptr_t delay_fptr)
+                         as5600_delay_fptr_t delay_fptr,
+                         void *intf_ptr)
 {
     uint8_t check_byte;
     int8_t rslt;
@@ -102,12 +104,13 @@ as5600_err_t as5600_init(as5600_dev_t *dev,
     dev->write = write_fptr;
     dev->read = read_fptr;
     dev->delay_ms = delay_fptr;
+    dev->intf_ptr = intf_ptr;
 
     /* Wait for power-up time (10ms as per datasheet) */
-    dev->delay_ms(10);
+    dev->delay_ms(10, dev->intf_ptr);
 
     /* Check if device is accessible by reading the ZMCO register */
-    rslt = dev->read(AS5600_I2C_ADDR, AS5600_ZMCO_REG, &check_byte, 1);
+    rslt = dev->read(AS5600_I2C_ADDR, AS5600_ZMCO_REG, &check_byte, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
@@ -167,13 +170,13 @@ as5600_err_t as5600_set_config(as5600_dev_t *dev, const as5600_config_t *config)
                (config->power_mode & AS5600_CONF_PM_MASK);
 
     /* Write configuration registers */
-    rslt = dev->write(AS5600_I2C_ADDR, AS5600_CONF_HIGH_REG, &conf_high, 1);
+    rslt = dev->write(AS5600_I2C_ADDR, AS5600_CONF_HIGH_REG, &conf_high, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
     }
 
-    rslt = dev->write(AS5600_I2C_ADDR, AS5600_CONF_LOW_REG, &conf_low, 1);
+    rslt = dev->write(AS5600_I2C_ADDR, AS5600_CONF_LOW_REG, &conf_low, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
@@ -213,7 +216,7 @@ as5600_err_t as5600_set_config(as5600_dev_t *dev, const as5600_config_t *config)
     dev->config = *config;
 
     /* Wait for at least 1ms for the configuration to take effect */
-    dev->delay_ms(1);
+    dev->delay_ms(1, dev->intf_ptr);
 
     return AS5600_OK;
 }
@@ -243,13 +246,13 @@ as5600_err_t as5600_get_config(const as5600_dev_t *dev, as5600_config_t *config)
     }
 
     /* Read configuration registers */
-    rslt = dev->read(AS5600_I2C_ADDR, AS5600_CONF_HIGH_REG, &conf_high, 1);
+    rslt = dev->read(AS5600_I2C_ADDR, AS5600_CONF_HIGH_REG, &conf_high, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
     }
 
-    rslt = dev->read(AS5600_I2C_ADDR, AS5600_CONF_LOW_REG, &conf_low, 1);
+    rslt = dev->read(AS5600_I2C_ADDR, AS5600_CONF_LOW_REG, &conf_low, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
@@ -438,6 +441,35 @@ as5600_err_t as5600_get_angle_degrees(const as5600_dev_t *dev, float *angle_deg)
     return AS5600_OK;
 }
 
+/**
+ * @brief Get the angle value in degrees as Q16.16 fixed point
+ *
+ * @param[in] dev Pointer to device structure
+ * @param[out] angle_q16 Pointer to variable to store the angle in degrees (0-360) in Q16.16
+ *
+ * @return AS5600_OK on success, error code on failure
+ */
+as5600_err_t as5600_get_angle_q16(const as5600_dev_t *dev, int32_t *angle_q16)
+{
+    uint16_t angle;
+    as5600_err_t rslt;
+
+    if (!dev || !angle_q16)
+    {
+        return AS5600_ERR_INVALID_PARAM;
+    }
+
+    rslt = as5600_get_angle(dev, &angle);
+    if (rslt != AS5600_OK)
+    {
+        return rslt;
+    }
+
+    /* Convert raw angle (0-4095) to degrees (0-360), exact in Q16.16 */
+    *angle_q16 = (int32_t)angle * AS5600_DEG_Q16_PER_COUNT;
+    return AS5600_OK;
+}
+
 /**
  * @brief Get the AGC value
  *
@@ -460,7 +492,7 @@ as5600_err_t as5600_get_agc(const as5600_dev_t *dev, uint8_t *agc)
         return AS5600_ERR_NOT_INITIALIZED;
     }
 
-    rslt = dev->read(AS5600_I2C_ADDR, AS5600_AGC_REG, agc, 1);
+    rslt = dev->read(AS5600_I2C_ADDR, AS5600_AGC_REG, agc, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
@@ -515,7 +547,7 @@ as5600_err_t as5600_set_start_position(as5600_dev_t *dev, uint16_t position)
     {
         dev->config.start_position = position;
         /* Wait for at least 1ms for the configuration to take effect */
-        dev->delay_ms(1);
+        dev->delay_ms(1, dev->intf_ptr);
     }
 
     return rslt;
@@ -554,7 +586,7 @@ as5600_err_t as5600_set_stop_position(as5600_dev_t *dev, uint16_t position)
     {
         dev->config.stop_position = position;
         /* Wait for at least 1ms for the configuration to take effect */
-        dev->delay_ms(1);
+        dev->delay_ms(1, dev->intf_ptr);
     }
 
     return rslt;
@@ -599,7 +631,7 @@ as5600_err_t as5600_set_max_angle(as5600_dev_t *dev, uint16_t angle)
     {
         dev->config.max_angle = angle;
         /* Wait for at least 1ms for the configuration to take effect */
-        dev->delay_ms(1);
+        dev->delay_ms(1, dev->intf_ptr);
     }
 
     return rslt;
@@ -656,14 +688,14 @@ as5600_err_t as5600_burn_angle(as5600_dev_t *dev)
     }
 
     /* Send the burn command */
-    rslt = dev->write(AS5600_I2C_ADDR, AS5600_BURN_REG, &command, 1);
+    rslt = dev->write(AS5600_I2C_ADDR, AS5600_BURN_REG, &command, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
     }
 
     /* Wait for the burn operation to complete (at least 1ms) */
-    dev->delay_ms(1);
+    dev->delay_ms(1, dev->intf_ptr);
 
     return AS5600_OK;
 }
@@ -708,14 +740,14 @@ as5600_err_t as5600_burn_setting(as5600_dev_t *dev)
     }
 
     /* Send the burn command */
-    rslt = dev->write(AS5600_I2C_ADDR, AS5600_BURN_REG, &command, 1);
+    rslt = dev->write(AS5600_I2C_ADDR, AS5600_BURN_REG, &command, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
     }
 
     /* Wait for the burn operation to complete (at least 1ms) */
-    dev->delay_ms(1);
+    dev->delay_ms(1, dev->intf_ptr);
 
     return AS5600_OK;
 }
@@ -743,7 +775,7 @@ as5600_err_t as5600_get_burn_count(const as5600_dev_t *dev, uint8_t *count)
         return AS5600_ERR_NOT_INITIALIZED;
     }
 
-    rslt = dev->read(AS5600_I2C_ADDR, AS5600_ZMCO_REG, &zmco, 1);
+    rslt = dev->read(AS5600_I2C_ADDR, AS5600_ZMCO_REG, &zmco, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
@@ -775,7 +807,7 @@ as5600_err_t as5600_get_status(const as5600_dev_t *dev, uint8_t *status)
         return AS5600_ERR_NOT_INITIALIZED;
     }
 
-    rslt = dev->read(AS5600_I2C_ADDR, AS5600_STATUS_REG, status, 1);
+    rslt = dev->read(AS5600_I2C_ADDR, AS5600_STATUS_REG, status, 1, dev->intf_ptr);
     if (rslt != 0)
     {
         return AS5600_ERR_COMM;
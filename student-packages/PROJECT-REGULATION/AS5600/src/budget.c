@@ -0,0 +1,105 @@
+/**
+ * @file budget.c
+ * @brief Per-loop CPU and bus time budget implementation
+ */
+
+#include "budget.h"
+
+/**
+ * @brief Initialize an empty budget
+ *
+ * @param[out] budget Pointer to budget structure
+ * @param[in] period_us Tick period in microseconds (> 0)
+ */
+void budget_init(budget_t *budget, uint32_t period_us)
+{
+    budget->period_us = period_us > 0 ? period_us : 1;
+    budget_reset(budget);
+}
+
+/**
+ * @brief Start a new window (the period is kept)
+ *
+ * @param[in,out] budget Pointer to budget structure
+ */
+void budget_reset(budget_t *budget)
+{
+    budget->ticks = 0;
+    budget->cpu_sum = 0;
+    budget->cpu_max = 0;
+    budget->bus_sum = 0;
+    budget->bus_max = 0;
+    budget->late_max = 0;
+    budget->overruns = 0;
+}
+
+/**
+ * @brief Record one tick
+ *
+ * @param[in,out] budget Pointer to budget structure
+ * @param[in] late_us Start of the tick after its scheduled slot (us)
+ * @param[in] cpu_us Run time of the tick (us)
+ * @param[in] bus_us Time the tick occupied its bus (us)
+ */
+void budget_add(budget_t *budget, uint32_t late_us, uint32_t cpu_us, uint32_t bus_us)
+{
+    budget->ticks++;
+    budget->cpu_sum += cpu_us;
+    budget->bus_sum += bus_us;
+
+    if (cpu_us > budget->cpu_max)
+    {
+        budget->cpu_max = cpu_us;
+    }
+    if (bus_us > budget->bus_max)
+    {
+        budget->bus_max = bus_us;
+    }
+    if (late_us > budget->late_max)
+    {
+        budget->late_max = late_us;
+    }
+
+    /* The next slot of this loop has already begun */
+    if (late_us + cpu_us > budget->period_us)
+    {
+        budget->overruns++;
+    }
+}
+
+/**
+ * @brief Mean CPU time per tick over the window
+ *
+ * @param[in] budget Pointer to budget structure
+ *
+ * @return Mean run time in microseconds (0 without ticks)
+ */
+uint32_t budget_cpu_mean(const budget_t *budget)
+{
+    return budget->ticks ? (uint32_t)(budget->cpu_sum / budget->ticks) : 0;
+}
+
+/**
+ * @brief Mean bus time per tick over the window
+ *
+ * @param[in] budget Pointer to budget structure
+ *
+ * @return Mean bus time in microseconds (0 without ticks)
+ */
+uint32_t budget_bus_mean(const budget_t *budget)
+{
+    return budget->ticks ? (uint32_t)(budget->bus_sum / budget->ticks) : 0;
+}
+
+/**
+ * @brief Share of the tick period taken by a time
+ *
+ * @param[in] budget Pointer to budget structure
+ * @param[in] time_us Time per tick in microseconds
+ *
+ * @return Load in permille of the period
+ */
+uint32_t budget_load(const budget_t *budget, uint32_t time_us)
+{
+    return (uint32_t)((uint64_t)time_us * 1000 / budget->period_us);
+}
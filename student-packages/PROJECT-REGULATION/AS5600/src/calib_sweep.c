@@ -0,0 +1,102 @@
+/**
+ * @file calib_sweep.c
+ * @brief Open-loop calibration sweep implementation
+ */
+
+#include "calib_sweep.h"
+
+/**
+ * @brief Start a sweep
+ *
+ * @param[out] sweep Pointer to sweep structure
+ * @param[in] duty_start Duty of the first step
+ * @param[in] duty_end Duty of the last step
+ * @param[in] steps Number of steps (2 - CALIB_SWEEP_MAX_STEPS)
+ * @param[in] settle_ticks Ticks to wait after each duty change
+ * @param[in] avg_ticks Ticks to average the angle over
+ * @param[in] angle_limit Abort when the angle exceeds this value (degrees)
+ */
+void calib_sweep_start(calib_sweep_t *sweep, fix16_t duty_start, fix16_t duty_end, uint8_t steps,
+                       uint32_t settle_ticks, uint32_t avg_ticks, fix16_t angle_limit)
+{
+    if (steps < 2)
+    {
+        steps = 2;
+    }
+    else if (steps > CALIB_SWEEP_MAX_STEPS)
+    {
+        steps = CALIB_SWEEP_MAX_STEPS;
+    }
+
+    sweep->duty_start = duty_start;
+    sweep->duty_step = (duty_end - duty_start) / (steps - 1);
+    sweep->steps = steps;
+    sweep->settle_ticks = settle_ticks;
+    sweep->avg_ticks = avg_ticks > 0 ? avg_ticks : 1;
+    sweep->angle_limit = angle_limit;
+    sweep->index = 0;
+    sweep->tick = 0;
+    sweep->acc = 0;
+    sweep->state = CALIB_SWEEP_RUNNING;
+}
+
+/**
+ * @brief Abort a running sweep
+ *
+ * @param[in,out] sweep Pointer to sweep structure
+ */
+void calib_sweep_abort(calib_sweep_t *sweep)
+{
+    if (sweep->state == CALIB_SWEEP_RUNNING)
+    {
+        sweep->state = CALIB_SWEEP_ABORTED;
+    }
+}
+
+/**
+ * @brief Run one sweep tick
+ *
+ * @param[in,out] sweep Pointer to sweep structure
+ * @param[in] angle Measured angle in degrees
+ *
+ * @return Duty to apply this tick (0 once the sweep is no longer running)
+ */
+fix16_t calib_sweep_tick(calib_sweep_t *sweep, fix16_t angle)
+{
+    fix16_t duty;
+
+    if (sweep->state != CALIB_SWEEP_RUNNING)
+    {
+        return 0;
+    }
+
+    if (angle > sweep->angle_limit)
+    {
+        sweep->state = CALIB_SWEEP_ABORTED;
+        return 0;
+    }
+
+    duty = sweep->duty_start + sweep->duty_step * sweep->index;
+
+    /* Average the angle once the pendulum has settled at this duty */
+    if (sweep->tick >= sweep->settle_ticks)
+    {
+        sweep->acc += angle;
+    }
+
+    if (++sweep->tick >= sweep->settle_ticks + sweep->avg_ticks)
+    {
+        sweep->duty[sweep->index] = duty;
+        sweep->angle[sweep->index] = (fix16_t)(sweep->acc / (int64_t)sweep->avg_ticks);
+        sweep->acc = 0;
+        sweep->tick = 0;
+
+        if (++sweep->index >= sweep->steps)
+        {
+            sweep->state = CALIB_SWEEP_DONE;
+            return 0;
+        }
+    }
+
+    return duty;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file capture.c
+ * @brief Triggered full-rate capture implementation
+ */
+
+#include <stddef.h>
+
+#include "capture.h"
+
+/**
+ * @brief Saturate a value to the int16_t range
+ *
+ * @param[in] x Value
+ *
+ * @return Saturated value
+ */
+static int16_t capture_sat16(int32_t x)
+{
+    return (int16_t)(x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x));
+}
+
+/**
+ * @brief Convert degrees to saturated centidegrees
+ *
+ * @param[in] deg Angle (deg)
+ *
+ * @return Angle (centidegrees)
+ */
+static int16_t capture_centideg(fix16_t deg)
+{
+    return capture_sat16((int32_t)(((int64_t)deg * 100 + FIX16_HALF) >> FIX16_SHIFT));
+}
+
+/**
+ * @brief Initialize the capture (idle)
+ *
+ * @param[out] cap Pointer to capture structure
+ * @param[in] buf Circular buffer (kept by reference)
+ * @param[in] capacity Number of samples the buffer holds
+ */
+void capture_init(capture_t *cap, capture_sample_t *buf, uint32_t capacity)
+{
+    cap->state = CAPTURE_IDLE;
+    cap->buf = buf;
+    cap->capacity = capacity;
+    cap->head = 0;
+    cap->recorded = 0;
+    cap->remaining = 0;
+    cap->start = 0;
+    cap->pre_count = 0;
+    cap->length = 0;
+    cap->cause = CAPTURE_CAUSE_NONE;
+    cap->target = 0;
+    cap->manual = 0;
+}
+
+/**
+ * @brief Start recording and wait for a trigger (discards a previous capture)
+ *
+ * @param[in,out] cap Pointer to capture structure
+ * @param[in] cfg Capture settings
+ *
+ * @return CAPTURE_OK on success, CAPTURE_ERR_INVALID_PARAM if post is 0 or
+ *         pre + post exceeds the capacity
+ */
+capture_err_t capture_arm(capture_t *cap, const capture_config_t *cfg)
+{
+    if (cfg->post == 0 || cfg->pre > cap->capacity || cfg->post > cap->capacity - cfg->pre || cfg->error_band < 0)
+    {
+        return CAPTURE_ERR_INVALID_PARAM;
+    }
+
+    cap->cfg = *cfg;
+    cap->head = 0;
+    cap->recorded = 0;
+    cap->length = 0;
+    cap->cause = CAPTURE_CAUSE_NONE;
+    cap->manual = 0;
+    cap->state = CAPTURE_ARMED;
+
+    return CAPTURE_OK;
+}
+
+/**
+ * @brief Trigger an armed capture at the next recorded tick
+ *
+ * @param[in,out] cap Pointer to capture structure
+ */
+void capture_trigger(capture_t *cap)
+{
+    cap->manual = 1;
+}
+
+/**
+ * @brief Stop recording (a complete capture stays readable)
+ *
+ * @param[in,out] cap Pointer to capture structure
+ */
+void capture_disarm(capture_t *cap)
+{
+    if (cap->state != CAPTURE_DONE)
+    {
+        cap->state = CAPTURE_IDLE;
+    }
+}
+
+/**
+ * @brief Record one tick (does nothing unless armed or triggered)
+ *
+ * @param[in,out] cap Pointer to capture structure
+ * @param[in] target Commanded target (deg)
+ * @param[in] setpoint Setpoint of the tick (deg)
+ * @param[in] angle Measured angle (deg)
+ * @param[in] command Motor command (duty)
+ * @param[in] late_us Start of the tick after its scheduled slot (us)
+ * @param[in] cpu_us Run time of the tick (us)
+ */
+void capture_record(capture_t *cap, fix16_t target, fix16_t setpoint, fix16_t angle, fix16_t command,
+                    uint32_t late_us, uint32_t cpu_us)
+{
+    capture_sample_t *s;
+
+    if (cap->state != CAPTURE_ARMED && cap->state != CAPTURE_TRIGGERED)
+    {
+        return;
+    }
+
+    if (cap->state == CAPTURE_ARMED)
+    {
+        capture_cause_t cause = CAPTURE_CAUSE_NONE;
+
+        if (cap->manual)
+        {
+            cause = CAPTURE_CAUSE_MANUAL;
+        }
+        else if (cap->cfg.on_target && cap->recorded > 0 && target != cap->target)
+        {
+            cause = CAPTURE_CAUSE_TARGET;
+        }
+        else if (cap->cfg.error_band > 0 && fix16_abs(setpoint - angle) > cap->cfg.error_band)
+        {
+            cause = CAPTURE_CAUSE_ERROR;
+        }
+        cap->target = target;
+
+        /* This tick is the trigger sample, the history before it is the pre-trigger part */
+        if (cause != CAPTURE_CAUSE_NONE)
+        {
+            cap->cause = cause;
+            cap->pre_count = cap->recorded < cap->cfg.pre ? cap->recorded : cap->cfg.pre;
+            cap->start = cap->head >= cap->pre_count ? cap->head - cap->pre_count
+                                                     : cap->head + cap->capacity - cap->pre_count;
+            cap->remaining = cap->cfg.post;
+            cap->state = CAPTURE_TRIGGERED;
+        }
+    }
+
+    s = &cap->buf[cap->head];
+    s->setpoint = capture_centideg(setpoint);
+    s->angle = capture_centideg(angle);
+    s->command = capture_sat16(command >> 1);
+    s->late_us = (uint16_t)(late_us > UINT16_MAX ? UINT16_MAX : late_us);
+    s->cpu_us = (uint16_t)(cpu_us > UINT16_MAX ? UINT16_MAX : cpu_us);
+
+    if (++cap->head == cap->capacity)
+    {
+        cap->head = 0;
+    }
+    if (cap->recorded < cap->capacity)
+    {
+        cap->recorded++;
+    }
+
+    if (cap->state == CAPTURE_TRIGGERED && --cap->remaining == 0)
+    {
+        cap->length = cap->pre_count + cap->cfg.post;
+        cap->manual = 0;
+        cap->state = CAPTURE_DONE;
+    }
+}
+
+/**
+ * @brief Sample of a complete capture
+ *
+ * @param[in] cap Pointer to capture structure
+ * @param[in] index Sample number, 0 for the oldest; the trigger sample is cap->pre_count
+ *
+ * @return Pointer to the sample, NULL if the capture is not complete or index is out of range
+ */
+const capture_sample_t *capture_get(const capture_t *cap, uint32_t index)
+{
+    uint32_t pos;
+
+    if (cap->state != CAPTURE_DONE || index >= cap->length)
+    {
+        return NULL;
+    }
+
+    pos = cap->start + index;
+    if (pos >= cap->capacity)
+    {
+        pos -= cap->capacity;
+    }
+
+    return &cap->buf[pos];
+}
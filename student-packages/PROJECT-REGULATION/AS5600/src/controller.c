@@ -0,0 +1,370 @@
+/**
+ * @file controller.c
+ * @brief Pendulum angle controller implementation
+ */
+
+#include "controller.h"
+
+/**
+ * @brief Hand coefficients to the PID stage with the gain scale applied (bumpless)
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] coeffs Nominal coefficients
+ */
+static void controller_load_coeffs(controller_t *ctrl, const pid_coeffs_t *coeffs)
+{
+    pid_coeffs_t scaled = *coeffs;
+
+    if (ctrl->gain_scale != FIX16_ONE)
+    {
+        scaled.kp = fix16_mul(coeffs->kp, ctrl->gain_scale);
+        scaled.ki = fix16_mul(coeffs->ki, ctrl->gain_scale);
+        scaled.kd = fix16_mul(coeffs->kd, ctrl->gain_scale);
+    }
+
+    pid_set_coeffs(&ctrl->pid, &scaled);
+}
+
+/**
+ * @brief Initialize the controller
+ *
+ * @param[out] ctrl Pointer to controller structure
+ * @param[in] gains Fixed PID gains (used while the schedule is off)
+ * @param[in] rate_hz Tick rate in Hz
+ * @param[in] out_min Output lower limit
+ * @param[in] out_max Output upper limit
+ */
+void controller_init(controller_t *ctrl, const pid_gains_t *gains, uint32_t rate_hz,
+                     fix16_t out_min, fix16_t out_max)
+{
+    ctrl->rate_hz = rate_hz;
+    ctrl->sched_enabled = 0;
+    ctrl->target = 0;
+    ctrl->setpoint = 0;
+    ctrl->angle = 0;
+    ctrl->output = 0;
+
+    pid_init(&ctrl->pid, gains, rate_hz, out_min, out_max);
+    ctrl->gains = *gains;
+    ctrl->coeffs = ctrl->pid.coeffs;
+    gain_sched_init(&ctrl->sched, GAIN_SCHED_SRC_SETPOINT, rate_hz);
+
+    /* Neutral angle and thrust range are set up by the owner (see regulator_init) */
+    ff_init(&ctrl->ff, 0, FIX16_ONE);
+    ctrl->ff_enabled = 0;
+    ctrl->ff_term = 0;
+
+    dob_init(&ctrl->dob, rate_hz);
+    ctrl->dob_enabled = 0;
+    ctrl->dob_term = 0;
+
+    lqr_init(&ctrl->lqr);
+    ctrl->lqr_enabled = 0;
+
+    predictor_init(&ctrl->pred, rate_hz);
+    ctrl->pred_modes = 0;
+    ctrl->gain_scale = FIX16_ONE;
+
+    traj_init(&ctrl->traj, rate_hz, 0);
+}
+
+/**
+ * @brief Set the fixed PID gains (bumpless)
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] gains New gains
+ */
+void controller_set_gains(controller_t *ctrl, const pid_gains_t *gains)
+{
+    ctrl->gains = *gains;
+    pid_discretize(gains, ctrl->rate_hz, &ctrl->coeffs);
+
+    if (!ctrl->sched_enabled)
+    {
+        controller_load_coeffs(ctrl, &ctrl->coeffs);
+    }
+}
+
+/**
+ * @brief Enable or disable the gain schedule (bumpless)
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] enable 1 to schedule gains from the table, 0 to use the fixed gains
+ */
+void controller_enable_schedule(controller_t *ctrl, uint8_t enable)
+{
+    if (enable && ctrl->sched.count == 0)
+    {
+        return;
+    }
+
+    if (enable && !ctrl->sched_enabled)
+    {
+        /* Restart the scheduling filter from the current operating point */
+        ctrl->sched.primed = 0;
+    }
+    else if (!enable && ctrl->sched_enabled)
+    {
+        controller_load_coeffs(ctrl, &ctrl->coeffs);
+    }
+
+    ctrl->sched_enabled = enable ? 1 : 0;
+}
+
+/**
+ * @brief Enable or disable the feedforward (bumpless)
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] enable 1 to add the feedforward to the output, 0 to disable it
+ */
+void controller_enable_feedforward(controller_t *ctrl, uint8_t enable)
+{
+    ctrl->ff_enabled = enable ? 1 : 0;
+    ctrl->ff_term = ctrl->ff_enabled ? ff_eval(&ctrl->ff, ctrl->setpoint, ctrl->traj.vel, ctrl->traj.acc) : 0;
+    pid_transfer_ff(&ctrl->pid, ctrl->ff_term + ctrl->dob_term);
+}
+
+/**
+ * @brief Enable or disable the disturbance compensation (bumpless)
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] enable 1 to cancel the estimated disturbance, 0 to disable it
+ */
+void controller_enable_dob(controller_t *ctrl, uint8_t enable)
+{
+    ctrl->dob_enabled = enable ? 1 : 0;
+    ctrl->dob_term = ctrl->dob_enabled ? dob_correction(&ctrl->dob, &ctrl->ff, ctrl->output) : 0;
+    pid_transfer_ff(&ctrl->pid, ctrl->ff_term + ctrl->dob_term);
+}
+
+/**
+ * @brief Switch between the PID stage and the state feedback
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] enable 1 to run the state feedback, 0 to run the PID stage
+ */
+void controller_enable_lqr(controller_t *ctrl, uint8_t enable)
+{
+    if (enable && ctrl->lqr.count == 0)
+    {
+        return;
+    }
+
+    if (!enable && ctrl->lqr_enabled)
+    {
+        /* The PID stage did not run meanwhile: restart it from the last output */
+        ctrl->ff_term = ctrl->ff_enabled ? ff_eval(&ctrl->ff, ctrl->setpoint, ctrl->traj.vel, ctrl->traj.acc) : 0;
+        ctrl->dob_term = ctrl->dob_enabled ? dob_correction(&ctrl->dob, &ctrl->ff, ctrl->output) : 0;
+        pid_reset(&ctrl->pid, ctrl->output - ctrl->ff_term - ctrl->dob_term);
+        ctrl->sched.primed = 0;
+    }
+
+    ctrl->lqr_enabled = enable ? 1 : 0;
+}
+
+/**
+ * @brief Select the controller modes that act on the latency-compensated angle
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] modes Bit mask of CONTROLLER_PRED_PID and CONTROLLER_PRED_LQR
+ */
+void controller_enable_predictor(controller_t *ctrl, uint8_t modes)
+{
+    modes &= CONTROLLER_PRED_PID | CONTROLLER_PRED_LQR;
+
+    if ((modes ^ ctrl->pred_modes) & CONTROLLER_PRED_PID)
+    {
+        /* The measurement jumps by the prediction: restart the derivative from it */
+        ctrl->pid.primed = 0;
+    }
+
+    ctrl->pred_modes = modes;
+}
+
+/**
+ * @brief Scale the feedback gains of the PID stage and the state feedback (bumpless)
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] scale Gain scale (Q16.16, 1.0 = nominal, > 0)
+ */
+void controller_set_gain_scale(controller_t *ctrl, fix16_t scale)
+{
+    if (scale <= 0 || scale == ctrl->gain_scale)
+    {
+        return;
+    }
+
+    ctrl->gain_scale = scale;
+
+    /* A running schedule picks the scale up with its next evaluation */
+    if (!ctrl->sched_enabled)
+    {
+        controller_load_coeffs(ctrl, &ctrl->coeffs);
+    }
+}
+
+/**
+ * @brief Read the active settings as a parameter set
+ *
+ * @param[in] ctrl Pointer to controller structure
+ * @param[out] params Parameter set
+ */
+void controller_get_params(const controller_t *ctrl, ctrl_params_t *params)
+{
+    params->gains = ctrl->gains;
+    params->d_alpha = ctrl->pid.d_alpha;
+    params->i_limit = ctrl->pid.i_limit;
+    params->target = ctrl->target;
+    params->profile = ctrl->traj.profile;
+    params->vel_max = ctrl->traj.vel_max;
+    params->acc_max = ctrl->traj.acc_max;
+    params->jerk_max = ctrl->traj.jerk_max;
+    params->ff_k_vel = ctrl->ff.k_vel;
+    params->ff_k_acc = ctrl->ff.k_acc;
+    params->dob_bandwidth = ctrl->dob.bandwidth;
+    params->dob_motor_tau_ms = ctrl->dob.motor_tau_ms;
+    params->sched_enabled = ctrl->sched_enabled;
+    params->ff_enabled = ctrl->ff_enabled;
+    params->dob_enabled = ctrl->dob_enabled;
+    params->lqr_enabled = ctrl->lqr_enabled;
+    params->pred_delay_us = ctrl->pred.delay_us;
+    params->pred_modes = ctrl->pred_modes;
+}
+
+/**
+ * @brief Apply a complete parameter set (bumpless)
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] params Parameter set
+ */
+void controller_apply_params(controller_t *ctrl, const ctrl_params_t *params)
+{
+    /* Model first: the feedforward and observer switches below evaluate it */
+    ff_set_dynamics(&ctrl->ff, params->ff_k_vel, params->ff_k_acc);
+    dob_configure(&ctrl->dob, params->dob_bandwidth, params->dob_motor_tau_ms);
+    predictor_set_delay(&ctrl->pred, params->pred_delay_us);
+
+    controller_set_gains(ctrl, &params->gains);
+    pid_set_tuning(&ctrl->pid, params->d_alpha, params->i_limit);
+    traj_set_limits(&ctrl->traj, params->profile, params->vel_max, params->acc_max, params->jerk_max);
+    if (params->target != ctrl->target)
+    {
+        controller_set_setpoint(ctrl, params->target);
+    }
+
+    controller_enable_schedule(ctrl, params->sched_enabled);
+    controller_enable_feedforward(ctrl, params->ff_enabled);
+    controller_enable_dob(ctrl, params->dob_enabled);
+    controller_enable_lqr(ctrl, params->lqr_enabled);
+    controller_enable_predictor(ctrl, params->pred_modes);
+}
+
+/**
+ * @brief Set the target; the setpoint follows along the trajectory profile
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] setpoint Target in degrees
+ */
+void controller_set_setpoint(controller_t *ctrl, fix16_t setpoint)
+{
+    ctrl->target = setpoint;
+    traj_set_target(&ctrl->traj, setpoint);
+    ctrl->setpoint = ctrl->traj.pos;
+}
+
+/**
+ * @brief Reset the controller state
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] angle Measured angle in degrees
+ * @param[in] output Integrator preload (the feedforward is added on top)
+ */
+void controller_reset(controller_t *ctrl, fix16_t angle, fix16_t output)
+{
+    /* Ramp from where the pendulum is instead of stepping to the target */
+    traj_reset(&ctrl->traj, angle);
+    traj_set_target(&ctrl->traj, ctrl->target);
+    ctrl->setpoint = ctrl->traj.pos;
+    ctrl->angle = angle;
+
+    pid_reset(&ctrl->pid, output);
+    ctrl->sched.primed = 0;
+    ctrl->output = ctrl->pid.output;
+
+    dob_reset(&ctrl->dob, angle, ff_duty_to_thrust(&ctrl->ff, ctrl->output));
+    ctrl->dob_term = 0;
+}
+
+/**
+ * @brief Run one control tick
+ *
+ * @param[in,out] ctrl Pointer to controller structure
+ * @param[in] angle Measured angle in degrees
+ *
+ * @return Motor duty (Q16.16)
+ */
+fix16_t controller_step(controller_t *ctrl, fix16_t angle)
+{
+    ctrl->angle = angle;
+    ctrl->setpoint = traj_step(&ctrl->traj);
+
+    /* The previous output has been driving the motor until this sample */
+    dob_update(&ctrl->dob, &ctrl->ff, angle, ctrl->output);
+    predictor_push(&ctrl->pred, ctrl->dob.thrust);
+
+    if (ctrl->lqr_enabled)
+    {
+        lqr_gains_t gains;
+
+        if (lqr_eval(&ctrl->lqr, ctrl->setpoint, &gains) == LQR_OK)
+        {
+            fix16_t pos = (fix16_t)(ctrl->dob.pos >> FIX16_SHIFT);
+            fix16_t vel = (fix16_t)(ctrl->dob.vel >> FIX16_SHIFT);
+            fix16_t thrust;
+
+            if (ctrl->gain_scale != FIX16_ONE)
+            {
+                gains.k_pos = fix16_mul(gains.k_pos, ctrl->gain_scale);
+                gains.k_vel = fix16_mul(gains.k_vel, ctrl->gain_scale);
+                gains.k_thr = fix16_mul(gains.k_thr, ctrl->gain_scale);
+            }
+
+            if (ctrl->pred_modes & CONTROLLER_PRED_LQR)
+            {
+                pos = predictor_run(&ctrl->pred, &ctrl->ff, &ctrl->dob, pos, vel);
+                vel = ctrl->pred.rate;
+            }
+
+            thrust = lqr_thrust(&gains, &ctrl->ff, &ctrl->dob, pos, vel, ctrl->setpoint, ctrl->traj.vel,
+                                ctrl->traj.acc);
+            ctrl->output = fix16_clamp(ff_thrust_to_duty(&ctrl->ff, thrust), ctrl->pid.out_min, ctrl->pid.out_max);
+            return ctrl->output;
+        }
+    }
+
+    /* Act on the angle of now rather than the one the sensor filter and the bus delayed */
+    if (ctrl->pred_modes & CONTROLLER_PRED_PID)
+    {
+        angle = predictor_run(&ctrl->pred, &ctrl->ff, &ctrl->dob, angle, (fix16_t)(ctrl->dob.vel >> FIX16_SHIFT));
+    }
+
+    if (ctrl->sched_enabled)
+    {
+        pid_coeffs_t coeffs;
+        fix16_t var = (ctrl->sched.source == GAIN_SCHED_SRC_ANGLE) ? angle : ctrl->setpoint;
+
+        if (gain_sched_eval(&ctrl->sched, var, &coeffs) == GAIN_SCHED_OK)
+        {
+            controller_load_coeffs(ctrl, &coeffs);
+        }
+    }
+
+    /* Thrust for the reference motion; the PID only has to correct the residual */
+    ctrl->ff_term = ctrl->ff_enabled ? ff_eval(&ctrl->ff, ctrl->setpoint, ctrl->traj.vel, ctrl->traj.acc) : 0;
+
+    /* Cancel the estimated external torque before the PID has to see it as an error */
+    ctrl->dob_term = ctrl->dob_enabled ? dob_correction(&ctrl->dob, &ctrl->ff, ctrl->output) : 0;
+
+    ctrl->output = pid_step(&ctrl->pid, ctrl->setpoint, angle, ctrl->ff_term + ctrl->dob_term);
+    return ctrl->output;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file ctrl_params.c
+ * @brief Double-buffered controller parameter block implementation
+ */
+
+#include "ctrl_params.h"
+
+/**
+ * @brief Initialize the block with the active parameter set (generation 0)
+ *
+ * @param[out] pb Pointer to parameter block
+ * @param[in] params Parameters the controller runs with
+ */
+void ctrl_params_init(ctrl_params_block_t *pb, const ctrl_params_t *params)
+{
+    pb->slot[0] = *params;
+    pb->slot[1] = *params;
+    pb->shadow = *params;
+    pb->gen = 0;
+    pb->ack = 0;
+    pb->dirty = 0;
+}
+
+/**
+ * @brief Shadow copy to edit (command side)
+ *
+ * @param[in,out] pb Pointer to parameter block
+ *
+ * @return Pointer to the shadow parameter set
+ */
+ctrl_params_t *ctrl_params_edit(ctrl_params_block_t *pb)
+{
+    pb->dirty = 1;
+    return &pb->shadow;
+}
+
+/**
+ * @brief Publish the edited shadow as a new generation (command side)
+ *
+ * @param[in,out] pb Pointer to parameter block
+ *
+ * @return CTRL_PARAMS_OK if published or nothing was pending,
+ *         CTRL_PARAMS_ERR_BUSY if the tick has not picked up the previous generation yet
+ */
+ctrl_params_err_t ctrl_params_publish(ctrl_params_block_t *pb)
+{
+    uint32_t next = pb->gen + 1;
+
+    if (!pb->dirty)
+    {
+        return CTRL_PARAMS_OK;
+    }
+
+    /*
+     * slot[next & 1] last held generation next - 2. The reader only copies a
+     * generation it has not acknowledged, so once it acknowledged next - 2
+     * (gen - ack <= 1) nobody reads that slot any more.
+     */
+    if (next - pb->ack > 2)
+    {
+        return CTRL_PARAMS_ERR_BUSY;
+    }
+
+    pb->slot[next & 1] = pb->shadow;
+    CTRL_PARAMS_BARRIER();
+    pb->gen = next;
+    pb->dirty = 0;
+
+    return CTRL_PARAMS_OK;
+}
+
+/**
+ * @brief Take the newest published generation (control tick)
+ *
+ * @param[in,out] pb Pointer to parameter block
+ * @param[out] params Copy of the new parameter set
+ *
+ * @return 1 if a new generation was copied, 0 if nothing changed
+ */
+uint8_t ctrl_params_acquire(ctrl_params_block_t *pb, ctrl_params_t *params)
+{
+    uint32_t gen = pb->gen;
+
+    if (gen == pb->ack)
+    {
+        return 0;
+    }
+
+    CTRL_PARAMS_BARRIER();
+    *params = pb->slot[gen & 1];
+    CTRL_PARAMS_BARRIER();
+    pb->ack = gen;
+
+    return 1;
+}
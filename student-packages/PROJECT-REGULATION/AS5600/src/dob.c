@@ -0,0 +1,163 @@
+/**
+ * @file dob.c
+ * @brief Disturbance observer implementation
+ */
+
+#include "dob.h"
+
+/**
+ * @brief Scale a Q16.16 value by a Q32.32 factor
+ *
+ * @param[in] x Value (Q16.16)
+ * @param[in] k Factor (Q32.32)
+ *
+ * @return Product (Q32.32)
+ */
+static int64_t dob_scale(fix16_t x, int64_t k)
+{
+    return ((int64_t)x * k) >> FIX16_SHIFT;
+}
+
+/**
+ * @brief Compute the per-tick gains for the bandwidth and the model inertia
+ *
+ * Poles of s^3 + l1 s^2 + l2 s + l3 / k_acc placed at -bandwidth (triple):
+ * l1 = 3 w, l2 = 3 w^2, l3 = w^3 * k_acc.
+ *
+ * @param[in,out] dob Pointer to observer structure
+ * @param[in] k_acc Model inertia (thrust per deg/s^2, Q8.24, > 0)
+ */
+static void dob_compute_gains(dob_t *dob, int32_t k_acc)
+{
+    const int64_t w = dob->bandwidth;
+
+    dob->dt = ((int64_t)1 << 32) / dob->rate_hz;
+    dob->l_pos = ((3 * w) << 32) / dob->rate_hz;
+    dob->l_vel = ((3 * w * w) << 32) / dob->rate_hz;
+    /* Q8.24 * 2^8 = Q32.32 */
+    dob->l_dist = ((w * w * w * k_acc) << 8) / dob->rate_hz;
+    dob->b = ((int64_t)1 << 56) / ((int64_t)k_acc * dob->rate_hz);
+    dob->k_acc = k_acc;
+
+    if (dob->motor_tau_ms == 0)
+    {
+        dob->lag = FIX16_ONE;
+    }
+    else
+    {
+        dob->lag = (fix16_t)(((int64_t)1000 << FIX16_SHIFT) / ((int64_t)dob->motor_tau_ms * dob->rate_hz));
+        dob->lag = dob->lag < FIX16_ONE ? dob->lag : FIX16_ONE;
+    }
+}
+
+/**
+ * @brief Initialize the observer with the default settings
+ *
+ * @param[out] dob Pointer to observer structure
+ * @param[in] rate_hz Tick rate in Hz
+ */
+void dob_init(dob_t *dob, uint32_t rate_hz)
+{
+    dob->rate_hz = rate_hz;
+    dob->bandwidth = DOB_BANDWIDTH_DEFAULT;
+    dob->motor_tau_ms = DOB_MOTOR_TAU_MS_DEFAULT;
+    dob_compute_gains(dob, FF_K_ACC_DEFAULT);
+    dob_reset(dob, 0, 0);
+}
+
+/**
+ * @brief Set the observer bandwidth and the modelled motor lag
+ *
+ * @param[in,out] dob Pointer to observer structure
+ * @param[in] bandwidth Observer bandwidth in rad/s (1 to rate_hz / DOB_BANDWIDTH_RATE_DIVIDER)
+ * @param[in] motor_tau_ms Motor time constant in ms (0 to DOB_MOTOR_TAU_MS_MAX)
+ *
+ * @return DOB_OK on success, DOB_ERR_INVALID_PARAM if out of range (unchanged)
+ */
+dob_err_t dob_configure(dob_t *dob, uint16_t bandwidth, uint16_t motor_tau_ms)
+{
+    if (bandwidth == 0 || bandwidth > dob->rate_hz / DOB_BANDWIDTH_RATE_DIVIDER ||
+        motor_tau_ms > DOB_MOTOR_TAU_MS_MAX)
+    {
+        return DOB_ERR_INVALID_PARAM;
+    }
+
+    dob->bandwidth = bandwidth;
+    dob->motor_tau_ms = motor_tau_ms;
+    dob_compute_gains(dob, dob->k_acc);
+    return DOB_OK;
+}
+
+/**
+ * @brief Restart the observer at rest
+ *
+ * @param[in,out] dob Pointer to observer structure
+ * @param[in] angle Measured angle in degrees
+ * @param[in] thrust Thrust of the current duty (gravity units)
+ */
+void dob_reset(dob_t *dob, fix16_t angle, fix16_t thrust)
+{
+    dob->pos = (int64_t)angle << FIX16_SHIFT;
+    dob->vel = 0;
+    dob->dist = 0;
+    dob->thrust = thrust;
+    dob->estimate = 0;
+}
+
+/**
+ * @brief Run one observer tick
+ *
+ * @param[in,out] dob Pointer to observer structure
+ * @param[in] ff Model (neutral, thrust table, velocity and inertia coefficients)
+ * @param[in] angle Measured angle in degrees
+ * @param[in] duty Duty applied since the previous tick
+ *
+ * @return Disturbance estimate (gravity units, positive acts like extra thrust)
+ */
+fix16_t dob_update(dob_t *dob, const feedforward_t *ff, fix16_t angle, fix16_t duty)
+{
+    fix16_t pos = (fix16_t)(dob->pos >> FIX16_SHIFT);
+    fix16_t vel = (fix16_t)(dob->vel >> FIX16_SHIFT);
+    fix16_t err = angle - pos;
+    int64_t net;
+
+    if (ff->k_acc <= 0)
+    {
+        return dob->estimate;
+    }
+    if (ff->k_acc != dob->k_acc)
+    {
+        /* Inertia changed (FFDYN): the disturbance gain and the input scale follow */
+        dob_compute_gains(dob, ff->k_acc);
+    }
+
+    /* Thrust reaching the pendulum, behind the motor lag */
+    dob->thrust += fix16_mul(dob->lag, ff_duty_to_thrust(ff, duty) - dob->thrust);
+
+    /* Net thrust accelerating the pendulum (Q8.24 * Q16.16 = Q24.40 -> Q16.16) */
+    net = (int64_t)dob->thrust + dob->estimate - ff_gravity_thrust(ff, angle) -
+          (((int64_t)ff->k_vel * vel) >> 24);
+
+    dob->pos += dob_scale(vel, dob->dt) + dob_scale(err, dob->l_pos);
+    dob->vel += dob_scale(fix16_sat(net), dob->b) + dob_scale(err, dob->l_vel);
+    dob->dist += dob_scale(err, dob->l_dist);
+
+    dob->estimate = fix16_sat(dob->dist >> FIX16_SHIFT);
+    return dob->estimate;
+}
+
+/**
+ * @brief Duty correction cancelling the estimated disturbance
+ *
+ * @param[in] dob Pointer to observer structure
+ * @param[in] ff Thrust table
+ * @param[in] duty Operating duty
+ *
+ * @return Duty to add to the operating duty
+ */
+fix16_t dob_correction(const dob_t *dob, const feedforward_t *ff, fix16_t duty)
+{
+    fix16_t thrust = ff_duty_to_thrust(ff, duty);
+
+    return ff_thrust_to_duty(ff, fix16_add(thrust, -dob->estimate)) - ff_thrust_to_duty(ff, thrust);
+}
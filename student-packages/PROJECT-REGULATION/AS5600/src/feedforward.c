@@ -0,0 +1,253 @@
+/**
+ * @file feedforward.c
+ * @brief Gravity and thrust feedforward implementation
+ */
+
+#include "feedforward.h"
+
+/**
+ * @brief Thrust below which a sweep point counts as dead zone (about 0.6 degrees)
+ */
+#define FF_DEADZONE_THRUST FIX16_FROM_FLOAT(0.01)
+
+/**
+ * @brief Initialize the feedforward with an uncalibrated quadratic thrust model
+ *
+ * @param[out] ff Pointer to feedforward structure
+ * @param[in] neutral Angle with zero gravity torque (degrees)
+ * @param[in] thrust_max Thrust at full duty (gravity units)
+ */
+void ff_init(feedforward_t *ff, fix16_t neutral, fix16_t thrust_max)
+{
+    ff->neutral = neutral;
+    ff->gain = FIX16_ONE;
+    ff->thrust_max = thrust_max;
+    ff->inv_step = fix16_div(FIX16_FROM_INT(FF_THRUST_POINTS - 1), thrust_max);
+    ff->k_vel = 0;
+    ff->k_acc = FF_K_ACC_DEFAULT;
+
+    /* duty = sqrt(thrust / thrust_max) */
+    for (uint8_t i = 0; i < FF_THRUST_POINTS; i++)
+    {
+        uint64_t ratio_q32 = ((uint64_t)i << 32) / (FF_THRUST_POINTS - 1);
+        ff->duty[i] = (fix16_t)fix16_isqrt64(ratio_q32);
+    }
+}
+
+/**
+ * @brief Build the thrust -> duty table from a calibration sweep
+ *
+ * @param[in,out] ff Pointer to feedforward structure
+ * @param[in] duty Applied duties (Q16.16)
+ * @param[in] angle Settled angles in degrees (Q16.16)
+ * @param[in] count Number of points
+ *
+ * @return FF_OK on success, error code on failure (table unchanged)
+ */
+ff_err_t ff_build_table(feedforward_t *ff, const fix16_t *duty, const fix16_t *angle, uint8_t count)
+{
+    fix16_t pt_duty[FF_CAL_MAX_POINTS];
+    fix16_t pt_thrust[FF_CAL_MAX_POINTS];
+    uint8_t n = 0;
+    uint8_t start = 0;
+    fix16_t thrust_max, inv_step;
+
+    if (!ff || !duty || !angle || count < 2 || count > FF_CAL_MAX_POINTS)
+    {
+        return FF_ERR_INVALID_PARAM;
+    }
+
+    /* The point before the first angle rise (last duty without thrust) anchors thrust 0 */
+    while (start < count && ff_gravity_thrust(ff, angle[start]) <= FF_DEADZONE_THRUST)
+    {
+        start++;
+    }
+    if (start == count)
+    {
+        return FF_ERR_NO_RANGE;
+    }
+    if (start == 0)
+    {
+        return FF_ERR_NO_DEADZONE;
+    }
+    start--;
+
+    /* Keep a strictly increasing thrust curve */
+    for (uint8_t i = start; i < count; i++)
+    {
+        fix16_t thrust = ff_gravity_thrust(ff, angle[i]);
+
+        if (n == 0)
+        {
+            pt_duty[0] = duty[i];
+            pt_thrust[0] = 0;
+            n = 1;
+        }
+        else if (thrust > pt_thrust[n - 1] && duty[i] > pt_duty[n - 1])
+        {
+            pt_duty[n] = duty[i];
+            pt_thrust[n] = thrust;
+            n++;
+        }
+    }
+
+    if (n < 2)
+    {
+        return FF_ERR_NO_RANGE;
+    }
+
+    thrust_max = pt_thrust[n - 1];
+    inv_step = fix16_div(FIX16_FROM_INT(FF_THRUST_POINTS - 1), thrust_max);
+
+    /* Resample the measured curve onto the uniform thrust grid */
+    uint8_t seg = 0;
+    for (uint8_t i = 0; i < FF_THRUST_POINTS; i++)
+    {
+        fix16_t thrust = (fix16_t)(((int64_t)thrust_max * i) / (FF_THRUST_POINTS - 1));
+
+        while (seg < n - 2 && thrust > pt_thrust[seg + 1])
+        {
+            seg++;
+        }
+
+        fix16_t t = fix16_div(thrust - pt_thrust[seg], pt_thrust[seg + 1] - pt_thrust[seg]);
+        ff->duty[i] = fix16_lerp(pt_duty[seg], pt_duty[seg + 1], fix16_clamp(t, 0, FIX16_ONE));
+    }
+
+    ff->thrust_max = thrust_max;
+    ff->inv_step = inv_step;
+    return FF_OK;
+}
+
+/**
+ * @brief Thrust needed to hold an angle against gravity
+ *
+ * @param[in] ff Pointer to feedforward structure
+ * @param[in] angle Angle in degrees (Q16.16)
+ *
+ * @return Thrust in gravity units (Q16.16)
+ */
+fix16_t ff_gravity_thrust(const feedforward_t *ff, fix16_t angle)
+{
+    return fix16_sin_deg(angle - ff->neutral);
+}
+
+/**
+ * @brief Duty producing a thrust (inverse table lookup)
+ *
+ * @param[in] ff Pointer to feedforward structure
+ * @param[in] thrust Thrust in gravity units (Q16.16); non-positive thrust gives 0
+ *
+ * @return Motor duty (Q16.16)
+ */
+fix16_t ff_thrust_to_duty(const feedforward_t *ff, fix16_t thrust)
+{
+    fix16_t pos;
+    int32_t idx;
+
+    if (thrust <= 0)
+    {
+        return 0;
+    }
+
+    pos = fix16_mul(thrust, ff->inv_step);
+    idx = pos >> FIX16_SHIFT;
+    if (idx >= FF_THRUST_POINTS - 1)
+    {
+        return ff->duty[FF_THRUST_POINTS - 1];
+    }
+
+    return fix16_lerp(ff->duty[idx], ff->duty[idx + 1], pos & (FIX16_ONE - 1));
+}
+
+/**
+ * @brief Thrust produced by a duty (forward table lookup)
+ *
+ * @param[in] ff Pointer to feedforward structure
+ * @param[in] duty Motor duty (Q16.16); duties in the dead zone give 0
+ *
+ * @return Thrust in gravity units (Q16.16), thrust_max above the table
+ */
+fix16_t ff_duty_to_thrust(const feedforward_t *ff, fix16_t duty)
+{
+    uint8_t lo = 0;
+    uint8_t hi = FF_THRUST_POINTS - 1;
+    int64_t num, den;
+
+    if (duty <= ff->duty[0])
+    {
+        return 0;
+    }
+    if (duty >= ff->duty[FF_THRUST_POINTS - 1])
+    {
+        return ff->thrust_max;
+    }
+
+    /* The table is monotonic: bisect for duty[lo] < duty <= duty[hi] */
+    while (hi - lo > 1)
+    {
+        uint8_t mid = (uint8_t)((lo + hi) / 2);
+
+        if (duty > ff->duty[mid])
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    /* thrust = (lo + fraction) * thrust_max / (FF_THRUST_POINTS - 1), one division */
+    num = ((int64_t)lo * (ff->duty[hi] - ff->duty[lo]) + (duty - ff->duty[lo])) * ff->thrust_max;
+    den = (int64_t)(ff->duty[hi] - ff->duty[lo]) * (FF_THRUST_POINTS - 1);
+
+    return (fix16_t)(num / den);
+}
+
+/**
+ * @brief Set the velocity and acceleration coefficients
+ *
+ * @param[in,out] ff Pointer to feedforward structure
+ * @param[in] k_vel Thrust per deg/s (gravity units, Q8.24)
+ * @param[in] k_acc Thrust per deg/s^2 (gravity units, Q8.24)
+ */
+void ff_set_dynamics(feedforward_t *ff, int32_t k_vel, int32_t k_acc)
+{
+    ff->k_vel = k_vel;
+    ff->k_acc = k_acc;
+}
+
+/**
+ * @brief Thrust for a reference position, velocity and acceleration
+ *
+ * @param[in] ff Pointer to feedforward structure
+ * @param[in] pos Reference angle in degrees (Q16.16)
+ * @param[in] vel Reference velocity in deg/s (Q16.16)
+ * @param[in] acc Reference acceleration in deg/s^2 (Q16.16)
+ *
+ * @return Thrust in gravity units (Q16.16)
+ */
+fix16_t ff_reference_thrust(const feedforward_t *ff, fix16_t pos, fix16_t vel, fix16_t acc)
+{
+    /* Q8.24 * Q16.16 = Q24.40 -> Q16.16 */
+    int64_t thrust = (int64_t)ff_gravity_thrust(ff, pos) +
+                     (((int64_t)ff->k_vel * vel + (int64_t)ff->k_acc * acc) >> 24);
+
+    return fix16_sat(thrust);
+}
+
+/**
+ * @brief Feedforward duty for a reference position, velocity and acceleration
+ *
+ * @param[in] ff Pointer to feedforward structure
+ * @param[in] pos Reference angle in degrees (Q16.16)
+ * @param[in] vel Reference velocity in deg/s (Q16.16)
+ * @param[in] acc Reference acceleration in deg/s^2 (Q16.16)
+ *
+ * @return Motor duty (Q16.16), scaled by the feedforward gain
+ */
+fix16_t ff_eval(const feedforward_t *ff, fix16_t pos, fix16_t vel, fix16_t acc)
+{
+    return fix16_mul(ff->gain, ff_thrust_to_duty(ff, ff_reference_thrust(ff, pos, vel, acc)));
+}
@@ -0,0 +1,181 @@
+/**
+ * @file fixed.c
+ * @brief Q16.16 fixed-point lookup tables
+ */
+
+#include "fixed.h"
+
+/**
+ * @brief sin(x) for x = 0..90 degrees in 1 degree steps, Q16.16
+ */
+static const int32_t sin_lut[91] = {
+    0, 1144, 2287, 3430, 4572, 5712, 6850, 7987,
+    9121, 10252, 11380, 12505, 13626, 14742, 15855, 16962,
+    18064, 19161, 20252, 21336, 22415, 23486, 24550, 25607,
+    26656, 27697, 28729, 29753, 30767, 31772, 32768, 33754,
+    34729, 35693, 36647, 37590, 38521, 39441, 40348, 41243,
+    42126, 42995, 43852, 44695, 45525, 46341, 47143, 47930,
+    48703, 49461, 50203, 50931, 51643, 52339, 53020, 53684,
+    54332, 54963, 55578, 56175, 56756, 57319, 57865, 58393,
+    58903, 59396, 59870, 60326, 60764, 61183, 61584, 61966,
+    62328, 62672, 62997, 63303, 63589, 63856, 64104, 64332,
+    64540, 64729, 64898, 65048, 65177, 65287, 65376, 65446,
+    65496, 65526, 65536};
+
+/**
+ * @brief Sine of an angle in degrees
+ *
+ * Quarter-wave table with linear interpolation, maximum error about 4e-5.
+ *
+ * @param[in] deg Angle in degrees (Q16.16)
+ *
+ * @return sin(deg) in Q16.16
+ */
+fix16_t fix16_sin_deg(fix16_t deg)
+{
+    fix16_t x = fix16_wrap_deg(deg);
+    int negative = 0;
+    int32_t idx;
+    fix16_t frac;
+
+    /* Fold [-180, 180) onto [0, 90] */
+    if (x < 0)
+    {
+        x = -x;
+        negative = 1;
+    }
+    if (x > FIX16_FROM_INT(90))
+    {
+        x = FIX16_FROM_INT(180) - x;
+    }
+
+    idx = x >> FIX16_SHIFT;
+    frac = x & (FIX16_ONE - 1);
+    if (idx >= 90)
+    {
+        return negative ? -FIX16_ONE : FIX16_ONE;
+    }
+
+    x = fix16_lerp(sin_lut[idx], sin_lut[idx + 1], frac);
+    return negative ? -x : x;
+}
+
+/**
+ * @brief Cosine of an angle in degrees
+ *
+ * @param[in] deg Angle in degrees (Q16.16)
+ *
+ * @return cos(deg) in Q16.16
+ */
+fix16_t fix16_cos_deg(fix16_t deg)
+{
+    return fix16_sin_deg(deg + FIX16_FROM_INT(90));
+}
+
+/**
+ * @brief Integer square root of a 64-bit value
+ *
+ * @param[in] x Value
+ *
+ * @return floor(sqrt(x))
+ */
+uint32_t fix16_isqrt64(uint64_t x)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > x)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (x >= res + bit)
+        {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else
+        {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)res;
+}
+
+/**
+ * @brief Base-2 logarithm of a Q16.16 value
+ *
+ * Integer part from normalization, fractional bits by repeated squaring.
+ *
+ * @param[in] x Value (must be > 0)
+ *
+ * @return log2(x) in Q16.16
+ */
+fix16_t fix16_log2(fix16_t x)
+{
+    uint64_t v = (uint32_t)x;
+    fix16_t res = 0;
+    fix16_t bit = FIX16_HALF;
+
+    /* Normalize into [1, 2) */
+    while (v >= (uint64_t)2 << FIX16_SHIFT)
+    {
+        v >>= 1;
+        res += FIX16_ONE;
+    }
+    while (v < FIX16_ONE)
+    {
+        v <<= 1;
+        res -= FIX16_ONE;
+    }
+
+    while (bit != 0)
+    {
+        v = (v * v) >> FIX16_SHIFT;
+        if (v >= (uint64_t)2 << FIX16_SHIFT)
+        {
+            v >>= 1;
+            res += bit;
+        }
+        bit >>= 1;
+    }
+
+    return res;
+}
+
+/**
+ * @brief Base-2 exponential of a Q16.16 value
+ *
+ * Integer part as a shift, fractional part by a cubic fit (relative error
+ * below 2e-4).
+ *
+ * @param[in] x Exponent
+ *
+ * @return 2^x in Q16.16 (saturated)
+ */
+fix16_t fix16_exp2(fix16_t x)
+{
+    int32_t n = x >> FIX16_SHIFT;
+    fix16_t f = x & (FIX16_ONE - 1);
+    fix16_t p;
+
+    if (n >= 15)
+    {
+        return FIX16_MAX;
+    }
+    if (n < -16)
+    {
+        return 0;
+    }
+
+    p = FIX16_FROM_FLOAT(0.07817);
+    p = fix16_mul(p, f) + FIX16_FROM_FLOAT(0.22606);
+    p = fix16_mul(p, f) + FIX16_FROM_FLOAT(0.69583);
+    p = fix16_mul(p, f) + FIX16_ONE;
+
+    return n >= 0 ? p << n : p >> -n;
+}
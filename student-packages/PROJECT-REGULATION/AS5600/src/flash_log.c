@@ -0,0 +1,409 @@
+/**
+ * @file flash_log.c
+ * @brief Log-structured record logger implementation
+ */
+
+#include <string.h>
+
+#include "flash_log.h"
+#include "telemetry.h"
+
+/**
+ * @brief Read a little-endian value
+ *
+ * @param[in] src Input
+ * @param[in] bytes Number of bytes (2 or 4)
+ *
+ * @return Value
+ */
+static uint32_t flash_log_get(const uint8_t *src, uint8_t bytes)
+{
+    uint32_t value = 0;
+
+    for (uint8_t i = 0; i < bytes; i++)
+    {
+        value |= (uint32_t)src[i] << (8 * i);
+    }
+
+    return value;
+}
+
+/**
+ * @brief Write a little-endian value
+ *
+ * @param[out] dst Output
+ * @param[in] value Value
+ * @param[in] bytes Number of bytes (2 or 4)
+ */
+static void flash_log_put(uint8_t *dst, uint32_t value, uint8_t bytes)
+{
+    for (uint8_t i = 0; i < bytes; i++)
+    {
+        dst[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Region address of a page of the log
+ *
+ * @param[in] log Pointer to logger structure
+ * @param[in] seq Sequence number of the page
+ *
+ * @return Region-relative address
+ */
+static uint32_t flash_log_addr(const flash_log_t *log, uint32_t seq)
+{
+    return (seq % log->pages) * FLASH_LOG_PAGE_SIZE;
+}
+
+/**
+ * @brief CRC of a page: header without the CRC field, then the used payload
+ *
+ * @param[in] page Page
+ * @param[in] used Record bytes in the payload
+ *
+ * @return CRC-16/CCITT-FALSE
+ */
+static uint16_t flash_log_crc(const uint8_t *page, uint16_t used)
+{
+    uint16_t crc = telemetry_crc16(0xFFFF, page, FLASH_LOG_HEADER_SIZE - 2);
+
+    return telemetry_crc16(crc, &page[FLASH_LOG_HEADER_SIZE], used);
+}
+
+/**
+ * @brief Empty the page being filled (unused bytes stay in the erased state)
+ *
+ * @param[in,out] log Pointer to logger structure
+ */
+static void flash_log_reset_fill(flash_log_t *log)
+{
+    memset(log->fill, 0xFF, sizeof(log->fill));
+    log->fill_len = 0;
+}
+
+/**
+ * @brief Close the page being filled and queue it for programming
+ *
+ * @param[in,out] log Pointer to logger structure
+ *
+ * @return FLASH_LOG_OK on success, FLASH_LOG_ERR_FULL if the queue is full
+ */
+static flash_log_err_t flash_log_seal(flash_log_t *log)
+{
+    if (log->q_count >= FLASH_LOG_QUEUE)
+    {
+        return FLASH_LOG_ERR_FULL;
+    }
+
+    flash_log_put(&log->fill[0], FLASH_LOG_MAGIC, 2);
+    flash_log_put(&log->fill[2], log->next_seq, 4);
+    flash_log_put(&log->fill[6], log->fill_len, 2);
+    flash_log_put(&log->fill[8], flash_log_crc(log->fill, log->fill_len), 2);
+
+    memcpy(log->queue[log->q_head], log->fill, FLASH_LOG_PAGE_SIZE);
+    log->q_head = (uint8_t)((log->q_head + 1) % FLASH_LOG_QUEUE);
+    log->q_count++;
+    log->next_seq++;
+    flash_log_reset_fill(log);
+
+    return FLASH_LOG_OK;
+}
+
+/**
+ * @brief Initialize the logger and find the end of the log in the region
+ *
+ * @param[out] log Pointer to logger structure
+ * @param[in] ops Platform functions (copied)
+ * @param[in] size Region size in bytes (a multiple of FLASH_LOG_SECTOR_SIZE, at least two sectors)
+ * @param[in] intf_ptr Interface context passed to the platform functions
+ *
+ * @return FLASH_LOG_OK on success, FLASH_LOG_ERR_INVALID_PARAM on invalid parameters
+ */
+flash_log_err_t flash_log_init(flash_log_t *log, const flash_log_ops_t *ops, uint32_t size, void *intf_ptr)
+{
+    uint8_t header[FLASH_LOG_HEADER_SIZE];
+    uint32_t newest = 0;
+    uint8_t found = 0;
+
+    if (!log || !ops || !ops->erase || !ops->program || !ops->busy || !ops->read ||
+        size % FLASH_LOG_SECTOR_SIZE != 0 || size < 2 * FLASH_LOG_SECTOR_SIZE)
+    {
+        return FLASH_LOG_ERR_INVALID_PARAM;
+    }
+
+    log->ops = *ops;
+    log->intf_ptr = intf_ptr;
+    log->pages = size / FLASH_LOG_PAGE_SIZE;
+
+    /* Newest page that sits where its sequence number puts it */
+    for (uint32_t i = 0; i < log->pages; i++)
+    {
+        uint32_t seq;
+
+        log->ops.read(i * FLASH_LOG_PAGE_SIZE, header, sizeof(header), log->intf_ptr);
+        seq = flash_log_get(&header[2], 4);
+        if (flash_log_get(header, 2) == FLASH_LOG_MAGIC && seq % log->pages == i && (!found || seq > newest))
+        {
+            newest = seq;
+            found = 1;
+        }
+    }
+
+    /* Continue at the next sector boundary: the rest of the newest sector may hold a torn page */
+    log->next_seq = 0;
+    if (found)
+    {
+        log->next_seq = (newest / FLASH_LOG_PAGES_PER_SECTOR + 1) * FLASH_LOG_PAGES_PER_SECTOR;
+    }
+    log->erased_to = log->next_seq;
+
+    log->running = 0;
+    log->op_busy = 0;
+    log->q_head = 0;
+    log->q_count = 0;
+    log->records = 0;
+    log->dropped = 0;
+    log->programs = 0;
+    log->erases = 0;
+    flash_log_reset_fill(log);
+
+    return FLASH_LOG_OK;
+}
+
+/**
+ * @brief Enable appending (the sector ahead is erased in the background)
+ *
+ * @param[in,out] log Pointer to logger structure
+ */
+void flash_log_start(flash_log_t *log)
+{
+    log->running = 1;
+}
+
+/**
+ * @brief Disable appending and queue the partly filled page
+ *
+ * @param[in,out] log Pointer to logger structure
+ */
+void flash_log_stop(flash_log_t *log)
+{
+    log->running = 0;
+    if (log->fill_len > 0 && flash_log_seal(log) != FLASH_LOG_OK)
+    {
+        flash_log_reset_fill(log);
+    }
+}
+
+/**
+ * @brief Forget the whole log: later read-outs start after this point
+ *
+ * The old pages stay in flash but fall out of the log window; an empty
+ * page marks the point so the clear survives a restart once it has been
+ * programmed.
+ *
+ * @param[in,out] log Pointer to logger structure
+ */
+void flash_log_clear(flash_log_t *log)
+{
+    flash_log_stop(log);
+
+    /* One lap on: every page written so far is older than the window */
+    log->next_seq = ((log->next_seq + log->pages) / FLASH_LOG_PAGES_PER_SECTOR + 1) * FLASH_LOG_PAGES_PER_SECTOR;
+    log->erased_to = log->next_seq;
+    flash_log_seal(log);
+}
+
+/**
+ * @brief Append one record (never waits)
+ *
+ * @param[in,out] log Pointer to logger structure
+ * @param[in] data Record
+ * @param[in] len Record length (1 - FLASH_LOG_RECORD_MAX)
+ *
+ * @return FLASH_LOG_OK if buffered, FLASH_LOG_ERR_STOPPED if not started,
+ *         FLASH_LOG_ERR_FULL if the page queue is full (record dropped),
+ *         FLASH_LOG_ERR_INVALID_PARAM for a bad length
+ */
+flash_log_err_t flash_log_append(flash_log_t *log, const uint8_t *data, uint8_t len)
+{
+    uint8_t *dst;
+
+    if (!log->running)
+    {
+        return FLASH_LOG_ERR_STOPPED;
+    }
+    if (len == 0 || len > FLASH_LOG_RECORD_MAX)
+    {
+        return FLASH_LOG_ERR_INVALID_PARAM;
+    }
+
+    if (log->fill_len + 1 + len > FLASH_LOG_PAYLOAD_SIZE && flash_log_seal(log) != FLASH_LOG_OK)
+    {
+        log->dropped++;
+        return FLASH_LOG_ERR_FULL;
+    }
+
+    dst = &log->fill[FLASH_LOG_HEADER_SIZE + log->fill_len];
+    dst[0] = len;
+    memcpy(&dst[1], data, len);
+    log->fill_len = (uint16_t)(log->fill_len + 1 + len);
+    log->records++;
+
+    return FLASH_LOG_OK;
+}
+
+/**
+ * @brief Advance the flash operations: start the next program or erase once the flash is idle
+ *
+ * Call often (e.g. every pass of the main loop); returns at once.
+ *
+ * @param[in,out] log Pointer to logger structure
+ */
+void flash_log_poll(flash_log_t *log)
+{
+    if (log->op_busy)
+    {
+        if (log->ops.busy(log->intf_ptr))
+        {
+            return;
+        }
+        log->op_busy = 0;
+    }
+
+    /* Oldest queued page, as soon as its sector has been erased */
+    if (log->q_count > 0)
+    {
+        const uint8_t *page = log->queue[(log->q_head + FLASH_LOG_QUEUE - log->q_count) % FLASH_LOG_QUEUE];
+        uint32_t seq = flash_log_get(&page[2], 4);
+
+        if (seq < log->erased_to)
+        {
+            if (log->ops.program(flash_log_addr(log, seq), page, log->intf_ptr) == 0)
+            {
+                log->programs++;
+            }
+            log->q_count--;
+            log->op_busy = 1;
+            return;
+        }
+    }
+
+    /* Keep the sector after the page being filled erased */
+    if ((log->running || log->q_count > 0) && log->erased_to < log->next_seq + FLASH_LOG_PAGES_PER_SECTOR)
+    {
+        if (log->ops.erase(flash_log_addr(log, log->erased_to), log->intf_ptr) == 0)
+        {
+            log->erases++;
+        }
+        log->erased_to += FLASH_LOG_PAGES_PER_SECTOR;
+        log->op_busy = 1;
+    }
+}
+
+/**
+ * @brief Check that nothing is pending (stopped, queue empty, flash idle)
+ *
+ * @param[in] log Pointer to logger structure
+ *
+ * @return 1 if idle, 0 otherwise
+ */
+uint8_t flash_log_idle(const flash_log_t *log)
+{
+    return !log->running && !log->op_busy && log->q_count == 0;
+}
+
+/**
+ * @brief Number of pages the log currently spans
+ *
+ * @param[in] log Pointer to logger structure
+ *
+ * @return Page count (including pages never written or skipped)
+ */
+uint32_t flash_log_span(const flash_log_t *log)
+{
+    return log->next_seq < log->pages ? log->next_seq : log->pages;
+}
+
+/**
+ * @brief Start reading the log from the oldest record (logger must be idle)
+ *
+ * @param[in] log Pointer to logger structure
+ * @param[out] rd Pointer to reader structure
+ *
+ * @return FLASH_LOG_OK on success, FLASH_LOG_ERR_BUSY if the logger is not idle
+ */
+flash_log_err_t flash_log_read_begin(const flash_log_t *log, flash_log_reader_t *rd)
+{
+    if (!flash_log_idle(log))
+    {
+        return FLASH_LOG_ERR_BUSY;
+    }
+
+    rd->end = log->next_seq;
+    rd->seq = log->next_seq - flash_log_span(log);
+    rd->pos = 0;
+    rd->used = 0;
+    rd->corrupt = 0;
+
+    return FLASH_LOG_OK;
+}
+
+/**
+ * @brief Read the next record
+ *
+ * @param[in] log Pointer to logger structure
+ * @param[in,out] rd Pointer to reader structure
+ * @param[out] data Pointer set to the record (valid until the next call)
+ * @param[out] len Record length
+ *
+ * @return FLASH_LOG_OK if a record was read, FLASH_LOG_ERR_END at the end of the log
+ */
+flash_log_err_t flash_log_read_next(const flash_log_t *log, flash_log_reader_t *rd, const uint8_t **data,
+                                    uint8_t *len)
+{
+    while (1)
+    {
+        const uint8_t *rec = &rd->page[FLASH_LOG_HEADER_SIZE + rd->pos];
+
+        if (rd->pos < rd->used)
+        {
+            /* A length running past the used bytes ends the page */
+            if (rec[0] == 0 || rec[0] > FLASH_LOG_RECORD_MAX || rd->pos + 1 + rec[0] > rd->used)
+            {
+                rd->corrupt++;
+                rd->pos = rd->used;
+                continue;
+            }
+
+            *data = &rec[1];
+            *len = rec[0];
+            rd->pos = (uint16_t)(rd->pos + 1 + rec[0]);
+            return FLASH_LOG_OK;
+        }
+
+        if (rd->seq >= rd->end)
+        {
+            return FLASH_LOG_ERR_END;
+        }
+
+        /* Next page; pages not written in this lap (erased, skipped, older) are passed over */
+        log->ops.read(flash_log_addr(log, rd->seq), rd->page, FLASH_LOG_PAGE_SIZE, log->intf_ptr);
+        rd->pos = 0;
+        rd->used = 0;
+        if (flash_log_get(rd->page, 2) == FLASH_LOG_MAGIC && flash_log_get(&rd->page[2], 4) == rd->seq)
+        {
+            uint16_t used = (uint16_t)flash_log_get(&rd->page[6], 2);
+
+            if (used <= FLASH_LOG_PAYLOAD_SIZE && flash_log_crc(rd->page, used) == flash_log_get(&rd->page[8], 2))
+            {
+                rd->used = used;
+            }
+            else
+            {
+                rd->corrupt++;
+            }
+        }
+        rd->seq++;
+    }
+}
@@ -0,0 +1,278 @@
+/**
+ * @file fmt.c
+ * @brief Integer and fixed-point text formatting implementation
+ */
+
+#include "fmt.h"
+
+/**
+ * @brief Powers of ten up to 10^FMT_DECIMALS_MAX
+ */
+static const uint32_t fmt_pow10[FMT_DECIMALS_MAX + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+/**
+ * @brief Append the digits of an unsigned integer, zero-padded to a width
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] value Value
+ * @param[in] width Least number of digits
+ */
+static void fmt_digits(fmt_line_t *line, uint32_t value, uint8_t width)
+{
+    char digits[10];
+    uint8_t n = 0;
+
+    do
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    while (n < width)
+    {
+        digits[n++] = '0';
+    }
+    while (n)
+    {
+        fmt_char(line, digits[--n]);
+    }
+}
+
+/**
+ * @brief Round a magnitude to the 24 significant bits a float keeps (ties to even)
+ *
+ * @param[in] mag Magnitude (up to 2^31)
+ *
+ * @return Rounded magnitude
+ */
+static uint32_t fmt_float_round(uint32_t mag)
+{
+    uint8_t shift = 0;
+    uint32_t rem, half;
+
+    while ((mag >> shift) >= (1u << 24))
+    {
+        shift++;
+    }
+    if (shift == 0)
+    {
+        return mag;
+    }
+
+    rem = mag & ((1u << shift) - 1);
+    half = 1u << (shift - 1);
+    mag >>= shift;
+    if (rem > half || (rem == half && (mag & 1)))
+    {
+        mag++;
+    }
+
+    return mag << shift;
+}
+
+/**
+ * @brief Start a line in a buffer
+ *
+ * @param[out] line Pointer to line structure
+ * @param[in] buf Buffer (at least one byte)
+ * @param[in] size Buffer size in bytes
+ */
+void fmt_init(fmt_line_t *line, char *buf, uint16_t size)
+{
+    line->buf = buf;
+    line->size = size;
+    line->len = 0;
+    line->overflow = 0;
+    buf[0] = '\0';
+}
+
+/**
+ * @brief Append a character
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] c Character
+ */
+void fmt_char(fmt_line_t *line, char c)
+{
+    if (line->len + 1 >= line->size)
+    {
+        line->overflow = 1;
+        return;
+    }
+
+    line->buf[line->len++] = c;
+    line->buf[line->len] = '\0';
+}
+
+/**
+ * @brief Append a null-terminated string
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] s String
+ */
+void fmt_str(fmt_line_t *line, const char *s)
+{
+    while (*s)
+    {
+        fmt_char(line, *s++);
+    }
+}
+
+/**
+ * @brief Append an unsigned integer (as printf "%lu")
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] value Value
+ */
+void fmt_u32(fmt_line_t *line, uint32_t value)
+{
+    fmt_digits(line, value, 1);
+}
+
+/**
+ * @brief Append a signed integer (as printf "%ld")
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] value Value
+ */
+void fmt_i32(fmt_line_t *line, int32_t value)
+{
+    if (value < 0)
+    {
+        fmt_char(line, '-');
+    }
+    fmt_digits(line, value < 0 ? 0u - (uint32_t)value : (uint32_t)value, 1);
+}
+
+/**
+ * @brief Append a Q16.16 value (as printf "%.*f" of FIX16_TO_FLOAT(value))
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] value Q16.16 value
+ * @param[in] decimals Decimal places (up to FMT_DECIMALS_MAX)
+ */
+void fmt_fix16(fmt_line_t *line, fix16_t value, uint8_t decimals)
+{
+    uint32_t mag = fmt_float_round(value < 0 ? 0u - (uint32_t)value : (uint32_t)value);
+    uint32_t whole = mag >> FIX16_SHIFT;
+    uint32_t frac, rem;
+    uint64_t scaled;
+
+    if (decimals > FMT_DECIMALS_MAX)
+    {
+        decimals = FMT_DECIMALS_MAX;
+    }
+
+    /* Fraction in decimal units; 32 bits suffice up to 4 decimals */
+    if (decimals <= 4)
+    {
+        scaled = (mag & (FIX16_ONE - 1)) * fmt_pow10[decimals];
+    }
+    else
+    {
+        scaled = (uint64_t)(mag & (FIX16_ONE - 1)) * fmt_pow10[decimals];
+    }
+    frac = (uint32_t)(scaled >> FIX16_SHIFT);
+    rem = (uint32_t)scaled & (FIX16_ONE - 1);
+
+    /* Exact decimal rounding, ties to the even last digit */
+    if (rem > FIX16_HALF || (rem == FIX16_HALF && ((decimals ? frac : whole) & 1)))
+    {
+        if (decimals == 0)
+        {
+            whole++;
+        }
+        else if (++frac == fmt_pow10[decimals])
+        {
+            frac = 0;
+            whole++;
+        }
+    }
+
+    if (value < 0)
+    {
+        fmt_char(line, '-');
+    }
+    fmt_digits(line, whole, 1);
+    if (decimals)
+    {
+        fmt_char(line, '.');
+        fmt_digits(line, frac, decimals);
+    }
+}
+
+/**
+ * @brief Append an integer in units of 10^-decimals (e.g. centidegrees with 2)
+ *
+ * Same as printf "%.*f" of value / 10^decimals computed in float for
+ * |value| below 2^23.
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] value Value in units of 10^-decimals
+ * @param[in] decimals Decimal places (up to FMT_DECIMALS_MAX)
+ */
+void fmt_decimal(fmt_line_t *line, int32_t value, uint8_t decimals)
+{
+    uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+
+    if (decimals > FMT_DECIMALS_MAX)
+    {
+        decimals = FMT_DECIMALS_MAX;
+    }
+
+    if (value < 0)
+    {
+        fmt_char(line, '-');
+    }
+    fmt_digits(line, mag / fmt_pow10[decimals], 1);
+    if (decimals)
+    {
+        fmt_char(line, '.');
+        fmt_digits(line, mag % fmt_pow10[decimals], decimals);
+    }
+}
+
+/**
+ * @brief Append a serial-plotter pair ">name:value" (first) or ",name:value" (Q16.16 value)
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] name Variable name
+ * @param[in] value Q16.16 value
+ * @param[in] decimals Decimal places
+ */
+void fmt_plot_fix16(fmt_line_t *line, const char *name, fix16_t value, uint8_t decimals)
+{
+    fmt_char(line, line->len ? ',' : '>');
+    fmt_str(line, name);
+    fmt_char(line, ':');
+    fmt_fix16(line, value, decimals);
+}
+
+/**
+ * @brief Append a serial-plotter pair ">name:value" (first) or ",name:value" (integer value)
+ *
+ * @param[in,out] line Pointer to line structure
+ * @param[in] name Variable name
+ * @param[in] value Value
+ */
+void fmt_plot_u32(fmt_line_t *line, const char *name, uint32_t value)
+{
+    fmt_char(line, line->len ? ',' : '>');
+    fmt_str(line, name);
+    fmt_char(line, ':');
+    fmt_u32(line, value);
+}
+
+/**
+ * @brief Finish a line
+ *
+ * @param[in] line Pointer to line structure
+ *
+ * @return FMT_OK if everything fit, FMT_ERR_OVERFLOW if the line was cut off
+ */
+fmt_err_t fmt_end(const fmt_line_t *line)
+{
+    return line->overflow ? FMT_ERR_OVERFLOW : FMT_OK;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file gain_schedule.c
+ * @brief Angle-scheduled PID gain table implementation
+ */
+
+#include "gain_schedule.h"
+
+/**
+ * @brief Initialize an empty gain schedule
+ *
+ * @param[out] sched Pointer to schedule structure
+ * @param[in] source Scheduling variable
+ * @param[in] rate_hz Tick rate of the controller
+ */
+void gain_sched_init(gain_sched_t *sched, gain_sched_source_t source, uint32_t rate_hz)
+{
+    sched->source = source;
+    sched->rate_hz = rate_hz;
+    sched->alpha = GAIN_SCHED_ALPHA_DEFAULT;
+    gain_sched_clear(sched);
+}
+
+/**
+ * @brief Remove all table entries
+ *
+ * @param[in,out] sched Pointer to schedule structure
+ */
+void gain_sched_clear(gain_sched_t *sched)
+{
+    sched->count = 0;
+    sched->seg = 0;
+    sched->primed = 0;
+    sched->var = 0;
+}
+
+/**
+ * @brief Insert or replace a table entry
+ *
+ * @param[in,out] sched Pointer to schedule structure
+ * @param[in] angle Breakpoint in degrees
+ * @param[in] gains Gains at the breakpoint
+ *
+ * @return GAIN_SCHED_OK on success, error code on failure
+ */
+gain_sched_err_t gain_sched_set_point(gain_sched_t *sched, fix16_t angle, const pid_gains_t *gains)
+{
+    uint8_t i;
+
+    if (!sched || !gains)
+    {
+        return GAIN_SCHED_ERR_INVALID_PARAM;
+    }
+
+    /* Find insertion position */
+    for (i = 0; i < sched->count && sched->angle[i] < angle; i++)
+    {
+    }
+
+    if (i == sched->count || sched->angle[i] != angle)
+    {
+        if (sched->count >= GAIN_SCHED_MAX_POINTS)
+        {
+            return GAIN_SCHED_ERR_FULL;
+        }
+
+        /* Shift the tail to make room */
+        for (uint8_t j = sched->count; j > i; j--)
+        {
+            sched->angle[j] = sched->angle[j - 1];
+            sched->gains[j] = sched->gains[j - 1];
+            sched->coeffs[j] = sched->coeffs[j - 1];
+        }
+        sched->count++;
+    }
+
+    sched->angle[i] = angle;
+    sched->gains[i] = *gains;
+    pid_discretize(gains, sched->rate_hz, &sched->coeffs[i]);
+    sched->seg = 0;
+
+    /* Precompute segment widths so the lookup needs no division */
+    for (uint8_t j = 0; j + 1 < sched->count; j++)
+    {
+        sched->inv_width[j] = fix16_div(FIX16_ONE, sched->angle[j + 1] - sched->angle[j]);
+    }
+
+    return GAIN_SCHED_OK;
+}
+
+/**
+ * @brief Evaluate the schedule for the current tick
+ *
+ * @param[in,out] sched Pointer to schedule structure
+ * @param[in] var Scheduling variable in degrees (setpoint or angle, see source)
+ * @param[out] coeffs Interpolated coefficients
+ *
+ * @return GAIN_SCHED_OK on success, GAIN_SCHED_ERR_INVALID_PARAM for an empty table
+ */
+gain_sched_err_t gain_sched_eval(gain_sched_t *sched, fix16_t var, pid_coeffs_t *coeffs)
+{
+    const pid_coeffs_t *a, *b;
+    fix16_t x, t;
+    uint8_t seg;
+
+    if (sched->count == 0)
+    {
+        return GAIN_SCHED_ERR_INVALID_PARAM;
+    }
+
+    /* Low-pass the scheduling variable so setpoint steps sweep the gains smoothly */
+    if (!sched->primed)
+    {
+        sched->var = var;
+        sched->primed = 1;
+    }
+    else
+    {
+        sched->var += fix16_mul(sched->alpha, var - sched->var);
+    }
+    x = sched->var;
+
+    /* Clamp to the table ends */
+    if (sched->count == 1 || x <= sched->angle[0])
+    {
+        *coeffs = sched->coeffs[0];
+        return GAIN_SCHED_OK;
+    }
+    if (x >= sched->angle[sched->count - 1])
+    {
+        *coeffs = sched->coeffs[sched->count - 1];
+        return GAIN_SCHED_OK;
+    }
+
+    /* The variable moves slowly, so start the search from the cached segment */
+    seg = sched->seg;
+    while (seg > 0 && x < sched->angle[seg])
+    {
+        seg--;
+    }
+    while (seg < sched->count - 2 && x >= sched->angle[seg + 1])
+    {
+        seg++;
+    }
+    sched->seg = seg;
+
+    /* Normalized position within the segment, shaped with smoothstep t^2 (3 - 2t) */
+    t = fix16_mul(x - sched->angle[seg], sched->inv_width[seg]);
+    t = fix16_clamp(t, 0, FIX16_ONE);
+    t = fix16_mul(fix16_mul(t, t), FIX16_FROM_INT(3) - 2 * t);
+
+    a = &sched->coeffs[seg];
+    b = &sched->coeffs[seg + 1];
+    coeffs->kp = fix16_lerp(a->kp, b->kp, t);
+    coeffs->ki = fix16_lerp(a->ki, b->ki, t);
+    coeffs->kd = fix16_lerp(a->kd, b->kd, t);
+
+    return GAIN_SCHED_OK;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file log_ring.c
+ * @brief Wait-free single-producer single-consumer ring of log records
+ */
+
+#include <stddef.h>
+
+#include "log_ring.h"
+
+/**
+ * @brief Initialize an empty ring
+ *
+ * @param[out] ring Pointer to ring structure
+ * @param[in] slots Record storage (kept by reference)
+ * @param[in] capacity Number of records in slots (power of two)
+ * @param[in] policy Overrun policy
+ *
+ * @return LOG_RING_OK on success, LOG_RING_ERR_INVALID_PARAM on invalid parameters
+ */
+log_ring_err_t log_ring_init(log_ring_t *ring, log_record_t *slots, uint32_t capacity, log_ring_policy_t policy)
+{
+    if (!ring || !slots || capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        return LOG_RING_ERR_INVALID_PARAM;
+    }
+
+    ring->slots = slots;
+    ring->mask = capacity - 1;
+    ring->policy = policy;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->refused = 0;
+    ring->overwritten = 0;
+
+    return LOG_RING_OK;
+}
+
+/**
+ * @brief Queue a record (producer side, wait-free)
+ *
+ * @param[in,out] ring Pointer to ring structure
+ * @param[in] rec Record to copy in
+ *
+ * @return LOG_RING_OK if queued, LOG_RING_ERR_FULL if refused (drop-newest policy)
+ */
+log_ring_err_t log_ring_push(log_ring_t *ring, const log_record_t *rec)
+{
+    uint32_t head = ring->head;
+
+    if (ring->policy == LOG_RING_DROP_NEWEST && head - ring->tail > ring->mask)
+    {
+        ring->refused = ring->refused + 1;
+        return LOG_RING_ERR_FULL;
+    }
+
+    ring->slots[head & ring->mask] = *rec;
+    LOG_RING_BARRIER();
+    ring->head = head + 1;
+
+    /* The next record may overwrite a slot the consumer is copying: publish the head before touching it */
+    if (ring->policy == LOG_RING_DROP_OLDEST)
+    {
+        LOG_RING_BARRIER();
+    }
+
+    return LOG_RING_OK;
+}
+
+/**
+ * @brief Take the oldest queued record (consumer side, never waits for the producer)
+ *
+ * @param[in,out] ring Pointer to ring structure
+ * @param[out] rec Record copied out
+ *
+ * @return LOG_RING_OK if a record was copied, LOG_RING_ERR_EMPTY if none is queued
+ */
+log_ring_err_t log_ring_pop(log_ring_t *ring, log_record_t *rec)
+{
+    uint32_t capacity = ring->mask + 1;
+    uint32_t tail = ring->tail;
+    uint32_t head;
+
+    while (1)
+    {
+        head = ring->head;
+        if (head == tail)
+        {
+            ring->tail = tail;
+            return LOG_RING_ERR_EMPTY;
+        }
+
+        /* Producer lapped the consumer: skip to the oldest record still in the ring */
+        if (head - tail > capacity)
+        {
+            ring->overwritten = ring->overwritten + (head - capacity - tail);
+            tail = head - capacity;
+        }
+
+        LOG_RING_BARRIER();
+        *rec = ring->slots[tail & ring->mask];
+        LOG_RING_BARRIER();
+
+        /* Record tail + capacity goes into the same slot once the head has reached it */
+        if (ring->policy == LOG_RING_DROP_OLDEST && ring->head - tail >= capacity)
+        {
+            ring->overwritten = ring->overwritten + 1;
+            tail++;
+            continue;
+        }
+
+        ring->tail = tail + 1;
+        return LOG_RING_OK;
+    }
+}
+
+/**
+ * @brief Number of records lost so far (refused and overwritten)
+ *
+ * @param[in] ring Pointer to ring structure
+ *
+ * @return Record count
+ */
+uint32_t log_ring_dropped(const log_ring_t *ring)
+{
+    return ring->refused + ring->overwritten;
+}
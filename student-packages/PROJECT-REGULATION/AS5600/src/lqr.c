@@ -0,0 +1,166 @@
+/**
+ * @file lqr.c
+ * @brief Observer-based state feedback implementation
+ */
+
+#include "lqr.h"
+
+/**
+ * @brief Initialize an empty gain table
+ *
+ * @param[out] lqr Pointer to gain table structure
+ */
+void lqr_init(lqr_t *lqr)
+{
+    lqr_clear(lqr);
+}
+
+/**
+ * @brief Remove all table entries
+ *
+ * @param[in,out] lqr Pointer to gain table structure
+ */
+void lqr_clear(lqr_t *lqr)
+{
+    lqr->count = 0;
+    lqr->seg = 0;
+}
+
+/**
+ * @brief Insert or replace a table entry
+ *
+ * @param[in,out] lqr Pointer to gain table structure
+ * @param[in] angle Breakpoint in degrees
+ * @param[in] gains Gains at the breakpoint (k_pos, k_vel and k_thr not negative)
+ *
+ * @return LQR_OK on success, error code on failure
+ */
+lqr_err_t lqr_set_point(lqr_t *lqr, fix16_t angle, const lqr_gains_t *gains)
+{
+    uint8_t i;
+
+    if (!lqr || !gains || gains->k_pos < 0 || gains->k_vel < 0 || gains->k_thr < 0)
+    {
+        return LQR_ERR_INVALID_PARAM;
+    }
+
+    /* Find insertion position */
+    for (i = 0; i < lqr->count && lqr->angle[i] < angle; i++)
+    {
+    }
+
+    if (i == lqr->count || lqr->angle[i] != angle)
+    {
+        if (lqr->count >= LQR_MAX_POINTS)
+        {
+            return LQR_ERR_FULL;
+        }
+
+        /* Shift the tail to make room */
+        for (uint8_t j = lqr->count; j > i; j--)
+        {
+            lqr->angle[j] = lqr->angle[j - 1];
+            lqr->gains[j] = lqr->gains[j - 1];
+        }
+        lqr->count++;
+    }
+
+    lqr->angle[i] = angle;
+    lqr->gains[i] = *gains;
+    lqr->seg = 0;
+
+    /* Precompute segment widths so the lookup needs no division */
+    for (uint8_t j = 0; j + 1 < lqr->count; j++)
+    {
+        lqr->inv_width[j] = fix16_div(FIX16_ONE, lqr->angle[j + 1] - lqr->angle[j]);
+    }
+
+    return LQR_OK;
+}
+
+/**
+ * @brief Interpolate the gains for an operating point
+ *
+ * @param[in,out] lqr Pointer to gain table structure
+ * @param[in] angle Reference angle in degrees
+ * @param[out] gains Interpolated gains
+ *
+ * @return LQR_OK on success, LQR_ERR_INVALID_PARAM for an empty table
+ */
+lqr_err_t lqr_eval(lqr_t *lqr, fix16_t angle, lqr_gains_t *gains)
+{
+    const lqr_gains_t *a, *b;
+    fix16_t t;
+    uint8_t seg;
+
+    if (lqr->count == 0)
+    {
+        return LQR_ERR_INVALID_PARAM;
+    }
+
+    /* Clamp to the table ends */
+    if (lqr->count == 1 || angle <= lqr->angle[0])
+    {
+        *gains = lqr->gains[0];
+        return LQR_OK;
+    }
+    if (angle >= lqr->angle[lqr->count - 1])
+    {
+        *gains = lqr->gains[lqr->count - 1];
+        return LQR_OK;
+    }
+
+    /* The reference moves slowly, so start the search from the cached segment */
+    seg = lqr->seg;
+    while (seg > 0 && angle < lqr->angle[seg])
+    {
+        seg--;
+    }
+    while (seg < lqr->count - 2 && angle >= lqr->angle[seg + 1])
+    {
+        seg++;
+    }
+    lqr->seg = seg;
+
+    t = fix16_clamp(fix16_mul(angle - lqr->angle[seg], lqr->inv_width[seg]), 0, FIX16_ONE);
+
+    /* The gains of neighbouring design points are close, the differences cannot overflow */
+    a = &lqr->gains[seg];
+    b = &lqr->gains[seg + 1];
+    gains->k_pos = fix16_lerp(a->k_pos, b->k_pos, t);
+    gains->k_vel = fix16_lerp(a->k_vel, b->k_vel, t);
+    gains->k_thr = fix16_lerp(a->k_thr, b->k_thr, t);
+
+    return LQR_OK;
+}
+
+/**
+ * @brief Thrust command of the state feedback
+ *
+ * @param[in] gains Gains of the operating point
+ * @param[in] ff Model (neutral, thrust table, velocity and inertia coefficients)
+ * @param[in] dob Observer (disturbance and lagged thrust estimates)
+ * @param[in] angle Angle estimate in degrees
+ * @param[in] rate Velocity estimate in deg/s
+ * @param[in] pos Reference angle in degrees
+ * @param[in] vel Reference velocity in deg/s
+ * @param[in] acc Reference acceleration in deg/s^2
+ *
+ * @return Commanded thrust (gravity units)
+ */
+fix16_t lqr_thrust(const lqr_gains_t *gains, const feedforward_t *ff, const dob_t *dob,
+                   fix16_t angle, fix16_t rate, fix16_t pos, fix16_t vel, fix16_t acc)
+{
+    /* Equilibrium thrust of the reference, with the estimated bias cancelled */
+    fix16_t steady = fix16_sat((int64_t)ff_reference_thrust(ff, pos, vel, acc) - dob->estimate);
+    fix16_t err_pos = fix16_sat((int64_t)angle - pos);
+    fix16_t err_vel = fix16_sat((int64_t)rate - vel);
+    int64_t thrust;
+
+    /* Q8.24 * Q16.16 = Q24.40 -> Q16.16 */
+    thrust = (int64_t)steady -
+             (((int64_t)gains->k_pos * err_pos + (int64_t)gains->k_vel * err_vel) >> 24) -
+             fix16_mul(gains->k_thr, fix16_sat((int64_t)dob->thrust - steady));
+
+    return fix16_sat(thrust);
+}
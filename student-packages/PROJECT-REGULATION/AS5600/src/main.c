@@ -1,80 +1,500 @@
 /**
- * @brief Example Raspberry Pi Pico (RP2040) implementation for the AS5600 driver
+ * @brief Pendulum regulation firmware for Raspberry Pi Pico (RP2040)
  *
- * This example shows how to implement the platform-specific functions
- * for an RP2040 microcontroller using the Pico SDK.
+ * Reads the pendulum angle from the AS5600, runs the fixed-point controller
+ * and drives the propeller through the DRV8871 H-bridge. The target angle is
+ * changed at run time over the (non-blocking) serial interface.
+ *
+ * One board runs up to RIG_COUNT independent rigs. Each rig is an instance
+ * (sensor, bridge, supply filter, regulator) wired as listed in rig_hw[];
+ * the rigs on I2C bus n run on core n, so no bus is shared between cores.
+ * The ticks of the rigs are staggered evenly over the control period. Core 0
+ * also reads the serial commands and hands each one to the selected rig,
+ * whose own core executes it between two ticks.
  */
 
+#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/stdio_usb.h"
 #include "hardware/i2c.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/pwm.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/watchdog.h"
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/systick.h"
+#include "hardware/clocks.h"
 #include "pico/binary_info.h"
+#include "tusb.h"
 
 #include "AS5600.h"
+#include "motor.h"
+#include "supply.h"
+#include "regulator.h"
+#include "budget.h"
+#include "telemetry.h"
+#include "log_ring.h"
+#include "capture.h"
+#include "flash_log.h"
+#include "registry.h"
+#include "fmt.h"
+#include "span.h"
 #include "utils.h"
 
-// I2C defines
-#define I2C_PORT i2c0
-#define I2C_SDA_PIN 0
-#define I2C_SCL_PIN 1
-#define I2C_FREQ 400000 // 400 KHz
+// Rig defines (the AS5600 address is fixed: one rig per bus, more behind a TCA9548A)
+#define RIG_COUNT 2       // rigs listed in rig_hw[]
+#define RIG_NO_MUX 0xFF   // rig wired to its bus directly
+#define I2C_MUX_ADDR 0x70 // TCA9548A with A0-A2 low
+#define I2C_FREQ 400000   // 400 KHz
+
+// DRV8871 defines
+#define MOTOR_PWM_WRAP 6249 // 125 MHz / 6250 = 20 kHz
+
+// Motor supply monitor defines (supply through a 100k/22k divider on ADC0)
+#define SUPPLY_ADC_PIN 26                                        // ADC0 (GPIO26)
+#define SUPPLY_ADC_NUM 0                                         // ADC0 input number
+#define SUPPLY_DIVIDER (122.0f / 22.0f)                          // supply volts per ADC input volt
+#define SUPPLY_MV_PER_COUNT (3300.0f / 4096.0f * SUPPLY_DIVIDER) // 3.3 V reference, 12 bits
+#define SUPPLY_NOMINAL_V 12.0f                                   // supply the thrust table is calibrated at
+#define SUPPLY_SAMPLE_HZ 64000                                   // free-running ADC rate
+#define SUPPLY_RING_BITS 7                                       // DMA ring of 128 bytes: 64 samples, 1 ms
+#define SUPPLY_RING_SAMPLES ((1u << SUPPLY_RING_BITS) / sizeof(uint16_t))
+
+// Control loop defines
+#define CONTROL_RATE_HZ 1000                          // 1 ms tick
+#define CONTROL_PERIOD_US (1000000 / CONTROL_RATE_HZ) // tick period of every rig
+#define LOG_DIVIDER 33                                // log every 33 ticks (~30 Hz)
+#define TLM_DIVIDER_MAX 1000                          // slowest binary log: 1 Hz
+#define TLM_BATCH_MS 20                               // longest wait of a sample in a delta frame (TLM 2)
+#define LOG_RING_SLOTS 64                             // log records queued per rig (64 ms at 1 kHz)
+#define LOG_RING_POLICY LOG_RING_DROP_OLDEST          // slow USB host: keep the latest records
+#define LOG_DRAIN_ROOM 128                            // USB buffer space for the longest log line
+#define LOG_LINE_MAX 256                              // formatted text line (serial plotter, 7 channels)
+#define LOG_TEXT_CHUNK (LOG_RING_VALUES * 4)          // characters of rig text per log record
+#define FMT_BENCH_LINES 1000                          // log lines formatted by FMTBENCH, one pair per pass
+#define COMMAND_LENGTH 48                             // longest command line
+
+// Latency compensation defines
+#define LATENCY_READS 16 // angle reads averaged for the transfer time
+
+// Safety supervisor defines
+#define SUPERVISOR_PERIOD_US (1000000 / CONTROL_RATE_HZ / 4) // 4 checks per tick
+#define WATCHDOG_TIMEOUT_MS 100
+
+// System identification defines
+#define SYSID_CAPACITY 8192  // captured ticks per rig (4 bytes each)
+#define SYSID_SETTLE_MS 3000 // time at the operating point before recording
+
+// Triggered capture defines
+#define CAPTURE_CAPACITY 4096 // captured ticks per rig (10 bytes each)
+#define CAPTURE_STREAM 0x80   // binary dump stream id: 0x80 + rig number
+
+// Flash log in the second MB of the 2 MB QSPI flash (program image below it)
+#define FLOG_OFFSET (1024 * 1024) // region start in flash
+#define FLOG_SIZE (1024 * 1024)   // region size (256 sectors)
+#define FLOG_RING_SLOTS 32        // samples queued per rig for the flash
+#define FLOG_DIVIDER_MAX 1000     // slowest flash log: 1 Hz
+#define FLOG_POLL_US 250          // flash status polled at most this often
+#define FLOG_STREAM 0x40          // binary dump stream id: 0x40 + rig number
+#define FLOG_RECORD_SESSION 1     // record: type, divider (LE16), start time (ms, LE32)
+#define FLOG_RECORD_SAMPLE 2      // record: type, rig, time (ms, LE32), log channels 1-4 (LE16 each)
+
+// Channel registry defines (CH command)
+#define CHANNEL_STREAM 0x20          // binary stream id: 0x20 + rig * REGISTRY_MAX_GROUPS + group
+#define CHANNEL_DIVIDER_MAX 1000     // slowest channel: 1 Hz
+#define CHANNEL_GEN_NONE 1           // odd: no layout, the stream of a group is not set up
+
+// Serial flash commands (W25Q16JV)
+#define FLASH_CMD_WRITE_ENABLE 0x06
+#define FLASH_CMD_PAGE_PROGRAM 0x02
+#define FLASH_CMD_SECTOR_ERASE 0x20
+#define FLASH_CMD_READ_STATUS 0x05
+#define FLASH_STATUS_BUSY 0x01
+
+// Wiring of one rig
+typedef struct
+{
+    uint8_t bus;     /* I2C instance (0 or 1), also the core running the rig */
+    uint8_t sda_pin; /* I2C SDA */
+    uint8_t scl_pin; /* I2C SCL */
+    uint8_t mux;     /* TCA9548A channel, RIG_NO_MUX without multiplexer */
+    uint8_t in1_pin; /* DRV8871 IN1 (PWM channel A) */
+    uint8_t in2_pin; /* DRV8871 IN2 (PWM channel B of the same slice) */
+} rig_hw_t;
+
+// Log record types queued by the control tick
+typedef enum
+{
+    LOG_SAMPLE = 0, /* Log line: setpoint, angle, command, supply */
+    LOG_READ_ERROR, /* Sensor read failed, code = error */
+    LOG_FAULT,      /* Safety stop, code = fault flags, value = angle */
+    LOG_STEP,       /* Step summary (step_summary_t order), code = settled */
+    LOG_OSC,        /* Oscillation: frequency, amplitude, gain scale */
+    LOG_CAPTURE,    /* Capture complete, code = cause, values = pre-trigger samples, length */
+    LOG_CHANNELS,   /* Registry group sample, code = group, values = variables, last value = generation */
+    LOG_TEXT        /* Command reply or report text, code = length, values = characters */
+} log_kind_t;
+
+// Binary stream of one registry group (output side)
+typedef struct
+{
+    telemetry_t tlm;                                      /* Stream */
+    telemetry_channel_t channels[TELEMETRY_MAX_CHANNELS]; /* Schema: time stamp, then the variables */
+    uint32_t gen;                                         /* Layout generation of the schema */
+} channel_stream_t;
+
+// One regulation loop: devices, schedule slot, command mailbox and reporting state
+typedef struct
+{
+    const rig_hw_t *hw;                             /* Wiring */
+    uint8_t index;                                  /* Rig number in commands and reports */
+    uint8_t present;                                /* Sensor answered at start-up */
+    i2c_inst_t *i2c;                                /* I2C instance of the bus */
+    uint slice;                                     /* PWM slice of the bridge inputs */
+    as5600_dev_t sensor;                            /* Angle sensor */
+    motor_dev_t motor;                              /* H-bridge */
+    supply_t supply;                                /* Supply filter (the ADC is shared) */
+    regulator_t reg;                                /* Regulation loop */
+    uint32_t phase_us;                              /* Slot of the rig within the control period */
+    uint64_t next_tick;                             /* Scheduled start of the next tick (us) */
+    uint32_t bus_us;                                /* I2C time of the running tick (us) */
+    uint32_t late_us;                               /* Start of the last tick after its slot (us) */
+    uint32_t cpu_us;                                /* Run time of the last tick (us) */
+    budget_t budget;                                /* CPU and bus time per tick */
+    volatile uint8_t budget_restart;                /* Window reported, start a new one */
+    char cmd[COMMAND_LENGTH];                       /* Command handed over by core 0 */
+    volatile uint8_t cmd_full;                      /* Command waiting for the rig's core */
+    uint32_t log_count;                             /* Ticks since the last log line */
+    log_ring_t log;                                 /* Records from the tick to the output (log_drain) */
+    log_record_t log_slots[LOG_RING_SLOTS];         /* Storage of the log ring */
+    uint32_t log_dropped_seen;                      /* Dropped records accounted for by the output */
+    char text[LOG_TEXT_CHUNK];                      /* Text not yet queued (rig_printf) */
+    uint8_t text_len;                               /* Characters in text */
+    telemetry_t tlm;                                /* Binary log stream (stream id = rig number) */
+    uint8_t tlm_active;                             /* Binary log sent last time (schema is current) */
+    uint32_t faults_seen;                           /* Reported fault flags */
+    uint32_t osc_seen;                              /* Reported oscillation count */
+    calib_sweep_state_t sweep_state;                /* Reported sweep state */
+    step_analyzer_state_t step_state;               /* Reported step analyzer state */
+    sysid_state_t sysid_state;                      /* Reported identification state */
+    volatile uint8_t sysid_dump;                    /* Identification capture waiting for its dump (core 0 clears it) */
+    fix16_t sysid_neutral;                          /* Neutral position of the capture (dump header) */
+    uint32_t sysid_latency_us;                      /* Measured sensor latency of the capture (dump header) */
+    capture_state_t capture_state;                  /* Reported capture state */
+    capture_t capture;                              /* Triggered capture */
+    uint32_t flog_count;                            /* Ticks since the last flash sample */
+    log_ring_t flog;                                /* Samples from the tick to the flash log */
+    log_record_t flog_slots[FLOG_RING_SLOTS];       /* Storage of the flash sample ring */
+    registry_t registry;                            /* Variables selectable for logging (CH) */
+    channel_stream_t ch[REGISTRY_MAX_GROUPS];       /* Binary streams of the registry groups */
+    uint32_t ch_stale;                              /* Group samples dropped after a layout change */
+    union
+    {
+        sysid_sample_t sysid_buf[SYSID_CAPACITY];       /* Identification capture */
+        capture_sample_t capture_buf[CAPTURE_CAPACITY]; /* Circular buffer of the capture */
+    };                                                  /* One buffer: identification and capture exclude each other */
+} rig_t;
+
+// Rig wiring: bus, SDA, SCL, mux channel, IN1, IN2
+static const rig_hw_t rig_hw[RIG_COUNT] = {
+    {0, 0, 1, RIG_NO_MUX, 2, 3}, // i2c0 on GPIO0/1, PWM slice 1 on GPIO2/3
+    {1, 6, 7, RIG_NO_MUX, 4, 5}, // i2c1 on GPIO6/7, PWM slice 2 on GPIO4/5
+};
+
+// Global rig instances
+static rig_t rigs[RIG_COUNT];
+static volatile uint8_t selected_rig; // rig addressed by commands and logged
+static uint64_t sched_epoch;          // start of the first control period (us)
+static uint8_t bus_channel[2] = {RIG_NO_MUX, RIG_NO_MUX}; // TCA9548A channel selected per bus
+static volatile uint8_t tlm_mode;                         // log format: 0 text CSV, 1 binary, 2 delta-compressed
+static volatile uint16_t tlm_divider = 1;                 // ticks per binary log sample
+static rig_t *volatile dump_rig;                          // rig whose capture is being dumped
+static uint32_t dump_pos;                                 // dump line: header, samples, end
+static uint8_t dump_binary;                               // dump as telemetry frames instead of CSV
+static telemetry_t dump_tlm;                              // stream of the binary dump
+static rig_t *sysid_dump_rig;                             // rig whose identification capture is being dumped
+static uint32_t sysid_dump_pos;                           // dump line: header, column names, samples, end
+static flash_log_t flog;                                  // flash log of all rigs (core 0 only)
+static uint8_t flog_ready;                                // flash log region usable
+static volatile uint16_t flog_divider;                    // ticks per flash sample, 0 = off
+static uint64_t flog_polled;                              // last flash status poll (us)
+static uint8_t flog_dumping;                              // flash log being dumped
+static uint8_t flog_dump_binary;                          // dump as telemetry frames instead of CSV
+static flash_log_reader_t flog_reader;                    // read position of the dump
+static telemetry_t flog_tlm[RIG_COUNT];                   // streams of the binary dump, one per rig
+static uint8_t flash_cmd_buf[4 + FLASH_LOG_PAGE_SIZE];    // flash command and address, then the page
+static uint8_t flash_rx_buf[4 + FLASH_LOG_PAGE_SIZE];     // bytes clocked in during a flash command
+static uint32_t bench_left;                               // FMTBENCH lines still to format
+static uint32_t bench_printf_us;                          // time of the printf lines so far
+static uint32_t bench_fmt_us;                             // time of the fmt lines so far
+static uint32_t bench_differ;                             // lines that came out differently
+static uint32_t bench_seed = 0x2545F491u;                 // pseudo-random sample values
+static uint64_t command_us;                               // arrival of the command line (its first character, us)
+static uint32_t sync_id;                                  // SYNC request waiting for its reply
+static uint32_t sync_rx_us;                               // its arrival (us, low 32 bits)
+static uint8_t sync_pending;                              // SYNC reply due (sent by log_drain)
+static volatile uint8_t span_restart[SPAN_CORES];         // span table reported, the core starts a new window
+static uint64_t span_window_start[SPAN_CORES];            // start of the span window of each core (us)
+#if SPAN_ENABLED
+static uint32_t span_pair_cycles;                         // cost of a marker pair inside another span
+static uint32_t span_empty_cycles;                        // span with nothing between its markers
+#endif
+
+// End of the program image in flash (linker symbol)
+extern char __flash_binary_end;
+
+// Channels of the binary capture dump (same columns as the CSV dump)
+static const telemetry_channel_t capture_channels[] = {
+    {"tick", TELEMETRY_TYPE_Q32, 0},     // ticks from the trigger
+    {"setpoint", TELEMETRY_TYPE_Q32, 8}, // deg
+    {"angle", TELEMETRY_TYPE_Q32, 8},    // deg
+    {"command", TELEMETRY_TYPE_Q16, 15}, // duty
+    {"late_us", TELEMETRY_TYPE_U32, 0},  // start after the scheduled slot
+    {"cpu_us", TELEMETRY_TYPE_U32, 0},   // run time of the tick
+};
 
-// Global device structure
-as5600_dev_t as5600_dev;
+// Supply samples written by DMA (ring wrap needs the buffer aligned to its size)
+static volatile uint16_t supply_ring[SUPPLY_RING_SAMPLES] __attribute__((aligned(1u << SUPPLY_RING_BITS)));
+static int supply_dma_chan;
+
+// Default PID gains
+static const pid_gains_t default_gains = {
+    .kp = FIX16_FROM_FLOAT(0.020),
+    .ki = FIX16_FROM_FLOAT(0.030),
+    .kd = FIX16_FROM_FLOAT(0.0015),
+};
+
+// Default gain schedule: gravity torque grows with sin(angle), so
+// higher angles get less proportional and more integral action
+static const struct
+{
+    int angle_deg;
+    pid_gains_t gains;
+} default_schedule[] = {
+    {30, {FIX16_FROM_FLOAT(0.030), FIX16_FROM_FLOAT(0.020), FIX16_FROM_FLOAT(0.0020)}},
+    {60, {FIX16_FROM_FLOAT(0.020), FIX16_FROM_FLOAT(0.030), FIX16_FROM_FLOAT(0.0015)}},
+    {90, {FIX16_FROM_FLOAT(0.015), FIX16_FROM_FLOAT(0.040), FIX16_FROM_FLOAT(0.0012)}},
+};
 
 // Function prototypes
-static int8_t pico_i2c_write(uint8_t dev_addr, uint8_t reg_addr, const uint8_t *data, uint32_t len);
-static int8_t pico_i2c_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint32_t len);
-static void pico_delay_ms(uint32_t ms);
-static void i2c_init_pico(void);
+static int8_t pico_i2c_write(uint8_t dev_addr, uint8_t reg_addr, const uint8_t *data, uint32_t len, void *intf_ptr);
+static int8_t pico_i2c_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint32_t len, void *intf_ptr);
+static void pico_delay_ms(uint32_t ms, void *intf_ptr);
+static void pico_motor_set_levels(uint16_t in1_level, uint16_t in2_level, void *intf_ptr);
+static uint8_t i2c_select_channel(rig_t *rig);
+static void i2c_init_pico(const rig_hw_t *hw);
+static void pwm_init_pico(rig_t *rig);
+static void adc_init_pico(void);
+static uint16_t pico_supply_read(void *intf_ptr);
+static int8_t pico_telemetry_write(const uint8_t *data, uint32_t len, void *intf_ptr);
+static int8_t pico_flash_erase(uint32_t addr, void *intf_ptr);
+static int8_t pico_flash_program(uint32_t addr, const uint8_t *data, void *intf_ptr);
+static uint8_t pico_flash_busy(void *intf_ptr);
+static void pico_flash_read(uint32_t addr, uint8_t *data, uint32_t len, void *intf_ptr);
+static void flash_log_init_pico(void);
+static as5600_err_t rig_init(rig_t *rig);
+static void rig_run(uint core);
+static void rig_tick(rig_t *rig);
+static void rig_report(rig_t *rig, as5600_err_t rslt);
+static void rig_log(rig_t *rig, log_kind_t kind, int16_t code, const int32_t *values, uint8_t count);
+static void rig_printf(rig_t *rig, const char *format, ...);
+static void rig_text_flush(rig_t *rig);
+static void log_drain(void);
+static void log_print(rig_t *rig, const log_record_t *rec);
+static uint32_t log_time_ms(uint32_t time);
+static void sync_reply(void);
+static void channels_register(rig_t *rig);
+static void channels_print(rig_t *rig, const log_record_t *rec);
+static void channels_flush(rig_t *rig);
+static uint8_t tlm_batch(uint32_t divider);
+static void log_format_sample(fmt_line_t *line, uint32_t time, const int32_t *values);
+static void fmt_bench_next(void);
+static uint8_t log_output_ready(void);
+static const char *capture_cause_name(int cause);
+static void capture_dump_start(rig_t *rig, uint8_t binary);
+static void capture_dump_next(void);
+static void flog_collect(void);
+static int16_t flog_q16(fix16_t value, uint8_t frac);
+static void flog_dump_next(void);
+static void sysid_dump_next(void);
+static void print_flog_status(void);
+static void core1_entry(void);
+static void feed_watchdog(void);
 static void print_diagnostics(as5600_dev_t *dev);
+static void print_budget(void);
+static void span_init_pico(uint core);
+static void print_spans(void);
+static void dispatch_command(const char *cmd);
+static void process_command(rig_t *rig, const char *cmd);
+static uint8_t lqr_table_locked(rig_t *rig);
+static void print_sweep_result(rig_t *rig);
+static void print_step_summary(const step_summary_t *s);
+static void poll_commands(void);
+static void supervisor_timer_init(void);
+static void supervisor_alarm_callback(uint alarm_num);
+static void print_faults(uint32_t faults, fix16_t angle);
 
 int main()
 {
+    uint8_t present = 0;
+    uint8_t core1_rigs = 0;
+
     // Initialize standard I/O
     stdio_init_all();
 
     // Allow time for USB to initialize
     sleep_ms(3000);
 
-    printf("\nAS5600 Magnetic Rotary Encoder Example for Raspberry Pi Pico\n");
+    printf("\nPendulum regulation for Raspberry Pi Pico\n");
+    if (watchdog_caused_reboot())
+    {
+        printf("Restarted by the watchdog\n");
+    }
+
+    // Initialize all bridges first so every motor is in a defined (coast) state
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        rigs[i].hw = &rig_hw[i];
+        rigs[i].index = i;
+        pwm_init_pico(&rigs[i]);
+        motor_init(&rigs[i].motor, pico_motor_set_levels, MOTOR_PWM_WRAP, &rigs[i]);
+    }
+
+    // Initialize the supply monitor (ADC sampled in the background by DMA)
+    adc_init_pico();
+    printf("Supply ADC initialized: GPIO%d at %d Hz\n", SUPPLY_ADC_PIN, SUPPLY_SAMPLE_HZ);
 
-    // Initialize I2C
-    i2c_init_pico();
-    printf("I2C initialized: SDA=GPIO%d, SCL=GPIO%d at %d Hz\n",
-           I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ);
+    // Find the end of the flash log left by earlier sessions
+    flash_log_init_pico();
 
-    // Initialize AS5600
-    as5600_err_t rslt = as5600_init(&as5600_dev, pico_i2c_write, pico_i2c_read, pico_delay_ms);
-    if (rslt != AS5600_OK)
+    // Bring up the rigs; a rig without sensor stays off, the others run
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        rigs[i].present = rig_init(&rigs[i]) == AS5600_OK;
+        if (rigs[i].present)
+        {
+            // Commands and the log go to the first running rig
+            if (present++ == 0)
+            {
+                selected_rig = i;
+            }
+            core1_rigs += rigs[i].hw->bus == 1;
+        }
+    }
+
+    if (present == 0)
     {
-        printf("AS5600 initialization failed with error code: %d\n", rslt);
+        printf("No rig answered, stopping\n");
         while (1)
         {
             sleep_ms(100);
         } // Stop execution
     }
 
-    printf("AS5600 initialized successfully\n");
+    // Stagger the ticks evenly over the control period
+    sched_epoch = micros();
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        rigs[i].phase_us = CONTROL_PERIOD_US * i / RIG_COUNT;
+        rigs[i].next_tick = sched_epoch + rigs[i].phase_us;
+        budget_init(&rigs[i].budget, CONTROL_PERIOD_US);
+    }
 
-    // Check if magnet is detected
-    uint8_t detected;
-    rslt = as5600_check_magnet(&as5600_dev, &detected);
-    if (rslt == AS5600_OK)
+    // Supervisor interrupt per core and hardware watchdog (fed only while all interrupts run)
+    supervisor_timer_init();
+    span_init_pico(0);
+    if (core1_rigs > 0)
     {
-        if (detected)
-        {
-            printf("Magnet detected!\n");
-        }
-        else
-        {
-            printf("WARNING: No magnet detected! Please place a magnet above the sensor.\n");
-        }
+        multicore_launch_core1(core1_entry);
     }
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, 1);
 
-    // Configure the sensor
+    printf("Commands: SET <deg>, START, STOP, CAL, CLEAR, SCHED <0|1>, FF <0|1>, SWEEP,\n"
+           "          PROF <0|1|2>, LIM <vel> <acc> <jerk>, FFDYN <kvel> <kacc>,\n"
+           "          DOB <0|1>, DOBCFG <rad/s> <lag ms>,\n"
+           "          LQR <0|1>, LQRK <deg> <kpos> <kvel> <kthr>, LQRCLR,\n"
+           "          PRED <pid 0|1> <lqr 0|1>, OSC <0|1> <backoff 0|1> <deg>,\n"
+           "          VCOMP <0|1> <nominal V>,\n"
+           "          PID <kp> <ki> <kd>, PIDF <dalpha> <ilimit>,\n"
+           "          ID <PRBS|SINE|CHIRP> <u0> <amp> <fmin> <fmax> <sec>,\n"
+           "          RIG <n> (rig addressed and logged), BUDGET, FMTBENCH, SPAN (stage cycle counts),\n"
+           "          TLM <0|1|2> <divider> (text, binary or compressed binary log),\n"
+           "          CAP <pre ms> <post ms> <SET|ERR|MAN> [deg], CAP OFF, CAPTRIG, CAPDUMP <CSV|BIN>,\n"
+           "          FLOG START <divider>, FLOG STOP, FLOG CLEAR, FLOG DUMP <CSV|BIN>, FLOG,\n"
+           "          CH <name> <divider> (0 = off), CH OFF, CH (logged variables),\n"
+           "          SYNC <id> (clock sync, answered with the device time in us)\n");
+    printf("%u of %d rigs running, rig %u selected\n", present, RIG_COUNT, selected_rig);
+
+    // Main loop: commands, the rigs of core 0 and the log output of all rigs
+    while (1)
+    {
+        feed_watchdog();
+        poll_commands();
+        rig_run(0);
+        log_drain();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Bring up the sensor and the regulation loop of one rig
+ *
+ * @param rig Pointer to rig (wiring and motor already set up)
+ * @return AS5600_OK if the sensor answered, error code otherwise
+ */
+static as5600_err_t rig_init(rig_t *rig)
+{
     as5600_config_t config;
-    rslt = as5600_get_config(&as5600_dev, &config);
+    as5600_err_t rslt;
+    uint8_t bus_ready = 0;
+
+    printf("\nRig %u:\n", rig->index);
+
+    supply_init(&rig->supply, pico_supply_read, FIX16_FROM_FLOAT(SUPPLY_MV_PER_COUNT),
+                FIX16_FROM_FLOAT(SUPPLY_NOMINAL_V), CONTROL_RATE_HZ, NULL);
+    log_ring_init(&rig->log, rig->log_slots, LOG_RING_SLOTS, LOG_RING_POLICY);
+    log_ring_init(&rig->flog, rig->flog_slots, FLOG_RING_SLOTS, LOG_RING_DROP_NEWEST);
+    telemetry_init(&rig->tlm, telemetry_log_channels_us, TELEMETRY_LOG_CHANNELS, rig->index, pico_telemetry_write,
+                   NULL);
+
+    // Initialize I2C (once per bus)
+    rig->i2c = rig->hw->bus ? i2c1 : i2c0;
+    for (uint8_t i = 0; i < rig->index; i++)
+    {
+        bus_ready |= rig_hw[i].bus == rig->hw->bus;
+    }
+    if (!bus_ready)
+    {
+        i2c_init_pico(rig->hw);
+    }
+    printf("I2C%u: SDA=GPIO%u, SCL=GPIO%u at %d Hz", rig->hw->bus, rig->hw->sda_pin, rig->hw->scl_pin,
+           I2C_FREQ);
+    if (rig->hw->mux != RIG_NO_MUX)
+    {
+        printf(", multiplexer channel %u", rig->hw->mux);
+    }
+    printf("\n");
+
+    // Initialize AS5600
+    rslt = as5600_init(&rig->sensor, pico_i2c_write, pico_i2c_read, pico_delay_ms, rig);
+    if (rslt != AS5600_OK)
+    {
+        printf("AS5600 initialization failed with error code: %d, rig off\n", rslt);
+        return rslt;
+    }
+
+    printf("AS5600 initialized successfully\n");
+
+    // Configure the sensor
+    rslt = as5600_get_config(&rig->sensor, &config);
     if (rslt != AS5600_OK)
     {
         printf("Failed to get sensor configuration: %d\n", rslt);
@@ -87,7 +507,7 @@ int main()
         config.slow_filter = AS5600_SF_4X;                   // Medium filter setting
         config.fast_filter_threshold = AS5600_FTH_SLOW_ONLY; // Use only slow filter
 
-        rslt = as5600_set_config(&as5600_dev, &config);
+        rslt = as5600_set_config(&rig->sensor, &config);
         if (rslt != AS5600_OK)
         {
             printf("Failed to set sensor configuration: %d\n", rslt);
@@ -99,135 +519,2377 @@ int main()
     }
 
     // Print diagnostics
-    print_diagnostics(&as5600_dev);
+    print_diagnostics(&rig->sensor);
 
-    // Main loop
-    uint64_t last_print_time = 0;
-    const uint64_t print_interval_us = 1000; // 1 ms - 1000 Hz
+    // Initialize the regulation loop and its gain schedule
+    regulator_init(&rig->reg, &rig->sensor, &rig->motor, &rig->supply, &default_gains, CONTROL_RATE_HZ);
+    for (size_t i = 0; i < sizeof(default_schedule) / sizeof(default_schedule[0]); i++)
+    {
+        gain_sched_set_point(&rig->reg.ctrl.sched, FIX16_FROM_INT(default_schedule[i].angle_deg),
+                             &default_schedule[i].gains);
+    }
 
-    while (1)
+    // Pendulum hangs in the neutral position with the motor off
+    rslt = regulator_calibrate(&rig->reg);
+    if (rslt != AS5600_OK)
+    {
+        printf("Calibration failed: %d\n", rslt);
+    }
+
+    // Measurement latency: sensor slow filter plus the blocking angle read
+    uint64_t read_start = micros();
+    for (int i = 0; i < LATENCY_READS; i++)
+    {
+        fix16_t angle;
+
+        regulator_read_angle(&rig->reg, &angle);
+    }
+    uint32_t read_us = (uint32_t)(micros() - read_start) / LATENCY_READS;
+    printf("Measurement latency %lu us (angle read %lu us)\n",
+           (unsigned long)regulator_set_latency(&rig->reg, read_us), (unsigned long)read_us);
+
+    rig->sweep_state = CALIB_SWEEP_IDLE;
+    rig->step_state = STEP_ANALYZER_IDLE;
+    rig->sysid_state = SYSID_IDLE;
+    capture_init(&rig->capture, rig->capture_buf, CAPTURE_CAPACITY);
+    rig->capture_state = CAPTURE_IDLE;
+    channels_register(rig);
+
+    return AS5600_OK;
+}
+
+/**
+ * @brief Scheduler pass of one core: commands, settings and due ticks of its rigs
+ *
+ * @param core Core number; runs the rigs on the I2C bus of the same number
+ */
+static void rig_run(uint core)
+{
+    // The span table of the core is cleared here, where its markers run
+    if (span_restart[core])
+    {
+        span_reset((uint8_t)core);
+        span_window_start[core] = micros();
+        span_restart[core] = 0;
+    }
+
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
     {
-        uint64_t current_time = micros();
+        rig_t *rig = &rigs[i];
 
-        if (current_time - last_print_time >= print_interval_us)
+        if (!rig->present || rig->hw->bus != core)
         {
-            last_print_time = current_time;
+            continue;
+        }
 
-            // Read raw angle
-            uint16_t raw_angle;
-            rslt = as5600_get_raw_angle(&as5600_dev, &raw_angle);
-            if (rslt == AS5600_OK)
-            {
-                printf("Raw angle: %u", raw_angle);
-            }
-            else
-            {
-                printf("Error reading raw angle: %d", rslt);
-            }
+        // Commands run in the context of the control tick, like on a single rig
+        if (rig->cmd_full)
+        {
+            __dmb();
+            process_command(rig, rig->cmd);
+            rig_text_flush(rig);
+            __dmb();
+            rig->cmd_full = 0;
+        }
 
-            // Read processed angle
-            uint16_t angle;
-            rslt = as5600_get_angle(&as5600_dev, &angle);
-            if (rslt == AS5600_OK)
-            {
-                printf("\tScaled angle: %u", angle);
-            }
+        // Hand edited settings to the control tick (retried while it has not picked up the last ones)
+        ctrl_params_publish(&rig->reg.params);
 
-            // Read angle in degrees
-            float angle_deg;
-            rslt = as5600_get_angle_degrees(&as5600_dev, &angle_deg);
-            if (rslt == AS5600_OK)
-            {
-                printf("\tDegrees: %.2f°\n", angle_deg);
-            }
+        if (micros() >= rig->next_tick)
+        {
+            rig_tick(rig);
         }
     }
-
-    return 0;
 }
 
 /**
- * @brief Pico SDK I2C write implementation
+ * @brief Run one control tick of a rig and account for its time
  *
- * @param dev_addr Device I2C address
- * @param reg_addr Register address
- * @param data Pointer to data to write
- * @param len Length of data
- * @return 0 on success, non-zero on failure
+ * @param rig Pointer to rig
  */
-static int8_t pico_i2c_write(uint8_t dev_addr, uint8_t reg_addr, const uint8_t *data, uint32_t len)
+static void rig_tick(rig_t *rig)
 {
-    int ret;
-    uint8_t buffer[len + 1];
+    uint64_t start = micros();
+    as5600_err_t rslt;
+    uint64_t end;
 
-    // Prepare buffer: register address followed by data
-    buffer[0] = reg_addr;
-    for (uint32_t i = 0; i < len; i++)
+    if (rig->budget_restart)
     {
-        buffer[i + 1] = data[i];
+        budget_reset(&rig->budget);
+        rig->budget_restart = 0;
     }
 
-    // Send data
-    ret = i2c_write_blocking(I2C_PORT, dev_addr, buffer, len + 1, false);
+    rig->bus_us = 0;
+    SPAN_BEGIN(span);
+    rslt = regulator_tick(&rig->reg);
+    SPAN_END(SPAN_TICK, span);
+    end = micros();
 
-    return (ret == PICO_ERROR_GENERIC || ret != (len + 1)) ? -1 : 0;
+    rig->late_us = (uint32_t)(start - rig->next_tick);
+    rig->cpu_us = (uint32_t)(end - start);
+
+    supervisor_check_deadline(&rig->reg.sup, (uint32_t)(end - rig->next_tick));
+    budget_add(&rig->budget, rig->late_us, rig->cpu_us, rig->bus_us);
+    capture_record(&rig->capture, rig->reg.ctrl.target, rig->reg.ctrl.setpoint, rig->reg.angle, rig->reg.command,
+                   rig->late_us, rig->cpu_us);
+    rig->next_tick += CONTROL_PERIOD_US;
+
+    SPAN_BEGIN(report);
+    rig_report(rig, rslt);
+    SPAN_END(SPAN_REPORT, report);
 }
 
 /**
- * @brief Pico SDK I2C read implementation
+ * @brief Queue the events of the last tick and the log of the selected rig
  *
- * @param dev_addr Device I2C address
- * @param reg_addr Register address
- * @param data Pointer to store read data
- * @param len Length of data to read
- * @return 0 on success, non-zero on failure
+ * The tick only pushes records into the rig's log ring, log_drain() prints
+ * them: the sweep result as text records, the identification capture from
+ * the rig's buffer once the rig has marked it for the dump.
+ *
+ * @param rig Pointer to rig
+ * @param rslt Result of the tick
  */
-static int8_t pico_i2c_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint32_t len)
+static void rig_report(rig_t *rig, as5600_err_t rslt)
 {
-    int ret;
+    regulator_t *reg = &rig->reg;
+    uint32_t divider = tlm_mode ? tlm_divider : LOG_DIVIDER;
 
-    // Send register address
-    ret = i2c_write_blocking(I2C_PORT, dev_addr, &reg_addr, 1, true); // true to keep master control of bus
-    if (ret == PICO_ERROR_GENERIC || ret != 1)
+    // Report a safety stop once
+    uint32_t faults = reg->sup.faults | reg->sup.isr_faults;
+    if (faults != rig->faults_seen)
     {
-        return -1;
+        rig->faults_seen = faults;
+        if (faults)
+        {
+            rig_log(rig, LOG_FAULT, (int16_t)faults, &reg->sup.fault_angle, 1);
+        }
     }
 
-    // Read data
-    ret = i2c_read_blocking(I2C_PORT, dev_addr, data, len, false);
-    if (ret == PICO_ERROR_GENERIC || ret != len)
+    // Report the calibration sweep once it has finished
+    if (reg->sweep.state != rig->sweep_state)
     {
-        return -1;
+        rig->sweep_state = reg->sweep.state;
+        if (rig->sweep_state == CALIB_SWEEP_DONE || rig->sweep_state == CALIB_SWEEP_ABORTED)
+        {
+            rig_printf(rig, "[rig %u] ", rig->index);
+            print_sweep_result(rig);
+            rig_text_flush(rig);
+        }
     }
 
-    return 0;
+    // Hand the identification capture to the dump once it has finished
+    if (reg->sysid.state != rig->sysid_state)
+    {
+        rig->sysid_state = reg->sysid.state;
+        if (rig->sysid_state == SYSID_DONE || rig->sysid_state == SYSID_ABORTED)
+        {
+            rig->sysid_neutral = reg->neutral;
+            rig->sysid_latency_us = reg->ctrl.pred.delay_us;
+            __dmb();
+            rig->sysid_dump = 1;
+        }
+    }
+
+    // Report each step response once it has settled
+    if (reg->analyzer.state != rig->step_state)
+    {
+        rig->step_state = reg->analyzer.state;
+        if (rig->step_state == STEP_ANALYZER_DONE)
+        {
+            const step_summary_t *sum = &reg->analyzer.summary;
+            int32_t values[] = {
+                sum->from, sum->to, (int32_t)sum->rise_ms, sum->overshoot,
+                (int32_t)sum->settle_ms, sum->ss_error, sum->iae, sum->ise,
+            };
+
+            rig_log(rig, LOG_STEP, sum->settled, values, 8);
+        }
+    }
+
+    // Report each confirmed oscillation and the gain it left the loop with
+    if (reg->osc.detections != rig->osc_seen)
+    {
+        int32_t values[] = {reg->osc.freq, reg->osc.amplitude, reg->ctrl.gain_scale};
+
+        rig->osc_seen = reg->osc.detections;
+        rig_log(rig, LOG_OSC, 0, values, 3);
+    }
+
+    // Announce a complete capture once
+    if (rig->capture.state != rig->capture_state)
+    {
+        rig->capture_state = rig->capture.state;
+        if (rig->capture_state == CAPTURE_DONE)
+        {
+            int32_t values[] = {(int32_t)rig->capture.pre_count, (int32_t)rig->capture.length};
+
+            rig_log(rig, LOG_CAPTURE, rig->capture.cause, values, 2);
+        }
+    }
+
+    // Flash log of every rig, whatever the USB output does
+    if (flog_divider && ++rig->flog_count >= flog_divider)
+    {
+        rig->flog_count = 0;
+        if (rslt == AS5600_OK)
+        {
+            log_record_t rec = {0};
+
+            rec.time = millis();
+            rec.source = rig->index;
+            rec.kind = LOG_SAMPLE;
+            rec.values[0] = reg->ctrl.setpoint;
+            rec.values[1] = reg->angle;
+            rec.values[2] = reg->command;
+            rec.values[3] = rig->supply.voltage;
+            log_ring_push(&rig->flog, &rec);
+        }
+    }
+
+    // Registered variables, each group at its own rate
+    for (uint8_t g = 0; g < rig->registry.ngroups; g++)
+    {
+        if (registry_tick(&rig->registry, g))
+        {
+            int32_t values[LOG_RING_VALUES] = {0};
+
+            registry_read(&rig->registry, g, values);
+            values[REGISTRY_GROUP_VARS] = (int32_t)rig->registry.gen;
+            rig_log(rig, LOG_CHANNELS, g, values, LOG_RING_VALUES);
+        }
+    }
+
+    // Log of the selected rig only (same columns as with a single rig)
+    if (++rig->log_count >= divider)
+    {
+        rig->log_count = 0;
+        if (rig->index != selected_rig)
+        {
+            return;
+        }
+
+        if (rslt != AS5600_OK)
+        {
+            rig_log(rig, LOG_READ_ERROR, rslt, NULL, 0);
+        }
+        else
+        {
+            int32_t values[] = {reg->ctrl.setpoint, reg->angle, reg->command, rig->supply.voltage};
+
+            rig_log(rig, LOG_SAMPLE, 0, values, 4);
+        }
+    }
 }
 
 /**
- * @brief Pico SDK delay implementation
+ * @brief Queue a log record of a rig (wait-free, a full ring drops per LOG_RING_POLICY)
  *
- * @param ms Delay time in milliseconds
+ * @param rig Pointer to rig
+ * @param kind Record type
+ * @param code Small integer payload
+ * @param values Values (count entries, NULL if none)
+ * @param count Number of values (up to LOG_RING_VALUES)
  */
-static void pico_delay_ms(uint32_t ms)
+static void rig_log(rig_t *rig, log_kind_t kind, int16_t code, const int32_t *values, uint8_t count)
 {
-    sleep_ms(ms);
+    log_record_t rec = {0};
+
+    rec.time = (uint32_t)micros();
+    rec.source = rig->index;
+    rec.kind = (uint8_t)kind;
+    rec.code = code;
+    if (count > 0)
+    {
+        memcpy(rec.values, values, count * sizeof(rec.values[0]));
+    }
+
+    log_ring_push(&rig->log, &rec);
+}
+
+/**
+ * @brief Print text on the core of a rig without waiting for the USB output
+ *
+ * Commands and reports of a rig run in the context of its control tick. Their
+ * text is packed into LOG_TEXT records of the rig's log ring, in order with
+ * its log, and printed by log_drain(). A record is queued when full,
+ * rig_text_flush() queues the rest.
+ *
+ * @param rig Pointer to rig (called on its core)
+ * @param format printf format, followed by its arguments
+ */
+static void rig_printf(rig_t *rig, const char *format, ...)
+{
+    char buf[LOG_LINE_MAX];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    len = len < (int)sizeof(buf) ? len : (int)sizeof(buf) - 1;
+
+    for (int i = 0; i < len; i++)
+    {
+        rig->text[rig->text_len++] = buf[i];
+        if (rig->text_len == LOG_TEXT_CHUNK)
+        {
+            rig_text_flush(rig);
+        }
+    }
+}
+
+/**
+ * @brief Queue the text of a rig not yet queued by rig_printf()
+ *
+ * @param rig Pointer to rig (called on its core)
+ */
+static void rig_text_flush(rig_t *rig)
+{
+    int32_t values[LOG_RING_VALUES] = {0};
+
+    if (rig->text_len == 0)
+    {
+        return;
+    }
+
+    memcpy(values, rig->text, rig->text_len);
+    rig_log(rig, LOG_TEXT, rig->text_len, values, LOG_RING_VALUES);
+    rig->text_len = 0;
 }
 
 /**
- * @brief Initialize the I2C interface for RP2040
+ * @brief Print the queued log records of all rigs as far as the USB output takes them without waiting
+ *
+ * Runs in the main loop of core 0; the rings of the rigs on core 1 are filled from there.
+ * An identification dump goes first and holds the rest back, so no other
+ * line lands in its CSV.
+ */
+static void log_drain(void)
+{
+    log_record_t rec;
+    uint64_t now = micros();
+
+    // Flash log first: it does not depend on the USB host
+    flog_collect();
+    if (flog_ready && now - flog_polled >= FLOG_POLL_US)
+    {
+        flog_polled = now;
+        flash_log_poll(&flog);
+    }
+
+    for (uint8_t i = 0; !sysid_dump_rig && i < RIG_COUNT; i++)
+    {
+        if (rigs[i].present && rigs[i].sysid_dump)
+        {
+            __dmb();
+            sysid_dump_rig = &rigs[i];
+            sysid_dump_pos = 0;
+        }
+    }
+    while (sysid_dump_rig && log_output_ready())
+    {
+        sysid_dump_next();
+    }
+    if (sysid_dump_rig)
+    {
+        return;
+    }
+
+    // Clock sync reply ahead of the log: its wait in the output adds to the measured delay
+    if (sync_pending && log_output_ready())
+    {
+        sync_reply();
+    }
+
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        rig_t *rig = &rigs[i];
+
+        if (!rig->present)
+        {
+            continue;
+        }
+
+        while (log_output_ready() && log_ring_pop(&rig->log, &rec) == LOG_RING_OK)
+        {
+            SPAN_BEGIN(span);
+            log_print(rig, &rec);
+            SPAN_END(SPAN_LOG, span);
+        }
+    }
+
+    // Capture and flash log dumps after the live records
+    while (dump_rig && log_output_ready())
+    {
+        capture_dump_next();
+    }
+    while (flog_dumping && log_output_ready())
+    {
+        flog_dump_next();
+    }
+    if (bench_left && log_output_ready())
+    {
+        fmt_bench_next();
+    }
+}
+
+/**
+ * @brief Move the queued flash samples of all rigs into the flash log page buffer
+ *
+ * Packed like the binary log (telemetry_log_channels): time in ms, then the
+ * setpoint, angle, command and supply as 16-bit fixed point.
+ */
+static void flog_collect(void)
+{
+    log_record_t rec;
+
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        while (log_ring_pop(&rigs[i].flog, &rec) == LOG_RING_OK)
+        {
+            uint8_t data[2 + 4 + 4 * 2];
+
+            data[0] = FLOG_RECORD_SAMPLE;
+            data[1] = rec.source;
+            memcpy(&data[2], &rec.time, 4);
+            for (uint8_t c = 0; c < 4; c++)
+            {
+                int16_t q = flog_q16(rec.values[c], telemetry_log_channels[c + 1].frac_bits);
+
+                memcpy(&data[6 + 2 * c], &q, 2);
+            }
+            flash_log_append(&flog, data, sizeof(data));
+        }
+    }
+}
+
+/**
+ * @brief Round a Q16.16 value to a saturated 16-bit fixed-point value (as telemetry_send() does)
+ *
+ * @param value Q16.16 value
+ * @param frac Fractional bits of the result
+ * @return Fixed-point value
+ */
+static int16_t flog_q16(fix16_t value, uint8_t frac)
+{
+    uint8_t shift = FIX16_SHIFT - frac;
+    int32_t q = shift ? (int32_t)(((int64_t)value + (1 << (shift - 1))) >> shift) : value;
+
+    return (int16_t)(q > INT16_MAX ? INT16_MAX : (q < INT16_MIN ? INT16_MIN : q));
+}
+
+/**
+ * @brief Print the next record of the flash log dump, or the end
+ */
+static void flog_dump_next(void)
+{
+    const uint8_t *data;
+    uint8_t len;
+    uint32_t time;
+    int16_t q[4];
+
+    if (flash_log_read_next(&flog, &flog_reader, &data, &len) != FLASH_LOG_OK)
+    {
+        if (!flog_dump_binary)
+        {
+            printf("# end, %lu corrupt\n", (unsigned long)flog_reader.corrupt);
+        }
+        for (uint8_t i = 0; flog_dump_binary && i < RIG_COUNT; i++)
+        {
+            telemetry_flush(&flog_tlm[i]);
+        }
+        flog_dumping = 0;
+        return;
+    }
+
+    if (data[0] == FLOG_RECORD_SESSION && len >= 7)
+    {
+        memcpy(&time, &data[3], 4);
+        if (!flog_dump_binary)
+        {
+            printf("# session at %lu ms, every %u ticks\n", (unsigned long)time, data[1] | (data[2] << 8));
+        }
+    }
+    else if (data[0] == FLOG_RECORD_SAMPLE && len >= 14 && data[1] < RIG_COUNT)
+    {
+        memcpy(&time, &data[2], 4);
+        memcpy(q, &data[6], sizeof(q));
+        if (flog_dump_binary)
+        {
+            int32_t values[TELEMETRY_LOG_CHANNELS] = {(int32_t)time};
+
+            for (uint8_t c = 0; c < 4; c++)
+            {
+                values[c + 1] = (int32_t)q[c] * (1 << (FIX16_SHIFT - telemetry_log_channels[c + 1].frac_bits));
+            }
+            telemetry_send(&flog_tlm[data[1]], values);
+        }
+        else
+        {
+            char buf[LOG_LINE_MAX];
+            fmt_line_t line;
+            int32_t values[4];
+
+            // Same columns as the text log, with the rig in front
+            for (uint8_t c = 0; c < 4; c++)
+            {
+                values[c] = (int32_t)q[c] * (1 << (FIX16_SHIFT - telemetry_log_channels[c + 1].frac_bits));
+            }
+            fmt_init(&line, buf, sizeof(buf));
+            fmt_u32(&line, data[1]);
+            fmt_char(&line, ',');
+            log_format_sample(&line, time, values);
+            printf("%s", buf);
+        }
+    }
+}
+
+/**
+ * @brief Print the next line of the identification dump: header, column names, one tick or the end
+ *
+ * CSV of the tick, duty and angle; the header carries what sysid_fit needs
+ * besides the samples. The end hands the buffer back to the rig.
+ */
+static void sysid_dump_next(void)
+{
+    static const char *const signals[] = {"prbs", "sine", "chirp"};
+    const sysid_t *id = &sysid_dump_rig->reg.sysid;
+
+    if (sysid_dump_pos == 0)
+    {
+        printf("# sysid %s%s rate %lu u0 %.4f amp %.4f fmin %.3f fmax %.3f neutral %.2f latency_us %lu samples %lu\n",
+               signals[id->cfg.signal], id->state == SYSID_ABORTED ? " aborted" : "",
+               (unsigned long)id->rate_hz, FIX16_TO_FLOAT(id->cfg.u0), FIX16_TO_FLOAT(id->cfg.amp),
+               FIX16_TO_FLOAT(id->cfg.f_min), FIX16_TO_FLOAT(id->cfg.f_max),
+               FIX16_TO_FLOAT(sysid_dump_rig->sysid_neutral), (unsigned long)sysid_dump_rig->sysid_latency_us,
+               (unsigned long)id->count);
+    }
+    else if (sysid_dump_pos == 1)
+    {
+        printf("tick,duty,angle\n");
+    }
+    else if (sysid_dump_pos - 2 < id->count)
+    {
+        const sysid_sample_t *s = &id->buf[sysid_dump_pos - 2];
+        char buf[LOG_LINE_MAX];
+        fmt_line_t line;
+
+        // Q1.15 duty and centidegrees, as printf "%.5f" and "%.2f" of the float values
+        fmt_init(&line, buf, sizeof(buf));
+        fmt_u32(&line, sysid_dump_pos - 2);
+        fmt_char(&line, ',');
+        fmt_fix16(&line, (fix16_t)s->duty * 2, 5);
+        fmt_char(&line, ',');
+        fmt_decimal(&line, s->angle, 2);
+        fmt_char(&line, '\n');
+        printf("%s", buf);
+    }
+    else
+    {
+        printf("# end\n");
+        __dmb();
+        sysid_dump_rig->sysid_dump = 0;
+        sysid_dump_rig = NULL;
+        return;
+    }
+    sysid_dump_pos++;
+}
+
+/**
+ * @brief Print the state of the flash log
+ */
+static void print_flog_status(void)
+{
+    uint32_t dropped = flog.dropped;
+
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        dropped += rigs[i].flog.refused;
+    }
+
+    if (flog.running)
+    {
+        printf("Flash log running, every %u ticks: ", flog_divider);
+    }
+    else
+    {
+        printf("Flash log stopped: ");
+    }
+    printf("%lu records, %lu dropped, %lu pages programmed, %lu sectors erased, log spans %lu of %lu pages\n",
+           (unsigned long)flog.records, (unsigned long)dropped, (unsigned long)flog.programs,
+           (unsigned long)flog.erases, (unsigned long)flash_log_span(&flog), (unsigned long)flog.pages);
+}
+
+/**
+ * @brief Check whether the USB output takes a log line without waiting
+ *
+ * @return 1 if there is room (or no host, then the output is discarded at once), 0 otherwise
+ */
+static uint8_t log_output_ready(void)
+{
+    return !stdio_usb_connected() || tud_cdc_write_available() >= LOG_DRAIN_ROOM;
+}
+
+/**
+ * @brief Print one log record in the current log format
+ *
+ * @param rig Rig the record comes from
+ * @param rec Pointer to record
+ */
+static void log_print(rig_t *rig, const log_record_t *rec)
+{
+    const int32_t *v = rec->values;
+    uint32_t dropped;
+    char buf[LOG_LINE_MAX];
+    fmt_line_t line;
+
+    switch (rec->kind)
+    {
+    case LOG_SAMPLE:
+        // Records lost in the ring show up as lost frames in the binary log
+        dropped = log_ring_dropped(&rig->log);
+        if (tlm_mode)
+        {
+            int32_t values[TELEMETRY_LOG_CHANNELS] = {(int32_t)rec->time, v[0], v[1], v[2], v[3]};
+
+            // A decoder attaching now needs the schema first
+            if (!rig->tlm_active)
+            {
+                telemetry_set_batch(&rig->tlm, tlm_batch(tlm_divider));
+                telemetry_restart(&rig->tlm);
+                rig->tlm_active = 1;
+            }
+            telemetry_skip(&rig->tlm, (uint16_t)(dropped - rig->log_dropped_seen));
+            SPAN_BEGIN(span);
+            telemetry_send(&rig->tlm, values);
+            SPAN_END(SPAN_TELEMETRY, span);
+        }
+        else
+        {
+            // Samples still waiting in a delta frame go out before the text
+            if (rig->tlm_active)
+            {
+                telemetry_flush(&rig->tlm);
+                rig->tlm_active = 0;
+            }
+            fmt_init(&line, buf, sizeof(buf));
+            log_format_sample(&line, log_time_ms(rec->time), v);
+            printf("%s", buf);
+        }
+        rig->log_dropped_seen = dropped;
+        break;
+
+    case LOG_READ_ERROR:
+        printf("Error reading angle: %d\n", rec->code);
+        break;
+
+    case LOG_FAULT:
+        printf("[rig %u] ", rec->source);
+        print_faults((uint16_t)rec->code, v[0]);
+        break;
+
+    case LOG_STEP:
+    {
+        step_summary_t sum = {v[0], v[1], (uint32_t)v[2], v[3], (uint32_t)v[4], v[5], v[6], v[7], (uint8_t)rec->code};
+
+        printf("[rig %u] ", rec->source);
+        print_step_summary(&sum);
+        break;
+    }
+
+    case LOG_OSC:
+        printf("[rig %u] Oscillation %.1f Hz, amplitude %.2f deg, gain scale %.2f\n", rec->source,
+               FIX16_TO_FLOAT(v[0]), FIX16_TO_FLOAT(v[1]), FIX16_TO_FLOAT(v[2]));
+        break;
+
+    case LOG_CAPTURE:
+        printf("[rig %u] Capture complete (%s trigger): %ld samples, %ld before the trigger, "
+               "read with CAPDUMP <CSV|BIN>\n",
+               rec->source, capture_cause_name(rec->code), (long)v[1], (long)v[0]);
+        break;
+
+    case LOG_CHANNELS:
+        channels_print(rig, rec);
+        break;
+
+    case LOG_TEXT:
+        printf("%.*s", rec->code, (const char *)v);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Time of a queued record in ms since boot (what millis() returned then)
+ *
+ * Records carry the low 32 bits of the us time. They are printed long
+ * before those wrap (71 minutes), so the upper bits are those of now.
+ *
+ * @param time Time stamp of the record (us, low 32 bits)
+ * @return Time in ms
+ */
+static uint32_t log_time_ms(uint32_t time)
+{
+    uint64_t now = micros();
+
+    return (uint32_t)((now - (uint32_t)((uint32_t)now - time)) / 1000);
+}
+
+/**
+ * @brief Answer the last SYNC request: "SYNC <id> <arrival> <reply>"
+ *
+ * Both times are in us since boot, low 32 bits, like the Timestamp_us column
+ * of the binary log. The host subtracts the time between them from the
+ * round trip and fits offset and drift (clock_sync.h of the host tools).
+ */
+static void sync_reply(void)
+{
+    char buf[48];
+    fmt_line_t line;
+
+    fmt_init(&line, buf, sizeof(buf));
+    fmt_str(&line, "SYNC ");
+    fmt_u32(&line, sync_id);
+    fmt_char(&line, ' ');
+    fmt_u32(&line, sync_rx_us);
+    fmt_char(&line, ' ');
+    fmt_u32(&line, (uint32_t)micros());
+    fmt_char(&line, '\n');
+    printf("%s", buf);
+    sync_pending = 0;
+}
+
+/**
+ * @brief Append a text log line: time in ms, then setpoint, angle, command and supply with 2 decimals
+ *
+ * Same characters as printf "%lu,%.2f,%.2f,%.2f,%.2f\n" of the float values,
+ * without the soft-float conversion and formatting.
+ *
+ * @param line Line being formatted
+ * @param time Time stamp (ms)
+ * @param values Setpoint, angle, command and supply (Q16.16)
+ */
+static void log_format_sample(fmt_line_t *line, uint32_t time, const int32_t *values)
+{
+    fmt_u32(line, time);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        fmt_char(line, ',');
+        fmt_fix16(line, values[i], 2);
+    }
+    fmt_char(line, '\n');
+}
+
+/**
+ * @brief Format one pseudo-random log line with printf and with fmt, time both and compare
+ *
+ * One pair per main loop pass, like a dump line, so the benchmark never
+ * holds up the ticks of the rigs on core 0.
+ */
+static void fmt_bench_next(void)
+{
+    char want[LOG_LINE_MAX];
+    char got[LOG_LINE_MAX];
+    fmt_line_t line;
+    int32_t v[4];
+    uint32_t time = millis();
+    uint64_t start;
+
+    // Angles within +-180 deg, duty within +-1, supply 12 - 13 V
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        bench_seed ^= bench_seed << 13;
+        bench_seed ^= bench_seed >> 17;
+        bench_seed ^= bench_seed << 5;
+        v[i] = (int32_t)(bench_seed % (360u << 16)) - (180 << 16);
+    }
+    v[2] /= 180;
+    v[3] = (12 << 16) + (v[3] & 0xFFFF);
+
+    start = micros();
+    snprintf(want, sizeof(want), "%lu,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)time, FIX16_TO_FLOAT(v[0]),
+             FIX16_TO_FLOAT(v[1]), FIX16_TO_FLOAT(v[2]), FIX16_TO_FLOAT(v[3]));
+    bench_printf_us += (uint32_t)(micros() - start);
+
+    start = micros();
+    fmt_init(&line, got, sizeof(got));
+    log_format_sample(&line, time, v);
+    bench_fmt_us += (uint32_t)(micros() - start);
+
+    bench_differ += strcmp(want, got) != 0;
+    if (--bench_left == 0)
+    {
+        printf("Format %d log lines: printf %lu us, fmt %lu us, %lu differ\n", FMT_BENCH_LINES,
+               (unsigned long)bench_printf_us, (unsigned long)bench_fmt_us, (unsigned long)bench_differ);
+    }
+}
+
+/**
+ * @brief Register the variables a rig can log with CH (all off)
+ *
+ * @param rig Pointer to rig
+ */
+static void channels_register(rig_t *rig)
+{
+    registry_t *r = &rig->registry;
+    regulator_t *reg = &rig->reg;
+
+    registry_init(r);
+    registry_add(r, "angle", &reg->angle, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q32, 8);
+    registry_add(r, "setpoint", &reg->ctrl.setpoint, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q32, 8);
+    registry_add(r, "target", &reg->ctrl.target, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q32, 8);
+    registry_add(r, "velocity", &reg->ctrl.dob.vel, REGISTRY_SRC_Q32, TELEMETRY_TYPE_Q32, 8);
+    registry_add(r, "p_term", &reg->ctrl.pid.p_term, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 14);
+    registry_add(r, "i_term", &reg->ctrl.pid.i_term, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 14);
+    registry_add(r, "d_term", &reg->ctrl.pid.d_term, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 14);
+    registry_add(r, "ff_term", &reg->ctrl.ff_term, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 14);
+    registry_add(r, "dob_term", &reg->ctrl.dob_term, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 14);
+    registry_add(r, "gain_scale", &reg->ctrl.gain_scale, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 14);
+    registry_add(r, "command", &reg->command, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 14);
+    registry_add(r, "voltage", &rig->supply.voltage, REGISTRY_SRC_FIX16, TELEMETRY_TYPE_Q16, 8);
+    registry_add(r, "late_us", &rig->late_us, REGISTRY_SRC_U32, TELEMETRY_TYPE_U32, 0);
+    registry_add(r, "cpu_us", &rig->cpu_us, REGISTRY_SRC_U32, TELEMETRY_TYPE_U32, 0);
+    registry_add(r, "bus_us", &rig->bus_us, REGISTRY_SRC_U32, TELEMETRY_TYPE_U32, 0);
+    registry_add(r, "agc", &reg->agc, REGISTRY_SRC_U8, TELEMETRY_TYPE_U32, 0);
+
+    for (uint8_t g = 0; g < REGISTRY_MAX_GROUPS; g++)
+    {
+        rig->ch[g].gen = CHANNEL_GEN_NONE;
+    }
+}
+
+/**
+ * @brief Print one registry group sample: serial plotter line or binary frame
+ *
+ * The layout is copied from the registry for every sample, so a CH command
+ * on the rig's core never waits for the output; samples taken with an older
+ * layout are dropped.
+ *
+ * @param rig Rig the record comes from
+ * @param rec Pointer to record (LOG_CHANNELS)
+ */
+static void channels_print(rig_t *rig, const log_record_t *rec)
+{
+    registry_layout_t layout;
+    uint32_t gen = (uint32_t)rec->values[REGISTRY_GROUP_VARS];
+    uint8_t g = (uint8_t)rec->code;
+    channel_stream_t *cs;
+    char buf[LOG_LINE_MAX];
+    fmt_line_t line;
+
+    if (registry_layout(&rig->registry, gen, g, &layout) != REGISTRY_OK)
+    {
+        rig->ch_stale++;
+        return;
+    }
+    cs = &rig->ch[g];
+
+    if (tlm_mode)
+    {
+        int32_t values[TELEMETRY_MAX_CHANNELS] = {(int32_t)rec->time};
+
+        // New layout: new schema on the group's stream
+        if (cs->gen != gen)
+        {
+            if (cs->gen != CHANNEL_GEN_NONE)
+            {
+                telemetry_flush(&cs->tlm);
+            }
+            cs->channels[0] = telemetry_log_channels_us[0];
+            memcpy(&cs->channels[1], layout.channels, layout.count * sizeof(layout.channels[0]));
+            telemetry_init(&cs->tlm, cs->channels, (uint8_t)(layout.count + 1),
+                           (uint8_t)(CHANNEL_STREAM + rig->index * REGISTRY_MAX_GROUPS + g), pico_telemetry_write,
+                           NULL);
+            telemetry_set_batch(&cs->tlm, tlm_batch(layout.divider));
+            cs->gen = gen;
+        }
+        memcpy(&values[1], rec->values, layout.count * sizeof(values[0]));
+        SPAN_BEGIN(span);
+        telemetry_send(&cs->tlm, values);
+        SPAN_END(SPAN_TELEMETRY, span);
+        return;
+    }
+
+    // Serial plotter lines of the selected rig only
+    channels_flush(rig);
+    if (rig->index != selected_rig)
+    {
+        return;
+    }
+    fmt_init(&line, buf, sizeof(buf));
+    for (uint8_t i = 0; i < layout.count; i++)
+    {
+        const telemetry_channel_t *ch = &layout.channels[i];
+        uint8_t decimals = (uint8_t)((ch->frac_bits * 3 + 9) / 10);
+
+        if (ch->type == TELEMETRY_TYPE_U32)
+        {
+            fmt_plot_u32(&line, ch->name, (uint32_t)rec->values[i]);
+        }
+        else
+        {
+            fmt_plot_fix16(&line, ch->name, rec->values[i], decimals < 2 ? 2 : decimals);
+        }
+    }
+    fmt_str(&line, "\r\n");
+    printf("%s", buf);
+}
+
+/**
+ * @brief Send the samples waiting in the delta frames of the group streams and forget their schemas
+ *
+ * @param rig Pointer to rig
+ */
+static void channels_flush(rig_t *rig)
+{
+    for (uint8_t g = 0; g < REGISTRY_MAX_GROUPS; g++)
+    {
+        if (rig->ch[g].gen != CHANNEL_GEN_NONE)
+        {
+            telemetry_flush(&rig->ch[g].tlm);
+            rig->ch[g].gen = CHANNEL_GEN_NONE;
+        }
+    }
+}
+
+/**
+ * @brief Samples per delta frame of a binary stream in the current log format
+ *
+ * @param divider Ticks per sample of the stream
+ * @return Batch size, 0 (one sample per frame) unless compressed (TLM 2)
+ */
+static uint8_t tlm_batch(uint32_t divider)
+{
+    uint32_t batch = TLM_BATCH_MS * CONTROL_RATE_HZ / 1000 / divider;
+
+    // Delta frames of TLM 2 hold a sample for at most TLM_BATCH_MS
+    if (tlm_mode != 2)
+    {
+        return 0;
+    }
+    if (batch > TELEMETRY_BATCH_MAX)
+    {
+        batch = TELEMETRY_BATCH_MAX;
+    }
+
+    return (uint8_t)(batch > 0 ? batch : 1);
+}
+
+/**
+ * @brief Name of a capture trigger cause
+ *
+ * @param cause Trigger cause (capture_cause_t)
+ * @return Name
+ */
+static const char *capture_cause_name(int cause)
+{
+    static const char *const names[] = {"no", "manual", "target", "error"};
+
+    return cause >= 0 && cause < (int)(sizeof(names) / sizeof(names[0])) ? names[cause] : "?";
+}
+
+/**
+ * @brief Start dumping the complete capture of a rig from the main loop
+ *
+ * @param rig Pointer to rig (capture complete)
+ * @param binary Telemetry frames instead of CSV
+ */
+static void capture_dump_start(rig_t *rig, uint8_t binary)
+{
+    dump_pos = 0;
+    dump_binary = binary;
+    if (binary)
+    {
+        telemetry_init(&dump_tlm, capture_channels, sizeof(capture_channels) / sizeof(capture_channels[0]),
+                       (uint8_t)(CAPTURE_STREAM + rig->index), pico_telemetry_write, NULL);
+        telemetry_set_batch(&dump_tlm, TELEMETRY_BATCH_MAX);
+    }
+    dump_rig = rig;
+}
+
+/**
+ * @brief Print the next line of the capture dump: header, one sample or the end
+ */
+static void capture_dump_next(void)
+{
+    const capture_t *cap = &dump_rig->capture;
+    const capture_sample_t *s;
+    long tick;
+
+    if (dump_pos == 0)
+    {
+        if (!dump_binary)
+        {
+            printf("# capture rig %u trigger %s rate %d pre %lu post %lu samples %lu\n", dump_rig->index,
+                   capture_cause_name(cap->cause), CONTROL_RATE_HZ, (unsigned long)cap->pre_count,
+                   (unsigned long)(cap->length - cap->pre_count), (unsigned long)cap->length);
+            printf("tick,setpoint,angle,command,late_us,cpu_us\n");
+        }
+        dump_pos++;
+        return;
+    }
+
+    s = capture_get(cap, dump_pos - 1);
+    if (!s)
+    {
+        if (!dump_binary)
+        {
+            printf("# end\n");
+        }
+        else
+        {
+            telemetry_flush(&dump_tlm);
+        }
+        dump_rig = NULL;
+        return;
+    }
+
+    tick = (long)(dump_pos - 1) - (long)cap->pre_count;
+    if (dump_binary)
+    {
+        int32_t values[] = {
+            (int32_t)tick * FIX16_ONE,
+            (int32_t)(((int64_t)s->setpoint << FIX16_SHIFT) / 100),
+            (int32_t)(((int64_t)s->angle << FIX16_SHIFT) / 100),
+            (int32_t)s->command * 2,
+            s->late_us,
+            s->cpu_us,
+        };
+
+        telemetry_send(&dump_tlm, values);
+    }
+    else
+    {
+        char buf[LOG_LINE_MAX];
+        fmt_line_t line;
+
+        // Centidegrees and Q1.15 duty, as printf "%.2f" and "%.5f" of the float values
+        fmt_init(&line, buf, sizeof(buf));
+        fmt_i32(&line, (int32_t)tick);
+        fmt_char(&line, ',');
+        fmt_decimal(&line, s->setpoint, 2);
+        fmt_char(&line, ',');
+        fmt_decimal(&line, s->angle, 2);
+        fmt_char(&line, ',');
+        fmt_fix16(&line, (fix16_t)s->command * 2, 5);
+        fmt_char(&line, ',');
+        fmt_u32(&line, s->late_us);
+        fmt_char(&line, ',');
+        fmt_u32(&line, s->cpu_us);
+        fmt_char(&line, '\n');
+        printf("%s", buf);
+    }
+    dump_pos++;
+}
+
+/**
+ * @brief Core 1: supervisor interrupt and scheduler for the rigs on I2C bus 1
+ */
+static void core1_entry(void)
+{
+    supervisor_timer_init();
+    span_init_pico(1);
+
+    while (1)
+    {
+        rig_run(1);
+    }
+}
+
+/**
+ * @brief Feed the watchdog once the supervisor interrupt of every running rig has been seen
+ */
+static void feed_watchdog(void)
+{
+    static uint32_t last_heartbeat[RIG_COUNT];
+    static uint32_t alive;
+    uint32_t running = 0;
+
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        if (!rigs[i].present)
+        {
+            continue;
+        }
+
+        running |= 1u << i;
+        if (rigs[i].reg.sup.heartbeat != last_heartbeat[i])
+        {
+            last_heartbeat[i] = rigs[i].reg.sup.heartbeat;
+            alive |= 1u << i;
+        }
+    }
+
+    if (alive == running)
+    {
+        alive = 0;
+        watchdog_update();
+    }
+}
+
+/**
+ * @brief Print the time budget of every rig, core and bus, then start a new window
+ *
+ * The room estimate assumes more rigs like the most expensive one on the core
+ * (bus) and plans with the worst tick, not the mean.
+ */
+static void print_budget(void)
+{
+    uint32_t cpu_load[2] = {0, 0}, cpu_peak[2] = {0, 0}, cpu_worst[2] = {0, 0};
+    uint32_t bus_load[2] = {0, 0}, bus_peak[2] = {0, 0}, bus_worst[2] = {0, 0};
+
+    printf("Budget per %d us tick (mean/max us):\n", CONTROL_PERIOD_US);
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        const rig_t *rig = &rigs[i];
+        const budget_t *b = &rig->budget;
+        uint8_t n = rig->hw->bus;
+
+        if (!rig->present)
+        {
+            printf("  rig %u: not present\n", i);
+            continue;
+        }
+
+        printf("  rig %u (core %u, bus %u, slot %lu us): cpu %lu/%lu (%.1f %%), bus %lu/%lu (%.1f %%), "
+               "late %lu, overruns %lu, ticks %lu, log dropped %lu\n",
+               i, n, n, (unsigned long)rig->phase_us,
+               (unsigned long)budget_cpu_mean(b), (unsigned long)b->cpu_max,
+               budget_load(b, budget_cpu_mean(b)) / 10.0f,
+               (unsigned long)budget_bus_mean(b), (unsigned long)b->bus_max,
+               budget_load(b, budget_bus_mean(b)) / 10.0f,
+               (unsigned long)b->late_max, (unsigned long)b->overruns, (unsigned long)b->ticks,
+               (unsigned long)log_ring_dropped(&rig->log));
+
+        cpu_load[n] += budget_load(b, budget_cpu_mean(b));
+        cpu_peak[n] += b->cpu_max;
+        bus_load[n] += budget_load(b, budget_bus_mean(b));
+        bus_peak[n] += b->bus_max;
+        if (b->cpu_max > cpu_worst[n])
+        {
+            cpu_worst[n] = b->cpu_max;
+        }
+        if (b->bus_max > bus_worst[n])
+        {
+            bus_worst[n] = b->bus_max;
+        }
+    }
+
+    for (uint8_t n = 0; n < 2; n++)
+    {
+        uint32_t cpu_room = 0, bus_room = 0;
+
+        if (cpu_worst[n] == 0)
+        {
+            continue;
+        }
+        if (cpu_peak[n] < CONTROL_PERIOD_US)
+        {
+            cpu_room = (CONTROL_PERIOD_US - cpu_peak[n]) / cpu_worst[n];
+        }
+        if (bus_worst[n] > 0 && bus_peak[n] < CONTROL_PERIOD_US)
+        {
+            bus_room = (CONTROL_PERIOD_US - bus_peak[n]) / bus_worst[n];
+        }
+
+        printf("  core %u: %.1f %% mean, %.1f %% peak, room for %lu more rigs\n", n, cpu_load[n] / 10.0f,
+               cpu_peak[n] * 100.0f / CONTROL_PERIOD_US, (unsigned long)cpu_room);
+        printf("  bus %u: %.1f %% mean, %.1f %% peak, room for %lu more rigs\n", n, bus_load[n] / 10.0f,
+               bus_peak[n] * 100.0f / CONTROL_PERIOD_US, (unsigned long)bus_room);
+    }
+
+    // Each rig starts its new window on its own core
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        rigs[i].budget_restart = 1;
+    }
+}
+
+/**
+ * @brief Start the cycle counter of the running core and clear its span table
+ *
+ * The SysTick of each core counts down from 0xFFFFFF at the system clock
+ * (SPAN_COUNTER() in span.h). Core 0 also measures what the markers cost:
+ * the span of an empty marker pair, and the time the pair adds to an
+ * enclosing span (its own counter reads and the table update).
+ *
+ * @param core Core number (the caller's core)
+ */
+static void span_init_pico(uint core)
+{
+#if SPAN_ENABLED
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+
+    if (core == 0)
+    {
+        SPAN_BEGIN(outer);
+        SPAN_BEGIN(inner);
+        SPAN_END(SPAN_TICK, inner);
+        span_pair_cycles = SPAN_ELAPSED(outer, SPAN_COUNTER());
+        span_empty_cycles = span_stats[core][SPAN_TICK].max;
+    }
+#endif
+
+    span_reset((uint8_t)core);
+    span_window_start[core] = micros();
+}
+
+/**
+ * @brief Print the span statistics of every core and stage, then start a new window
+ *
+ * Per stage: spans, min/mean/max in cycles, the mean in us, the share of the
+ * window spent in the stage and the non-empty histogram buckets (cycles).
+ * Nested stages (sensor, control and motor in tick, telemetry in log) are
+ * also counted in the enclosing one.
+ */
+static void print_spans(void)
+{
+#if SPAN_ENABLED
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+    uint64_t now = micros();
+
+    printf("Spans in cycles at %lu MHz, min/mean/max (empty span %lu, marker pair adds %lu):\n", (unsigned long)mhz,
+           (unsigned long)span_empty_cycles, (unsigned long)span_pair_cycles);
+    for (uint8_t n = 0; n < SPAN_CORES; n++)
+    {
+        uint32_t window_us = (uint32_t)(now - span_window_start[n]);
+
+        printf("  core %u, %lu ms:\n", n, (unsigned long)(window_us / 1000));
+        for (uint8_t st = 0; st < SPAN_STAGES; st++)
+        {
+            const span_stats_t *s = &span_stats[n][st];
+
+            if (s->count == 0)
+            {
+                continue;
+            }
+
+            printf("    %-9s %lu spans, %lu/%lu/%lu (%.1f us mean, %.2f %% of the window),", span_stage_names[st],
+                   (unsigned long)s->count, (unsigned long)s->min, (unsigned long)span_mean(s),
+                   (unsigned long)s->max, (float)span_mean(s) / mhz,
+                   window_us > 0 ? (float)s->sum * 100.0f / ((float)window_us * mhz) : 0.0f);
+            for (uint8_t b = 0; b < SPAN_BUCKETS; b++)
+            {
+                if (s->hist[b] > 0)
+                {
+                    printf(" %lu-%lu:%lu", b == 0 ? 0ul : 1ul << b, (2ul << b) - 1, (unsigned long)s->hist[b]);
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    // Each core starts its new window itself
+    for (uint8_t n = 0; n < SPAN_CORES; n++)
+    {
+        span_restart[n] = 1;
+    }
+#else
+    printf("Span profiling not compiled in (cmake -DSPAN_PROFILING=ON)\n");
+#endif
+}
+
+/**
+ * @brief Handle a command line on core 0: board commands here, rig commands to the selected rig
+ *
+ * @param cmd Null-terminated command string
+ */
+static void dispatch_command(const char *cmd)
+{
+    rig_t *rig = &rigs[selected_rig];
+    int value;
+    int divider = 1;
+    char name[8];
+    unsigned long id;
+
+    if (sscanf(cmd, "SYNC %lu", &id) == 1)
+    {
+        // Clock sync: only the arrival time here, log_drain() replies without waiting for the output
+        sync_id = (uint32_t)id;
+        sync_rx_us = (uint32_t)command_us;
+        sync_pending = 1;
+    }
+    else if (sscanf(cmd, "RIG %d", &value) == 1)
+    {
+        if (value >= 0 && value < RIG_COUNT && rigs[value].present)
+        {
+            if (rig->tlm_active)
+            {
+                telemetry_flush(&rig->tlm);
+            }
+            selected_rig = (uint8_t)value;
+            rigs[value].tlm_active = 0;
+            printf("Rig %d selected\n", value);
+        }
+        else
+        {
+            printf("Rig %d not present\n", value);
+        }
+    }
+    else if (strcmp(cmd, "BUDGET") == 0)
+    {
+        print_budget();
+    }
+    else if (strcmp(cmd, "SPAN") == 0)
+    {
+        print_spans();
+    }
+    else if (strcmp(cmd, "FMTBENCH") == 0)
+    {
+        bench_left = FMT_BENCH_LINES;
+        bench_printf_us = 0;
+        bench_fmt_us = 0;
+        bench_differ = 0;
+    }
+    else if (sscanf(cmd, "CAPDUMP %7s", name) == 1)
+    {
+        // No command in the mailbox: a CAP cannot re-arm the buffer while it is read
+        if (rig->capture.state != CAPTURE_DONE)
+        {
+            printf("No complete capture on rig %u\n", rig->index);
+        }
+        else if (dump_rig || flog_dumping || rig->cmd_full)
+        {
+            printf("Rig %u busy, try again\n", rig->index);
+        }
+        else if (strcmp(name, "CSV") == 0 || strcmp(name, "BIN") == 0)
+        {
+            capture_dump_start(rig, name[0] == 'B');
+        }
+        else
+        {
+            printf("Unknown dump format: %s\n", name);
+        }
+    }
+    else if (strncmp(cmd, "FLOG", 4) == 0 && !flog_ready)
+    {
+        printf("Flash log unavailable\n");
+    }
+    else if (sscanf(cmd, "FLOG START %d", &divider) == 1)
+    {
+        uint8_t data[7] = {FLOG_RECORD_SESSION};
+        uint32_t now = millis();
+
+        if (divider < 1 || divider > FLOG_DIVIDER_MAX || flog_dumping)
+        {
+            printf("Invalid flash log divider (1-%d) or dump running\n", FLOG_DIVIDER_MAX);
+            return;
+        }
+
+        // A session record marks each start in the dump
+        flash_log_start(&flog);
+        data[1] = (uint8_t)divider;
+        data[2] = (uint8_t)(divider >> 8);
+        memcpy(&data[3], &now, 4);
+        flash_log_append(&flog, data, sizeof(data));
+        flog_divider = (uint16_t)divider;
+        printf("Flash log started, %lu Hz per rig\n", (unsigned long)(CONTROL_RATE_HZ / divider));
+    }
+    else if (strcmp(cmd, "FLOG STOP") == 0)
+    {
+        // Samples already queued still go to the flash
+        flog_divider = 0;
+        flog_collect();
+        flash_log_stop(&flog);
+        print_flog_status();
+    }
+    else if (strcmp(cmd, "FLOG CLEAR") == 0)
+    {
+        if (flog_dumping)
+        {
+            printf("Flash log dump running\n");
+            return;
+        }
+        flog_divider = 0;
+        flash_log_clear(&flog);
+        printf("Flash log cleared\n");
+    }
+    else if (sscanf(cmd, "FLOG DUMP %7s", name) == 1)
+    {
+        if (strcmp(name, "CSV") != 0 && strcmp(name, "BIN") != 0)
+        {
+            printf("Unknown dump format: %s\n", name);
+        }
+        else if (dump_rig || flog_dumping || flash_log_read_begin(&flog, &flog_reader) != FLASH_LOG_OK)
+        {
+            printf("Flash log busy (stop it with FLOG STOP), try again\n");
+        }
+        else
+        {
+            flog_dump_binary = name[0] == 'B';
+            if (flog_dump_binary)
+            {
+                for (uint8_t i = 0; i < RIG_COUNT; i++)
+                {
+                    telemetry_init(&flog_tlm[i], telemetry_log_channels, TELEMETRY_LOG_CHANNELS,
+                                   (uint8_t)(FLOG_STREAM + i), pico_telemetry_write, NULL);
+                    telemetry_set_batch(&flog_tlm[i], TELEMETRY_BATCH_MAX);
+                }
+            }
+            else
+            {
+                printf("# flash log rate %d pages %lu\n", CONTROL_RATE_HZ, (unsigned long)flash_log_span(&flog));
+                printf("rig,time,setpoint,angle,command,voltage\n");
+            }
+            flog_dumping = 1;
+        }
+    }
+    else if (strcmp(cmd, "FLOG") == 0)
+    {
+        print_flog_status();
+    }
+    else if (sscanf(cmd, "TLM %d %d", &value, &divider) >= 1)
+    {
+        static const char *const modes[] = {"text", "binary", "binary delta-compressed"};
+
+        if (value < 0 || value > 2)
+        {
+            value = 0;
+        }
+        if (value && divider >= 1 && divider <= TLM_DIVIDER_MAX)
+        {
+            tlm_divider = (uint16_t)divider;
+        }
+        else if (value)
+        {
+            tlm_divider = 1;
+        }
+
+        // Schema, and keyframe or batch size, with the next binary sample
+        tlm_mode = (uint8_t)value;
+        for (uint8_t i = 0; i < RIG_COUNT; i++)
+        {
+            if (rigs[i].tlm_active)
+            {
+                telemetry_flush(&rigs[i].tlm);
+                rigs[i].tlm_active = 0;
+            }
+            channels_flush(&rigs[i]);
+        }
+        printf("Log %s, %lu Hz\n", modes[value],
+               (unsigned long)(CONTROL_RATE_HZ / (tlm_mode ? tlm_divider : LOG_DIVIDER)));
+    }
+    else if (!rig->present)
+    {
+        printf("Rig %u not present, select one with RIG <n>\n", rig->index);
+    }
+    else if (rig->cmd_full)
+    {
+        printf("Rig %u busy, command dropped\n", rig->index);
+    }
+    else
+    {
+        // Picked up by the rig's core between two ticks
+        strncpy(rig->cmd, cmd, sizeof(rig->cmd) - 1);
+        rig->cmd[sizeof(rig->cmd) - 1] = '\0';
+        __dmb();
+        rig->cmd_full = 1;
+    }
+}
+
+/**
+ * @brief Process a complete command line
+ *
+ * Runs on the core of the rig, in the same context as its control tick.
+ *
+ * @param rig Rig addressed by the command
+ * @param cmd Null-terminated command string
+ */
+static void process_command(rig_t *rig, const char *cmd)
+{
+    regulator_t *reg = &rig->reg;
+    int value, tau;
+    int pred_pid, pred_lqr;
+    int osc_on, osc_backoff;
+    float osc_deg;
+    float volts;
+    float vel, acc, jerk;
+    float kp, ki, kd, alpha, limit;
+    float u0, amp, fmin, fmax, secs;
+    float deg, kpos, kvel, kthr;
+    float pre_ms, post_ms;
+    char name[8];
+    char channel[TELEMETRY_NAME_MAX + 1];
+    int n;
+
+    // Controller settings go through the shadow parameter set; the scheduler
+    // publishes it and the next control tick applies it as a whole
+    if (sscanf(cmd, "SET %d", &value) == 1)
+    {
+        ctrl_params_edit(&reg->params)->target = FIX16_FROM_INT(value);
+        rig_printf(rig, "Target angle set to %d\n", value);
+    }
+    else if (sscanf(cmd, "SCHED %d", &value) == 1)
+    {
+        // An empty schedule cannot be enabled
+        uint8_t enable = value && reg->ctrl.sched.count > 0;
+
+        ctrl_params_edit(&reg->params)->sched_enabled = enable;
+        rig_printf(rig, "Gain schedule %s\n", enable ? "enabled" : "disabled");
+    }
+    else if (sscanf(cmd, "FF %d", &value) == 1)
+    {
+        ctrl_params_edit(&reg->params)->ff_enabled = value ? 1 : 0;
+        rig_printf(rig, "Feedforward %s\n", value ? "enabled" : "disabled");
+    }
+    else if (sscanf(cmd, "DOB %d", &value) == 1)
+    {
+        ctrl_params_edit(&reg->params)->dob_enabled = value ? 1 : 0;
+        rig_printf(rig, "Disturbance observer %s (estimate %.3f)\n", value ? "enabled" : "disabled",
+                   FIX16_TO_FLOAT(reg->ctrl.dob.estimate));
+    }
+    else if (sscanf(cmd, "DOBCFG %d %d", &value, &tau) == 2)
+    {
+        if (value > 0 && value <= CONTROL_RATE_HZ / DOB_BANDWIDTH_RATE_DIVIDER && tau >= 0 &&
+            tau <= DOB_MOTOR_TAU_MS_MAX)
+        {
+            ctrl_params_t *params = ctrl_params_edit(&reg->params);
+
+            params->dob_bandwidth = (uint16_t)value;
+            params->dob_motor_tau_ms = (uint16_t)tau;
+            rig_printf(rig, "Disturbance observer %d rad/s, motor lag %d ms\n", value, tau);
+        }
+        else
+        {
+            rig_printf(rig, "Invalid observer settings (bandwidth 1-%d rad/s, lag 0-%d ms)\n",
+                       CONTROL_RATE_HZ / DOB_BANDWIDTH_RATE_DIVIDER, DOB_MOTOR_TAU_MS_MAX);
+        }
+    }
+    else if (sscanf(cmd, "LQRK %f %f %f %f", &deg, &kpos, &kvel, &kthr) == 4)
+    {
+        lqr_gains_t gains = {LQR_K_FROM_FLOAT(kpos), LQR_K_FROM_FLOAT(kvel), FIX16_FROM_FLOAT(kthr)};
+        lqr_err_t err;
+
+        if (lqr_table_locked(rig))
+        {
+            return;
+        }
+
+        err = lqr_set_point(&reg->ctrl.lqr, FIX16_FROM_FLOAT(deg), &gains);
+        if (err == LQR_OK)
+        {
+            rig_printf(rig, "State feedback at %.1f deg: %.5f per deg, %.6f per deg/s, %.3f (%u points)\n",
+                       deg, kpos, kvel, kthr, reg->ctrl.lqr.count);
+        }
+        else
+        {
+            rig_printf(rig, "%s\n", err == LQR_ERR_FULL ? "State feedback table full" : "Invalid state feedback gains");
+        }
+    }
+    else if (strcmp(cmd, "LQRCLR") == 0)
+    {
+        if (!lqr_table_locked(rig))
+        {
+            lqr_clear(&reg->ctrl.lqr);
+            rig_printf(rig, "State feedback table cleared\n");
+        }
+    }
+    else if (sscanf(cmd, "LQR %d", &value) == 1)
+    {
+        // An empty gain table cannot be enabled
+        uint8_t enable = value && reg->ctrl.lqr.count > 0;
+
+        ctrl_params_edit(&reg->params)->lqr_enabled = enable;
+        rig_printf(rig, "State feedback %s\n", enable ? "enabled" : "disabled");
+    }
+    else if (sscanf(cmd, "PRED %d %d", &pred_pid, &pred_lqr) == 2)
+    {
+        ctrl_params_t *params = ctrl_params_edit(&reg->params);
+
+        params->pred_modes = (pred_pid ? CONTROLLER_PRED_PID : 0) | (pred_lqr ? CONTROLLER_PRED_LQR : 0);
+        rig_printf(rig, "Latency compensation %lu us: PID %s, LQR %s\n", (unsigned long)params->pred_delay_us,
+                   pred_pid ? "on" : "off", pred_lqr ? "on" : "off");
+    }
+    else if (sscanf(cmd, "VCOMP %d %f", &value, &volts) == 2 && volts >= 0.0f)
+    {
+        // Same context as the control tick: takes effect with the next duty
+        supply_configure(&rig->supply, value, FIX16_FROM_FLOAT(volts));
+        rig_printf(rig, "Supply compensation %s, nominal %.2f V (supply %.2f V)\n", value ? "on" : "off",
+                   FIX16_TO_FLOAT(rig->supply.nominal), FIX16_TO_FLOAT(rig->supply.voltage));
+    }
+    else if (sscanf(cmd, "OSC %d %d %f", &osc_on, &osc_backoff, &osc_deg) == 3 && osc_deg >= 0.0f)
+    {
+        regulator_configure_osc(reg, osc_on, osc_backoff, FIX16_FROM_FLOAT(osc_deg));
+        rig_printf(rig, "Oscillation detector %s, back-off %s, threshold %.2f deg\n", osc_on ? "on" : "off",
+                   osc_backoff ? "on" : "off", FIX16_TO_FLOAT(reg->osc.threshold));
+    }
+    else if (sscanf(cmd, "PROF %d", &value) == 1 && value >= TRAJ_PROFILE_STEP && value <= TRAJ_PROFILE_SCURVE)
+    {
+        ctrl_params_edit(&reg->params)->profile = (traj_profile_t)value;
+        rig_printf(rig, "Setpoint profile %d\n", value);
+    }
+    else if (sscanf(cmd, "LIM %f %f %f", &vel, &acc, &jerk) == 3)
+    {
+        ctrl_params_t *params;
+
+        // Checked as floats: the conversion of a value outside Q16.16 is undefined
+        if (!(vel <= FIX16_TO_FLOAT(TRAJ_VEL_MAX_LIMIT) && acc <= FIX16_TO_FLOAT(TRAJ_ACC_MAX_LIMIT) &&
+              jerk <= FIX16_TO_FLOAT(TRAJ_JERK_MAX_LIMIT)))
+        {
+            rig_printf(rig, "Invalid limits (at most %.0f deg/s, %.0f deg/s^2, %.0f deg/s^3)\n",
+                       FIX16_TO_FLOAT(TRAJ_VEL_MAX_LIMIT), FIX16_TO_FLOAT(TRAJ_ACC_MAX_LIMIT),
+                       FIX16_TO_FLOAT(TRAJ_JERK_MAX_LIMIT));
+            return;
+        }
+
+        // Non-positive limits fall back to the defaults, like traj_set_limits() does
+        params = ctrl_params_edit(&reg->params);
+        params->vel_max = vel > 0 ? FIX16_FROM_FLOAT(vel) : TRAJ_VEL_MAX_DEFAULT;
+        params->acc_max = acc > 0 ? FIX16_FROM_FLOAT(acc) : TRAJ_ACC_MAX_DEFAULT;
+        params->jerk_max = jerk > 0 ? FIX16_FROM_FLOAT(jerk) : TRAJ_JERK_MAX_DEFAULT;
+        rig_printf(rig, "Limits %.1f deg/s, %.1f deg/s^2, %.1f deg/s^3\n",
+                   FIX16_TO_FLOAT(params->vel_max), FIX16_TO_FLOAT(params->acc_max), FIX16_TO_FLOAT(params->jerk_max));
+    }
+    else if (sscanf(cmd, "FFDYN %f %f", &vel, &acc) == 2)
+    {
+        ctrl_params_t *params;
+
+        if (!(vel > -FF_K_FLOAT_LIMIT && vel < FF_K_FLOAT_LIMIT && acc > -FF_K_FLOAT_LIMIT && acc < FF_K_FLOAT_LIMIT))
+        {
+            rig_printf(rig, "Invalid feedforward coefficients (magnitude below %.0f)\n", FF_K_FLOAT_LIMIT);
+            return;
+        }
+
+        params = ctrl_params_edit(&reg->params);
+        params->ff_k_vel = FF_K_FROM_FLOAT(vel);
+        params->ff_k_acc = FF_K_FROM_FLOAT(acc);
+        rig_printf(rig, "Feedforward %.6f per deg/s, %.6f per deg/s^2\n", vel, acc);
+    }
+    else if (sscanf(cmd, "PID %f %f %f", &kp, &ki, &kd) == 3)
+    {
+        pid_gains_t gains = {FIX16_FROM_FLOAT(kp), FIX16_FROM_FLOAT(ki), FIX16_FROM_FLOAT(kd)};
+
+        ctrl_params_edit(&reg->params)->gains = gains;
+        rig_printf(rig, "Gains Kp %.6f, Ki %.6f, Kd %.6f\n", kp, ki, kd);
+    }
+    else if (sscanf(cmd, "PIDF %f %f", &alpha, &limit) == 2)
+    {
+        ctrl_params_t *params = ctrl_params_edit(&reg->params);
+
+        // Same limits as pid_set_tuning()
+        params->d_alpha = fix16_clamp(FIX16_FROM_FLOAT(alpha), 1, FIX16_ONE);
+        params->i_limit = limit > 0 ? FIX16_FROM_FLOAT(limit) : FIX16_ONE;
+        rig_printf(rig, "Derivative filter %.3f, integrator limit %.3f\n",
+                   FIX16_TO_FLOAT(params->d_alpha), FIX16_TO_FLOAT(params->i_limit));
+    }
+    else if (sscanf(cmd, "ID %7s %f %f %f %f %f", name, &u0, &amp, &fmin, &fmax, &secs) == 6)
+    {
+        static const char *const signals[] = {"PRBS", "SINE", "CHIRP"};
+        sysid_config_t cfg = {
+            .u0 = FIX16_FROM_FLOAT(u0),
+            .amp = FIX16_FROM_FLOAT(amp),
+            .f_min = FIX16_FROM_FLOAT(fmin),
+            .f_max = FIX16_FROM_FLOAT(fmax),
+            .settle_ticks = SYSID_SETTLE_MS * CONTROL_RATE_HZ / 1000,
+            .samples = secs > 0 ? (uint32_t)(secs * CONTROL_RATE_HZ) : 0,
+        };
+        size_t i = 0;
+
+        while (i < sizeof(signals) / sizeof(signals[0]) && strcmp(name, signals[i]) != 0)
+        {
+            i++;
+        }
+
+        if (i == sizeof(signals) / sizeof(signals[0]))
+        {
+            rig_printf(rig, "Unknown excitation: %s\n", name);
+            return;
+        }
+        cfg.signal = (sysid_signal_t)i;
+
+        // The identification records into the capture buffer, which may still be dumped
+        if (dump_rig == rig || rig->sysid_dump)
+        {
+            rig_printf(rig, "Capture being dumped, try again\n");
+            return;
+        }
+
+        sysid_err_t err = regulator_start_sysid(reg, &cfg, rig->sysid_buf, SYSID_CAPACITY);
+        if (err == SYSID_ERR_BUFFER)
+        {
+            rig_printf(rig, "Capture too long, at most %.1f s\n", (float)SYSID_CAPACITY / CONTROL_RATE_HZ);
+        }
+        else if (err != SYSID_OK)
+        {
+            rig_printf(rig, "Invalid identification settings\n");
+        }
+        else if (reg->mode == REGULATOR_MODE_SYSID)
+        {
+            if (rig->capture.state != CAPTURE_IDLE)
+            {
+                rig_printf(rig, "Capture discarded\n");
+            }
+            capture_init(&rig->capture, rig->capture_buf, CAPTURE_CAPACITY);
+            rig_printf(rig, "Identification started (%s around %.3f +/- %.3f, %.2f - %.2f Hz, %.1f s)\n",
+                       name, u0, amp, fmin, fmax, secs);
+        }
+        else
+        {
+            rig_printf(rig, "Identification blocked by latched faults, send CLEAR\n");
+        }
+    }
+    else if (strcmp(cmd, "CAP OFF") == 0)
+    {
+        capture_disarm(&rig->capture);
+        rig_printf(rig, "Capture disarmed\n");
+    }
+    else if ((n = sscanf(cmd, "CAP %f %f %7s %f", &pre_ms, &post_ms, name, &deg)) >= 3)
+    {
+        capture_config_t cfg = {
+            .pre = pre_ms > 0 ? (uint32_t)(pre_ms * CONTROL_RATE_HZ / 1000.0f + 0.5f) : 0,
+            .post = post_ms > 0 ? (uint32_t)(post_ms * CONTROL_RATE_HZ / 1000.0f + 0.5f) : 0,
+            .on_target = strcmp(name, "SET") == 0,
+            .error_band = 0,
+        };
+
+        if (strcmp(name, "ERR") == 0)
+        {
+            cfg.error_band = n == 4 && deg > 0 ? FIX16_FROM_FLOAT(deg) : -1;
+        }
+        else if (!cfg.on_target && strcmp(name, "MAN") != 0)
+        {
+            rig_printf(rig, "Unknown trigger: %s\n", name);
+            return;
+        }
+
+        if (reg->mode == REGULATOR_MODE_SYSID)
+        {
+            rig_printf(rig, "Identification running, capture not armed\n");
+        }
+        else if (dump_rig == rig || rig->sysid_dump || capture_arm(&rig->capture, &cfg) != CAPTURE_OK)
+        {
+            rig_printf(rig, "Invalid capture (pre + post at most %d ms, post at least 1 ms, ERR needs a band)\n",
+                       CAPTURE_CAPACITY * 1000 / CONTROL_RATE_HZ);
+        }
+        else
+        {
+            rig_printf(rig, "Capture armed: %lu ms before, %lu ms after a %s trigger\n",
+                       (unsigned long)(cfg.pre * 1000 / CONTROL_RATE_HZ),
+                       (unsigned long)(cfg.post * 1000 / CONTROL_RATE_HZ), name);
+        }
+    }
+    else if (strcmp(cmd, "CAPTRIG") == 0)
+    {
+        capture_trigger(&rig->capture);
+        rig_printf(rig, "Capture %s\n", rig->capture.state == CAPTURE_ARMED ? "triggered" : "not armed");
+    }
+    else if (strcmp(cmd, "CH OFF") == 0)
+    {
+        registry_clear(&rig->registry);
+        rig_printf(rig, "All channels off\n");
+    }
+    else if (sscanf(cmd, "CH %15s %d", channel, &value) == 2)
+    {
+        registry_err_t err = REGISTRY_ERR_INVALID_PARAM;
+
+        if (value >= 0 && value <= CHANNEL_DIVIDER_MAX)
+        {
+            err = registry_set(&rig->registry, channel, (uint16_t)value);
+        }
+
+        if (err == REGISTRY_OK && value)
+        {
+            rig_printf(rig, "Channel %s at %lu Hz\n", channel, (unsigned long)(CONTROL_RATE_HZ / value));
+        }
+        else if (err == REGISTRY_OK)
+        {
+            rig_printf(rig, "Channel %s off\n", channel);
+        }
+        else if (err == REGISTRY_ERR_UNKNOWN)
+        {
+            rig_printf(rig, "Unknown channel: %s (list with CH)\n", channel);
+        }
+        else if (err == REGISTRY_ERR_FULL)
+        {
+            rig_printf(rig, "Too many channels: at most %d rates with %d channels each\n", REGISTRY_MAX_GROUPS,
+                       REGISTRY_GROUP_VARS);
+        }
+        else
+        {
+            rig_printf(rig, "Invalid channel divider (0-%d)\n", CHANNEL_DIVIDER_MAX);
+        }
+    }
+    else if (strcmp(cmd, "CH") == 0)
+    {
+        rig_printf(rig, "Channels of rig %u (%lu samples dropped on changes):", rig->index, (unsigned long)rig->ch_stale);
+        for (uint8_t i = 0; i < rig->registry.count; i++)
+        {
+            const registry_var_t *var = &rig->registry.vars[i];
+
+            rig_printf(rig, " %s", var->channel.name);
+            if (var->divider)
+            {
+                rig_printf(rig, "/%u", var->divider);
+            }
+        }
+        rig_printf(rig, "\n");
+    }
+    else if (strcmp(cmd, "SWEEP") == 0)
+    {
+        regulator_start_sweep(reg);
+        if (reg->mode == REGULATOR_MODE_SWEEP)
+        {
+            rig_printf(rig, "Calibration sweep started\n");
+        }
+        else
+        {
+            rig_printf(rig, "Calibration sweep blocked by latched faults, send CLEAR\n");
+        }
+    }
+    else if (strcmp(cmd, "START") == 0)
+    {
+        regulator_enable(reg, 1);
+        if (reg->enabled)
+        {
+            rig_printf(rig, "Regulation started\n");
+        }
+        else
+        {
+            rig_printf(rig, "Regulation blocked by latched faults, send CLEAR\n");
+        }
+    }
+    else if (strcmp(cmd, "CLEAR") == 0)
+    {
+        supervisor_clear(&reg->sup);
+        rig_printf(rig, "Faults cleared\n");
+    }
+    else if (strcmp(cmd, "STOP") == 0)
+    {
+        regulator_enable(reg, 0);
+        rig_printf(rig, "Regulation stopped\n");
+    }
+    else if (strcmp(cmd, "CAL") == 0)
+    {
+        regulator_enable(reg, 0);
+        rig_printf(rig, "Calibration %s\n", regulator_calibrate(reg) == AS5600_OK ? "done" : "failed");
+    }
+    else
+    {
+        rig_printf(rig, "Unknown command: %s\n", cmd);
+    }
+}
+
+/**
+ * @brief Check whether the state feedback gain table may be edited
+ *
+ * The control tick reads the table only while the state feedback runs, so it
+ * is edited in place while it is off, both active and pending.
+ *
+ * @param rig Pointer to rig (called on its core)
+ * @return 1 if locked (a message has been printed), 0 if it may be edited
+ */
+static uint8_t lqr_table_locked(rig_t *rig)
+{
+    const regulator_t *reg = &rig->reg;
+
+    if (reg->ctrl.lqr_enabled || reg->params.shadow.lqr_enabled)
+    {
+        rig_printf(rig, "Gain table locked while the state feedback is enabled, send LQR 0\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Start the supervisor interrupt of the calling core on a hardware alarm at the highest priority
+ *
+ * The alarm interrupt is enabled on the core that sets the callback, so
+ * each core checks its own rigs.
+ */
+static void supervisor_timer_init(void)
+{
+    int alarm_num = hardware_alarm_claim_unused(true);
+
+    hardware_alarm_set_callback(alarm_num, supervisor_alarm_callback);
+    irq_set_priority(TIMER_IRQ_0 + alarm_num, PICO_HIGHEST_IRQ_PRIORITY);
+    hardware_alarm_set_target(alarm_num, make_timeout_time_us(SUPERVISOR_PERIOD_US));
+}
+
+/**
+ * @brief Supervisor interrupt: check the regulation loops of this core and re-arm the alarm
+ *
+ * @param alarm_num Hardware alarm number
+ */
+static void supervisor_alarm_callback(uint alarm_num)
+{
+    uint core = get_core_num();
+
+    for (uint8_t i = 0; i < RIG_COUNT; i++)
+    {
+        if (rigs[i].present && rigs[i].hw->bus == core)
+        {
+            supervisor_isr(&rigs[i].reg.sup);
+        }
+    }
+    hardware_alarm_set_target(alarm_num, make_timeout_time_us(SUPERVISOR_PERIOD_US));
+}
+
+/**
+ * @brief Print the latched supervisor faults
+ *
+ * @param faults Latched fault flags (SUPERVISOR_FAULT_*)
+ * @param angle Angle at the first fault
+ */
+static void print_faults(uint32_t faults, fix16_t angle)
+{
+    static const char *const names[] = {"stale", "sensor", "magnet", "agc", "angle", "rate", "deadline"};
+
+    printf("Safety stop at %.1f deg:", FIX16_TO_FLOAT(angle));
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (faults & (1u << i))
+        {
+            printf(" %s", names[i]);
+        }
+    }
+    printf(" (send CLEAR, then START)\n");
+}
+
+
+/**
+ * @brief Print the summary of a completed step response on one line
+ *
+ * @param s Pointer to step summary
+ */
+static void print_step_summary(const step_summary_t *s)
+{
+    printf("Step %.1f -> %.1f: ", FIX16_TO_FLOAT(s->from), FIX16_TO_FLOAT(s->to));
+
+    if (s->rise_ms != UINT32_MAX)
+    {
+        printf("rise %lu ms, ", (unsigned long)s->rise_ms);
+    }
+    else
+    {
+        printf("rise -, ");
+    }
+
+    if (s->settled)
+    {
+        printf("settle %lu ms, ", (unsigned long)s->settle_ms);
+    }
+    else
+    {
+        printf("not settled, ");
+    }
+
+    printf("overshoot %.1f %%, error %.2f, IAE %.2f, ISE %.1f\n",
+           FIX16_TO_FLOAT(s->overshoot), FIX16_TO_FLOAT(s->ss_error),
+           FIX16_TO_FLOAT(s->iae), FIX16_TO_FLOAT(s->ise));
+}
+
+/**
+ * @brief Print the calibration sweep and the resulting feedforward table
+ *
+ * @param rig Pointer to rig (called on its core, the text goes through rig_printf())
+ */
+static void print_sweep_result(rig_t *rig)
+{
+    const regulator_t *reg = &rig->reg;
+    const calib_sweep_t *sweep = &reg->sweep;
+    const feedforward_t *ff = &reg->ctrl.ff;
+
+    if (sweep->state == CALIB_SWEEP_ABORTED)
+    {
+        rig_printf(rig, "Calibration sweep aborted at step %u\n", sweep->index);
+        return;
+    }
+
+    rig_printf(rig, "Calibration sweep (duty, angle):\n");
+    for (uint8_t i = 0; i < sweep->steps; i++)
+    {
+        rig_printf(rig, "  %.3f, %.2f\n", FIX16_TO_FLOAT(sweep->duty[i]), FIX16_TO_FLOAT(sweep->angle[i]));
+    }
+
+    if (reg->sweep_result != FF_OK)
+    {
+        rig_printf(rig, "Thrust table not rebuilt (%s), previous table kept\n",
+                   reg->sweep_result == FF_ERR_NO_DEADZONE ? "the first step already moved the pendulum"
+                                                           : "no usable thrust range");
+        return;
+    }
+
+    rig_printf(rig, "Thrust table (thrust, duty), thrust max %.3f:\n", FIX16_TO_FLOAT(ff->thrust_max));
+    for (uint8_t i = 0; i < FF_THRUST_POINTS; i++)
+    {
+        rig_printf(rig, "  %.3f, %.3f\n",
+                   FIX16_TO_FLOAT(ff->thrust_max) * i / (FF_THRUST_POINTS - 1),
+                   FIX16_TO_FLOAT(ff->duty[i]));
+    }
+}
+
+/**
+ * @brief Non-blocking read of the serial input, dispatches complete lines
+ */
+static void poll_commands(void)
+{
+    static char command_buffer[COMMAND_LENGTH]; // Buffer for user input
+    static size_t index = 0;        // Input position
+
+    int c = getchar_timeout_us(0); // Non-blocking read
+
+    if (c == PICO_ERROR_TIMEOUT)
+    {
+        return;
+    }
+
+    if (c == '\n' || c == '\r')
+    { // End of command
+        command_buffer[index] = '\0';
+        if (index > 0)
+        {
+            dispatch_command(command_buffer);
+        }
+        index = 0; // Reset buffer
+    }
+    else if (index < sizeof(command_buffer) - 1)
+    {
+        // The host sends a line in one USB packet: its first character marks the arrival
+        if (index == 0)
+        {
+            command_us = micros();
+        }
+        command_buffer[index++] = (char)c;
+    }
+}
+
+/**
+ * @brief Select the multiplexer channel of a rig if its bus is on another one
+ *
+ * Rigs on one bus run on the same core, one after the other, so the
+ * selected channel needs no locking.
+ *
+ * @param rig Pointer to rig
+ * @return 0 on success, non-zero on failure
+ */
+static uint8_t i2c_select_channel(rig_t *rig)
+{
+    uint8_t mask;
+
+    if (rig->hw->mux == RIG_NO_MUX || bus_channel[rig->hw->bus] == rig->hw->mux)
+    {
+        return 0;
+    }
+
+    mask = (uint8_t)(1u << rig->hw->mux);
+    if (i2c_write_blocking(rig->i2c, I2C_MUX_ADDR, &mask, 1, false) != 1)
+    {
+        bus_channel[rig->hw->bus] = RIG_NO_MUX;
+        return 1;
+    }
+
+    bus_channel[rig->hw->bus] = rig->hw->mux;
+    return 0;
+}
+
+/**
+ * @brief Pico SDK I2C write implementation
+ *
+ * @param dev_addr Device I2C address
+ * @param reg_addr Register address
+ * @param data Pointer to data to write
+ * @param len Length of data
+ * @param intf_ptr Rig the sensor belongs to
+ * @return 0 on success, non-zero on failure
+ */
+static int8_t pico_i2c_write(uint8_t dev_addr, uint8_t reg_addr, const uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    rig_t *rig = intf_ptr;
+    uint64_t start = micros();
+    int ret;
+    uint8_t buffer[len + 1];
+
+    // Prepare buffer: register address followed by data
+    buffer[0] = reg_addr;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        buffer[i + 1] = data[i];
+    }
+
+    // Send data
+    ret = i2c_select_channel(rig) ? PICO_ERROR_GENERIC
+                                  : i2c_write_blocking(rig->i2c, dev_addr, buffer, len + 1, false);
+    rig->bus_us += (uint32_t)(micros() - start);
+
+    return (ret == PICO_ERROR_GENERIC || ret != (len + 1)) ? -1 : 0;
+}
+
+/**
+ * @brief Pico SDK I2C read implementation
+ *
+ * @param dev_addr Device I2C address
+ * @param reg_addr Register address
+ * @param data Pointer to store read data
+ * @param len Length of data to read
+ * @param intf_ptr Rig the sensor belongs to
+ * @return 0 on success, non-zero on failure
+ */
+static int8_t pico_i2c_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    rig_t *rig = intf_ptr;
+    uint64_t start = micros();
+    int ret;
+
+    // Send register address
+    ret = i2c_select_channel(rig) ? PICO_ERROR_GENERIC
+                                  : i2c_write_blocking(rig->i2c, dev_addr, &reg_addr, 1, true); // true to keep master control of bus
+    if (ret == PICO_ERROR_GENERIC || ret != 1)
+    {
+        rig->bus_us += (uint32_t)(micros() - start);
+        return -1;
+    }
+
+    // Read data
+    ret = i2c_read_blocking(rig->i2c, dev_addr, data, len, false);
+    rig->bus_us += (uint32_t)(micros() - start);
+    if (ret == PICO_ERROR_GENERIC || ret != len)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Pico SDK delay implementation
+ *
+ * @param ms Delay time in milliseconds
+ * @param intf_ptr Rig the sensor belongs to (unused)
+ */
+static void pico_delay_ms(uint32_t ms, void *intf_ptr)
+{
+    sleep_ms(ms);
+}
+
+/**
+ * @brief Pico SDK PWM implementation for the DRV8871 inputs
+ *
+ * @param in1_level Compare level of IN1
+ * @param in2_level Compare level of IN2
+ * @param intf_ptr Rig the bridge belongs to
+ */
+static void pico_motor_set_levels(uint16_t in1_level, uint16_t in2_level, void *intf_ptr)
+{
+    const rig_t *rig = intf_ptr;
+
+    pwm_set_both_levels(rig->slice, in1_level, in2_level);
+}
+
+/**
+ * @brief Initialize the PWM outputs for the DRV8871 inputs of a rig
+ *
+ * @param rig Pointer to rig
+ */
+static void pwm_init_pico(rig_t *rig)
+{
+    gpio_set_function(rig->hw->in1_pin, GPIO_FUNC_PWM);
+    gpio_set_function(rig->hw->in2_pin, GPIO_FUNC_PWM);
+    uint slice_num = pwm_gpio_to_slice_num(rig->hw->in1_pin);
+
+    rig->slice = slice_num;
+
+    // Set PWM configuration
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_wrap(&config, MOTOR_PWM_WRAP);
+    pwm_init(slice_num, &config, false);
+    pwm_set_both_levels(slice_num, 0, 0);
+    pwm_set_enabled(slice_num, true);
+}
+
+/**
+ * @brief Start the free-running supply ADC with DMA into the sample ring
+ */
+static void adc_init_pico(void)
+{
+    adc_init();
+    adc_gpio_init(SUPPLY_ADC_PIN);
+    adc_select_input(SUPPLY_ADC_NUM);
+
+    // FIFO feeds the DMA one 12-bit sample at a time
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(48000000.0f / SUPPLY_SAMPLE_HZ - 1.0f);
+
+    supply_dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(supply_dma_chan);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, SUPPLY_RING_BITS);
+    channel_config_set_dreq(&config, DREQ_ADC);
+    dma_channel_configure(supply_dma_chan, &config, (void *)supply_ring, &adc_hw->fifo, UINT32_MAX, true);
+
+    adc_run(true);
+}
+
+/**
+ * @brief Mean of the supply ring (the last 1 ms, 20 PWM periods)
+ *
+ * Every rig filters the shared ring on its own.
+ *
+ * @param intf_ptr Unused (one ADC for all rigs)
+ * @return Mean ADC reading (counts)
+ */
+static uint16_t pico_supply_read(void *intf_ptr)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < SUPPLY_RING_SAMPLES; i++)
+    {
+        sum += supply_ring[i];
+    }
+
+    // The transfer count runs out after about 18 hours: re-arm the channel
+    if (!dma_channel_is_busy(supply_dma_chan))
+    {
+        dma_channel_set_trans_count(supply_dma_chan, UINT32_MAX, true);
+    }
+
+    return (uint16_t)(sum / SUPPLY_RING_SAMPLES);
+}
+
+/**
+ * @brief Binary log output: raw bytes to USB stdio (no CR inserted before 0x0A)
+ *
+ * @param data Encoded frame
+ * @param len Number of bytes
+ * @param intf_ptr Unused
+ * @return 0 on success
+ */
+static int8_t pico_telemetry_write(const uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        putchar_raw(data[i]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Start erasing one sector of the flash log region (returns without waiting)
+ *
+ * flash_do_cmd() leaves XIP for the command and re-enables it, but the flash
+ * answers no reads until the erase is complete. The program runs from RAM
+ * (copy_to_ram), so neither core touches the flash meanwhile.
+ *
+ * @param addr Sector address within the region
+ * @param intf_ptr Unused
+ * @return 0 on success
+ */
+static int8_t pico_flash_erase(uint32_t addr, void *intf_ptr)
+{
+    uint32_t offset = FLOG_OFFSET + addr;
+
+    flash_cmd_buf[0] = FLASH_CMD_WRITE_ENABLE;
+    flash_do_cmd(flash_cmd_buf, flash_rx_buf, 1);
+
+    flash_cmd_buf[0] = FLASH_CMD_SECTOR_ERASE;
+    flash_cmd_buf[1] = (uint8_t)(offset >> 16);
+    flash_cmd_buf[2] = (uint8_t)(offset >> 8);
+    flash_cmd_buf[3] = (uint8_t)offset;
+    flash_do_cmd(flash_cmd_buf, flash_rx_buf, 4);
+
+    return 0;
+}
+
+/**
+ * @brief Start programming one page of the flash log region (returns without waiting)
+ *
+ * @param addr Page address within the region
+ * @param data FLASH_LOG_PAGE_SIZE bytes
+ * @param intf_ptr Unused
+ * @return 0 on success
+ */
+static int8_t pico_flash_program(uint32_t addr, const uint8_t *data, void *intf_ptr)
+{
+    uint32_t offset = FLOG_OFFSET + addr;
+
+    flash_cmd_buf[0] = FLASH_CMD_WRITE_ENABLE;
+    flash_do_cmd(flash_cmd_buf, flash_rx_buf, 1);
+
+    flash_cmd_buf[0] = FLASH_CMD_PAGE_PROGRAM;
+    flash_cmd_buf[1] = (uint8_t)(offset >> 16);
+    flash_cmd_buf[2] = (uint8_t)(offset >> 8);
+    flash_cmd_buf[3] = (uint8_t)offset;
+    memcpy(&flash_cmd_buf[4], data, FLASH_LOG_PAGE_SIZE);
+    flash_do_cmd(flash_cmd_buf, flash_rx_buf, sizeof(flash_cmd_buf));
+
+    return 0;
+}
+
+/**
+ * @brief Check the flash status register for a running erase or program
+ *
+ * The last check that finds the flash idle also restores XIP for the reads.
+ *
+ * @param intf_ptr Unused
+ * @return 1 while busy, 0 otherwise
+ */
+static uint8_t pico_flash_busy(void *intf_ptr)
+{
+    flash_cmd_buf[0] = FLASH_CMD_READ_STATUS;
+    flash_cmd_buf[1] = 0;
+    flash_do_cmd(flash_cmd_buf, flash_rx_buf, 2);
+
+    return (flash_rx_buf[1] & FLASH_STATUS_BUSY) != 0;
+}
+
+/**
+ * @brief Read from the flash log region through XIP, bypassing the cache
+ *
+ * @param addr Address within the region
+ * @param data Output
+ * @param len Number of bytes
+ * @param intf_ptr Unused
+ */
+static void pico_flash_read(uint32_t addr, uint8_t *data, uint32_t len, void *intf_ptr)
+{
+    memcpy(data, (const uint8_t *)(uintptr_t)(XIP_NOCACHE_NOALLOC_BASE + FLOG_OFFSET + addr), len);
+}
+
+/**
+ * @brief Mount the flash log region behind the program image
+ */
+static void flash_log_init_pico(void)
+{
+    static const flash_log_ops_t ops = {pico_flash_erase, pico_flash_program, pico_flash_busy, pico_flash_read};
+    uint32_t image = (uint32_t)((uintptr_t)&__flash_binary_end - XIP_BASE);
+
+    // The region must not overlap the program
+    if (image > FLOG_OFFSET || flash_log_init(&flog, &ops, FLOG_SIZE, NULL) != FLASH_LOG_OK)
+    {
+        printf("Flash log unavailable (program image %lu bytes)\n", (unsigned long)image);
+        return;
+    }
+
+    flog_ready = 1;
+    printf("Flash log: %lu KB at %lu KB, log spans %lu pages\n", (unsigned long)(FLOG_SIZE / 1024),
+           (unsigned long)(FLOG_OFFSET / 1024), (unsigned long)flash_log_span(&flog));
+}
+
+/**
+ * @brief Initialize the I2C interface of a rig for RP2040
+ *
+ * @param hw Wiring of the rig
  */
-static void i2c_init_pico(void)
+static void i2c_init_pico(const rig_hw_t *hw)
 {
     // Initialize I2C port at 400 kHz
-    i2c_init(I2C_PORT, I2C_FREQ);
+    i2c_init(hw->bus ? i2c1 : i2c0, I2C_FREQ);
 
     // Setup GPIO pins
-    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(hw->sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(hw->scl_pin, GPIO_FUNC_I2C);
 
     // Enable pull-ups
-    gpio_pull_up(I2C_SDA_PIN);
-    gpio_pull_up(I2C_SCL_PIN);
+    gpio_pull_up(hw->sda_pin);
+    gpio_pull_up(hw->scl_pin);
 }
 
 /**
@@ -0,0 +1,130 @@
+/**
+ * @file motor.c
+ * @brief DRV8871 H-bridge motor driver implementation
+ */
+
+#include "motor.h"
+
+/**
+ * @brief Initialize the motor driver, leaving the bridge in coast
+ *
+ * @param[out] dev Pointer to device structure
+ * @param[in] set_levels_fptr Pointer to platform-specific PWM level function
+ * @param[in] wrap PWM counter top
+ * @param[in] intf_ptr Interface context passed to the level function
+ *
+ * @return MOTOR_OK on success, error code on failure
+ */
+motor_err_t motor_init(motor_dev_t *dev, motor_set_levels_fptr_t set_levels_fptr, uint16_t wrap,
+                       void *intf_ptr)
+{
+    /* wrap + 1 must still fit for the brake level */
+    if (!dev || !set_levels_fptr || wrap == 0 || wrap == UINT16_MAX)
+    {
+        return MOTOR_ERR_INVALID_PARAM;
+    }
+
+    dev->set_levels = set_levels_fptr;
+    dev->intf_ptr = intf_ptr;
+    dev->wrap = wrap;
+    dev->initialized = 1;
+
+    return motor_coast(dev);
+}
+
+/**
+ * @brief Set the motor duty
+ *
+ * @param[in,out] dev Pointer to device structure
+ * @param[in] duty Duty in Q16.16, -1 (full reverse) to 1 (full forward); clamped
+ *
+ * @return MOTOR_OK on success, error code on failure
+ */
+motor_err_t motor_set_duty(motor_dev_t *dev, fix16_t duty)
+{
+    uint16_t level;
+
+    if (!dev)
+    {
+        return MOTOR_ERR_INVALID_PARAM;
+    }
+
+    if (!dev->initialized)
+    {
+        return MOTOR_ERR_NOT_INITIALIZED;
+    }
+
+    duty = fix16_clamp(duty, -FIX16_ONE, FIX16_ONE);
+
+    /* Scale |duty| (0-1 in Q16.16) to the PWM counter range */
+    level = (uint16_t)(((uint32_t)fix16_abs(duty) * dev->wrap + FIX16_HALF) >> FIX16_SHIFT);
+
+    if (level == 0)
+    {
+        return motor_coast(dev);
+    }
+
+    if (duty > 0)
+    {
+        dev->set_levels(level, 0, dev->intf_ptr);
+    }
+    else
+    {
+        dev->set_levels(0, level, dev->intf_ptr);
+    }
+
+    dev->duty = duty;
+    dev->state = MOTOR_STATE_DRIVE;
+    return MOTOR_OK;
+}
+
+/**
+ * @brief Put the bridge into coast (both outputs Hi-Z)
+ *
+ * @param[in,out] dev Pointer to device structure
+ *
+ * @return MOTOR_OK on success, error code on failure
+ */
+motor_err_t motor_coast(motor_dev_t *dev)
+{
+    if (!dev)
+    {
+        return MOTOR_ERR_INVALID_PARAM;
+    }
+
+    if (!dev->initialized)
+    {
+        return MOTOR_ERR_NOT_INITIALIZED;
+    }
+
+    dev->set_levels(0, 0, dev->intf_ptr);
+    dev->duty = 0;
+    dev->state = MOTOR_STATE_COAST;
+    return MOTOR_OK;
+}
+
+/**
+ * @brief Put the bridge into brake (both low-side switches on)
+ *
+ * @param[in,out] dev Pointer to device structure
+ *
+ * @return MOTOR_OK on success, error code on failure
+ */
+motor_err_t motor_brake(motor_dev_t *dev)
+{
+    if (!dev)
+    {
+        return MOTOR_ERR_INVALID_PARAM;
+    }
+
+    if (!dev->initialized)
+    {
+        return MOTOR_ERR_NOT_INITIALIZED;
+    }
+
+    /* A level above wrap keeps the output permanently high */
+    dev->set_levels(dev->wrap + 1, dev->wrap + 1, dev->intf_ptr);
+    dev->duty = 0;
+    dev->state = MOTOR_STATE_BRAKE;
+    return MOTOR_OK;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file osc_detect.c
+ * @brief On-line oscillation detector implementation
+ */
+
+#include "osc_detect.h"
+
+/**
+ * @brief Candidate frequencies (0.1 Hz): pendulum swing up to delay-driven limit cycles
+ *
+ * The two-period blocks give each bin a main lobe of +-50 %, so neighbouring
+ * candidates overlap and no frequency in between is missed.
+ */
+static const uint16_t osc_detect_freq_dhz[OSC_DETECT_BINS] = {10, 15, 20, 30, 40, 55, 75, 100};
+
+/**
+ * @brief Initialize the detector (disabled, nominal gain)
+ *
+ * @param[out] osc Pointer to detector structure
+ * @param[in] rate_hz Tick rate in Hz
+ */
+void osc_detect_init(osc_detect_t *osc, uint32_t rate_hz)
+{
+    uint32_t fs;
+
+    osc->decim = (uint16_t)(rate_hz > OSC_DETECT_RATE_HZ ? rate_hz / OSC_DETECT_RATE_HZ : 1);
+    fs = rate_hz / osc->decim;
+
+    for (uint8_t i = 0; i < OSC_DETECT_BINS; i++)
+    {
+        osc_bin_t *bin = &osc->bin[i];
+        fix16_t s;
+
+        bin->freq_dhz = osc_detect_freq_dhz[i];
+        bin->len = (uint16_t)((20 * fs + bin->freq_dhz / 2) / bin->freq_dhz);
+
+        /* 2 cos(w) = 2 - 4 sin^2(w / 2); the sine of the small half angle is accurate in the table */
+        s = fix16_sin_deg(FIX16_FROM_INT(360) / bin->len);
+        bin->coeff = (int32_t)(((int64_t)2 << 29) - (((int64_t)s * s) >> 1));
+    }
+
+    osc->threshold = OSC_DETECT_THRESHOLD_DEFAULT;
+    osc->enabled = 0;
+    osc->backoff = 0;
+    osc->scale = FIX16_ONE;
+    osc->detections = 0;
+    osc_detect_reset(osc);
+}
+
+/**
+ * @brief Enable or disable detection and back-off
+ *
+ * @param[in,out] osc Pointer to detector structure
+ * @param[in] enable 1 to watch the error, 0 to stop
+ * @param[in] backoff 1 to scale the gain down on every confirmed detection
+ * @param[in] threshold Amplitude threshold in degrees (0 keeps the current one)
+ */
+void osc_detect_configure(osc_detect_t *osc, uint8_t enable, uint8_t backoff, fix16_t threshold)
+{
+    osc->enabled = enable ? 1 : 0;
+    osc->backoff = backoff ? 1 : 0;
+    if (threshold > 0)
+    {
+        osc->threshold = threshold;
+    }
+    osc->scale = FIX16_ONE;
+    osc_detect_reset(osc);
+}
+
+/**
+ * @brief Restart the detection (filter states and confirmations, not the gain scale)
+ *
+ * @param[in,out] osc Pointer to detector structure
+ */
+void osc_detect_reset(osc_detect_t *osc)
+{
+    for (uint8_t i = 0; i < OSC_DETECT_BINS; i++)
+    {
+        osc->bin[i].s1 = 0;
+        osc->bin[i].s2 = 0;
+        osc->bin[i].n = 0;
+        osc->bin[i].amplitude = 0;
+        osc->bin[i].hits = 0;
+    }
+
+    osc->phase = 0;
+    osc->acc = 0;
+    osc->active = 0;
+    osc->freq = 0;
+    osc->amplitude = 0;
+}
+
+/**
+ * @brief Close the block of a bin: amplitude and threshold count
+ *
+ * @param[in,out] osc Pointer to detector structure
+ * @param[in,out] bin Bin whose block is complete
+ */
+static void osc_detect_end_block(osc_detect_t *osc, osc_bin_t *bin)
+{
+    int64_t power = (int64_t)bin->s1 * bin->s1 + (int64_t)bin->s2 * bin->s2 -
+                    (((int64_t)bin->coeff * bin->s1) >> 29) * bin->s2;
+    uint32_t mag = fix16_isqrt64(power > 0 ? (uint64_t)power : 0);
+
+    /* 2 |X| / N, Q24.8 -> Q16.16 */
+    bin->amplitude = fix16_sat(((int64_t)mag << 9) / bin->len);
+    bin->s1 = 0;
+    bin->s2 = 0;
+    bin->n = 0;
+
+    if (bin->amplitude >= osc->threshold)
+    {
+        if (bin->hits < OSC_DETECT_CONFIRM)
+        {
+            bin->hits++;
+        }
+    }
+    else
+    {
+        bin->hits = 0;
+    }
+}
+
+/**
+ * @brief Report the strongest confirmed bin and back off on a new detection
+ *
+ * @param[in,out] osc Pointer to detector structure
+ *
+ * @return 1 if an oscillation was newly confirmed, 0 otherwise
+ */
+static uint8_t osc_detect_evaluate(osc_detect_t *osc)
+{
+    const osc_bin_t *best = 0;
+
+    for (uint8_t i = 0; i < OSC_DETECT_BINS; i++)
+    {
+        const osc_bin_t *bin = &osc->bin[i];
+
+        if (bin->hits >= OSC_DETECT_CONFIRM && (!best || bin->amplitude > best->amplitude))
+        {
+            best = bin;
+        }
+    }
+
+    if (!best)
+    {
+        osc->active = 0;
+        return 0;
+    }
+
+    osc->freq = (fix16_t)(((int64_t)best->freq_dhz << FIX16_SHIFT) / 10);
+    osc->amplitude = best->amplitude;
+    if (osc->active)
+    {
+        return 0;
+    }
+
+    osc->active = 1;
+    osc->detections++;
+
+    if (osc->backoff)
+    {
+        osc->scale = fix16_mul(osc->scale, OSC_DETECT_BACKOFF);
+        if (osc->scale < OSC_DETECT_SCALE_MIN)
+        {
+            osc->scale = OSC_DETECT_SCALE_MIN;
+        }
+
+        /* The next back-off needs a fresh confirmation at the reduced gain */
+        for (uint8_t i = 0; i < OSC_DETECT_BINS; i++)
+        {
+            osc->bin[i].hits = 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Feed one tick of the control error
+ *
+ * @param[in,out] osc Pointer to detector structure
+ * @param[in] error Setpoint minus angle in degrees
+ *
+ * @return 1 if an oscillation was confirmed in this tick, 0 otherwise
+ */
+uint8_t osc_detect_tick(osc_detect_t *osc, fix16_t error)
+{
+    int32_t x;
+    uint8_t ended = 0;
+
+    if (!osc->enabled)
+    {
+        return 0;
+    }
+
+    osc->acc += error;
+    if (++osc->phase < osc->decim)
+    {
+        return 0;
+    }
+
+    /* Mean over the sample in Q24.8; even 360 deg of error keep the states below 2^30 */
+    x = (osc->acc / osc->decim) >> 8;
+    osc->phase = 0;
+    osc->acc = 0;
+
+    for (uint8_t i = 0; i < OSC_DETECT_BINS; i++)
+    {
+        osc_bin_t *bin = &osc->bin[i];
+        int32_t s = x + (int32_t)(((int64_t)bin->coeff * bin->s1) >> 29) - bin->s2;
+
+        bin->s2 = bin->s1;
+        bin->s1 = s;
+
+        if (++bin->n >= bin->len)
+        {
+            osc_detect_end_block(osc, bin);
+            ended = 1;
+        }
+    }
+
+    return ended ? osc_detect_evaluate(osc) : 0;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file pid.c
+ * @brief Fixed-point PID controller implementation
+ */
+
+#include "pid.h"
+
+/**
+ * @brief Clamp the integrator to the output range left over by the feedforward
+ *        and to the integrator limit (Q32.32)
+ *
+ * @param[in,out] pid Pointer to controller structure
+ */
+static void pid_clamp_integ(pid_ctrl_t *pid)
+{
+    int64_t min = ((int64_t)pid->out_min - pid->ff) << FIX16_SHIFT;
+    int64_t max = ((int64_t)pid->out_max - pid->ff) << FIX16_SHIFT;
+    const int64_t limit = (int64_t)pid->i_limit << FIX16_SHIFT;
+
+    if (min < -limit)
+    {
+        min = -limit;
+    }
+    if (max > limit)
+    {
+        max = limit;
+    }
+
+    if (pid->integ > max)
+    {
+        pid->integ = max;
+    }
+    else if (pid->integ < min)
+    {
+        pid->integ = min;
+    }
+}
+
+/**
+ * @brief Initialize the PID controller
+ *
+ * @param[out] pid Pointer to controller structure
+ * @param[in] gains Initial gains
+ * @param[in] rate_hz Tick rate in Hz
+ * @param[in] out_min Output lower limit
+ * @param[in] out_max Output upper limit
+ */
+void pid_init(pid_ctrl_t *pid, const pid_gains_t *gains, uint32_t rate_hz,
+              fix16_t out_min, fix16_t out_max)
+{
+    pid->rate_hz = rate_hz;
+    pid->d_alpha = PID_D_ALPHA_DEFAULT;
+    pid->i_limit = PID_I_LIMIT_DEFAULT;
+    pid->out_min = out_min;
+    pid->out_max = out_max;
+    pid_discretize(gains, rate_hz, &pid->coeffs);
+    pid_reset(pid, 0);
+}
+
+/**
+ * @brief Convert continuous gains into per-tick coefficients
+ *
+ * @param[in] gains Continuous gains
+ * @param[in] rate_hz Tick rate in Hz
+ * @param[out] coeffs Discretized coefficients
+ */
+void pid_discretize(const pid_gains_t *gains, uint32_t rate_hz, pid_coeffs_t *coeffs)
+{
+    coeffs->kp = gains->kp;
+    /* Q16.16 -> Q8.24 and multiply by the tick period */
+    coeffs->ki = fix16_sat(((int64_t)gains->ki << 8) / rate_hz);
+    coeffs->kd = fix16_sat((int64_t)gains->kd * rate_hz);
+}
+
+/**
+ * @brief Change the active coefficients without a bump in the output
+ *
+ * @param[in,out] pid Pointer to controller structure
+ * @param[in] coeffs New coefficients
+ */
+void pid_set_coeffs(pid_ctrl_t *pid, const pid_coeffs_t *coeffs)
+{
+    if (pid->primed)
+    {
+        /* Output delta of the P and D terms for the same error, moved into the integrator */
+        fix16_t p_new = fix16_mul(coeffs->kp, pid->error);
+        fix16_t d_new = fix16_mul(coeffs->kd, pid->dmeas);
+        int64_t delta = (int64_t)(pid->p_term - p_new) + (pid->d_term - d_new);
+
+        pid->integ += delta << FIX16_SHIFT;
+        pid_clamp_integ(pid);
+        pid->p_term = p_new;
+        pid->d_term = d_new;
+    }
+
+    pid->coeffs = *coeffs;
+}
+
+/**
+ * @brief Set the derivative filter and the integrator limit
+ *
+ * @param[in,out] pid Pointer to controller structure
+ * @param[in] d_alpha Derivative low-pass coefficient (Q16.16, 0-1, 1 = no filtering)
+ * @param[in] i_limit Integrator limit (Q16.16, output units, > 0)
+ */
+void pid_set_tuning(pid_ctrl_t *pid, fix16_t d_alpha, fix16_t i_limit)
+{
+    pid->d_alpha = fix16_clamp(d_alpha, 1, FIX16_ONE);
+    pid->i_limit = i_limit > 0 ? i_limit : FIX16_ONE;
+    pid_clamp_integ(pid);
+    pid->i_term = (fix16_t)(pid->integ >> FIX16_SHIFT);
+}
+
+/**
+ * @brief Switch the feedforward to a new value without a bump in the output
+ *
+ * @param[in,out] pid Pointer to controller structure
+ * @param[in] ff New feedforward value
+ */
+void pid_transfer_ff(pid_ctrl_t *pid, fix16_t ff)
+{
+    if (pid->primed)
+    {
+        pid->integ += ((int64_t)pid->ff - ff) << FIX16_SHIFT;
+    }
+
+    pid->ff = ff;
+    pid_clamp_integ(pid);
+}
+
+/**
+ * @brief Reset the controller state
+ *
+ * @param[in,out] pid Pointer to controller structure
+ * @param[in] output Output to continue from (preloaded into the integrator)
+ */
+void pid_reset(pid_ctrl_t *pid, fix16_t output)
+{
+    pid->ff = 0;
+    pid->integ = (int64_t)output << FIX16_SHIFT;
+    pid_clamp_integ(pid);
+    pid->error = 0;
+    pid->prev_meas = 0;
+    pid->dmeas = 0;
+    pid->p_term = 0;
+    pid->i_term = (fix16_t)(pid->integ >> FIX16_SHIFT);
+    pid->d_term = 0;
+    pid->output = pid->i_term;
+    pid->primed = 0;
+}
+
+/**
+ * @brief Run one controller tick
+ *
+ * Derivative acts on the measurement (no derivative kick on setpoint steps)
+ * and is low-pass filtered. The integrator is clamped to the output limits and
+ * stops integrating while the output is saturated in the direction of the error.
+ *
+ * @param[in,out] pid Pointer to controller structure
+ * @param[in] setpoint Setpoint in degrees
+ * @param[in] meas Measured angle in degrees
+ * @param[in] ff Feedforward added to the output (taken into account by the anti-windup)
+ *
+ * @return Saturated controller output
+ */
+fix16_t pid_step(pid_ctrl_t *pid, fix16_t setpoint, fix16_t meas, fix16_t ff)
+{
+    fix16_t error = setpoint - meas;
+    int64_t sum;
+
+    if (!pid->primed)
+    {
+        pid->prev_meas = meas;
+        pid->primed = 1;
+    }
+
+    /* Derivative on measurement, first-order low-pass */
+    fix16_t dmeas = pid->prev_meas - meas;
+    pid->dmeas += fix16_mul(pid->d_alpha, dmeas - pid->dmeas);
+    pid->prev_meas = meas;
+
+    pid->error = error;
+    pid->ff = ff;
+    pid->p_term = fix16_mul(pid->coeffs.kp, error);
+    pid->d_term = fix16_mul(pid->coeffs.kd, pid->dmeas);
+
+    /* Conditional integration: freeze while saturated in the direction of the error */
+    if (!((pid->output >= pid->out_max && error > 0) ||
+          (pid->output <= pid->out_min && error < 0)))
+    {
+        /* Q8.24 * Q16.16 = Q24.40 -> Q32.32 */
+        pid->integ += ((int64_t)pid->coeffs.ki * error) >> 8;
+        pid_clamp_integ(pid);
+    }
+    pid->i_term = (fix16_t)(pid->integ >> FIX16_SHIFT);
+
+    sum = (int64_t)pid->p_term + pid->i_term + pid->d_term + ff;
+    pid->output = fix16_clamp(fix16_sat(sum), pid->out_min, pid->out_max);
+
+    return pid->output;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file predictor.c
+ * @brief Measurement latency compensation implementation
+ */
+
+#include "predictor.h"
+
+/**
+ * @brief Initialize the predictor without delay
+ *
+ * @param[out] pred Pointer to predictor structure
+ * @param[in] rate_hz Tick rate in Hz
+ */
+void predictor_init(predictor_t *pred, uint32_t rate_hz)
+{
+    pred->rate_hz = rate_hz;
+    pred->delay_us = 0;
+    pred->ticks = 0;
+    pred->frac = 0;
+    pred->head = 0;
+    pred->angle = 0;
+    pred->rate = 0;
+
+    for (uint8_t i = 0; i < PREDICTOR_MAX_TICKS; i++)
+    {
+        pred->thrust[i] = 0;
+    }
+}
+
+/**
+ * @brief Set the delay to compensate
+ *
+ * @param[in,out] pred Pointer to predictor structure
+ * @param[in] delay_us Age of the measurement when the output is applied (us)
+ *
+ * @return PREDICTOR_OK on success, PREDICTOR_ERR_INVALID_PARAM if too long (unchanged)
+ */
+predictor_err_t predictor_set_delay(predictor_t *pred, uint32_t delay_us)
+{
+    /* Delay in ticks, Q16.16 */
+    uint64_t delay = ((uint64_t)delay_us * pred->rate_hz << FIX16_SHIFT) / 1000000u;
+
+    if (delay > ((uint64_t)PREDICTOR_MAX_TICKS << FIX16_SHIFT))
+    {
+        return PREDICTOR_ERR_INVALID_PARAM;
+    }
+
+    pred->delay_us = delay_us;
+    pred->ticks = (uint8_t)(delay >> FIX16_SHIFT);
+    pred->frac = (fix16_t)(delay & (FIX16_ONE - 1));
+    return PREDICTOR_OK;
+}
+
+/**
+ * @brief Record the thrust acting on the pendulum during the current tick
+ *
+ * @param[in,out] pred Pointer to predictor structure
+ * @param[in] thrust Modelled thrust after the motor lag (gravity units)
+ */
+void predictor_push(predictor_t *pred, fix16_t thrust)
+{
+    pred->head = (uint8_t)((pred->head + 1) % PREDICTOR_MAX_TICKS);
+    pred->thrust[pred->head] = thrust;
+}
+
+/**
+ * @brief Carry a delayed state forward over the delay
+ *
+ * @param[in,out] pred Pointer to predictor structure
+ * @param[in] ff Model (neutral, velocity and inertia coefficients)
+ * @param[in] dob Observer (disturbance estimate and per-tick scaling)
+ * @param[in] angle Delayed angle in degrees
+ * @param[in] rate Delayed velocity in deg/s
+ *
+ * @return Predicted current angle in degrees
+ */
+fix16_t predictor_run(predictor_t *pred, const feedforward_t *ff, const dob_t *dob, fix16_t angle,
+                      fix16_t rate)
+{
+    /* Gravity barely changes within a few ms: evaluate it once at the measurement */
+    const int64_t bias = (int64_t)dob->estimate - ff_gravity_thrust(ff, angle);
+    int64_t pos = (int64_t)angle << FIX16_SHIFT;
+    int64_t vel = (int64_t)rate << FIX16_SHIFT;
+    uint8_t steps = pred->ticks + (pred->frac > 0 ? 1 : 0);
+
+    /* Oldest tick first; the fraction is the part of the oldest tick inside the delay */
+    for (uint8_t i = steps; i > 0; i--)
+    {
+        fix16_t v = (fix16_t)(vel >> FIX16_SHIFT);
+        fix16_t thrust = pred->thrust[(pred->head + PREDICTOR_MAX_TICKS + 1 - i) % PREDICTOR_MAX_TICKS];
+        fix16_t net = fix16_sat(thrust + bias - (((int64_t)ff->k_vel * v) >> 24));
+        int64_t dpos = ((int64_t)v * dob->dt) >> FIX16_SHIFT;
+        int64_t dvel = ((int64_t)net * dob->b) >> FIX16_SHIFT;
+
+        if (i > pred->ticks)
+        {
+            dpos = (dpos >> FIX16_SHIFT) * pred->frac;
+            dvel = (dvel >> FIX16_SHIFT) * pred->frac;
+        }
+        pos += dpos;
+        vel += dvel;
+    }
+
+    pred->angle = fix16_sat(pos >> FIX16_SHIFT);
+    pred->rate = fix16_sat(vel >> FIX16_SHIFT);
+    return pred->angle;
+}
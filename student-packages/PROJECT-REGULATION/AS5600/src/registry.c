@@ -0,0 +1,286 @@
+/**
+ * @file registry.c
+ * @brief Registry of loggable variables implementation
+ */
+
+#include <string.h>
+
+#include "registry.h"
+
+/**
+ * @brief Group the enabled variables by decimation
+ *
+ * @param[in] reg Pointer to registry structure
+ * @param[out] groups Groups (counters cleared)
+ * @param[out] ngroups Number of groups
+ *
+ * @return REGISTRY_OK on success, REGISTRY_ERR_FULL if the selection does not fit
+ */
+static registry_err_t registry_build(const registry_t *reg, registry_group_t *groups, uint8_t *ngroups)
+{
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < reg->count; i++)
+    {
+        uint16_t divider = reg->vars[i].divider;
+        uint8_t g = 0;
+
+        if (divider == 0)
+        {
+            continue;
+        }
+
+        while (g < n && groups[g].divider != divider)
+        {
+            g++;
+        }
+        if (g == n)
+        {
+            if (n == REGISTRY_MAX_GROUPS)
+            {
+                return REGISTRY_ERR_FULL;
+            }
+            groups[n].divider = divider;
+            groups[n].count = 0;
+            groups[n].nvars = 0;
+            n++;
+        }
+        if (groups[g].nvars == REGISTRY_GROUP_VARS)
+        {
+            return REGISTRY_ERR_FULL;
+        }
+        groups[g].vars[groups[g].nvars++] = i;
+    }
+
+    *ngroups = n;
+    return REGISTRY_OK;
+}
+
+/**
+ * @brief Rebuild the groups from the variable dividers and publish them as a new generation
+ *
+ * @param[in,out] reg Pointer to registry structure
+ *
+ * @return REGISTRY_OK on success, REGISTRY_ERR_FULL if the selection does not fit (nothing changed)
+ */
+static registry_err_t registry_publish(registry_t *reg)
+{
+    registry_group_t groups[REGISTRY_MAX_GROUPS];
+    uint8_t ngroups;
+
+    if (registry_build(reg, groups, &ngroups) != REGISTRY_OK)
+    {
+        return REGISTRY_ERR_FULL;
+    }
+
+    /* Odd generation: readers leave the groups alone */
+    reg->gen = reg->gen + 1;
+    REGISTRY_BARRIER();
+    memcpy(reg->groups, groups, sizeof(groups));
+    reg->ngroups = ngroups;
+    REGISTRY_BARRIER();
+    reg->gen = reg->gen + 1;
+
+    return REGISTRY_OK;
+}
+
+/**
+ * @brief Initialize an empty registry
+ *
+ * @param[out] reg Pointer to registry structure
+ */
+void registry_init(registry_t *reg)
+{
+    memset(reg, 0, sizeof(*reg));
+}
+
+/**
+ * @brief Register a variable (off)
+ *
+ * @param[in,out] reg Pointer to registry structure
+ * @param[in] name Channel name (kept by reference, up to TELEMETRY_NAME_MAX characters)
+ * @param[in] ptr Variable (kept by reference)
+ * @param[in] src Type of the variable
+ * @param[in] type Wire type (TELEMETRY_TYPE_U32 for the integer types)
+ * @param[in] frac_bits Fractional bits on the wire
+ *
+ * @return REGISTRY_OK on success, REGISTRY_ERR_FULL if the table is full,
+ *         REGISTRY_ERR_INVALID_PARAM on invalid parameters
+ */
+registry_err_t registry_add(registry_t *reg, const char *name, const void *ptr, registry_src_t src,
+                            telemetry_type_t type, uint8_t frac_bits)
+{
+    registry_var_t *var;
+    uint8_t integer = src == REGISTRY_SRC_U32 || src == REGISTRY_SRC_U8;
+
+    if (!name || !ptr || strlen(name) > TELEMETRY_NAME_MAX || src > REGISTRY_SRC_U8 || type > TELEMETRY_TYPE_Q32 ||
+        frac_bits > 16 || integer != (type == TELEMETRY_TYPE_U32) || (integer && frac_bits != 0))
+    {
+        return REGISTRY_ERR_INVALID_PARAM;
+    }
+    if (reg->count == REGISTRY_MAX_VARS)
+    {
+        return REGISTRY_ERR_FULL;
+    }
+
+    var = &reg->vars[reg->count++];
+    var->channel.name = name;
+    var->channel.type = (uint8_t)type;
+    var->channel.frac_bits = frac_bits;
+    var->ptr = ptr;
+    var->src = src;
+    var->divider = 0;
+
+    return REGISTRY_OK;
+}
+
+/**
+ * @brief Switch a variable on or off (control tick context)
+ *
+ * @param[in,out] reg Pointer to registry structure
+ * @param[in] name Channel name
+ * @param[in] divider Ticks per sample, 0 to switch it off
+ *
+ * @return REGISTRY_OK on success, REGISTRY_ERR_UNKNOWN for an unknown name,
+ *         REGISTRY_ERR_FULL if the selection does not fit into the groups
+ *         (the variable keeps its previous setting)
+ */
+registry_err_t registry_set(registry_t *reg, const char *name, uint16_t divider)
+{
+    for (uint8_t i = 0; i < reg->count; i++)
+    {
+        registry_var_t *var = &reg->vars[i];
+        uint16_t old = var->divider;
+
+        if (strcmp(var->channel.name, name) != 0)
+        {
+            continue;
+        }
+
+        var->divider = divider;
+        if (registry_publish(reg) != REGISTRY_OK)
+        {
+            var->divider = old;
+            return REGISTRY_ERR_FULL;
+        }
+        return REGISTRY_OK;
+    }
+
+    return REGISTRY_ERR_UNKNOWN;
+}
+
+/**
+ * @brief Switch all variables off (control tick context)
+ *
+ * @param[in,out] reg Pointer to registry structure
+ */
+void registry_clear(registry_t *reg)
+{
+    for (uint8_t i = 0; i < reg->count; i++)
+    {
+        reg->vars[i].divider = 0;
+    }
+    registry_publish(reg);
+}
+
+/**
+ * @brief Count one tick for a group (control tick)
+ *
+ * @param[in,out] reg Pointer to registry structure
+ * @param[in] group Group number (below reg->ngroups)
+ *
+ * @return 1 if the group is due for a sample, 0 otherwise
+ */
+uint8_t registry_tick(registry_t *reg, uint8_t group)
+{
+    registry_group_t *g = &reg->groups[group];
+
+    if (++g->count < g->divider)
+    {
+        return 0;
+    }
+
+    g->count = 0;
+    return 1;
+}
+
+/**
+ * @brief Read the variables of a group (control tick)
+ *
+ * @param[in] reg Pointer to registry structure
+ * @param[in] group Group number (below reg->ngroups)
+ * @param[out] values One value per variable (integers as is, fixed-point in Q16.16)
+ *
+ * @return Number of values
+ */
+uint8_t registry_read(const registry_t *reg, uint8_t group, int32_t *values)
+{
+    const registry_group_t *g = &reg->groups[group];
+
+    for (uint8_t i = 0; i < g->nvars; i++)
+    {
+        const registry_var_t *var = &reg->vars[g->vars[i]];
+
+        switch (var->src)
+        {
+        case REGISTRY_SRC_Q32:
+            values[i] = fix16_sat(*(const int64_t *)var->ptr >> FIX16_SHIFT);
+            break;
+
+        case REGISTRY_SRC_U32:
+            values[i] = (int32_t)*(const uint32_t *)var->ptr;
+            break;
+
+        case REGISTRY_SRC_U8:
+            values[i] = *(const uint8_t *)var->ptr;
+            break;
+
+        default:
+            values[i] = *(const fix16_t *)var->ptr;
+            break;
+        }
+    }
+
+    return g->nvars;
+}
+
+/**
+ * @brief Copy the layout of a group (output side, never waits)
+ *
+ * @param[in] reg Pointer to registry structure
+ * @param[in] gen Generation the sample was taken with
+ * @param[in] group Group number
+ * @param[out] layout Copy of the layout
+ *
+ * @return REGISTRY_OK on success, REGISTRY_ERR_STALE if the layout is no
+ *         longer (or not yet) that of generation gen
+ */
+registry_err_t registry_layout(const registry_t *reg, uint32_t gen, uint8_t group, registry_layout_t *layout)
+{
+    const registry_group_t *g;
+
+    if (group >= REGISTRY_MAX_GROUPS || (gen & 1) || reg->gen != gen)
+    {
+        return REGISTRY_ERR_STALE;
+    }
+    REGISTRY_BARRIER();
+
+    g = &reg->groups[group];
+    layout->divider = g->divider;
+    layout->count = g->nvars <= REGISTRY_GROUP_VARS ? g->nvars : REGISTRY_GROUP_VARS;
+    for (uint8_t i = 0; i < layout->count; i++)
+    {
+        uint8_t var = g->vars[i];
+
+        layout->channels[i] = reg->vars[var < REGISTRY_MAX_VARS ? var : 0].channel;
+    }
+
+    /* Changed while copied */
+    REGISTRY_BARRIER();
+    if (reg->gen != gen)
+    {
+        return REGISTRY_ERR_STALE;
+    }
+
+    return REGISTRY_OK;
+}
@@ -0,0 +1,417 @@
+/**
+ * @file regulator.c
+ * @brief Pendulum regulation loop implementation
+ */
+
+#include "regulator.h"
+#include "span.h"
+
+/**
+ * @brief Step-response delay of the AS5600 slow filter per CONF SF setting (datasheet)
+ */
+static const uint16_t regulator_sf_delay_us[4] = {
+    2200, /* AS5600_SF_16X */
+    1100, /* AS5600_SF_8X */
+    550,  /* AS5600_SF_4X */
+    286,  /* AS5600_SF_2X */
+};
+
+/**
+ * @brief Initialize the regulation loop (motor disabled)
+ *
+ * @param[out] reg Pointer to regulator structure
+ * @param[in] sensor Initialized AS5600 device
+ * @param[in] motor Initialized motor device
+ * @param[in] supply Initialized supply monitor (updated every tick)
+ * @param[in] gains Initial PID gains
+ * @param[in] rate_hz Tick rate in Hz
+ */
+void regulator_init(regulator_t *reg, as5600_dev_t *sensor, motor_dev_t *motor, supply_t *supply,
+                    const pid_gains_t *gains, uint32_t rate_hz)
+{
+    supervisor_limits_t limits;
+    ctrl_params_t params;
+
+    reg->sensor = sensor;
+    reg->motor = motor;
+    reg->supply = supply;
+    reg->zero_q16 = 0;
+    reg->neutral = FIX16_FROM_INT(REGULATOR_NEUTRAL_DEG);
+    reg->direction = 1;
+    reg->enabled = 0;
+    reg->angle = reg->neutral;
+    reg->command = 0;
+    reg->agc = 0;
+    reg->sensor_err = AS5600_OK;
+    reg->ticks = 0;
+    reg->rate_hz = rate_hz;
+    reg->mode = REGULATOR_MODE_CONTROL;
+    reg->sweep.state = CALIB_SWEEP_IDLE;
+    reg->sweep_result = FF_OK;
+    step_analyzer_init(&reg->analyzer, rate_hz, REGULATOR_STEP_BAND, REGULATOR_STEP_HOLD_MS,
+                       REGULATOR_STEP_TIMEOUT_MS);
+    supervisor_default_limits(&limits, rate_hz);
+    supervisor_init(&reg->sup, motor, &limits, rate_hz);
+    osc_detect_init(&reg->osc, rate_hz);
+    sysid_init(&reg->sysid, rate_hz, REGULATOR_OUT_MIN, REGULATOR_OUT_MAX);
+
+    controller_init(&reg->ctrl, gains, rate_hz, REGULATOR_OUT_MIN, REGULATOR_OUT_MAX);
+    controller_set_setpoint(&reg->ctrl, reg->neutral);
+    controller_reset(&reg->ctrl, reg->neutral, 0);
+    ff_init(&reg->ctrl.ff, reg->neutral, REGULATOR_THRUST_MAX_DEFAULT);
+
+    controller_get_params(&reg->ctrl, &params);
+    ctrl_params_init(&reg->params, &params);
+}
+
+/**
+ * @brief Calibrate the sensor offset with the pendulum at the neutral position
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ *
+ * @return AS5600_OK on success, error code on failure
+ */
+as5600_err_t regulator_calibrate(regulator_t *reg)
+{
+    int32_t raw;
+    as5600_err_t rslt;
+
+    rslt = as5600_get_angle_q16(reg->sensor, &raw);
+    if (rslt != AS5600_OK)
+    {
+        return rslt;
+    }
+
+    reg->zero_q16 = raw;
+    reg->angle = reg->neutral;
+    return AS5600_OK;
+}
+
+/**
+ * @brief Read the calibrated pendulum angle
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ * @param[out] angle Pendulum angle in degrees (Q16.16)
+ *
+ * @return AS5600_OK on success, error code on failure
+ */
+as5600_err_t regulator_read_angle(regulator_t *reg, fix16_t *angle)
+{
+    int32_t raw;
+    as5600_err_t rslt;
+
+    SPAN_BEGIN(span);
+    rslt = as5600_get_angle_q16(reg->sensor, &raw);
+    SPAN_END(SPAN_SENSOR, span);
+    if (rslt != AS5600_OK)
+    {
+        return rslt;
+    }
+
+    /* Offset relative to the neutral position, wrapped so the 0/360 crossing is continuous */
+    *angle = reg->neutral + reg->direction * fix16_wrap_deg(raw - reg->zero_q16);
+    return AS5600_OK;
+}
+
+/**
+ * @brief Set the measurement latency compensated by the predictor
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ * @param[in] transfer_us Measured read and compute time (us)
+ *
+ * @return Total latency (us)
+ */
+uint32_t regulator_set_latency(regulator_t *reg, uint32_t transfer_us)
+{
+    uint32_t delay_us = regulator_sf_delay_us[reg->sensor->config.slow_filter & AS5600_CONF_SF_MASK] + transfer_us;
+
+    ctrl_params_edit(&reg->params)->pred_delay_us = delay_us;
+    return delay_us;
+}
+
+/**
+ * @brief Configure the oscillation detector
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ * @param[in] enable 1 to watch the control error, 0 to stop
+ * @param[in] backoff 1 to reduce the gain automatically
+ * @param[in] threshold Amplitude threshold in degrees (0 keeps the current one)
+ */
+void regulator_configure_osc(regulator_t *reg, uint8_t enable, uint8_t backoff, fix16_t threshold)
+{
+    osc_detect_configure(&reg->osc, enable, backoff, threshold);
+    controller_set_gain_scale(&reg->ctrl, reg->osc.scale);
+}
+
+/**
+ * @brief Enable or disable the motor output
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ * @param[in] enable 1 to enable, 0 to disable
+ */
+void regulator_enable(regulator_t *reg, uint8_t enable)
+{
+    if (enable && !reg->enabled)
+    {
+        if (!supervisor_arm(&reg->sup, 1))
+        {
+            return;
+        }
+        controller_reset(&reg->ctrl, reg->angle, 0);
+        step_analyzer_start(&reg->analyzer, reg->angle, reg->ctrl.target);
+        osc_detect_reset(&reg->osc);
+    }
+    else if (!enable)
+    {
+        supervisor_arm(&reg->sup, 0);
+        calib_sweep_abort(&reg->sweep);
+        sysid_abort(&reg->sysid);
+        step_analyzer_abort(&reg->analyzer);
+        reg->mode = REGULATOR_MODE_CONTROL;
+        motor_coast(reg->motor);
+        reg->command = 0;
+    }
+
+    reg->enabled = enable ? 1 : 0;
+}
+
+/**
+ * @brief Start the calibration sweep
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ */
+void regulator_start_sweep(regulator_t *reg)
+{
+    if (!supervisor_arm(&reg->sup, 1))
+    {
+        return;
+    }
+
+    calib_sweep_start(&reg->sweep, 0, REGULATOR_OUT_MAX, REGULATOR_SWEEP_STEPS,
+                      REGULATOR_SWEEP_SETTLE_MS * reg->rate_hz / 1000,
+                      REGULATOR_SWEEP_AVG_MS * reg->rate_hz / 1000,
+                      FIX16_FROM_INT(REGULATOR_SWEEP_ANGLE_LIMIT_DEG));
+    step_analyzer_abort(&reg->analyzer);
+    reg->sweep_result = FF_OK;
+    reg->mode = REGULATOR_MODE_SWEEP;
+    reg->enabled = 1;
+}
+
+/**
+ * @brief Start an identification capture
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ * @param[in] cfg Excitation settings
+ * @param[out] buf Capture buffer
+ * @param[in] capacity Number of samples the buffer holds
+ *
+ * @return SYSID_OK if started or refused by the supervisor, error code for invalid settings
+ */
+sysid_err_t regulator_start_sysid(regulator_t *reg, const sysid_config_t *cfg, sysid_sample_t *buf,
+                                  uint32_t capacity)
+{
+    sysid_err_t rslt;
+
+    if (!supervisor_arm(&reg->sup, 1))
+    {
+        return SYSID_OK;
+    }
+
+    rslt = sysid_start(&reg->sysid, cfg, buf, capacity);
+    if (rslt != SYSID_OK)
+    {
+        supervisor_arm(&reg->sup, 0);
+        return rslt;
+    }
+
+    step_analyzer_abort(&reg->analyzer);
+    reg->mode = REGULATOR_MODE_SYSID;
+    reg->enabled = 1;
+    return SYSID_OK;
+}
+
+/**
+ * @brief Drive the motor with a duty scaled to the nominal supply voltage
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ * @param[in] duty Duty at the nominal voltage (Q16.16)
+ */
+static void regulator_drive(regulator_t *reg, fix16_t duty)
+{
+    SPAN_BEGIN(span);
+    motor_set_duty(reg->motor, supply_compensate(reg->supply, duty));
+    SPAN_END(SPAN_MOTOR, span);
+}
+
+/**
+ * @brief Run one sweep tick and finish the calibration when the sweep ends
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ */
+static void regulator_sweep_tick(regulator_t *reg)
+{
+    reg->command = calib_sweep_tick(&reg->sweep, reg->angle);
+
+    if (reg->sweep.state == CALIB_SWEEP_RUNNING)
+    {
+        regulator_drive(reg, reg->command);
+        return;
+    }
+
+    /* A rejected sweep leaves the previous table in place */
+    if (reg->sweep.state == CALIB_SWEEP_DONE)
+    {
+        reg->sweep_result = ff_build_table(&reg->ctrl.ff, reg->sweep.duty, reg->sweep.angle, reg->sweep.steps);
+    }
+
+    supervisor_arm(&reg->sup, 0);
+    reg->mode = REGULATOR_MODE_CONTROL;
+    reg->enabled = 0;
+    motor_coast(reg->motor);
+}
+
+/**
+ * @brief Run one identification tick and stop the motor when the capture is complete
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ */
+static void regulator_sysid_tick(regulator_t *reg)
+{
+    reg->command = sysid_tick(&reg->sysid, reg->angle);
+
+    if (reg->sysid.state == SYSID_SETTLING || reg->sysid.state == SYSID_RUNNING)
+    {
+        regulator_drive(reg, reg->command);
+        return;
+    }
+
+    supervisor_arm(&reg->sup, 0);
+    reg->mode = REGULATOR_MODE_CONTROL;
+    reg->enabled = 0;
+    reg->command = 0;
+    motor_coast(reg->motor);
+}
+
+/**
+ * @brief Read the magnet status and AGC and let the supervisor check them
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ */
+static void regulator_check_magnet(regulator_t *reg)
+{
+    uint8_t status, agc;
+    as5600_err_t rslt;
+
+    SPAN_BEGIN(span);
+    rslt = as5600_get_status(reg->sensor, &status);
+    if (rslt == AS5600_OK)
+    {
+        rslt = as5600_get_agc(reg->sensor, &agc);
+    }
+    SPAN_END(SPAN_MAGNET, span);
+
+    /* A failed read is left to the per-sample error count */
+    if (rslt == AS5600_OK)
+    {
+        reg->agc = agc;
+        supervisor_check_magnet(&reg->sup, status, agc);
+    }
+}
+
+/**
+ * @brief Stop the regulation after a supervisor trip (the bridge is already safe)
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ */
+static void regulator_fault_stop(regulator_t *reg)
+{
+    calib_sweep_abort(&reg->sweep);
+    sysid_abort(&reg->sysid);
+    step_analyzer_abort(&reg->analyzer);
+    reg->mode = REGULATOR_MODE_CONTROL;
+    reg->enabled = 0;
+    reg->command = 0;
+}
+
+/**
+ * @brief Run one regulation tick: read angle, step the controller, drive the motor
+ *
+ * @param[in,out] reg Pointer to regulator structure
+ *
+ * @return AS5600_OK on success, sensor error code on failure
+ */
+as5600_err_t regulator_tick(regulator_t *reg)
+{
+    fix16_t angle = 0;
+    uint32_t faults;
+    ctrl_params_t params;
+
+    /* Settings changed since the last tick take effect as a whole, here */
+    if (ctrl_params_acquire(&reg->params, &params))
+    {
+        controller_apply_params(&reg->ctrl, &params);
+    }
+
+    reg->ticks++;
+    supply_update(reg->supply);
+    reg->sensor_err = regulator_read_angle(reg, &angle);
+    faults = supervisor_check_sample(&reg->sup, reg->sensor_err, angle);
+    if (faults && reg->enabled)
+    {
+        regulator_fault_stop(reg);
+    }
+
+    if (reg->sensor_err != AS5600_OK)
+    {
+        /* No valid measurement, do not drive blind */
+        calib_sweep_abort(&reg->sweep);
+        sysid_abort(&reg->sysid);
+        motor_coast(reg->motor);
+        supervisor_enforce(&reg->sup);
+        reg->command = 0;
+        return reg->sensor_err;
+    }
+
+    reg->angle = angle;
+
+    if (!reg->enabled)
+    {
+        return AS5600_OK;
+    }
+
+    if (reg->ticks % REGULATOR_MAGNET_CHECK_TICKS == 0)
+    {
+        regulator_check_magnet(reg);
+        if (!reg->sup.armed)
+        {
+            regulator_fault_stop(reg);
+            return AS5600_OK;
+        }
+    }
+
+    if (reg->mode == REGULATOR_MODE_SWEEP)
+    {
+        regulator_sweep_tick(reg);
+    }
+    else if (reg->mode == REGULATOR_MODE_SYSID)
+    {
+        regulator_sysid_tick(reg);
+    }
+    else
+    {
+        SPAN_BEGIN(span);
+        reg->command = controller_step(&reg->ctrl, angle);
+        SPAN_END(SPAN_CONTROL, span);
+        regulator_drive(reg, reg->command);
+        step_analyzer_tick(&reg->analyzer, reg->ctrl.target, angle);
+
+        if (osc_detect_tick(&reg->osc, fix16_sat((int64_t)reg->ctrl.setpoint - angle)) && reg->osc.backoff)
+        {
+            controller_set_gain_scale(&reg->ctrl, reg->osc.scale);
+        }
+    }
+
+    supervisor_enforce(&reg->sup);
+
+    return AS5600_OK;
+}
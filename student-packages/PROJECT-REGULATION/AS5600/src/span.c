@@ -0,0 +1,64 @@
+/**
+ * @file span.c
+ * @brief Cycle-count spans of the hot path implementation
+ */
+
+#include "span.h"
+
+span_stats_t span_stats[SPAN_CORES][SPAN_STAGES];
+
+const char *const span_stage_names[SPAN_STAGES] = {
+    "tick", "sensor", "magnet", "control", "motor", "report", "log", "telemetry",
+};
+
+/**
+ * @brief Clear the statistics of one stage (start a new window)
+ *
+ * @param[out] stats Pointer to stage statistics
+ */
+void span_stats_reset(span_stats_t *stats)
+{
+    stats->count = 0;
+    stats->min = UINT32_MAX;
+    stats->max = 0;
+    stats->sum = 0;
+    for (uint8_t b = 0; b < SPAN_BUCKETS; b++)
+    {
+        stats->hist[b] = 0;
+    }
+}
+
+/**
+ * @brief Clear the table of one core
+ *
+ * @param[in] core Core number (< SPAN_CORES)
+ */
+void span_reset(uint8_t core)
+{
+    if (core >= SPAN_CORES)
+    {
+        return;
+    }
+
+    for (uint8_t s = 0; s < SPAN_STAGES; s++)
+    {
+        span_stats_reset(&span_stats[core][s]);
+    }
+}
+
+/**
+ * @brief Mean span of a stage over the window
+ *
+ * @param[in] stats Pointer to stage statistics
+ *
+ * @return Mean length in cycles (0 without spans)
+ */
+uint32_t span_mean(const span_stats_t *stats)
+{
+    if (stats->count == 0)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(stats->sum / stats->count);
+}
@@ -0,0 +1,182 @@
+/**
+ * @file step_analyzer.c
+ * @brief On-line step-response analysis implementation
+ */
+
+#include "step_analyzer.h"
+
+/**
+ * @brief Convert a tick count into milliseconds
+ *
+ * @param[in] sa Pointer to analyzer structure
+ * @param[in] ticks Tick count
+ *
+ * @return Time in milliseconds
+ */
+static uint32_t step_analyzer_ms(const step_analyzer_t *sa, uint32_t ticks)
+{
+    return (uint32_t)((uint64_t)ticks * 1000 / sa->rate_hz);
+}
+
+/**
+ * @brief Finish the step in progress and fill in the summary
+ *
+ * @param[in,out] sa Pointer to analyzer structure
+ * @param[in] settled 1 if the step settled, 0 on timeout
+ * @param[in] error Last error (used as steady-state error when never in the band)
+ */
+static void step_analyzer_finish(step_analyzer_t *sa, uint8_t settled, fix16_t error)
+{
+    step_summary_t *s = &sa->summary;
+    fix16_t size = fix16_abs(sa->step);
+
+    s->from = sa->from;
+    s->to = sa->target;
+    s->settled = settled;
+    s->rise_ms = (sa->t10 && sa->t90) ? step_analyzer_ms(sa, sa->t90 - sa->t10) : UINT32_MAX;
+    s->overshoot = size > 0 ? fix16_sat(((int64_t)sa->peak * 100 << FIX16_SHIFT) / size) : 0;
+    s->settle_ms = settled ? step_analyzer_ms(sa, sa->in_band) : UINT32_MAX;
+    s->ss_error = sa->in_band ? (fix16_t)(sa->ss_acc / (int64_t)(sa->tick - sa->in_band + 1)) : error;
+    s->iae = fix16_sat(sa->iae_acc / sa->rate_hz);
+    s->ise = fix16_sat(sa->ise_acc / sa->rate_hz);
+
+    sa->state = STEP_ANALYZER_DONE;
+}
+
+/**
+ * @brief Initialize the analyzer
+ *
+ * @param[out] sa Pointer to analyzer structure
+ * @param[in] rate_hz Tick rate in Hz
+ * @param[in] band Settling band (degrees, Q16.16)
+ * @param[in] hold_ms Time within the band to count as settled
+ * @param[in] timeout_ms Longest evaluated response
+ */
+void step_analyzer_init(step_analyzer_t *sa, uint32_t rate_hz, fix16_t band,
+                        uint32_t hold_ms, uint32_t timeout_ms)
+{
+    sa->state = STEP_ANALYZER_IDLE;
+    sa->rate_hz = rate_hz;
+    sa->band = band;
+    sa->hold_ticks = hold_ms * rate_hz / 1000;
+    sa->hold_ticks = sa->hold_ticks > 0 ? sa->hold_ticks : 1;
+    sa->timeout_ticks = timeout_ms * rate_hz / 1000;
+    sa->from = 0;
+    sa->target = 0;
+    sa->step = 0;
+}
+
+/**
+ * @brief Start evaluating a step explicitly (e.g. when the regulation is enabled)
+ *
+ * @param[in,out] sa Pointer to analyzer structure
+ * @param[in] from Angle the step starts from (deg)
+ * @param[in] target Target angle (deg)
+ */
+void step_analyzer_start(step_analyzer_t *sa, fix16_t from, fix16_t target)
+{
+    sa->from = from;
+    sa->target = target;
+    sa->step = target - from;
+    sa->tick = 0;
+    sa->t10 = 0;
+    sa->t90 = 0;
+    sa->in_band = 0;
+    sa->peak = 0;
+    sa->iae_acc = 0;
+    sa->ise_acc = 0;
+    sa->ss_acc = 0;
+    sa->state = STEP_ANALYZER_TRACKING;
+}
+
+/**
+ * @brief Stop evaluating without a summary (e.g. when the regulation is disabled)
+ *
+ * @param[in,out] sa Pointer to analyzer structure
+ */
+void step_analyzer_abort(step_analyzer_t *sa)
+{
+    sa->state = STEP_ANALYZER_IDLE;
+}
+
+/**
+ * @brief Run one analyzer tick
+ *
+ * @param[in,out] sa Pointer to analyzer structure
+ * @param[in] target Current target angle (deg)
+ * @param[in] angle Measured angle (deg)
+ *
+ * @return 1 when a step has just completed and sa->summary holds its result, 0 otherwise
+ */
+uint8_t step_analyzer_tick(step_analyzer_t *sa, fix16_t target, fix16_t angle)
+{
+    fix16_t error, abs_error, along, beyond, size;
+
+    if (sa->state == STEP_ANALYZER_IDLE)
+    {
+        return 0;
+    }
+
+    if (fix16_abs(target - sa->target) >= STEP_ANALYZER_MIN_STEP)
+    {
+        /* New target: the step starts from the previous target */
+        step_analyzer_start(sa, sa->target, target);
+    }
+
+    if (sa->state != STEP_ANALYZER_TRACKING)
+    {
+        return 0;
+    }
+
+    sa->tick++;
+    error = target - angle;
+    abs_error = fix16_abs(error);
+    sa->iae_acc += abs_error;
+    sa->ise_acc += ((int64_t)error * error) >> FIX16_SHIFT;
+
+    /* Progress and excursion measured in the direction of the step */
+    size = fix16_abs(sa->step);
+    along = sa->step >= 0 ? angle - sa->from : sa->from - angle;
+    beyond = sa->step >= 0 ? angle - target : target - angle;
+
+    if (!sa->t10 && (int64_t)along * 10 >= size)
+    {
+        sa->t10 = sa->tick;
+    }
+    if (!sa->t90 && (int64_t)along * 10 >= (int64_t)size * 9)
+    {
+        sa->t90 = sa->tick;
+    }
+    if (beyond > sa->peak)
+    {
+        sa->peak = beyond;
+    }
+
+    if (abs_error <= sa->band)
+    {
+        if (!sa->in_band)
+        {
+            sa->in_band = sa->tick;
+            sa->ss_acc = 0;
+        }
+        sa->ss_acc += error;
+
+        if (sa->tick - sa->in_band + 1 >= sa->hold_ticks)
+        {
+            step_analyzer_finish(sa, 1, error);
+            return 1;
+        }
+    }
+    else
+    {
+        sa->in_band = 0;
+    }
+
+    if (sa->timeout_ticks && sa->tick >= sa->timeout_ticks)
+    {
+        step_analyzer_finish(sa, 0, error);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,272 @@
+/**
+ * @file supervisor.c
+ * @brief Safety supervisor implementation
+ */
+
+#include "supervisor.h"
+
+/**
+ * @brief Put the bridge into the configured safe state
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ */
+static void supervisor_cut(supervisor_t *sup)
+{
+    if (sup->lim.action == SUPERVISOR_ACTION_BRAKE)
+    {
+        motor_brake(sup->motor);
+    }
+    else
+    {
+        motor_coast(sup->motor);
+    }
+}
+
+/**
+ * @brief Fill the limits with the default values
+ *
+ * @param[out] lim Pointer to limits structure
+ * @param[in] rate_hz Control tick rate in Hz (sets the deadline to one tick)
+ */
+void supervisor_default_limits(supervisor_limits_t *lim, uint32_t rate_hz)
+{
+    lim->angle_min = SUPERVISOR_ANGLE_MIN_DEFAULT;
+    lim->angle_max = SUPERVISOR_ANGLE_MAX_DEFAULT;
+    lim->rate_max = SUPERVISOR_RATE_MAX_DEFAULT;
+    lim->agc_min = SUPERVISOR_AGC_MIN_DEFAULT;
+    lim->agc_max = SUPERVISOR_AGC_MAX_DEFAULT;
+    lim->read_errors = SUPERVISOR_READ_ERRORS_DEFAULT;
+    lim->stale_periods = SUPERVISOR_STALE_PERIODS_DEFAULT;
+    lim->deadline_us = 1000000 / rate_hz;
+    lim->action = SUPERVISOR_ACTION_COAST;
+}
+
+/**
+ * @brief Initialize the supervisor (disarmed, no faults)
+ *
+ * @param[out] sup Pointer to supervisor structure
+ * @param[in] motor Motor cut on a fault
+ * @param[in] lim Limits
+ * @param[in] rate_hz Control tick rate in Hz
+ */
+void supervisor_init(supervisor_t *sup, motor_dev_t *motor, const supervisor_limits_t *lim,
+                     uint32_t rate_hz)
+{
+    sup->lim = *lim;
+    sup->motor = motor;
+    /* Rate limit as an angle change per tick, so the hot path needs no division */
+    sup->step_max = lim->rate_max / (int32_t)rate_hz;
+    sup->faults = 0;
+    sup->isr_faults = 0;
+    sup->armed = 0;
+    sup->idle = 0;
+    sup->heartbeat = 0;
+    sup->read_errors = 0;
+    sup->primed = 0;
+    sup->prev_angle = 0;
+    sup->fault_angle = 0;
+    sup->trips = 0;
+}
+
+/**
+ * @brief Start or stop watching
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ * @param[in] arm 1 to arm, 0 to disarm
+ *
+ * @return 1 if armed, 0 if arming was refused because of latched faults
+ */
+uint8_t supervisor_arm(supervisor_t *sup, uint8_t arm)
+{
+    if (arm && (sup->faults | sup->isr_faults))
+    {
+        return 0;
+    }
+
+    sup->idle = 0;
+    sup->read_errors = 0;
+    sup->primed = 0;
+    sup->armed = arm ? 1 : 0;
+
+    return sup->armed;
+}
+
+/**
+ * @brief Clear the latched faults
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ */
+void supervisor_clear(supervisor_t *sup)
+{
+    sup->faults = 0;
+    sup->isr_faults = 0;
+}
+
+/**
+ * @brief Latch a fault and cut the motor
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ * @param[in] faults Fault flags to latch
+ */
+void supervisor_trip(supervisor_t *sup, uint32_t faults)
+{
+    if (!(sup->faults | sup->isr_faults))
+    {
+        sup->fault_angle = sup->prev_angle;
+        sup->trips++;
+    }
+
+    sup->faults |= faults;
+    sup->armed = 0;
+    supervisor_cut(sup);
+}
+
+/**
+ * @brief Cut the motor again if a fault is latched
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ */
+void supervisor_enforce(supervisor_t *sup)
+{
+    if (sup->faults | sup->isr_faults)
+    {
+        supervisor_cut(sup);
+    }
+}
+
+/**
+ * @brief Check one sample of the regulation loop (called every tick)
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ * @param[in] rslt Result of the sensor read
+ * @param[in] angle Measured angle (deg, ignored on a read error)
+ *
+ * @return Latched fault flags of both sources (0 if the loop may drive the motor)
+ */
+uint32_t supervisor_check_sample(supervisor_t *sup, as5600_err_t rslt, fix16_t angle)
+{
+    uint32_t faults = 0;
+
+    sup->idle = 0;
+
+    if (!sup->armed)
+    {
+        return sup->faults | sup->isr_faults;
+    }
+
+    if (rslt != AS5600_OK)
+    {
+        if (rslt == AS5600_ERR_NO_MAGNET || rslt == AS5600_ERR_MAGNET_WEAK || rslt == AS5600_ERR_MAGNET_STRONG)
+        {
+            faults |= SUPERVISOR_FAULT_MAGNET;
+        }
+        else if (++sup->read_errors >= sup->lim.read_errors)
+        {
+            faults |= SUPERVISOR_FAULT_SENSOR;
+        }
+        sup->primed = 0;
+    }
+    else
+    {
+        sup->read_errors = 0;
+
+        if (angle < sup->lim.angle_min || angle > sup->lim.angle_max)
+        {
+            faults |= SUPERVISOR_FAULT_ANGLE;
+        }
+        if (sup->primed && fix16_abs(angle - sup->prev_angle) > sup->step_max)
+        {
+            faults |= SUPERVISOR_FAULT_RATE;
+        }
+
+        sup->prev_angle = angle;
+        sup->primed = 1;
+    }
+
+    if (faults)
+    {
+        supervisor_trip(sup, faults);
+    }
+
+    return sup->faults | sup->isr_faults;
+}
+
+/**
+ * @brief Check the magnet status (STATUS register and AGC)
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ * @param[in] status STATUS register value
+ * @param[in] agc AGC register value
+ *
+ * @return Latched fault flags
+ */
+uint32_t supervisor_check_magnet(supervisor_t *sup, uint8_t status, uint8_t agc)
+{
+    uint32_t faults = 0;
+
+    if (!sup->armed)
+    {
+        return sup->faults | sup->isr_faults;
+    }
+
+    if (!(status & AS5600_STATUS_MD) || (status & (AS5600_STATUS_ML | AS5600_STATUS_MH)))
+    {
+        faults |= SUPERVISOR_FAULT_MAGNET;
+    }
+    if (agc < sup->lim.agc_min || agc > sup->lim.agc_max)
+    {
+        faults |= SUPERVISOR_FAULT_AGC;
+    }
+
+    if (faults)
+    {
+        supervisor_trip(sup, faults);
+    }
+
+    return sup->faults | sup->isr_faults;
+}
+
+/**
+ * @brief Check the completion time of a control tick
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ * @param[in] latency_us Time from the scheduled tick start to the end of the tick
+ *
+ * @return Latched fault flags
+ */
+uint32_t supervisor_check_deadline(supervisor_t *sup, uint32_t latency_us)
+{
+    if (sup->armed && latency_us > sup->lim.deadline_us)
+    {
+        supervisor_trip(sup, SUPERVISOR_FAULT_DEADLINE);
+    }
+
+    return sup->faults | sup->isr_faults;
+}
+
+/**
+ * @brief Periodic check from the highest-priority interrupt
+ *
+ * @param[in,out] sup Pointer to supervisor structure
+ */
+void supervisor_isr(supervisor_t *sup)
+{
+    sup->heartbeat++;
+
+    if (!sup->armed)
+    {
+        return;
+    }
+
+    if (++sup->idle >= sup->lim.stale_periods)
+    {
+        /* The main loop is stuck: cut from here, it cannot be relied on */
+        if (!(sup->faults | sup->isr_faults))
+        {
+            sup->trips++;
+        }
+        sup->isr_faults |= SUPERVISOR_FAULT_STALE;
+        sup->armed = 0;
+        supervisor_cut(sup);
+    }
+}
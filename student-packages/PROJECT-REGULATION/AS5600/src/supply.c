@@ -0,0 +1,116 @@
+/**
+ * @file supply.c
+ * @brief Motor supply voltage monitor implementation
+ */
+
+#include "supply.h"
+
+/**
+ * @brief Initialize the monitor (compensation disabled)
+ *
+ * @param[out] supply Pointer to supply monitor structure
+ * @param[in] read_fptr Pointer to platform-specific ADC reading function
+ * @param[in] mv_per_count Supply millivolts per ADC count (Q16.16, > 0)
+ * @param[in] nominal Nominal supply voltage in volts (Q16.16, > 0)
+ * @param[in] rate_hz Update rate in Hz
+ * @param[in] intf_ptr Interface context passed to the reading function
+ *
+ * @return SUPPLY_OK on success, SUPPLY_ERR_INVALID_PARAM on invalid parameters
+ */
+supply_err_t supply_init(supply_t *supply, supply_read_fptr_t read_fptr, fix16_t mv_per_count,
+                         fix16_t nominal, uint32_t rate_hz, void *intf_ptr)
+{
+    uint32_t tau_ticks = SUPPLY_FILTER_TAU_MS * rate_hz / 1000;
+
+    if (!supply || !read_fptr || mv_per_count <= 0 || nominal <= 0 || rate_hz == 0)
+    {
+        return SUPPLY_ERR_INVALID_PARAM;
+    }
+
+    supply->read = read_fptr;
+    supply->intf_ptr = intf_ptr;
+    supply->mv_per_count = mv_per_count;
+    supply->alpha = tau_ticks > 1 ? (fix16_t)(FIX16_ONE / tau_ticks) : FIX16_ONE;
+    supply->nominal = nominal;
+    supply->voltage = 0;
+    supply->gain = FIX16_ONE;
+    supply->primed = 0;
+    supply->present = 0;
+    supply->compensate = 0;
+
+    return SUPPLY_OK;
+}
+
+/**
+ * @brief Enable or disable the compensation
+ *
+ * @param[in,out] supply Pointer to supply monitor structure
+ * @param[in] enable 1 to scale the duty to the nominal voltage, 0 to pass it through
+ * @param[in] nominal Nominal voltage in volts (Q16.16); 0 takes the present filtered voltage
+ */
+void supply_configure(supply_t *supply, uint8_t enable, fix16_t nominal)
+{
+    if (nominal > 0)
+    {
+        supply->nominal = nominal;
+    }
+    else if (supply->primed && supply->voltage > 0)
+    {
+        supply->nominal = supply->voltage;
+    }
+
+    supply->compensate = enable ? 1 : 0;
+    if (!supply->compensate)
+    {
+        supply->gain = FIX16_ONE;
+    }
+}
+
+/**
+ * @brief Read and filter the supply voltage, update the compensation gain
+ *
+ * @param[in,out] supply Pointer to supply monitor structure
+ *
+ * @return Filtered supply voltage in volts (Q16.16)
+ */
+fix16_t supply_update(supply_t *supply)
+{
+    fix16_t raw = fix16_sat((int64_t)supply->read(supply->intf_ptr) * supply->mv_per_count / 1000);
+
+    if (!supply->primed)
+    {
+        supply->voltage = raw;
+        supply->primed = 1;
+    }
+    else
+    {
+        supply->voltage += fix16_mul(supply->alpha, raw - supply->voltage);
+    }
+
+    /* Without motor supply (board on USB only) there is nothing to compensate */
+    supply->present = supply->voltage >= supply->nominal / 2;
+
+    if (supply->compensate && supply->present)
+    {
+        supply->gain = fix16_clamp(fix16_div(supply->nominal, supply->voltage), SUPPLY_GAIN_MIN, SUPPLY_GAIN_MAX);
+    }
+    else
+    {
+        supply->gain = FIX16_ONE;
+    }
+
+    return supply->voltage;
+}
+
+/**
+ * @brief Scale a duty to constant effective motor voltage
+ *
+ * @param[in] supply Pointer to supply monitor structure
+ * @param[in] duty Duty at the nominal voltage (Q16.16)
+ *
+ * @return Duty to apply at the present voltage (the motor driver clamps it)
+ */
+fix16_t supply_compensate(const supply_t *supply, fix16_t duty)
+{
+    return supply->gain == FIX16_ONE ? duty : fix16_mul(duty, supply->gain);
+}
@@ -0,0 +1,309 @@
+/**
+ * @file sysid.c
+ * @brief System-identification excitation and capture implementation
+ */
+
+#include "sysid.h"
+
+/**
+ * @brief Saturate a value to the int16_t range
+ *
+ * @param[in] x Value
+ *
+ * @return Saturated value
+ */
+static int16_t sysid_sat16(int32_t x)
+{
+    return (int16_t)(x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x));
+}
+
+/**
+ * @brief Phase increment per tick for a frequency
+ *
+ * @param[in] id Pointer to identification structure
+ * @param[in] freq Frequency (Hz, Q16.16)
+ *
+ * @return Phase increment (full turn = 2^32)
+ */
+static uint32_t sysid_phase_inc(const sysid_t *id, fix16_t freq)
+{
+    return (uint32_t)(((uint64_t)freq << 16) / id->rate_hz);
+}
+
+/**
+ * @brief Sine of an accumulator phase
+ *
+ * @param[in] phase Phase (full turn = 2^32)
+ *
+ * @return Sine in Q16.16
+ */
+static fix16_t sysid_sin(uint32_t phase)
+{
+    return fix16_sin_deg((fix16_t)(((uint64_t)phase * 360) >> 16));
+}
+
+/**
+ * @brief Reset the multisine phases to the Schroeder phases
+ *
+ * @param[in,out] id Pointer to identification structure
+ */
+static void sysid_reset_phases(sysid_t *id)
+{
+    for (uint8_t k = 0; k < id->sines; k++)
+    {
+        /* -pi * k * (k + 1) / N for the (k + 1)-th component */
+        id->phase[k] = 0u - (uint32_t)(((uint64_t)k * (k + 1) << 31) / SYSID_SINES);
+    }
+}
+
+/**
+ * @brief Set up the multisine: log-spaced harmonics of f_min up to f_max
+ *
+ * @param[in,out] id Pointer to identification structure
+ */
+static void sysid_setup_multisine(sysid_t *id)
+{
+    fix16_t octaves = fix16_log2(fix16_div(id->cfg.f_max, id->cfg.f_min));
+    uint32_t prev = 0;
+
+    id->sines = SYSID_SINES;
+    for (uint8_t k = 0; k < SYSID_SINES; k++)
+    {
+        fix16_t x = (fix16_t)((int64_t)octaves * k / (SYSID_SINES - 1));
+        uint32_t h = (uint32_t)((fix16_exp2(x) + FIX16_HALF) >> FIX16_SHIFT);
+
+        /* Distinct harmonics, even when the range holds fewer than SYSID_SINES */
+        h = h > prev ? h : prev + 1;
+        prev = h;
+
+        id->inc[k] = sysid_phase_inc(id, (fix16_t)(h * (uint32_t)id->cfg.f_min));
+    }
+    sysid_reset_phases(id);
+}
+
+/**
+ * @brief Sum of the unit multisine components, advancing their phases
+ *
+ * @param[in,out] id Pointer to identification structure
+ *
+ * @return Sum in Q16.16
+ */
+static fix16_t sysid_multisine_sum(sysid_t *id)
+{
+    fix16_t sum = 0;
+
+    for (uint8_t k = 0; k < id->sines; k++)
+    {
+        sum += sysid_sin(id->phase[k]);
+        id->phase[k] += id->inc[k];
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Leave the settle phase: scale the multisine to the peak seen so far
+ *
+ * Schroeder phases only flatten the peak for dense harmonics; for the sparse
+ * log-spaced ones the crest factor depends on the frequency range, so the
+ * sum runs silently during the settle time and its largest magnitude sets
+ * the gain. A settle time shorter than 1 / f_min sees only part of the
+ * period; the rare higher peaks are then clipped to the amplitude.
+ *
+ * @param[in,out] id Pointer to identification structure
+ */
+static void sysid_begin_capture(sysid_t *id)
+{
+    if (id->sines > 0)
+    {
+        fix16_t peak = id->peak > 0 ? id->peak : FIX16_FROM_INT(SYSID_SINES);
+
+        id->gain = fix16_div(id->cfg.amp, peak);
+        sysid_reset_phases(id);
+    }
+    id->state = SYSID_RUNNING;
+}
+
+/**
+ * @brief Excitation value of the current tick (before the operating point is added)
+ *
+ * @param[in,out] id Pointer to identification structure
+ *
+ * @return Excitation (duty)
+ */
+static fix16_t sysid_excitation(sysid_t *id)
+{
+    fix16_t value, ratio;
+
+    switch (id->cfg.signal)
+    {
+    case SYSID_SIGNAL_PRBS:
+        if (id->hold == 0)
+        {
+            uint16_t bit = id->lfsr & 1u;
+
+            id->lfsr >>= 1;
+            if (bit)
+            {
+                id->lfsr ^= SYSID_PRBS_TAPS;
+            }
+            id->level = bit ? id->cfg.amp : -id->cfg.amp;
+            id->hold = id->hold_ticks;
+        }
+        id->hold--;
+        return id->level;
+
+    case SYSID_SIGNAL_MULTISINE:
+        return fix16_clamp(fix16_mul(sysid_multisine_sum(id), id->gain), -id->cfg.amp, id->cfg.amp);
+
+    case SYSID_SIGNAL_CHIRP:
+        value = fix16_mul(sysid_sin(id->phase[0]), id->cfg.amp);
+        ratio = fix16_exp2((fix16_t)(id->chirp_oct >> 16));
+        id->chirp_oct += id->chirp_step;
+        id->phase[0] += (uint32_t)(((uint64_t)id->chirp_inc0 * (uint32_t)ratio) >> FIX16_SHIFT);
+        return value;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Initialize the identification (idle)
+ *
+ * @param[out] id Pointer to identification structure
+ * @param[in] rate_hz Tick rate in Hz
+ * @param[in] out_min Lowest motor command
+ * @param[in] out_max Highest motor command
+ */
+void sysid_init(sysid_t *id, uint32_t rate_hz, fix16_t out_min, fix16_t out_max)
+{
+    id->state = SYSID_IDLE;
+    id->rate_hz = rate_hz;
+    id->out_min = out_min;
+    id->out_max = out_max;
+    id->buf = 0;
+    id->count = 0;
+    id->tick = 0;
+}
+
+/**
+ * @brief Start an excitation and capture
+ *
+ * @param[in,out] id Pointer to identification structure
+ * @param[in] cfg Excitation settings
+ * @param[out] buf Capture buffer
+ * @param[in] capacity Number of samples the buffer holds
+ *
+ * @return SYSID_OK on success, error code on failure
+ */
+sysid_err_t sysid_start(sysid_t *id, const sysid_config_t *cfg, sysid_sample_t *buf, uint32_t capacity)
+{
+    fix16_t nyquist = FIX16_FROM_INT(id->rate_hz / 2);
+
+    if (cfg->f_min <= 0 || cfg->f_max < cfg->f_min || cfg->f_max > nyquist || cfg->amp <= 0 ||
+        cfg->u0 < id->out_min || cfg->u0 > id->out_max || cfg->samples == 0 || buf == 0)
+    {
+        return SYSID_ERR_INVALID_PARAM;
+    }
+    if (cfg->samples > capacity)
+    {
+        return SYSID_ERR_BUFFER;
+    }
+
+    id->cfg = *cfg;
+    id->buf = buf;
+    id->count = 0;
+    id->tick = 0;
+
+    /* PRBS bits of 1 / (2 * f_max): flat spectrum up to about f_max */
+    id->lfsr = SYSID_PRBS_SEED;
+    id->hold_ticks = (uint32_t)(((uint64_t)id->rate_hz << FIX16_SHIFT) / ((uint64_t)cfg->f_max * 2));
+    id->hold_ticks = id->hold_ticks > 0 ? id->hold_ticks : 1;
+    id->hold = 0;
+    id->level = 0;
+
+    id->sines = 0;
+    id->peak = 0;
+    id->gain = 0;
+    id->phase[0] = 0;
+    if (cfg->signal == SYSID_SIGNAL_MULTISINE)
+    {
+        sysid_setup_multisine(id);
+    }
+
+    /* Chirp: the frequency doubles every (samples / octaves) ticks */
+    id->chirp_inc0 = sysid_phase_inc(id, cfg->f_min);
+    id->chirp_oct = 0;
+    id->chirp_step = ((int64_t)fix16_log2(fix16_div(cfg->f_max, cfg->f_min)) << 16) / cfg->samples;
+
+    if (cfg->settle_ticks > 0)
+    {
+        id->state = SYSID_SETTLING;
+    }
+    else
+    {
+        sysid_begin_capture(id);
+    }
+    return SYSID_OK;
+}
+
+/**
+ * @brief Abort a running capture (the samples recorded so far stay valid)
+ *
+ * @param[in,out] id Pointer to identification structure
+ */
+void sysid_abort(sysid_t *id)
+{
+    if (id->state == SYSID_SETTLING || id->state == SYSID_RUNNING)
+    {
+        id->state = SYSID_ABORTED;
+    }
+}
+
+/**
+ * @brief Run one tick: record the sample and return the motor command
+ *
+ * @param[in,out] id Pointer to identification structure
+ * @param[in] angle Measured angle (deg)
+ *
+ * @return Motor command for this tick
+ */
+fix16_t sysid_tick(sysid_t *id, fix16_t angle)
+{
+    fix16_t duty;
+    sysid_sample_t *s;
+
+    if (id->state == SYSID_SETTLING)
+    {
+        if (id->sines > 0)
+        {
+            fix16_t peak = fix16_abs(sysid_multisine_sum(id));
+
+            id->peak = peak > id->peak ? peak : id->peak;
+        }
+        if (++id->tick >= id->cfg.settle_ticks)
+        {
+            sysid_begin_capture(id);
+        }
+        return id->cfg.u0;
+    }
+
+    if (id->state != SYSID_RUNNING)
+    {
+        return id->cfg.u0;
+    }
+
+    duty = fix16_clamp(fix16_add(id->cfg.u0, sysid_excitation(id)), id->out_min, id->out_max);
+
+    s = &id->buf[id->count++];
+    s->duty = sysid_sat16(duty >> 1);
+    s->angle = sysid_sat16((int32_t)(((int64_t)angle * 100 + FIX16_HALF) >> FIX16_SHIFT));
+
+    if (id->count >= id->cfg.samples)
+    {
+        id->state = SYSID_DONE;
+    }
+
+    return duty;
+}
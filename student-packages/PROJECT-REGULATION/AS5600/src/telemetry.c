@@ -0,0 +1,484 @@
+/**
+ * @file telemetry.c
+ * @brief Binary framed telemetry implementation
+ */
+
+#include <string.h>
+
+#include "telemetry.h"
+
+/**
+ * @brief CRC-16/CCITT-FALSE remainders of one nibble (polynomial 0x1021)
+ */
+static const uint16_t telemetry_crc_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/**
+ * @brief Channels of the regulation log
+ *
+ * Angles in 1/128 deg (+-256 deg), duty in 1/16384 (+-2), supply in 1/256 V.
+ */
+const telemetry_channel_t telemetry_log_channels[TELEMETRY_LOG_CHANNELS] = {
+    {"Timestamp", TELEMETRY_TYPE_U32, 0},
+    {"TargetAngle", TELEMETRY_TYPE_Q16, 7},
+    {"CurrentAngle", TELEMETRY_TYPE_Q16, 7},
+    {"MotorPower", TELEMETRY_TYPE_Q16, 14},
+    {"SupplyVoltage", TELEMETRY_TYPE_Q16, 8},
+};
+
+/**
+ * @brief Channels of the live regulation log: the same columns with the time stamp in us
+ *
+ * A millisecond resolves neither the 1 kHz samples nor the alignment with
+ * the host; the low 32 bits of the us time since boot wrap after 71 minutes,
+ * which the host undoes from the order of the samples.
+ */
+const telemetry_channel_t telemetry_log_channels_us[TELEMETRY_LOG_CHANNELS] = {
+    {"Timestamp_us", TELEMETRY_TYPE_U32, 0},
+    {"TargetAngle", TELEMETRY_TYPE_Q16, 7},
+    {"CurrentAngle", TELEMETRY_TYPE_Q16, 7},
+    {"MotorPower", TELEMETRY_TYPE_Q16, 14},
+    {"SupplyVoltage", TELEMETRY_TYPE_Q16, 8},
+};
+
+/**
+ * @brief Update a CRC-16/CCITT-FALSE (start with 0xFFFF)
+ *
+ * @param[in] crc CRC of the preceding bytes
+ * @param[in] data Pointer to data
+ * @param[in] len Number of bytes
+ *
+ * @return Updated CRC
+ */
+uint16_t telemetry_crc16(uint16_t crc, const uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc = (uint16_t)((crc << 4) ^ telemetry_crc_nibble[(crc >> 12) ^ (data[i] >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ telemetry_crc_nibble[(crc >> 12) ^ (data[i] & 0x0F)]);
+    }
+
+    return crc;
+}
+
+/**
+ * @brief COBS encode a frame (without delimiters)
+ *
+ * @param[in] src Unencoded frame
+ * @param[in] len Number of bytes
+ * @param[out] dst Output, at least len + len / 254 + 1 bytes
+ *
+ * @return Encoded length
+ */
+uint32_t telemetry_cobs_encode(const uint8_t *src, uint32_t len, uint8_t *dst)
+{
+    uint32_t code_pos = 0;
+    uint32_t out = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if (src[i] != 0)
+        {
+            dst[out++] = src[i];
+            code++;
+        }
+
+        /* A zero ends the block; so does a full block of 254 data bytes */
+        if (src[i] == 0 || code == 0xFF)
+        {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        }
+    }
+
+    dst[code_pos] = code;
+    return out;
+}
+
+/**
+ * @brief COBS decode a frame (the bytes between two delimiters)
+ *
+ * @param[in] src Encoded frame
+ * @param[in] len Number of bytes
+ * @param[out] dst Output
+ * @param[in] size Size of the output
+ *
+ * @return Decoded length, -1 if malformed or too long
+ */
+int32_t telemetry_cobs_decode(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t size)
+{
+    uint32_t in = 0;
+    uint32_t out = 0;
+
+    while (in < len)
+    {
+        uint8_t code = src[in++];
+
+        if (code == 0 || in + code - 1 > len)
+        {
+            return -1;
+        }
+
+        for (uint8_t i = 1; i < code; i++)
+        {
+            if (src[in] == 0 || out >= size)
+            {
+                return -1;
+            }
+            dst[out++] = src[in++];
+        }
+
+        /* The zero a block stands for, except after a full block and at the end */
+        if (code != 0xFF && in < len)
+        {
+            if (out >= size)
+            {
+                return -1;
+            }
+            dst[out++] = 0;
+        }
+    }
+
+    return (int32_t)out;
+}
+
+/**
+ * @brief Write a signed value as a zig-zag varint
+ *
+ * @param[in] value Value
+ * @param[out] dst Output, at least TELEMETRY_VARINT_MAX bytes
+ *
+ * @return Number of bytes written (1 - TELEMETRY_VARINT_MAX)
+ */
+uint8_t telemetry_varint_encode(int32_t value, uint8_t *dst)
+{
+    /* 0, -1, 1, -2, ... -> 0, 1, 2, 3, ... */
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    uint8_t len = 0;
+
+    while (zz >= 0x80)
+    {
+        dst[len++] = (uint8_t)(zz | 0x80);
+        zz >>= 7;
+    }
+    dst[len++] = (uint8_t)zz;
+
+    return len;
+}
+
+/**
+ * @brief Read a zig-zag varint
+ *
+ * @param[in] src Input
+ * @param[in] len Bytes available
+ * @param[out] value Value
+ *
+ * @return Number of bytes read, -1 if truncated or too long
+ */
+int32_t telemetry_varint_decode(const uint8_t *src, uint32_t len, int32_t *value)
+{
+    uint32_t zz = 0;
+
+    for (uint32_t i = 0; i < len && i < TELEMETRY_VARINT_MAX; i++)
+    {
+        zz |= (uint32_t)(src[i] & 0x7F) << (7 * i);
+        if ((src[i] & 0x80) == 0)
+        {
+            *value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+            return (int32_t)i + 1;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Put a little-endian value into a frame
+ *
+ * @param[out] dst Output
+ * @param[in] value Value
+ * @param[in] bytes Number of bytes (2 or 4)
+ */
+static void telemetry_put(uint8_t *dst, uint32_t value, uint8_t bytes)
+{
+    for (uint8_t i = 0; i < bytes; i++)
+    {
+        dst[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Add header and CRC to a frame, encode it and hand it to the output
+ *
+ * @param[in,out] tlm Pointer to telemetry structure
+ * @param[in] type Frame type
+ * @param[in,out] frame Frame with the payload after TELEMETRY_HEADER_SIZE bytes
+ * @param[in] payload Payload length
+ * @param[in] seq Sequence number of the frame
+ */
+static void telemetry_emit(telemetry_t *tlm, telemetry_frame_t type, uint8_t *frame, uint32_t payload, uint16_t seq)
+{
+    uint8_t out[TELEMETRY_ENCODED_MAX];
+    uint32_t len = TELEMETRY_HEADER_SIZE + payload;
+    uint32_t enc;
+
+    frame[0] = (uint8_t)type;
+    frame[1] = tlm->schema_id;
+    frame[2] = tlm->stream;
+    telemetry_put(&frame[3], seq, 2);
+    telemetry_put(&frame[len], telemetry_crc16(0xFFFF, frame, len), 2);
+
+    out[0] = 0;
+    enc = telemetry_cobs_encode(frame, len + TELEMETRY_CRC_SIZE, &out[1]);
+    out[enc + 1] = 0;
+
+    if (tlm->write(out, enc + 2, tlm->intf_ptr) == 0)
+    {
+        tlm->frames++;
+    }
+    else
+    {
+        /* The decoder loses the reference of the deltas with this frame */
+        tlm->errors++;
+        tlm->since_key = TELEMETRY_KEYFRAME_INTERVAL;
+    }
+}
+
+/**
+ * @brief Write the channel list of a stream
+ *
+ * @param[in] tlm Pointer to telemetry structure
+ * @param[out] dst Output, at least TELEMETRY_PAYLOAD_MAX bytes
+ *
+ * @return Payload length
+ */
+static uint32_t telemetry_schema(const telemetry_t *tlm, uint8_t *dst)
+{
+    uint32_t len = 0;
+
+    dst[len++] = TELEMETRY_SCHEMA_VERSION;
+    dst[len++] = tlm->count;
+
+    for (uint8_t i = 0; i < tlm->count; i++)
+    {
+        const telemetry_channel_t *ch = &tlm->channels[i];
+        uint8_t name_len = (uint8_t)strlen(ch->name);
+
+        dst[len++] = ch->type;
+        dst[len++] = ch->frac_bits;
+        dst[len++] = name_len;
+        memcpy(&dst[len], ch->name, name_len);
+        len += name_len;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Initialize a stream (the schema goes out with the first sample)
+ *
+ * @param[out] tlm Pointer to telemetry structure
+ * @param[in] channels Channel list (kept by reference)
+ * @param[in] count Number of channels (1 - TELEMETRY_MAX_CHANNELS)
+ * @param[in] stream Stream id
+ * @param[in] write_fptr Pointer to platform-specific output function
+ * @param[in] intf_ptr Interface context passed to the output function
+ *
+ * @return TELEMETRY_OK on success, TELEMETRY_ERR_INVALID_PARAM on invalid parameters
+ */
+telemetry_err_t telemetry_init(telemetry_t *tlm, const telemetry_channel_t *channels, uint8_t count,
+                               uint8_t stream, telemetry_write_fptr_t write_fptr, void *intf_ptr)
+{
+    uint8_t schema[TELEMETRY_PAYLOAD_MAX];
+
+    if (!tlm || !channels || !write_fptr || count == 0 || count > TELEMETRY_MAX_CHANNELS)
+    {
+        return TELEMETRY_ERR_INVALID_PARAM;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const telemetry_channel_t *ch = &channels[i];
+
+        if (!ch->name || strlen(ch->name) > TELEMETRY_NAME_MAX || ch->type > TELEMETRY_TYPE_Q32 ||
+            ch->frac_bits > 16 || (ch->type == TELEMETRY_TYPE_U32 && ch->frac_bits != 0))
+        {
+            return TELEMETRY_ERR_INVALID_PARAM;
+        }
+    }
+
+    tlm->write = write_fptr;
+    tlm->intf_ptr = intf_ptr;
+    tlm->channels = channels;
+    tlm->count = count;
+    tlm->stream = stream;
+    tlm->seq = 0;
+    tlm->batch = 0;
+    tlm->pending = 0;
+    tlm->frames = 0;
+    tlm->errors = 0;
+    tlm->schema_id = (uint8_t)telemetry_crc16(0xFFFF, schema, telemetry_schema(tlm, schema));
+    telemetry_restart(tlm);
+
+    return TELEMETRY_OK;
+}
+
+/**
+ * @brief Send the schema with the next sample (e.g. when the output is switched on)
+ *
+ * @param[in,out] tlm Pointer to telemetry structure
+ */
+void telemetry_restart(telemetry_t *tlm)
+{
+    telemetry_flush(tlm);
+    tlm->since_schema = 0;
+}
+
+/**
+ * @brief Send one sample (preceded by the schema when it is due)
+ *
+ * @param[in,out] tlm Pointer to telemetry structure
+ * @param[in] values One value per channel (integers as is, fixed-point in Q16.16)
+ */
+void telemetry_send(telemetry_t *tlm, const int32_t *values)
+{
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    uint32_t len = 0;
+    uint8_t *payload = &frame[TELEMETRY_HEADER_SIZE];
+    int32_t wire[TELEMETRY_MAX_CHANNELS];
+
+    if (tlm->since_schema == 0)
+    {
+        telemetry_flush(tlm);
+        telemetry_emit(tlm, TELEMETRY_FRAME_SCHEMA, frame, telemetry_schema(tlm, payload), tlm->seq++);
+        tlm->since_key = TELEMETRY_KEYFRAME_INTERVAL;
+    }
+    if (++tlm->since_schema >= TELEMETRY_SCHEMA_INTERVAL)
+    {
+        tlm->since_schema = 0;
+    }
+
+    for (uint8_t i = 0; i < tlm->count; i++)
+    {
+        const telemetry_channel_t *ch = &tlm->channels[i];
+        uint8_t shift = (uint8_t)(FIX16_SHIFT - ch->frac_bits);
+        int32_t raw = values[i];
+
+        /* Round to the wire resolution */
+        if (ch->type != TELEMETRY_TYPE_U32 && shift > 0)
+        {
+            raw = (int32_t)(((int64_t)raw + (1 << (shift - 1))) >> shift);
+        }
+        if (ch->type == TELEMETRY_TYPE_Q16)
+        {
+            raw = raw > INT16_MAX ? INT16_MAX : (raw < INT16_MIN ? INT16_MIN : raw);
+        }
+        wire[i] = raw;
+    }
+
+    /* Keyframe: plain sample frame */
+    if (tlm->batch == 0 || tlm->since_key >= TELEMETRY_KEYFRAME_INTERVAL)
+    {
+        telemetry_flush(tlm);
+        for (uint8_t i = 0; i < tlm->count; i++)
+        {
+            uint8_t bytes = tlm->channels[i].type == TELEMETRY_TYPE_Q16 ? 2 : 4;
+
+            telemetry_put(&payload[len], (uint32_t)wire[i], bytes);
+            len += bytes;
+            tlm->ref[i] = wire[i];
+        }
+        tlm->step = 0;
+        tlm->since_key = 0;
+        telemetry_emit(tlm, TELEMETRY_FRAME_SAMPLE, frame, len, tlm->seq++);
+        return;
+    }
+
+    /* Delta: room for the longest sample, otherwise a new frame */
+    if (tlm->pending > 0 && tlm->pending_len + tlm->count * TELEMETRY_VARINT_MAX > TELEMETRY_PAYLOAD_MAX)
+    {
+        telemetry_flush(tlm);
+    }
+    if (tlm->pending == 0)
+    {
+        tlm->pending_seq = tlm->seq;
+        tlm->pending_len = 0;
+    }
+
+    payload = &tlm->frame[TELEMETRY_HEADER_SIZE];
+    for (uint8_t i = 0; i < tlm->count; i++)
+    {
+        int32_t delta = (int32_t)((uint32_t)wire[i] - (uint32_t)tlm->ref[i]);
+
+        /* Time stamp: change of the step (0 for a steady tick) */
+        if (i == 0 && tlm->channels[0].type == TELEMETRY_TYPE_U32)
+        {
+            int32_t step = delta;
+
+            delta = (int32_t)((uint32_t)step - (uint32_t)tlm->step);
+            tlm->step = step;
+        }
+        tlm->pending_len += telemetry_varint_encode(delta, &payload[tlm->pending_len]);
+        tlm->ref[i] = wire[i];
+    }
+    tlm->pending++;
+    tlm->seq++;
+    tlm->since_key++;
+
+    if (tlm->pending >= tlm->batch)
+    {
+        telemetry_flush(tlm);
+    }
+}
+
+/**
+ * @brief Switch delta compression on or off (sends the open delta frame)
+ *
+ * @param[in,out] tlm Pointer to telemetry structure
+ * @param[in] batch Samples per delta frame (1 - TELEMETRY_BATCH_MAX), 0 for plain sample frames
+ */
+void telemetry_set_batch(telemetry_t *tlm, uint8_t batch)
+{
+    telemetry_flush(tlm);
+    tlm->batch = batch > TELEMETRY_BATCH_MAX ? TELEMETRY_BATCH_MAX : batch;
+    tlm->since_key = TELEMETRY_KEYFRAME_INTERVAL;
+}
+
+/**
+ * @brief Send the open delta frame, if any
+ *
+ * @param[in,out] tlm Pointer to telemetry structure
+ */
+void telemetry_flush(telemetry_t *tlm)
+{
+    if (tlm->pending == 0)
+    {
+        return;
+    }
+
+    tlm->pending = 0;
+    telemetry_emit(tlm, TELEMETRY_FRAME_DELTA, tlm->frame, tlm->pending_len, tlm->pending_seq);
+}
+
+/**
+ * @brief Account for samples that were never sent (the decoder counts them as lost)
+ *
+ * @param[in,out] tlm Pointer to telemetry structure
+ * @param[in] count Number of samples skipped
+ */
+void telemetry_skip(telemetry_t *tlm, uint16_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    /* The delta frame must not span the gap, and the decoder resyncs on a keyframe */
+    telemetry_flush(tlm);
+    tlm->seq += count;
+    tlm->since_key = TELEMETRY_KEYFRAME_INTERVAL;
+}
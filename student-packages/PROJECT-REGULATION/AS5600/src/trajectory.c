@@ -0,0 +1,320 @@
+/**
+ * @file trajectory.c
+ * @brief Rate-, acceleration- and jerk-limited setpoint generator implementation
+ */
+
+#include "trajectory.h"
+
+/**
+ * @brief Distance and velocity below which the target counts as reached
+ */
+#define TRAJ_POS_EPS FIX16_FROM_FLOAT(0.01) /* deg */
+#define TRAJ_VEL_EPS FIX16_FROM_FLOAT(0.05) /* deg/s */
+
+/**
+ * @brief Initialize the generator at rest
+ *
+ * @param[out] traj Pointer to trajectory structure
+ * @param[in] rate_hz Tick rate in Hz
+ * @param[in] pos Initial position (deg)
+ */
+void traj_init(traj_t *traj, uint32_t rate_hz, fix16_t pos)
+{
+    traj->rate_hz = rate_hz;
+    traj_set_limits(traj, TRAJ_PROFILE_SCURVE, TRAJ_VEL_MAX_DEFAULT,
+                    TRAJ_ACC_MAX_DEFAULT, TRAJ_JERK_MAX_DEFAULT);
+    traj_reset(traj, pos);
+}
+
+/**
+ * @brief Set the profile type and limits
+ *
+ * @param[in,out] traj Pointer to trajectory structure
+ * @param[in] profile Profile type
+ * @param[in] vel_max Velocity limit (deg/s, > 0)
+ * @param[in] acc_max Acceleration limit (deg/s^2, > 0)
+ * @param[in] jerk_max Jerk limit (deg/s^3, > 0, S-curve only)
+ */
+void traj_set_limits(traj_t *traj, traj_profile_t profile,
+                     fix16_t vel_max, fix16_t acc_max, fix16_t jerk_max)
+{
+    traj->profile = profile;
+    traj->vel_max = vel_max > 0 ? fix16_clamp(vel_max, 1, TRAJ_VEL_MAX_LIMIT) : TRAJ_VEL_MAX_DEFAULT;
+    traj->acc_max = acc_max > 0 ? fix16_clamp(acc_max, 1, TRAJ_ACC_MAX_LIMIT) : TRAJ_ACC_MAX_DEFAULT;
+    traj->jerk_max = jerk_max > 0 ? fix16_clamp(jerk_max, 1, TRAJ_JERK_MAX_LIMIT) : TRAJ_JERK_MAX_DEFAULT;
+
+    /* Whole jerk steps per tick, so the braking arithmetic uses the jerk actually applied */
+    traj->jerk_max -= traj->jerk_max % (fix16_t)traj->rate_hz;
+    traj->jerk_max = traj->jerk_max > 0 ? traj->jerk_max : (fix16_t)traj->rate_hz;
+}
+
+/**
+ * @brief Set a new target; the reference moves there along the profile
+ *
+ * @param[in,out] traj Pointer to trajectory structure
+ * @param[in] target Target position (deg)
+ */
+void traj_set_target(traj_t *traj, fix16_t target)
+{
+    traj->target = target;
+    traj->done = 0;
+
+    if (traj->profile == TRAJ_PROFILE_STEP)
+    {
+        traj_reset(traj, target);
+    }
+}
+
+/**
+ * @brief Put the reference at a position at rest (target = position)
+ *
+ * @param[in,out] traj Pointer to trajectory structure
+ * @param[in] pos Position (deg)
+ */
+void traj_reset(traj_t *traj, fix16_t pos)
+{
+    traj->target = pos;
+    traj->pos = pos;
+    traj->vel = 0;
+    traj->acc = 0;
+    traj->done = 1;
+}
+
+/**
+ * @brief Braking distance of a trapezoidal profile: v^2 / (2a)
+ *
+ * @param[in] traj Pointer to trajectory structure
+ * @param[in] vel Speed towards the target (deg/s, >= 0)
+ *
+ * @return Braking distance (deg)
+ */
+static fix16_t traj_stop_distance_trapezoid(const traj_t *traj, fix16_t vel)
+{
+    return fix16_sat(((int64_t)vel * vel) / (2 * (int64_t)traj->acc_max));
+}
+
+/**
+ * @brief Braking distance of a jerk-limited profile started right now
+ *
+ * The braking manoeuvre ramps the acceleration from its current value down
+ * to -peak with maximum jerk, holds -peak if needed and ramps back to zero,
+ * ending at zero velocity. peak is acc_max, or less for short manoeuvres.
+ * Moving away from the target (vel < 0, acc > 0), a peak of zero means the
+ * acceleration only has to be ramped out, and the result is the excursion
+ * towards the target on the way.
+ *
+ * @param[in] traj Pointer to trajectory structure
+ * @param[in] vel Speed towards the target (deg/s, >= 0 or acc > 0)
+ * @param[in] acc Acceleration towards the target (deg/s^2)
+ * @param[out] peak Peak deceleration of the manoeuvre (deg/s^2, >= 0)
+ *
+ * @return Braking distance (deg)
+ */
+static fix16_t traj_stop_distance_scurve(const traj_t *traj, fix16_t vel, fix16_t acc, fix16_t *peak)
+{
+    const fix16_t jerk = traj->jerk_max;
+    fix16_t t1, t2, t3, v1, v2;
+    int64_t dist, peak_sq;
+
+    /* Triangular deceleration: peak^2 = jerk * vel + acc^2 / 2 */
+    peak_sq = (int64_t)jerk * vel + ((int64_t)acc * acc) / 2;
+    if (peak_sq >= (int64_t)traj->acc_max * traj->acc_max)
+    {
+        *peak = traj->acc_max;
+    }
+    else if (peak_sq <= 0)
+    {
+        *peak = 0;
+    }
+    else
+    {
+        *peak = (fix16_t)fix16_isqrt64((uint64_t)peak_sq);
+    }
+
+    /* Phase 1: acc -> -peak */
+    t1 = fix16_div(acc + *peak, jerk);
+    dist = (int64_t)fix16_mul(vel, t1) + fix16_mul(fix16_mul(acc, t1), t1) / 2 -
+           fix16_mul(fix16_mul(fix16_mul(jerk, t1), t1), t1) / 6;
+    v1 = fix16_sat((int64_t)vel + fix16_mul(acc, t1) - fix16_mul(fix16_mul(jerk, t1), t1) / 2);
+
+    /* Phase 2: hold -peak until the final ramp brings the velocity to zero */
+    t3 = fix16_div(*peak, jerk);
+    v2 = fix16_mul(*peak, t3) / 2;
+    t2 = v1 > v2 ? fix16_div(v1 - v2, *peak) : 0;
+    dist += (int64_t)fix16_mul(v1, t2) - fix16_mul(fix16_mul(*peak, t2), t2) / 2;
+
+    /* Phase 3: -peak -> 0 */
+    dist += (int64_t)fix16_mul(v2, t3) - fix16_mul(fix16_mul(*peak, t3), t3) / 2 +
+            fix16_mul(fix16_mul(fix16_mul(jerk, t3), t3), t3) / 6;
+
+    return fix16_sat(dist);
+}
+
+/**
+ * @brief Largest acceleration that can be ramped out within a velocity change
+ *
+ * Ramping a out one jerk step s per tick changes the velocity by
+ * (a + s) * a / (2 * jerk) when a is a whole number of steps, and by up to
+ * s^2 / (8 * jerk) more in between: a = sqrt(2 * jerk * dv) - s / 2 always
+ * reaches zero acceleration within dv.
+ *
+ * @param[in] traj Pointer to trajectory structure
+ * @param[in] dv Velocity change (deg/s, >= 0)
+ *
+ * @return Acceleration (deg/s^2, 0 to acc_max)
+ */
+static fix16_t traj_ramp_acc(const traj_t *traj, int64_t dv)
+{
+    const uint32_t half_step = (uint32_t)(traj->jerk_max / (fix16_t)traj->rate_hz) / 2;
+    uint32_t acc = fix16_isqrt64(2 * (uint64_t)traj->jerk_max * (uint64_t)dv);
+
+    /* The root may exceed INT32_MAX (up to 2 * TRAJ_VEL_MAX_LIMIT of dv) */
+    acc = acc > half_step ? acc - half_step : 0;
+    return acc < (uint32_t)traj->acc_max ? (fix16_t)acc : traj->acc_max;
+}
+
+/**
+ * @brief Acceleration that brings the velocity to the limit without overshoot
+ *
+ * @param[in] traj Pointer to trajectory structure
+ * @param[in] vel Speed towards the target (deg/s)
+ *
+ * @return Acceleration demand (deg/s^2)
+ */
+static fix16_t traj_cruise_acc(const traj_t *traj, fix16_t vel)
+{
+    int64_t dv = (int64_t)traj->vel_max - vel;
+
+    return dv >= 0 ? traj_ramp_acc(traj, dv) : -traj_ramp_acc(traj, -dv);
+}
+
+/**
+ * @brief Advance the profile by one tick
+ *
+ * @param[in,out] traj Pointer to trajectory structure
+ *
+ * @return Reference position (deg); velocity and acceleration are in traj->vel / traj->acc
+ */
+fix16_t traj_step(traj_t *traj)
+{
+    const int32_t rate = (int32_t)traj->rate_hz;
+    fix16_t d, dist, vel, acc, acc_des, peak, vel_prev, acc_prev;
+    int dir;
+
+    if (traj->done)
+    {
+        return traj->pos;
+    }
+
+    /* Work in the direction of the target */
+    d = traj->target - traj->pos;
+    dir = d >= 0 ? 1 : -1;
+    dist = fix16_abs(d);
+    vel = dir * traj->vel;
+    acc = dir * traj->acc;
+    vel_prev = traj->vel;
+    acc_prev = traj->acc;
+
+    if (traj->profile == TRAJ_PROFILE_SCURVE)
+    {
+        const fix16_t jerk_step = traj->jerk_max / rate;
+
+        /*
+         * Final ramp: a linear acceleration ramp from -a to 0 that ends at rest
+         * covers 2/3 * v^2 / a, so a = 2/3 * v^2 / dist lands on the target.
+         * The ramp starts once the deceleration can just be ramped out before
+         * the velocity reaches zero, and a is then tracked within the jerk
+         * limit and kept within what can still be ramped out: the reference
+         * comes to rest with zero acceleration, close enough to the target
+         * for the snap below or for a short new move.
+         */
+        uint64_t land = 0;
+        fix16_t acc_stop = 0;
+
+        if (vel > 0)
+        {
+            land = (2 * (uint64_t)vel * (uint64_t)vel) / (3 * (uint64_t)dist + (uint64_t)vel / (2 * rate) + 1);
+            acc_stop = traj_ramp_acc(traj, vel);
+        }
+
+        /* At rest within reach of the snap: only ramp the acceleration out */
+        if (fix16_abs(vel) < TRAJ_VEL_EPS && dist < TRAJ_POS_EPS)
+        {
+            acc_des = 0;
+        }
+        else if (vel > 0 && acc < 0 && -acc >= acc_stop)
+        {
+            acc_des = -(land < (uint64_t)acc_stop ? (fix16_t)land : acc_stop);
+        }
+        else
+        {
+            /*
+             * Brake unless one more tick towards the cruise velocity leaves
+             * enough distance to brake from: braking starts one tick early
+             * rather than late, and the final ramp takes up the slack.
+             */
+            fix16_t acc_next, vel_next, dist_next;
+
+            acc_des = traj_cruise_acc(traj, vel);
+            acc_next = acc + fix16_clamp(acc_des - acc, -jerk_step, jerk_step);
+            vel_next = vel + acc_next / rate;
+            dist_next = dist - (fix16_t)(((int64_t)vel + vel_next) / (2 * rate));
+            if ((vel_next > 0 || acc_next > 0) &&
+                traj_stop_distance_scurve(traj, vel_next, acc_next, &peak) >= dist_next)
+            {
+                acc_des = -peak;
+            }
+        }
+
+        acc += fix16_clamp(acc_des - acc, -jerk_step, jerk_step);
+        vel += acc / rate;
+    }
+    else
+    {
+        /* Brake one tick early so the landing deceleration stays within the limit */
+        if (vel > 0 && traj_stop_distance_trapezoid(traj, vel) >= dist - vel / rate)
+        {
+            /* Constant deceleration v^2 / (2 * dist) lands exactly on the target */
+            int64_t land = ((int64_t)vel * vel) / (2 * (int64_t)(dist > 0 ? dist : 1));
+
+            acc = -(fix16_t)(land < traj->acc_max ? land : traj->acc_max);
+            vel += acc / rate;
+            vel = vel > 0 ? vel : 0;
+        }
+        else
+        {
+            /* Accelerate towards the velocity limit without stepping past it */
+            fix16_t vel_new = vel < traj->vel_max ? vel + traj->acc_max / rate
+                                                  : vel - traj->acc_max / rate;
+
+            if ((vel < traj->vel_max) != (vel_new < traj->vel_max))
+            {
+                vel_new = traj->vel_max;
+            }
+            acc = (vel_new - vel) * rate;
+            vel = vel_new;
+        }
+    }
+
+    traj->vel = dir * vel;
+    traj->acc = dir * acc;
+
+    /* Trapezoidal integration of the velocity */
+    traj->pos += (fix16_t)(((int64_t)vel_prev + traj->vel) / (2 * rate));
+
+    /*
+     * Snap onto the target once reached, or once crossed with no more than one
+     * tick worth of acceleration left. Crossing faster (target moved too close
+     * to stop in time) turns the reference around instead. The S-curve snaps
+     * only from within one jerk step of zero acceleration.
+     */
+    d = traj->target - traj->pos;
+    if ((traj->profile != TRAJ_PROFILE_SCURVE || fix16_abs(acc_prev) <= traj->jerk_max / rate) &&
+        (fix16_abs(traj->vel) < TRAJ_VEL_EPS ? fix16_abs(d) < TRAJ_POS_EPS || (d >= 0 ? 1 : -1) != dir
+                                             : (d >= 0 ? 1 : -1) != dir && fix16_abs(traj->vel) <= traj->acc_max / rate))
+    {
+        traj_reset(traj, traj->target);
+    }
+
+    return traj->pos;
+}